@@ -0,0 +1,162 @@
+// Offline asset cooker : turns gltf / glb / obj / fbx files into .vrbundle files that Model::LoadModel()
+// uploads without importing, decoding or compressing anything at startup.
+// runs headless, no vulkan device is created.
+#include "Model/ModelImporter.hpp"
+#include "Model/ModelCache.hpp"
+#include "Model/TextureCompression.hpp"
+#include "Tools/ThreadPool.hpp"
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct CookSettings {
+	ModelLoadOptions options;
+	std::string outputDirectory;	// empty -> next to every input
+	bool compress = true;			// BC1 / BC3 textures, RGBA8 otherwise
+	bool reencode = false;			// BC7 / ASTC ktx2 / dds files are decoded and stored like any other image
+	uint32_t threads = 0;			// 0 -> hardware threads - 1
+};
+
+static void PrintUsage() {
+	printf("usage : AssetCooker <file or directory>... [options]\n"
+		"  -o <directory>      write bundles there instead of next to the sources\n"
+		"  --no-compress       keep textures as rgba8 instead of BC1 / BC3\n"
+		"  --reencode          decode BC7 / ASTC files and store them as BC1 / BC3 (rgba8 with --no-compress),\n"
+		"                      for targets that can't sample them\n"
+		"  --no-optimize       skip the vertex cache / overdraw / fetch optimization\n"
+		"  --no-meshlets       don't build meshlets\n"
+		"  --lods <n>          levels of detail per mesh including the full one (default 4)\n"
+		"  --threads <n>       worker threads, 0 = hardware threads - 1 (default)\n");
+}
+
+static bool IsModelFile(const fs::path& path) {
+	std::string extension = path.extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return extension == ".gltf" || extension == ".glb" || extension == ".obj" || extension == ".fbx";
+}
+
+static std::string GetBundlePath(const std::string& fn, const CookSettings& settings) {
+	fs::path source(fn);
+	fs::path directory = settings.outputDirectory.empty() ? source.parent_path() : fs::path(settings.outputDirectory);
+	return (directory / source.stem()).string() + ModelCache::BUNDLE_EXTENSION;
+}
+
+//import, compress and write one model. throws on failure
+static void CookModel(const std::string& fn, const CookSettings& settings, ThreadPool& workers) {
+	auto start = std::chrono::steady_clock::now();
+	ModelImporter importer;
+	if (settings.reencode) {
+		uint32_t decoded = TextureCompression::GetEncodingBit(TextureEncoding::BC7) | TextureCompression::GetEncodingBit(TextureEncoding::ASTC4x4) |
+			TextureCompression::GetEncodingBit(TextureEncoding::ASTC6x6) | TextureCompression::GetEncodingBit(TextureEncoding::ASTC8x8);
+		importer.SetSampledEncodings(~decoded);
+	}
+	importer.Read(fn, workers);
+	importer.Process(settings.options, workers, true);
+	std::vector<ImportedTexture>& textures = importer.GetTextures();
+	std::vector<std::vector<uint8_t>> payloads(textures.size());
+	std::vector<TextureEncoding> encodings(textures.size(), TextureEncoding::RGBA8);
+	workers.ParallelFor(textures.size(), [&](size_t i) {
+		ImportedTexture& texture = textures[i];
+		uint32_t width = texture.image.width, height = texture.image.height;
+		//ktx2 / dds textures keep the encoding they were stored in, unless --reencode decoded them to rgba8
+		encodings[i] = texture.encoding;
+		if (settings.compress && !TextureCompression::IsBlockCompressed(texture.encoding)) {
+			encodings[i] = TextureCompression::ChooseEncoding(texture.mipChain.data(), width, height);
+			payloads[i] = TextureCompression::CompressMipChain(texture.mipChain, width, height, texture.mipLevels, encodings[i]);
+			std::vector<uint8_t>().swap(texture.mipChain);
+		}
+		else {
+			payloads[i] = std::move(texture.mipChain);
+		}
+	});
+	ModelCache::Writer writer;
+	for (const auto& mesh : importer.GetMeshes()) writer.AddMesh(mesh);
+	for (size_t i = 0; i < textures.size(); i++) {
+		const ImportedTexture& texture = textures[i];
+		writer.AddTexture(texture.path, texture.image.width, texture.image.height, texture.mipLevels, texture.image.nChannels, texture.sRGB, encodings[i], payloads[i], texture.contentHash);
+	}
+	std::string bundlePath = GetBundlePath(fn, settings);
+	uint64_t written = writer.Save(bundlePath, ModelCache::HashFile(fn), ModelCache::HashOptions(settings.options), ModelCache::FLAG_BUNDLE);
+	if (written == 0) {
+		throw std::runtime_error("failed to write " + bundlePath);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("Cooked %s -> %s : %zu meshes, %zu textures, %.2f MB in %.2f s\n", fn.c_str(), bundlePath.c_str(),
+		importer.GetMeshes().size(), textures.size(), written / (1024.0 * 1024.0), seconds);
+}
+
+int main(int argc, char** argv) {
+	CookSettings settings;
+	std::vector<std::string> inputs;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "-o" && hasValue) settings.outputDirectory = argv[++i];
+		else if (arg == "--no-compress") settings.compress = false;
+		else if (arg == "--reencode") settings.reencode = true;
+		else if (arg == "--no-optimize") settings.options.optimizeGeometry = false;
+		else if (arg == "--no-meshlets") settings.options.buildMeshlets = false;
+		else if (arg == "--lods" && hasValue) settings.options.lodCount = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+		else if (arg == "--threads" && hasValue) settings.threads = static_cast<uint32_t>(std::max(0, std::atoi(argv[++i])));
+		else if (arg == "-h" || arg == "--help") {
+			PrintUsage();
+			return 0;
+		}
+		else if (!arg.empty() && arg[0] == '-') {
+			printf("unknown option %s\n", arg.c_str());
+			PrintUsage();
+			return 1;
+		}
+		else inputs.push_back(arg);
+	}
+	if (inputs.empty()) {
+		PrintUsage();
+		return 1;
+	}
+	//directories are searched recursively
+	std::vector<std::string> files;
+	for (const auto& input : inputs) {
+		std::error_code error;
+		if (fs::is_directory(input, error)) {
+			for (const auto& entry : fs::recursive_directory_iterator(input, error)) {
+				if (entry.is_regular_file() && IsModelFile(entry.path())) files.push_back(entry.path().generic_string());
+			}
+		}
+		else if (fs::is_regular_file(input, error)) {
+			files.push_back(fs::path(input).generic_string());
+		}
+		else {
+			printf("skipping %s : not found\n", input.c_str());
+		}
+	}
+	if (!settings.outputDirectory.empty()) {
+		std::error_code error;
+		fs::create_directories(settings.outputDirectory, error);
+	}
+	ThreadPool workers;
+	workers.Init(settings.threads);
+	//models run side by side, each one spreads its meshes and images over the same workers
+	std::atomic<uint32_t> failed{ 0 };
+	auto start = std::chrono::steady_clock::now();
+	workers.ParallelFor(files.size(), [&](size_t i) {
+		try {
+			CookModel(files[i], settings, workers);
+		}
+		catch (const std::exception& e) {
+			fprintf(stderr, "failed to cook %s : %s\n", files[i].c_str(), e.what());
+			failed++;
+		}
+	});
+	workers.Clean();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("%zu of %zu models cooked in %.2f s\n", files.size() - failed, files.size(), seconds);
+	return failed > 0 ? 1 : 0;
+}
@@ -16,13 +16,21 @@ layout(push_constant) uniform VertexShaderPushConstant{
 }pushed_Mat;
 
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
+layout(location = 1) in vec2 inNormal;	// octahedral, CompactAttributes
 layout(location = 2) in vec2 inTexCoord;
 
+vec3 DecodeOctahedral(vec2 e){
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
 void main(){
 	gl_Position = ubo.proj * ubo.view * pushed_Mat.model * vec4(inPosition,1.0f);
 	texCoord = inTexCoord;
-	outNormal = normalize((pushed_Mat.model * vec4(inNormal,0.0f)).xyz);
+	outNormal = normalize((pushed_Mat.model * vec4(DecodeOctahedral(inNormal),0.0f)).xyz);
 	worldPos = (pushed_Mat.model * vec4(inPosition, 1.0f)).xyz;
 	lightSpaceFragPos = ubo.lightSpaceMat * pushed_Mat.model * vec4(inPosition,1.0f);
 	lightProj = ubo.lightSpaceMat;
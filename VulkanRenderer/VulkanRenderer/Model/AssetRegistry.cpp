@@ -0,0 +1,173 @@
+#include "AssetRegistry.hpp"
+#include "ModelCache.hpp"
+#include <unordered_map>
+#include <mutex>
+#include <filesystem>
+#include <algorithm>
+#include <cctype>
+#include <utility>
+
+namespace AssetRegistry {
+	namespace {
+		struct Stamp {
+			uint64_t size = 0;
+			int64_t time = 0;
+			bool operator==(const Stamp& rhs) const { return size == rhs.size && time == rhs.time; }
+		};
+		//zero when the file can't be read, e.g. the quad or a generated texture
+		Stamp GetStamp(const std::string& file) {
+			Stamp stamp;
+			if (!ModelCache::GetFileStamp(file, stamp.size, stamp.time)) return Stamp{};
+			return stamp;
+		}
+
+		template<typename T>
+		struct Table {
+			struct Entry {
+				std::weak_ptr<T> asset;
+				std::string file;	//canonical path without the "#..." suffix
+				Stamp stamp;
+			};
+			std::unordered_map<std::string, Entry> byPath;
+			std::unordered_map<uint64_t, std::weak_ptr<T>> byHash;
+			size_t pruneAt = 64;
+			size_t hits = 0;
+
+			std::shared_ptr<T> Find(const std::string& key) {
+				auto it = byPath.find(key);
+				if (it == byPath.end()) return nullptr;
+				std::shared_ptr<T> asset = it->second.asset.lock();
+				if (asset == nullptr || !(GetStamp(it->second.file) == it->second.stamp)) {
+					byPath.erase(it);
+					return nullptr;
+				}
+				hits++;
+				return asset;
+			}
+			std::shared_ptr<T> Find(uint64_t key) {
+				auto it = byHash.find(key);
+				if (it == byHash.end()) return nullptr;
+				std::shared_ptr<T> asset = it->second.lock();
+				if (asset == nullptr) {
+					byHash.erase(it);
+					return nullptr;
+				}
+				hits++;
+				return asset;
+			}
+			void Add(const std::string& key, const std::string& file, uint64_t hashKey, bool hasHash, const std::shared_ptr<T>& asset) {
+				byPath[key] = Entry{ asset, file, GetStamp(file) };
+				if (hasHash) byHash[hashKey] = asset;
+				//entries of released assets are dropped lazily, a full pass only once the table has doubled
+				if (byPath.size() + byHash.size() < pruneAt) return;
+				for (auto it = byPath.begin(); it != byPath.end();) {
+					it = it->second.asset.expired() ? byPath.erase(it) : std::next(it);
+				}
+				for (auto it = byHash.begin(); it != byHash.end();) {
+					it = it->second.expired() ? byHash.erase(it) : std::next(it);
+				}
+				pruneAt = std::max<size_t>(64, (byPath.size() + byHash.size()) * 2);
+			}
+			size_t CountAlive() const {
+				size_t alive = 0;
+				for (const auto& entry : byPath) alive += entry.second.asset.expired() ? 0 : 1;
+				return alive;
+			}
+		};
+
+		std::mutex mutex;
+		Table<Texture> textures;
+		Table<MeshSet> meshSets;
+
+		//canonical path with its "#..." suffix and the canonical path of the file alone
+		std::pair<std::string, std::string> SplitPath(const std::string& path) {
+			//embedded images are named after their model file
+			std::string file = path, suffix;
+			size_t split = path.rfind('#');
+			if (split != std::string::npos && !std::filesystem::exists(path)) {
+				file = path.substr(0, split);
+				suffix = path.substr(split);
+			}
+			std::error_code error;
+			std::filesystem::path canonical = std::filesystem::weakly_canonical(file, error);
+			if (error) canonical = std::filesystem::absolute(file, error);
+			file = canonical.lexically_normal().generic_string();
+#ifdef _WIN32
+			std::transform(file.begin(), file.end(), file.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+#endif
+			return { file + suffix, file };
+		}
+		std::string TextureKey(const std::string& canonical, bool sRGB) {
+			return canonical + (sRGB ? "|srgb" : "|linear");
+		}
+		uint64_t TextureHashKey(uint64_t contentHash, bool sRGB) {
+			uint32_t flag = sRGB ? 1 : 0;
+			return ModelCache::Hash(&flag, sizeof(flag), contentHash);
+		}
+		std::string MeshSetKey(const std::string& canonical, uint64_t optionsHash) {
+			return canonical + "|" + std::to_string(optionsHash);
+		}
+		uint64_t MeshSetHashKey(uint64_t contentHash, uint64_t optionsHash) {
+			return ModelCache::Hash(&optionsHash, sizeof(optionsHash), contentHash);
+		}
+	}
+
+	std::string CanonicalPath(const std::string& path) {
+		return SplitPath(path).first;
+	}
+
+	uint64_t HashMeshOptions(const ModelLoadOptions& options) {
+		struct {
+			uint64_t cached;
+			uint32_t vertexFormat;
+			uint32_t retention;
+		} key = { ModelCache::HashOptions(options), static_cast<uint32_t>(options.vertexFormat), static_cast<uint32_t>(options.retention) };
+		return ModelCache::Hash(&key, sizeof(key));
+	}
+
+	std::shared_ptr<Texture> FindTexture(const std::string& path, bool sRGB) {
+		std::string key = TextureKey(CanonicalPath(path), sRGB);
+		std::lock_guard<std::mutex> lock(mutex);
+		return textures.Find(key);
+	}
+
+	std::shared_ptr<Texture> FindTexture(uint64_t contentHash, bool sRGB) {
+		if (contentHash == 0) return nullptr;
+		std::lock_guard<std::mutex> lock(mutex);
+		return textures.Find(TextureHashKey(contentHash, sRGB));
+	}
+
+	void AddTexture(const std::string& path, uint64_t contentHash, bool sRGB, const std::shared_ptr<Texture>& texture) {
+		auto split = SplitPath(path);
+		std::lock_guard<std::mutex> lock(mutex);
+		textures.Add(TextureKey(split.first, sRGB), split.second, TextureHashKey(contentHash, sRGB), contentHash != 0, texture);
+	}
+
+	std::shared_ptr<MeshSet> FindMeshSet(const std::string& path, uint64_t optionsHash) {
+		std::string key = MeshSetKey(CanonicalPath(path), optionsHash);
+		std::lock_guard<std::mutex> lock(mutex);
+		return meshSets.Find(key);
+	}
+
+	std::shared_ptr<MeshSet> FindMeshSet(uint64_t contentHash, uint64_t optionsHash) {
+		if (contentHash == 0) return nullptr;
+		std::lock_guard<std::mutex> lock(mutex);
+		return meshSets.Find(MeshSetHashKey(contentHash, optionsHash));
+	}
+
+	void AddMeshSet(const std::string& path, uint64_t contentHash, uint64_t optionsHash, const std::shared_ptr<MeshSet>& set) {
+		auto split = SplitPath(path);
+		std::lock_guard<std::mutex> lock(mutex);
+		meshSets.Add(MeshSetKey(split.first, optionsHash), split.second, MeshSetHashKey(contentHash, optionsHash), contentHash != 0, set);
+	}
+
+	Stats GetStats() {
+		std::lock_guard<std::mutex> lock(mutex);
+		Stats stats;
+		stats.textures = textures.CountAlive();
+		stats.meshSets = meshSets.CountAlive();
+		stats.textureHits = textures.hits;
+		stats.meshSetHits = meshSets.hits;
+		return stats;
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#ifndef ASSET_REGISTRY_HPP
+#define ASSET_REGISTRY_HPP
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "Model.hpp"
+
+// gpu content of one model file as its load left it, shared by every Model instancing the file
+struct MeshSet {
+	std::shared_ptr<GeometryArena> geometry;
+	std::vector<Mesh> meshes;		//Mesh::Instance() copies, material indices point into textures
+	std::vector<std::shared_ptr<Texture>> textures;
+	VkDeviceSize attributeOffset = 0;
+	VkDeviceSize index32Offset = 0;
+	VkDeviceSize index16Offset = 0;
+	VkDeviceSize meshletTableOffset = 0;
+	uint32_t meshletTableCount = 0;
+	VertexFormat vertexFormat = VertexFormat::Compact;
+	Bounds bounds;
+	MeshOptimizer::Report optimizeReport;
+	size_t meshletCount = 0;
+	size_t lodCount = 0;
+};
+
+// Process wide lookup of the gpu assets some Model still holds, so loading a file twice or two models using the same
+// image keep one gpu copy. entries are weak, an asset goes away with the last Model using it.
+// keys : canonical path (checked against the file's size and time, an edited file loads again) or content hash,
+// which finds the same bytes under another name (embedded images, copied files). one hash map probe per lookup.
+// thread safe.
+namespace AssetRegistry {
+	struct Stats {
+		size_t textures = 0;		//alive
+		size_t meshSets = 0;
+		size_t textureHits = 0;		//since start
+		size_t meshSetHits = 0;
+	};
+	//absolute and normalized, case folded on windows. "file.glb#image0" keeps its suffix
+	std::string CanonicalPath(const std::string& path);
+	//the load options a mesh set depends on : the cached data, the vertex format and the retention
+	uint64_t HashMeshOptions(const ModelLoadOptions& options);
+
+	//sRGB is part of the key, the same image sampled linearly is another texture
+	std::shared_ptr<Texture> FindTexture(const std::string& path, bool sRGB);
+	//contentHash == 0 -> nullptr
+	std::shared_ptr<Texture> FindTexture(uint64_t contentHash, bool sRGB);
+	//call once the texture's upload is recorded, contentHash == 0 -> path key only
+	void AddTexture(const std::string& path, uint64_t contentHash, bool sRGB, const std::shared_ptr<Texture>& texture);
+
+	std::shared_ptr<MeshSet> FindMeshSet(const std::string& path, uint64_t optionsHash);
+	std::shared_ptr<MeshSet> FindMeshSet(uint64_t contentHash, uint64_t optionsHash);
+	void AddMeshSet(const std::string& path, uint64_t contentHash, uint64_t optionsHash, const std::shared_ptr<MeshSet>& set);
+
+	Stats GetStats();
+}
+
+#endif // !ASSET_REGISTRY_HPP
@@ -0,0 +1,539 @@
+#include "AstcDecoder.hpp"
+#include <algorithm>
+
+namespace {
+	constexpr uint32_t MAX_WEIGHTS = 64;
+	constexpr uint32_t MAX_COLOR_VALUES = 18;
+	//quantization levels of the integer sequence encoding, in the spec's order
+	struct Range {
+		uint8_t trits, quints, bits;
+	};
+	constexpr Range RANGES[21] = {
+		{ 0, 0, 1 }, { 1, 0, 0 }, { 0, 0, 2 }, { 0, 1, 0 }, { 1, 0, 1 }, { 0, 0, 3 }, { 0, 1, 1 },
+		{ 1, 0, 2 }, { 0, 0, 4 }, { 0, 1, 2 }, { 1, 0, 3 }, { 0, 0, 5 }, { 0, 1, 3 }, { 1, 0, 4 },
+		{ 0, 0, 6 }, { 0, 1, 4 }, { 1, 0, 5 }, { 0, 0, 7 }, { 0, 1, 5 }, { 1, 0, 6 }, { 0, 0, 8 }
+	};
+	constexpr uint32_t RANGE_6 = 4;		//fewest levels color endpoints may use
+
+	//little endian bits, everything at or past end reads as 0
+	struct BitReader {
+		const uint8_t* data;
+		uint32_t position;
+		uint32_t end;
+		uint32_t Read(uint32_t count) {
+			uint32_t value = 0;
+			for (uint32_t i = 0; i < count; i++, position++) {
+				if (position < end) value |= ((data[position >> 3] >> (position & 7)) & 1u) << i;
+			}
+			return value;
+		}
+	};
+	uint32_t GetBits(const uint8_t* data, uint32_t start, uint32_t count) {
+		BitReader reader{ data, start, 128 };
+		return reader.Read(count);
+	}
+	uint8_t ReverseByte(uint8_t b) {
+		b = static_cast<uint8_t>((b & 0xF0) >> 4 | (b & 0x0F) << 4);
+		b = static_cast<uint8_t>((b & 0xCC) >> 2 | (b & 0x33) << 2);
+		return static_cast<uint8_t>((b & 0xAA) >> 1 | (b & 0x55) << 1);
+	}
+	//value of bits bits repeated until it fills to bits
+	uint32_t Replicate(uint32_t value, uint32_t bits, uint32_t to) {
+		if (bits == 0) return 0;
+		uint32_t result = 0;
+		for (int shift = int(to) - int(bits); shift > -int(bits); shift -= int(bits)) {
+			result |= shift >= 0 ? value << shift : value >> -shift;
+		}
+		return result & ((1u << to) - 1);
+	}
+
+	uint32_t GetIseBitCount(uint32_t range, uint32_t count) {
+		const Range& r = RANGES[range];
+		return r.bits * count + (r.trits ? (8 * count + 4) / 5 : 0) + (r.quints ? (7 * count + 2) / 3 : 0);
+	}
+	void DecodeTrits(uint32_t T, uint32_t t[5]) {
+		uint32_t C;
+		if (((T >> 2) & 7) == 7) {
+			C = (((T >> 5) & 7) << 2) | (T & 3);
+			t[4] = t[3] = 2;
+		}
+		else {
+			C = T & 0x1F;
+			if (((T >> 5) & 3) == 3) {
+				t[4] = 2;
+				t[3] = (T >> 7) & 1;
+			}
+			else {
+				t[4] = (T >> 7) & 1;
+				t[3] = (T >> 5) & 3;
+			}
+		}
+		if ((C & 3) == 3) {
+			t[2] = 2;
+			t[1] = (C >> 4) & 1;
+			t[0] = (((C >> 3) & 1) << 1) | ((C >> 2) & ~(C >> 3) & 1);
+		}
+		else if (((C >> 2) & 3) == 3) {
+			t[2] = t[1] = 2;
+			t[0] = C & 3;
+		}
+		else {
+			t[2] = (C >> 4) & 1;
+			t[1] = (C >> 2) & 3;
+			t[0] = (((C >> 1) & 1) << 1) | (C & ~(C >> 1) & 1);
+		}
+	}
+	void DecodeQuints(uint32_t Q, uint32_t q[3]) {
+		if (((Q >> 1) & 3) == 3 && ((Q >> 5) & 3) == 0) {
+			uint32_t low = Q & 1;
+			q[2] = (low << 2) | ((((Q >> 4) & ~low) & 1) << 1) | ((Q >> 3) & ~low & 1);
+			q[1] = q[0] = 4;
+			return;
+		}
+		uint32_t C;
+		if (((Q >> 1) & 3) == 3) {
+			q[2] = 4;
+			C = (((Q >> 3) & 3) << 3) | ((~Q >> 5 & 3) << 1) | (Q & 1);
+		}
+		else {
+			q[2] = (Q >> 5) & 3;
+			C = Q & 0x1F;
+		}
+		if ((C & 7) == 5) {
+			q[1] = 4;
+			q[0] = (C >> 3) & 3;
+		}
+		else {
+			q[1] = (C >> 3) & 3;
+			q[0] = C & 7;
+		}
+	}
+	//count values of range stored at start, each one (trit or quint << bits) | bits
+	void DecodeIse(const uint8_t* data, uint32_t start, uint32_t range, uint32_t count, uint8_t* out) {
+		const Range& r = RANGES[range];
+		BitReader reader{ data, start, start + GetIseBitCount(range, count) };
+		for (uint32_t i = 0; i < count;) {
+			if (r.trits) {
+				//5 values share 8 bits of trits, interleaved with their own bits
+				static const uint8_t TRIT_BITS[5] = { 2, 2, 1, 2, 1 };
+				uint32_t m[5], T = 0, shift = 0, t[5];
+				for (int j = 0; j < 5; j++) {
+					m[j] = reader.Read(r.bits);
+					T |= reader.Read(TRIT_BITS[j]) << shift;
+					shift += TRIT_BITS[j];
+				}
+				DecodeTrits(T, t);
+				for (int j = 0; j < 5 && i < count; j++, i++) out[i] = static_cast<uint8_t>((t[j] << r.bits) | m[j]);
+			}
+			else if (r.quints) {
+				//3 values share 7 bits of quints
+				static const uint8_t QUINT_BITS[3] = { 3, 2, 2 };
+				uint32_t m[3], Q = 0, shift = 0, q[3];
+				for (int j = 0; j < 3; j++) {
+					m[j] = reader.Read(r.bits);
+					Q |= reader.Read(QUINT_BITS[j]) << shift;
+					shift += QUINT_BITS[j];
+				}
+				DecodeQuints(Q, q);
+				for (int j = 0; j < 3 && i < count; j++, i++) out[i] = static_cast<uint8_t>((q[j] << r.bits) | m[j]);
+			}
+			else {
+				out[i++] = static_cast<uint8_t>(reader.Read(r.bits));
+			}
+		}
+	}
+
+	//endpoint value -> 0 ~ 255
+	uint32_t UnquantizeColor(uint32_t value, uint32_t range) {
+		const Range& r = RANGES[range];
+		if (!r.trits && !r.quints) return Replicate(value, r.bits, 8);
+		uint32_t low = value & ((1u << r.bits) - 1), digit = value >> r.bits;
+		uint32_t A = (low & 1) ? 0x1FF : 0, x = low >> 1, B = 0, C = 0;
+		if (r.trits) {
+			switch (r.bits) {
+			case 1: C = 204; break;
+			case 2: C = 93; B = x * 0x116; break;
+			case 3: C = 44; B = (x << 7) | (x << 2) | x; break;
+			case 4: C = 22; B = (x << 6) | x; break;
+			case 5: C = 11; B = (x << 5) | (x >> 2); break;
+			default: C = 5; B = (x << 4) | (x >> 4); break;
+			}
+		}
+		else {
+			switch (r.bits) {
+			case 1: C = 113; break;
+			case 2: C = 54; B = x * 0x10C; break;
+			case 3: C = 26; B = (x << 7) | (x << 1) | (x >> 1); break;
+			case 4: C = 13; B = (x << 6) | (x >> 1); break;
+			default: C = 6; B = (x << 5) | (x >> 3); break;
+			}
+		}
+		uint32_t T = (digit * C + B) ^ A;
+		return (A & 0x80) | (T >> 2);
+	}
+	//weight value -> 0 ~ 64
+	uint32_t UnquantizeWeight(uint32_t value, uint32_t range) {
+		const Range& r = RANGES[range];
+		uint32_t result;
+		if (!r.trits && !r.quints) {
+			result = Replicate(value, r.bits, 6);
+		}
+		else if (r.bits == 0) {
+			return value * (r.trits ? 32 : 16);
+		}
+		else {
+			uint32_t low = value & ((1u << r.bits) - 1), digit = value >> r.bits;
+			uint32_t A = (low & 1) ? 0x7F : 0, x = low >> 1, B = 0, C = 0;
+			if (r.trits) {
+				switch (r.bits) {
+				case 1: C = 50; break;
+				case 2: C = 23; B = x * 0x45; break;
+				default: C = 11; B = (x << 5) | x; break;
+				}
+			}
+			else {
+				switch (r.bits) {
+				case 1: C = 28; break;
+				default: C = 13; B = x * 0x42; break;
+				}
+			}
+			uint32_t T = (digit * C + B) ^ A;
+			result = (A & 0x20) | (T >> 2);
+		}
+		return result > 32 ? result + 1 : result;
+	}
+
+	struct BlockMode {
+		uint32_t width = 0, height = 0;		//weight grid
+		bool dualPlane = false;
+		uint32_t range = 0;					//of the weights
+	};
+	//false for reserved modes, the void extent is checked before
+	bool DecodeBlockMode(uint32_t mode, BlockMode& out) {
+		uint32_t r, a = (mode >> 5) & 3, b;
+		bool precision = ((mode >> 9) & 1) != 0;
+		out.dualPlane = ((mode >> 10) & 1) != 0;
+		if ((mode & 3) != 0) {
+			r = ((mode >> 4) & 1) | ((mode & 3) << 1);
+			b = (mode >> 7) & 3;
+			switch ((mode >> 2) & 3) {
+			case 0: out.width = b + 4; out.height = a + 2; break;
+			case 1: out.width = b + 8; out.height = a + 2; break;
+			case 2: out.width = a + 2; out.height = b + 8; break;
+			default:
+				b &= 1;
+				if (mode & 0x100) {
+					out.width = b + 2;
+					out.height = a + 2;
+				}
+				else {
+					out.width = a + 2;
+					out.height = b + 6;
+				}
+				break;
+			}
+		}
+		else {
+			if (((mode >> 2) & 3) == 0) return false;
+			r = ((mode >> 4) & 1) | (((mode >> 2) & 3) << 1);
+			b = (mode >> 9) & 3;
+			switch ((mode >> 7) & 3) {
+			case 0: out.width = 12; out.height = a + 2; break;
+			case 1: out.width = a + 2; out.height = 12; break;
+			case 2:
+				out.width = a + 6;
+				out.height = b + 6;
+				precision = false;
+				out.dualPlane = false;
+				break;
+			default:
+				if ((mode >> 6) & 1) return false;
+				if ((mode >> 5) & 1) {
+					out.width = 10;
+					out.height = 6;
+				}
+				else {
+					out.width = 6;
+					out.height = 10;
+				}
+				break;
+			}
+		}
+		if (r < 2) return false;
+		out.range = (r - 2) + (precision ? 6 : 0);
+		return true;
+	}
+
+	uint32_t Hash52(uint32_t p) {
+		p ^= p >> 15;
+		p -= p << 17;
+		p += p << 7;
+		p += p << 4;
+		p ^= p >> 5;
+		p += p << 16;
+		p ^= p >> 7;
+		p ^= p >> 3;
+		p ^= p << 6;
+		p ^= p >> 17;
+		return p;
+	}
+	//partition of texel x, y, the spec's hash of the block's 10 bit seed
+	uint32_t SelectPartition(uint32_t seed, uint32_t x, uint32_t y, uint32_t partitions, bool smallBlock) {
+		if (smallBlock) {
+			x <<= 1;
+			y <<= 1;
+		}
+		seed += (partitions - 1) * 1024;
+		uint32_t rnum = Hash52(seed);
+		uint32_t seeds[8];
+		for (int i = 0; i < 8; i++) {
+			uint32_t s = (rnum >> (4 * i)) & 0xF;
+			seeds[i] = s * s;
+		}
+		uint32_t sh1, sh2;
+		if (seed & 1) {
+			sh1 = (seed & 2) ? 4 : 5;
+			sh2 = partitions == 3 ? 6 : 5;
+		}
+		else {
+			sh1 = partitions == 3 ? 6 : 5;
+			sh2 = (seed & 2) ? 4 : 5;
+		}
+		//z is always 0 for 2d blocks, seeds 9 ~ 12 only weigh z
+		uint32_t a = (seeds[0] >> sh1) * x + (seeds[1] >> sh2) * y + (rnum >> 14);
+		uint32_t b = (seeds[2] >> sh1) * x + (seeds[3] >> sh2) * y + (rnum >> 10);
+		uint32_t c = (seeds[4] >> sh1) * x + (seeds[5] >> sh2) * y + (rnum >> 6);
+		uint32_t d = (seeds[6] >> sh1) * x + (seeds[7] >> sh2) * y + (rnum >> 2);
+		a &= 0x3F;
+		b &= 0x3F;
+		c = partitions < 3 ? 0 : c & 0x3F;
+		d = partitions < 4 ? 0 : d & 0x3F;
+		if (a >= b && a >= c && a >= d) return 0;
+		if (b >= c && b >= d) return 1;
+		if (c >= d) return 2;
+		return 3;
+	}
+
+	int Clamp(int v) { return std::min(std::max(v, 0), 255); }
+	void BitTransferSigned(int& a, int& b) {
+		b >>= 1;
+		b |= a & 0x80;
+		a >>= 1;
+		a &= 0x3F;
+		if (a & 0x20) a -= 0x40;
+	}
+	void SetEndpoint(int e[4], int r, int g, int b, int a) {
+		e[0] = Clamp(r);
+		e[1] = Clamp(g);
+		e[2] = Clamp(b);
+		e[3] = Clamp(a);
+	}
+	//blue contraction of the rgb modes, the endpoints come swapped
+	void SetContracted(int e[4], int r, int g, int b, int a) {
+		SetEndpoint(e, (r + b) >> 1, (g + b) >> 1, b, a);
+	}
+	//ldr endpoint modes, false for the hdr ones
+	bool DecodeEndpoints(uint32_t cem, const uint32_t* values, int e0[4], int e1[4]) {
+		int v[8];
+		for (uint32_t i = 0; i < 2 * ((cem >> 2) + 1); i++) v[i] = static_cast<int>(values[i]);
+		switch (cem) {
+		case 0:
+			SetEndpoint(e0, v[0], v[0], v[0], 255);
+			SetEndpoint(e1, v[1], v[1], v[1], 255);
+			return true;
+		case 1: {
+			int l0 = (v[0] >> 2) | (v[1] & 0xC0);
+			int l1 = std::min(l0 + (v[1] & 0x3F), 255);
+			SetEndpoint(e0, l0, l0, l0, 255);
+			SetEndpoint(e1, l1, l1, l1, 255);
+			return true;
+		}
+		case 4:
+			SetEndpoint(e0, v[0], v[0], v[0], v[2]);
+			SetEndpoint(e1, v[1], v[1], v[1], v[3]);
+			return true;
+		case 5:
+			BitTransferSigned(v[1], v[0]);
+			BitTransferSigned(v[3], v[2]);
+			SetEndpoint(e0, v[0], v[0], v[0], v[2]);
+			SetEndpoint(e1, v[0] + v[1], v[0] + v[1], v[0] + v[1], v[2] + v[3]);
+			return true;
+		case 6:
+			SetEndpoint(e0, (v[0] * v[3]) >> 8, (v[1] * v[3]) >> 8, (v[2] * v[3]) >> 8, 255);
+			SetEndpoint(e1, v[0], v[1], v[2], 255);
+			return true;
+		case 8:
+		case 12: {
+			int a0 = cem == 12 ? v[6] : 255, a1 = cem == 12 ? v[7] : 255;
+			if (v[1] + v[3] + v[5] >= v[0] + v[2] + v[4]) {
+				SetEndpoint(e0, v[0], v[2], v[4], a0);
+				SetEndpoint(e1, v[1], v[3], v[5], a1);
+			}
+			else {
+				SetContracted(e0, v[1], v[3], v[5], a1);
+				SetContracted(e1, v[0], v[2], v[4], a0);
+			}
+			return true;
+		}
+		case 9:
+		case 13: {
+			BitTransferSigned(v[1], v[0]);
+			BitTransferSigned(v[3], v[2]);
+			BitTransferSigned(v[5], v[4]);
+			int a0 = 255, a1 = 255;
+			if (cem == 13) {
+				BitTransferSigned(v[7], v[6]);
+				a0 = v[6];
+				a1 = v[6] + v[7];
+			}
+			if (v[1] + v[3] + v[5] >= 0) {
+				SetEndpoint(e0, v[0], v[2], v[4], a0);
+				SetEndpoint(e1, v[0] + v[1], v[2] + v[3], v[4] + v[5], a1);
+			}
+			else {
+				SetContracted(e0, v[0] + v[1], v[2] + v[3], v[4] + v[5], a1);
+				SetContracted(e1, v[0], v[2], v[4], a0);
+			}
+			return true;
+		}
+		case 10:
+			SetEndpoint(e0, (v[0] * v[3]) >> 8, (v[1] * v[3]) >> 8, (v[2] * v[3]) >> 8, v[4]);
+			SetEndpoint(e1, v[0], v[1], v[2], v[5]);
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	void FillError(uint32_t count, uint8_t* texels) {
+		for (uint32_t i = 0; i < count; i++) {
+			texels[i * 4] = 255;
+			texels[i * 4 + 1] = 0;
+			texels[i * 4 + 2] = 255;
+			texels[i * 4 + 3] = 255;
+		}
+	}
+}
+
+namespace AstcDecoder {
+	void DecodeBlock(const uint8_t block[16], uint32_t blockWidth, uint32_t blockHeight, uint8_t* texels) {
+		uint32_t texelCount = blockWidth * blockHeight;
+		uint32_t mode = GetBits(block, 0, 11);
+		if ((mode & 0x1FF) == 0x1FC) {
+			//void extent : one unorm16 color for the whole block, hdr ones are errors here
+			if (mode & 0x200) {
+				FillError(texelCount, texels);
+				return;
+			}
+			uint8_t color[4];
+			for (int c = 0; c < 4; c++) color[c] = static_cast<uint8_t>(GetBits(block, 64 + 16 * c, 16) >> 8);
+			for (uint32_t i = 0; i < texelCount; i++) {
+				for (int c = 0; c < 4; c++) texels[i * 4 + c] = color[c];
+			}
+			return;
+		}
+		BlockMode grid;
+		if (!DecodeBlockMode(mode, grid) || grid.width > blockWidth || grid.height > blockHeight) {
+			FillError(texelCount, texels);
+			return;
+		}
+		uint32_t planes = grid.dualPlane ? 2 : 1;
+		uint32_t weightCount = grid.width * grid.height * planes;
+		uint32_t weightBits = weightCount <= MAX_WEIGHTS ? GetIseBitCount(grid.range, weightCount) : 0;
+		uint32_t partitions = GetBits(block, 11, 2) + 1;
+		if (weightCount > MAX_WEIGHTS || weightBits < 24 || weightBits > 96 || (partitions == 4 && grid.dualPlane)) {
+			FillError(texelCount, texels);
+			return;
+		}
+
+		//endpoint modes : one for every partition, or a shared class with per partition offsets partly stored below the weights
+		uint32_t cems[4] = {};
+		uint32_t colorStart = 17, extraBits = 0, seed = 0;
+		if (partitions == 1) {
+			cems[0] = GetBits(block, 13, 4);
+		}
+		else {
+			seed = GetBits(block, 13, 10);
+			colorStart = 29;
+			uint32_t cem = GetBits(block, 23, 6);
+			if ((cem & 3) == 0) {
+				for (uint32_t p = 0; p < partitions; p++) cems[p] = cem >> 2;
+			}
+			else {
+				extraBits = 3 * partitions - 4;
+				cem |= GetBits(block, 128 - weightBits - extraBits, extraBits) << 6;
+				uint32_t base = (cem & 3) - 1;
+				for (uint32_t p = 0; p < partitions; p++) {
+					uint32_t offset = (cem >> (2 + p)) & 1;
+					uint32_t modifier = (cem >> (2 + partitions + 2 * p)) & 3;
+					cems[p] = ((base + offset) << 2) | modifier;
+				}
+			}
+		}
+		uint32_t colorEnd = 128 - weightBits - extraBits - (grid.dualPlane ? 2 : 0);
+		uint32_t planeComponent = grid.dualPlane ? GetBits(block, colorEnd, 2) : 4;
+		uint32_t colorCount = 0;
+		for (uint32_t p = 0; p < partitions; p++) colorCount += 2 * ((cems[p] >> 2) + 1);
+		if (colorCount > MAX_COLOR_VALUES || colorEnd < colorStart) {
+			FillError(texelCount, texels);
+			return;
+		}
+		//the endpoints take the finest range that fits in the bits left
+		int colorRange = 20;
+		while (colorRange >= 0 && GetIseBitCount(colorRange, colorCount) > colorEnd - colorStart) colorRange--;
+		if (colorRange < int(RANGE_6)) {
+			FillError(texelCount, texels);
+			return;
+		}
+		uint8_t packed[MAX_COLOR_VALUES];
+		uint32_t values[MAX_COLOR_VALUES];
+		DecodeIse(block, colorStart, colorRange, colorCount, packed);
+		for (uint32_t i = 0; i < colorCount; i++) values[i] = UnquantizeColor(packed[i], colorRange);
+		int endpoints[4][2][4];
+		for (uint32_t p = 0, offset = 0; p < partitions; p++) {
+			if (!DecodeEndpoints(cems[p], values + offset, endpoints[p][0], endpoints[p][1])) {
+				FillError(texelCount, texels);
+				return;
+			}
+			offset += 2 * ((cems[p] >> 2) + 1);
+		}
+
+		//weights are stored bit reversed from the top of the block
+		uint8_t reversed[16];
+		for (int i = 0; i < 16; i++) reversed[i] = ReverseByte(block[15 - i]);
+		uint8_t weights[MAX_WEIGHTS];
+		DecodeIse(reversed, 0, grid.range, weightCount, weights);
+		for (uint32_t i = 0; i < weightCount; i++) weights[i] = static_cast<uint8_t>(UnquantizeWeight(weights[i], grid.range));
+
+		//the weight grid is stretched over the block bilinearly
+		uint32_t ds = (1024 + blockWidth / 2) / (blockWidth - 1), dt = (1024 + blockHeight / 2) / (blockHeight - 1);
+		bool smallBlock = texelCount < 31;
+		auto weightAt = [&](uint32_t x, uint32_t y, uint32_t plane) {
+			x = std::min(x, grid.width - 1);
+			y = std::min(y, grid.height - 1);
+			return static_cast<uint32_t>(weights[(y * grid.width + x) * planes + plane]);
+		};
+		for (uint32_t y = 0; y < blockHeight; y++) {
+			for (uint32_t x = 0; x < blockWidth; x++) {
+				uint32_t gs = (ds * x * (grid.width - 1) + 32) >> 6, gt = (dt * y * (grid.height - 1) + 32) >> 6;
+				uint32_t js = gs >> 4, fs = gs & 15, jt = gt >> 4, ft = gt & 15;
+				uint32_t w11 = (fs * ft + 8) >> 4, w10 = ft - w11, w01 = fs - w11, w00 = 16 - fs - ft + w11;
+				uint32_t texelWeights[2] = {};
+				for (uint32_t plane = 0; plane < planes; plane++) {
+					texelWeights[plane] = (weightAt(js, jt, plane) * w00 + weightAt(js + 1, jt, plane) * w01 +
+						weightAt(js, jt + 1, plane) * w10 + weightAt(js + 1, jt + 1, plane) * w11 + 8) >> 4;
+				}
+				uint32_t partition = partitions > 1 ? SelectPartition(seed, x, y, partitions, smallBlock) : 0;
+				const int* e0 = endpoints[partition][0];
+				const int* e1 = endpoints[partition][1];
+				uint8_t* texel = texels + (y * blockWidth + x) * 4;
+				for (uint32_t c = 0; c < 4; c++) {
+					uint32_t w = texelWeights[c == planeComponent ? 1 : 0];
+					//unorm16 interpolation of the expanded endpoints, the top byte is the texel
+					uint32_t c0 = uint32_t(e0[c]) * 257, c1 = uint32_t(e1[c]) * 257;
+					texel[c] = static_cast<uint8_t>(((c0 * (64 - w) + c1 * w + 32) >> 6) >> 8);
+				}
+			}
+		}
+	}
+}
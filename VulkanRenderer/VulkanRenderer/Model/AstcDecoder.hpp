@@ -0,0 +1,14 @@
+#pragma once
+#ifndef ASTC_DECODER_HPP
+#define ASTC_DECODER_HPP
+#include <cstdint>
+
+// cpu decoder of ASTC ldr blocks, TextureCompression::Decompress() uses it for devices without
+// textureCompressionASTC_LDR. hdr endpoint modes, hdr void extents and reserved encodings come out as the
+// error color (magenta) the way an ldr decoder samples them. no vulkan.
+namespace AstcDecoder {
+	//one 16 byte block -> blockWidth * blockHeight rgba8 texels, rows of blockWidth. at most 12 x 12
+	void DecodeBlock(const uint8_t block[16], uint32_t blockWidth, uint32_t blockHeight, uint8_t* texels);
+}
+
+#endif // !ASTC_DECODER_HPP
@@ -0,0 +1,101 @@
+#include "ClusterCulling.hpp"
+#include "Model.hpp"
+#include <stdexcept>
+
+GpuMeshlet GpuMeshlet::Encode(const Meshlet& meshlet, uint32_t meshFirstIndex, int32_t meshVertexOffset) {
+	GpuMeshlet out{};
+	out.sphere = glm::vec4(meshlet.center, meshlet.radius);
+	float length = glm::length(meshlet.coneAxis);
+	//a degenerate axis never culls
+	out.cone = length > 0.0f ? glm::vec4(meshlet.coneAxis / length, meshlet.coneCutoff) : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	out.firstIndex = meshFirstIndex + meshlet.firstIndex;
+	out.indexCount = meshlet.indexCount;
+	out.vertexOffset = meshVertexOffset;
+	return out;
+}
+
+GpuCullView GpuCullView::FromView(const CullView& view, const glm::mat4& modelMat) {
+	GpuCullView out{};
+	//dot(plane, M * p) = dot(transpose(M) * plane, p). divided by the length of the normal the model space distance of a
+	//sphere compares with its model space radius, whatever the scale
+	glm::mat4 transposed = glm::transpose(modelMat);
+	for (int i = 0; i < 6; i++) {
+		glm::vec4 plane = transposed * view.planes[i];
+		float length = glm::length(glm::vec3(plane));
+		out.planes[i] = length > 0.0f ? plane / length : plane;
+	}
+	//the cone test assumes a uniform scale, like Mesh::DrawClusters()
+	out.eye = glm::vec4(glm::vec3(glm::inverse(modelMat) * glm::vec4(view.position, 1.0f)), view.perspective ? 1.0f : 0.0f);
+	glm::vec3 direction = glm::transpose(glm::mat3(modelMat)) * view.direction;
+	float length = glm::length(direction);
+	out.direction = glm::vec4(length > 0.0f ? direction / length : direction, view.coneCulling ? 1.0f : 0.0f);
+	return out;
+}
+
+void CullTarget::Clean() {
+	if (pool == VK_NULL_HANDLE) return;
+	Renderer* renderer = Renderer::GetInstance();
+	for (auto& frame : frames) {
+		if (frame.commands != VK_NULL_HANDLE) renderer->deletionQueue.PushBuffer(frame.commands, frame.memory);
+		frame = Frame{};
+	}
+	//the sets go with their pool
+	renderer->deletionQueue.PushDescriptorPool(pool);
+	pool = VK_NULL_HANDLE;
+}
+
+void CullTarget::Barrier(VkCommandBuffer commandBuffer) {
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+CullTarget::Frame& CullTarget::Prepare(const GeometryArena& arena, VkDeviceSize meshletOffset, uint32_t count) {
+	Renderer* renderer = Renderer::GetInstance();
+	if (pool == VK_NULL_HANDLE) {
+		VkDescriptorPoolSize poolSize;
+		poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 2;
+		VkDescriptorPoolCreateInfo poolCreateInfo = Initializer::InitDescriptorPoolCreateInfo(1, &poolSize, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+		if (vkCreateDescriptorPool(renderer->device, &poolCreateInfo, nullptr, &pool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor pool!");
+		}
+		VkDescriptorSetLayout layouts[MAX_FRAMES_IN_FLIGHT];
+		for (auto& layout : layouts) layout = renderer->GetClusterCullDescriptorSetLayout();
+		VkDescriptorSet sets[MAX_FRAMES_IN_FLIGHT];
+		VkDescriptorSetAllocateInfo allocInfo = Initializer::InitDescriptorSetAllocateInfo(pool, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT), layouts);
+		if (vkAllocateDescriptorSets(renderer->device, &allocInfo, sets) != VK_SUCCESS) {
+			renderer->deletionQueue.PushDescriptorPool(pool);
+			throw std::runtime_error("failed to allocate descriptor sets!");
+		}
+		for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) frames[i].descriptorSet = sets[i];
+	}
+	//the slot's previous frame has completed, its commands and descriptors are free to change
+	Frame& frame = frames[renderer->GetCurrentFrame()];
+	if (frame.capacity < count) {
+		if (frame.commands != VK_NULL_HANDLE) renderer->deletionQueue.PushBuffer(frame.commands, frame.memory);
+		//headroom, so a model reloading with a few more meshlets keeps the buffer
+		frame.capacity = count + count / 4;
+		Utils::CreateBuffer(renderer->device, renderer->allocator, frame.capacity * sizeof(VkDrawIndexedIndirectCommand),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.commands, frame.memory);
+	}
+	VkDescriptorBufferInfo meshletInfo = Initializer::InitDescriptorBufferInfo(arena.buffer, count * sizeof(GpuMeshlet), meshletOffset);
+	VkDescriptorBufferInfo commandInfo = Initializer::InitDescriptorBufferInfo(frame.commands, count * sizeof(VkDrawIndexedIndirectCommand));
+	VkWriteDescriptorSet writes[2] = {
+		Initializer::InitWriteDescriptorSet(frame.descriptorSet, 0, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &meshletInfo),
+		Initializer::InitWriteDescriptorSet(frame.descriptorSet, 1, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &commandInfo)
+	};
+	vkUpdateDescriptorSets(renderer->device, 2, writes, 0, nullptr);
+	frame.arena = &arena;
+	frame.frameValue = renderer->GetFrameTimelineValue();
+	return frame;
+}
+
+const CullTarget::Frame* CullTarget::GetCulled(const GeometryArena* arena) const {
+	Renderer* renderer = Renderer::GetInstance();
+	const Frame& frame = frames[renderer->GetCurrentFrame()];
+	if (arena == nullptr || frame.arena != arena || frame.frameValue != renderer->GetFrameTimelineValue()) return nullptr;
+	return &frame;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#ifndef CLUSTER_CULLING_HPP
+#define CLUSTER_CULLING_HPP
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include "Meshlet.hpp"
+#include "Renderer.h"
+struct GeometryArena;
+
+//local_size_x of ClusterCull.comp
+constexpr uint32_t CLUSTER_CULL_GROUP_SIZE = 64;
+
+//one meshlet as ClusterCull.comp reads it (std430), the table of a model lives in its geometry arena
+struct GpuMeshlet {
+	glm::vec4 sphere;		//center, radius in mesh space
+	glm::vec4 cone;			//normalized axis, cutoff
+	uint32_t firstIndex;	//the draw's firstIndex : in the arena range of the mesh's index type
+	uint32_t indexCount;
+	int32_t vertexOffset;
+	uint32_t padding;
+
+	static GpuMeshlet Encode(const Meshlet& meshlet, uint32_t meshFirstIndex, int32_t meshVertexOffset);
+};
+static_assert(sizeof(GpuMeshlet) == 48, "GpuMeshlet must match ClusterCull.comp");
+
+//push constant of ClusterCull.comp : a CullView moved into model space
+struct GpuCullView {
+	glm::vec4 planes[6];	//normalized in model space, the sphere test is exact for any model matrix there
+	glm::vec4 eye;			//w = 1 : perspective
+	glm::vec4 direction;	//w = 1 : cone culling
+
+	static GpuCullView FromView(const CullView& view, const glm::mat4& modelMat);
+};
+static_assert(sizeof(GpuCullView) == 128, "GpuCullView must fit the push constant size every device supports");
+
+// Indirect meshlet draws of one model instance seen from one view.
+// Model::Cull() records the compute pass writing them, Model::Draw() / DrawDepth() with the same target then draw every
+// mesh with one vkCmdDrawIndexedIndirect, culled meshlets have instanceCount 0. the commands live in one buffer per frame
+// in flight, grown to the model's meshlet count. like LodState, keep one per view and instance and cull it once per frame.
+class CullTarget {
+public:
+	CullTarget() {}
+	CullTarget(const CullTarget&) = delete;
+	CullTarget& operator=(const CullTarget&) = delete;
+	~CullTarget() { Clean(); }
+	//safe to call more than once, buffers go to the renderer's deletion queue
+	void Clean();
+	//makes the commands of every Cull() recorded before it visible to indirect draws.
+	//once per frame, after the last Cull() and before the render passes drawing them
+	static void Barrier(VkCommandBuffer commandBuffer);
+private:
+	friend class Model;
+	struct Frame {
+		VkBuffer commands = VK_NULL_HANDLE;
+		MemoryAllocation memory;
+		uint32_t capacity = 0;					//in VkDrawIndexedIndirectCommand
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		const GeometryArena* arena = nullptr;	//culled content
+		uint64_t frameValue = 0;				//frame the commands were written for
+	};
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	Frame frames[MAX_FRAMES_IN_FLIGHT];
+	//the recording frame's commands, sized for count meshlets and bound to the meshlet table of arena
+	Frame& Prepare(const GeometryArena& arena, VkDeviceSize meshletOffset, uint32_t count);
+	//nullptr unless arena was culled into this target for the frame being recorded
+	const Frame* GetCulled(const GeometryArena* arena) const;
+};
+
+#endif // !CLUSTER_CULLING_HPP
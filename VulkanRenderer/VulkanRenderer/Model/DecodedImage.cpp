@@ -0,0 +1,85 @@
+#include "DecodedImage.hpp"
+#include "TextureCompression.hpp"
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#include <cstring>
+
+namespace {
+	//8 bit sRGB <-> linear. the way back goes through a 16 bit table, fine enough for the darkest steps
+	struct SrgbTables {
+		float toLinear[256];
+		uint8_t fromLinear[65536];
+		SrgbTables() {
+			for (int i = 0; i < 256; i++) {
+				float c = i / 255.0f;
+				toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (int i = 0; i < 65536; i++) {
+				float l = i / 65535.0f;
+				float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+				fromLinear[i] = static_cast<uint8_t>(std::lround(std::min(std::max(c, 0.0f), 1.0f) * 255.0f));
+			}
+		}
+	};
+	const SrgbTables& GetSrgbTables() {
+		static const SrgbTables tables;
+		return tables;
+	}
+
+	//2x2 box filter, odd sizes clamp the last column / row
+	void Downsample(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight, bool sRGB) {
+		const SrgbTables& tables = GetSrgbTables();
+		for (uint32_t y = 0; y < dstHeight; y++) {
+			uint32_t y0 = std::min(y * 2, srcHeight - 1), y1 = std::min(y * 2 + 1, srcHeight - 1);
+			for (uint32_t x = 0; x < dstWidth; x++) {
+				uint32_t x0 = std::min(x * 2, srcWidth - 1), x1 = std::min(x * 2 + 1, srcWidth - 1);
+				const uint8_t* p[4] = {
+					src + (size_t(y0) * srcWidth + x0) * 4, src + (size_t(y0) * srcWidth + x1) * 4,
+					src + (size_t(y1) * srcWidth + x0) * 4, src + (size_t(y1) * srcWidth + x1) * 4 };
+				uint8_t* out = dst + (size_t(y) * dstWidth + x) * 4;
+				for (int c = 0; c < 4; c++) {
+					//alpha is linear in either case
+					if (sRGB && c < 3) {
+						float sum = tables.toLinear[p[0][c]] + tables.toLinear[p[1][c]] + tables.toLinear[p[2][c]] + tables.toLinear[p[3][c]];
+						out[c] = tables.fromLinear[static_cast<uint32_t>(sum * 0.25f * 65535.0f + 0.5f)];
+					}
+					else {
+						out[c] = static_cast<uint8_t>((p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) / 4);
+					}
+				}
+			}
+		}
+	}
+}
+
+std::vector<uint8_t> DecodedImage::BuildMipChain(bool sRGB, uint32_t mipLevels) const {
+	if (isHdr || pixels == nullptr) {
+		throw std::runtime_error("failed to build mip chain, only 8 bit images are supported!");
+	}
+	std::vector<uint8_t> chain(static_cast<size_t>(TextureCompression::GetMipChainSize(TextureEncoding::RGBA8, width, height, mipLevels)));
+	BuildMipChain(sRGB, mipLevels, chain.data());
+	return chain;
+}
+
+void DecodedImage::BuildMipChain(bool sRGB, uint32_t mipLevels, uint8_t* out) const {
+	if (isHdr || pixels == nullptr) {
+		throw std::runtime_error("failed to build mip chain, only 8 bit images are supported!");
+	}
+	uint32_t w = static_cast<uint32_t>(width), h = static_cast<uint32_t>(height);
+	size_t offset = size_t(w) * h * 4;
+	memcpy(out, pixels, offset);
+	//levels are filtered in cached memory and only copied to out, staging memory is usually write combined
+	std::vector<uint8_t> scratch[2];
+	const uint8_t* src = static_cast<const uint8_t*>(pixels);
+	for (uint32_t i = 1; i < mipLevels; i++) {
+		uint32_t nw = std::max(w / 2, 1u), nh = std::max(h / 2, 1u);
+		std::vector<uint8_t>& dst = scratch[i & 1];
+		dst.resize(size_t(nw) * nh * 4);
+		Downsample(src, w, h, dst.data(), nw, nh, sRGB);
+		memcpy(out + offset, dst.data(), dst.size());
+		offset += dst.size();
+		src = dst.data();
+		w = nw;
+		h = nh;
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+#ifndef DECODED_IMAGE_HPP
+#define DECODED_IMAGE_HPP
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <stb_image.h>
+
+//cpu half of a texture load : the file decoded to 4 channels. holds no vulkan objects, so any thread may decode.
+struct DecodedImage {
+	void* pixels = nullptr;
+	int width = 0, height = 0, nChannels = 0;	//nChannels of the file, pixels always have 4
+	bool isHdr = false;							//float pixels
+
+	DecodedImage() {}
+	DecodedImage(const DecodedImage&) = delete;
+	DecodedImage& operator=(const DecodedImage&) = delete;
+	DecodedImage(DecodedImage&& rhs) noexcept { *this = std::move(rhs); }
+	DecodedImage& operator=(DecodedImage&& rhs) noexcept {
+		if (this == &rhs) return *this;
+		if (pixels != nullptr) stbi_image_free(pixels);
+		pixels = std::exchange(rhs.pixels, nullptr);
+		width = rhs.width;
+		height = rhs.height;
+		nChannels = rhs.nChannels;
+		isHdr = rhs.isHdr;
+		return *this;
+	}
+	~DecodedImage() {
+		if (pixels != nullptr) stbi_image_free(pixels);
+	}
+	uint64_t GetSize() const { return uint64_t(width) * height * 4 * (isHdr ? sizeof(float) : 1); }
+	//rgba8 mip chain, level 0 first and every level tightly packed. 8 bit images only.
+	//sRGB images are averaged in linear space, like the blits Texture::Upload() records
+	std::vector<uint8_t> BuildMipChain(bool sRGB, uint32_t mipLevels) const;
+	//same chain written to out, TextureCompression::GetMipChainSize(RGBA8, ...) bytes (e.g. mapped staging memory)
+	void BuildMipChain(bool sRGB, uint32_t mipLevels, uint8_t* out) const;
+	static uint32_t GetMipLevelCount(uint32_t width, uint32_t height) {
+		return static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+	}
+
+	//size of the image from its header, nothing is decoded. false when stb can't read the header
+	static bool ReadSize(const std::string& fn, int& width, int& height) {
+		int nChannels = 0;
+		return stbi_info(fn.c_str(), &width, &height, &nChannels) != 0;
+	}
+	static bool ReadSize(const uint8_t* data, size_t size, int& width, int& height) {
+		int nChannels = 0;
+		return stbi_info_from_memory(data, static_cast<int>(size), &width, &height, &nChannels) != 0;
+	}
+
+	static DecodedImage Decode(const std::string& fn, bool isHdr = false) {
+		DecodedImage image;
+		image.isHdr = isHdr;
+		//4ä̹ ƴϸ 4äη   1äΰ 3ä STBI_rgb_alpha  Ǵµ 2ä  ߰
+		//per thread flag, the global one would race between decoding workers
+		stbi_set_flip_vertically_on_load_thread(true);
+		if (isHdr) {
+			image.pixels = stbi_loadf(fn.c_str(), &image.width, &image.height, &image.nChannels, STBI_rgb_alpha);
+		}
+		else {
+			image.pixels = stbi_load(fn.c_str(), &image.width, &image.height, &image.nChannels, STBI_rgb_alpha);
+		}
+		if (image.pixels == nullptr) {
+			throw std::runtime_error("failed to load texture image!");
+		}
+		printf("%s image load success! width : %d height : %d channels : %d\n", fn.c_str(), image.width, image.height, image.nChannels);
+		return image;
+	}
+	//encoded file already in memory (glb buffer views, data uris). name is only for the log
+	static DecodedImage DecodeMemory(const uint8_t* data, size_t size, const std::string& name, bool isHdr = false) {
+		DecodedImage image;
+		image.isHdr = isHdr;
+		stbi_set_flip_vertically_on_load_thread(true);
+		if (isHdr) {
+			image.pixels = stbi_loadf_from_memory(data, static_cast<int>(size), &image.width, &image.height, &image.nChannels, STBI_rgb_alpha);
+		}
+		else {
+			image.pixels = stbi_load_from_memory(data, static_cast<int>(size), &image.width, &image.height, &image.nChannels, STBI_rgb_alpha);
+		}
+		if (image.pixels == nullptr) {
+			throw std::runtime_error("failed to load texture image!");
+		}
+		printf("%s image load success! width : %d height : %d channels : %d\n", name.c_str(), image.width, image.height, image.nChannels);
+		return image;
+	}
+};
+
+#endif // !DECODED_IMAGE_HPP
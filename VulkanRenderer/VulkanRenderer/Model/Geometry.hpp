@@ -0,0 +1,87 @@
+#pragma once
+#ifndef GEOMETRY_HPP
+#define GEOMETRY_HPP
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstdint>
+#include <cmath>
+
+// cpu side geometry types shared by the importer, the cache and the renderer.
+// no vulkan here, the offline cooker builds against it with assimp alone.
+
+// import format, 32 bytes. the gpu streams in VertexLayout.hpp are encoded from it
+struct Vertex
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 texCoords;
+
+	bool operator==(const Vertex& other) const {
+		return position == other.position && normal == other.normal && texCoords == other.texCoords;
+	}
+};
+
+// position = origin + unorm16 * scale. the scale is uniform, so the dequantization can be folded into the
+// model matrix without bending normals.
+struct Quantization {
+	glm::vec3 origin = glm::vec3(0);
+	float scale = 1.0f;
+
+	static Quantization FromBox(const glm::vec3& min, const glm::vec3& max) {
+		Quantization q;
+		glm::vec3 extent = max - min;
+		q.origin = min;
+		q.scale = std::fmax(extent.x, std::fmax(extent.y, extent.z));
+		if (q.scale <= 0.0f) q.scale = 1.0f;
+		return q;
+	}
+	glm::mat4 GetMatrix() const {
+		return glm::scale(glm::translate(glm::mat4(1.0f), origin), glm::vec3(scale));
+	}
+};
+
+//axis aligned box + bounding sphere in model space
+struct Bounds {
+	glm::vec3 min = glm::vec3(0);
+	glm::vec3 max = glm::vec3(0);
+	glm::vec3 center = glm::vec3(0);
+	float radius = 0.0f;
+	bool valid = false;
+
+	void Expand(const glm::vec3& p) {
+		if (!valid) { min = max = p; valid = true; }
+		else { min = glm::min(min, p); max = glm::max(max, p); }
+	}
+	void Expand(const Bounds& other) {
+		if (!other.valid) return;
+		Expand(other.min);
+		Expand(other.max);
+	}
+	//call after the last Expand()
+	void Finalize() {
+		center = (min + max) * 0.5f;
+		radius = glm::length(max - center);
+	}
+};
+
+//one level of detail : an index range of the mesh, every level shares the mesh's vertices
+struct MeshLod {
+	uint32_t firstIndex = 0;	// relative to the mesh's first index
+	uint32_t indexCount = 0;
+	float error = 0.0f;			// deviation from level 0 in mesh units
+};
+
+//what a Mesh keeps on the cpu after its geometry is uploaded
+enum class GeometryRetention {
+	KeepAll,		//vertices + indices, needed to upload again or for cpu side queries
+	KeepBounds,		//index count, bounds and material
+	KeepNothing		//index count and material, just enough to draw
+};
+
+// vertex format of a Model's geometry arena, pipelines drawing it must use the matching layout
+enum class VertexFormat {
+	Full,		// FullLayout / FullDepthLayout
+	Compact		// CompactLayout / CompactDepthLayout
+};
+
+#endif // !GEOMETRY_HPP
@@ -0,0 +1,469 @@
+#include "GltfLoader.hpp"
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
+
+namespace {
+	constexpr uint32_t GLB_MAGIC = 0x46546C67;		// "glTF"
+	constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+	constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;
+	//deeper node trees are broken or cyclic
+	constexpr int MAX_NODE_DEPTH = 256;
+
+	enum ComponentType {
+		BYTE = 5120,
+		UNSIGNED_BYTE = 5121,
+		SHORT = 5122,
+		UNSIGNED_SHORT = 5123,
+		UNSIGNED_INT = 5125,
+		FLOAT = 5126
+	};
+
+	std::string GetDirectory(const std::string& fn) {
+		size_t slash = fn.find_last_of('/');
+		return slash == std::string::npos ? "" : fn.substr(0, slash + 1);
+	}
+	std::string GetLowerExtension(const std::string& fn) {
+		size_t dot = fn.find_last_of('.');
+		if (dot == std::string::npos) return "";
+		std::string extension = fn.substr(dot);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+		return extension;
+	}
+	//offsets and lengths come from the file, offset + length could wrap
+	bool InBounds(size_t offset, size_t length, size_t size) {
+		return offset <= size && length <= size - offset;
+	}
+	//false when a * b doesn't fit
+	bool Multiply(size_t a, size_t b, size_t& out) {
+		if (a != 0 && b > std::numeric_limits<size_t>::max() / a) return false;
+		out = a * b;
+		return true;
+	}
+	//a byte count or offset, negative, fractional or huge numbers become SIZE_MAX and fail every bounds check
+	size_t GetSize(const JsonValue& value) {
+		double number = value.GetNumber(0);
+		if (!(number >= 0.0) || number >= 9007199254740992.0 || number != static_cast<double>(static_cast<uint64_t>(number))) {
+			return std::numeric_limits<size_t>::max();
+		}
+		uint64_t size = static_cast<uint64_t>(number);
+		return size > std::numeric_limits<size_t>::max() ? std::numeric_limits<size_t>::max() : static_cast<size_t>(size);
+	}
+	uint32_t ReadU32(const uint8_t* p) {
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+	size_t GetComponentSize(int componentType) {
+		switch (componentType) {
+		case BYTE: case UNSIGNED_BYTE: return 1;
+		case SHORT: case UNSIGNED_SHORT: return 2;
+		case UNSIGNED_INT: case FLOAT: return 4;
+		default: return 0;
+		}
+	}
+	int GetComponentCount(const std::string& type) {
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		return 0;
+	}
+	//relative uris may be percent encoded (spaces in file names)
+	std::string DecodeUri(const std::string& uri) {
+		std::string out;
+		out.reserve(uri.size());
+		for (size_t i = 0; i < uri.size(); i++) {
+			if (uri[i] == '%' && i + 2 < uri.size() && isxdigit(static_cast<unsigned char>(uri[i + 1])) && isxdigit(static_cast<unsigned char>(uri[i + 2]))) {
+				out += static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+				i += 2;
+			}
+			else out += uri[i];
+		}
+		return out;
+	}
+	//"data:<mime>;base64,<payload>" -> payload bytes, false when uri is not a base64 data uri
+	bool DecodeDataUri(const std::string& uri, std::vector<uint8_t>& out) {
+		if (uri.compare(0, 5, "data:") != 0) return false;
+		size_t comma = uri.find(',');
+		if (comma == std::string::npos || uri.rfind(";base64", comma) == std::string::npos) return false;
+		out.clear();
+		out.reserve((uri.size() - comma) / 4 * 3);
+		uint32_t bits = 0;
+		int bitCount = 0;
+		for (size_t i = comma + 1; i < uri.size(); i++) {
+			char c = uri[i];
+			int value;
+			if (c >= 'A' && c <= 'Z') value = c - 'A';
+			else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+			else if (c >= '0' && c <= '9') value = c - '0' + 52;
+			else if (c == '+') value = 62;
+			else if (c == '/') value = 63;
+			else if (c == '=') break;
+			else return false;
+			bits = (bits << 6) | static_cast<uint32_t>(value);
+			bitCount += 6;
+			if (bitCount >= 8) {
+				bitCount -= 8;
+				out.push_back(static_cast<uint8_t>(bits >> bitCount));
+			}
+		}
+		return true;
+	}
+	//one component as float, normalized integers map to [0, 1] / [-1, 1]
+	float ReadComponent(const uint8_t* p, int componentType, bool normalized) {
+		switch (componentType) {
+		case FLOAT: {
+			float value;
+			memcpy(&value, p, sizeof(value));
+			return value;
+		}
+		case BYTE: {
+			int8_t value = static_cast<int8_t>(*p);
+			return normalized ? std::max(value / 127.0f, -1.0f) : value;
+		}
+		case UNSIGNED_BYTE:
+			return normalized ? *p / 255.0f : *p;
+		case SHORT: {
+			int16_t value;
+			memcpy(&value, p, sizeof(value));
+			return normalized ? std::max(value / 32767.0f, -1.0f) : value;
+		}
+		case UNSIGNED_SHORT: {
+			uint16_t value;
+			memcpy(&value, p, sizeof(value));
+			return normalized ? value / 65535.0f : value;
+		}
+		default:
+			return 0.0f;
+		}
+	}
+	//element i of view into out[0..n), float elements are copied as they are
+	void ReadElement(const uint8_t* data, size_t stride, int componentType, bool normalized, size_t i, float* out, int n) {
+		const uint8_t* p = data + i * stride;
+		if (componentType == FLOAT) {
+			memcpy(out, p, n * sizeof(float));
+			return;
+		}
+		size_t componentSize = GetComponentSize(componentType);
+		for (int c = 0; c < n; c++) {
+			out[c] = ReadComponent(p + c * componentSize, componentType, normalized);
+		}
+	}
+	uint32_t ReadIndex(const uint8_t* p, int componentType) {
+		if (componentType == UNSIGNED_BYTE) return *p;
+		if (componentType == UNSIGNED_SHORT) {
+			uint16_t value;
+			memcpy(&value, p, sizeof(value));
+			return value;
+		}
+		return ReadU32(p);
+	}
+}
+
+bool GltfLoader::IsGltf(const std::string& fn) {
+	std::string extension = GetLowerExtension(fn);
+	return extension == ".gltf" || extension == ".glb";
+}
+
+bool GltfLoader::Open(const std::string& fn) {
+	fileName = fn;
+	primitives.clear();
+	images.clear();
+	buffers.clear();
+	mappedBuffers.clear();
+	decodedBuffers.clear();
+	try {
+		return Parse(fn);
+	}
+	catch (const std::exception& e) {
+		return Fail(e.what());
+	}
+}
+
+bool GltfLoader::Parse(const std::string& fn) {
+	if (!file.Open(fn)) return Fail("can't map the file");
+	const uint8_t* data = file.GetData();
+	size_t size = file.GetSize();
+	const uint8_t* binChunk = nullptr;
+	size_t binSize = 0;
+	if (size >= 12 && ReadU32(data) == GLB_MAGIC) {
+		//binary container : header, json chunk, optional bin chunk, each chunk 4 byte aligned
+		if (ReadU32(data + 4) != 2) return Fail("unsupported glb version");
+		size_t length = std::min<size_t>(ReadU32(data + 8), size);
+		const char* json = nullptr;
+		size_t jsonSize = 0;
+		for (size_t offset = 12; offset + 8 <= length;) {
+			size_t chunkSize = ReadU32(data + offset);
+			uint32_t chunkType = ReadU32(data + offset + 4);
+			if (offset + 8 + chunkSize > length) return Fail("truncated glb chunk");
+			if (chunkType == GLB_CHUNK_JSON && json == nullptr) {
+				json = reinterpret_cast<const char*>(data + offset + 8);
+				jsonSize = chunkSize;
+			}
+			else if (chunkType == GLB_CHUNK_BIN && binChunk == nullptr) {
+				binChunk = data + offset + 8;
+				binSize = chunkSize;
+			}
+			offset += 8 + ((chunkSize + 3) & ~size_t(3));
+		}
+		if (json == nullptr) return Fail("glb without a json chunk");
+		document = JsonValue::Parse(json, jsonSize);
+	}
+	else {
+		document = JsonValue::Parse(reinterpret_cast<const char*>(data), size);
+	}
+
+	if (document["asset"]["version"].GetString().compare(0, 2, "2.") != 0) return Fail("not a glTF 2.0 file");
+	const JsonValue& required = document["extensionsRequired"];
+	if (required.Size() > 0) return Fail("requires extension " + required[0].GetString());
+	if (!LoadBuffers(binChunk, binSize) || !LoadImages()) return false;
+
+	//default scene, files without scenes list every mesh once
+	const JsonValue& scenes = document["scenes"];
+	if (scenes.Size() > 0) {
+		const JsonValue& nodes = scenes[document["scene"].GetInt(0)]["nodes"];
+		for (size_t i = 0; i < nodes.Size(); i++) {
+			if (!CollectNode(nodes[i].GetInt(), 0)) return false;
+		}
+	}
+	else {
+		for (size_t i = 0; i < document["meshes"].Size(); i++) {
+			if (!AddMesh(static_cast<int>(i))) return false;
+		}
+	}
+	return true;
+}
+
+bool GltfLoader::LoadBuffers(const uint8_t* binChunk, size_t binSize) {
+	std::string directory = GetDirectory(fileName);
+	const JsonValue& list = document["buffers"];
+	buffers.resize(list.Size());
+	for (size_t i = 0; i < list.Size(); i++) {
+		const JsonValue& buffer = list[i];
+		size_t byteLength = GetSize(buffer["byteLength"]);
+		Buffer& out = buffers[i];
+		if (!buffer.Has("uri")) {
+			//the glb's own binary chunk
+			if (i != 0 || binChunk == nullptr) return Fail("buffer without data");
+			out.data = binChunk;
+			out.size = binSize;
+		}
+		else if (buffer["uri"].GetString().compare(0, 5, "data:") == 0) {
+			decodedBuffers.emplace_back();
+			if (!DecodeDataUri(buffer["uri"].GetString(), decodedBuffers.back())) return Fail("bad data uri");
+			out.data = decodedBuffers.back().data();
+			out.size = decodedBuffers.back().size();
+		}
+		else {
+			std::string path = directory + DecodeUri(buffer["uri"].GetString());
+			dependencies.push_back(path);
+			mappedBuffers.push_back(std::make_unique<MappedFile>());
+			if (!mappedBuffers.back()->Open(path)) return Fail("can't map buffer " + path);
+			out.data = mappedBuffers.back()->GetData();
+			out.size = mappedBuffers.back()->GetSize();
+		}
+		if (out.size < byteLength) return Fail("buffer shorter than its byteLength");
+		out.size = byteLength;
+	}
+	return true;
+}
+
+bool GltfLoader::LoadImages() {
+	std::string directory = GetDirectory(fileName);
+	const JsonValue& list = document["images"];
+	images.resize(list.Size());
+	for (size_t i = 0; i < list.Size(); i++) {
+		const JsonValue& image = list[i];
+		Image& out = images[i];
+		if (image.Has("bufferView")) {
+			const JsonValue& view = document["bufferViews"][image["bufferView"].GetInt()];
+			int buffer = view["buffer"].GetInt();
+			size_t offset = GetSize(view["byteOffset"]);
+			size_t length = GetSize(view["byteLength"]);
+			if (buffer < 0 || buffer >= static_cast<int>(buffers.size()) || !InBounds(offset, length, buffers[buffer].size)) return Fail("bad image buffer view");
+			out.path = fileName + "#image" + std::to_string(i);
+			out.data = buffers[buffer].data + offset;
+			out.size = length;
+		}
+		else if (image["uri"].GetString().compare(0, 5, "data:") == 0) {
+			decodedBuffers.emplace_back();
+			if (!DecodeDataUri(image["uri"].GetString(), decodedBuffers.back())) return Fail("bad image data uri");
+			out.path = fileName + "#image" + std::to_string(i);
+			out.data = decodedBuffers.back().data();
+			out.size = decodedBuffers.back().size();
+		}
+		else {
+			out.path = directory + DecodeUri(image["uri"].GetString());
+		}
+	}
+	return true;
+}
+
+bool GltfLoader::CollectNode(int node, int depth) {
+	const JsonValue& json = document["nodes"][node];
+	if (!json.IsObject() || depth > MAX_NODE_DEPTH) return Fail("bad node hierarchy");
+	//transforms are not applied, the same as the assimp path
+	if (json.Has("mesh") && !AddMesh(json["mesh"].GetInt())) return false;
+	const JsonValue& children = json["children"];
+	for (size_t i = 0; i < children.Size(); i++) {
+		if (!CollectNode(children[i].GetInt(), depth + 1)) return false;
+	}
+	return true;
+}
+
+bool GltfLoader::AddMesh(int mesh) {
+	const JsonValue& list = document["meshes"][mesh]["primitives"];
+	if (!list.IsArray()) return Fail("bad mesh index");
+	for (size_t i = 0; i < list.Size(); i++) {
+		const JsonValue& json = list[i];
+		Primitive primitive;
+		primitive.mode = json["mode"].GetInt(4);
+		//points and lines can't go into a triangle list, assimp's triangulation drops them as well
+		if (primitive.mode < 4 || primitive.mode > 6) continue;
+		primitive.material = json["material"].GetInt(-1);
+		const JsonValue& attributes = json["attributes"];
+		if (!GetAccessor(attributes["POSITION"].GetInt(), primitive.positions, false) || primitive.positions.components != 3) {
+			return Fail("missing or unsupported positions (sparse accessors are not read)");
+		}
+		size_t vertexCount = primitive.positions.count;
+		if (attributes.Has("NORMAL")) {
+			if (!GetAccessor(attributes["NORMAL"].GetInt(), primitive.normals, false) || primitive.normals.components != 3 || primitive.normals.count != vertexCount) {
+				return Fail("unsupported normals");
+			}
+		}
+		if (attributes.Has("TEXCOORD_0")) {
+			if (!GetAccessor(attributes["TEXCOORD_0"].GetInt(), primitive.texCoords, false) || primitive.texCoords.components != 2 || primitive.texCoords.count != vertexCount) {
+				return Fail("unsupported texture coordinates");
+			}
+		}
+		if (json.Has("indices") && !GetAccessor(json["indices"].GetInt(), primitive.indices, true)) {
+			return Fail("unsupported indices");
+		}
+		primitives.push_back(primitive);
+	}
+	return true;
+}
+
+bool GltfLoader::GetAccessor(int accessor, AccessorView& out, bool isIndex) const {
+	const JsonValue& json = document["accessors"][accessor];
+	if (!json.IsObject()) return false;
+	if (json.Has("sparse") || !json.Has("bufferView")) return false;
+	out.componentType = json["componentType"].GetInt(0);
+	out.components = GetComponentCount(json["type"].GetString());
+	out.normalized = json["normalized"].GetBool(false);
+	out.count = GetSize(json["count"]);
+	size_t componentSize = GetComponentSize(out.componentType);
+	if (componentSize == 0 || out.components == 0) return false;
+	if (isIndex) {
+		if (out.components != 1 || (out.componentType != UNSIGNED_BYTE && out.componentType != UNSIGNED_SHORT && out.componentType != UNSIGNED_INT)) return false;
+	}
+	else if (out.componentType == UNSIGNED_INT) return false;
+	const JsonValue& view = document["bufferViews"][json["bufferView"].GetInt()];
+	int buffer = view["buffer"].GetInt();
+	if (buffer < 0 || buffer >= static_cast<int>(buffers.size())) return false;
+	size_t viewOffset = GetSize(view["byteOffset"]);
+	size_t viewLength = GetSize(view["byteLength"]);
+	if (!InBounds(viewOffset, viewLength, buffers[buffer].size)) return false;
+	size_t elementSize = componentSize * out.components;
+	out.stride = GetSize(view["byteStride"]);
+	if (out.stride == 0) out.stride = elementSize;
+	if (out.stride < elementSize) return false;
+	size_t offset = GetSize(json["byteOffset"]);
+	if (offset > viewLength) return false;
+	if (out.count > 0) {
+		//the last element starts stride * (count - 1) after the first
+		size_t lastStart;
+		if (!Multiply(out.stride, out.count - 1, lastStart) || !InBounds(lastStart, elementSize, viewLength - offset)) return false;
+	}
+	out.data = buffers[buffer].data + viewOffset + offset;
+	return true;
+}
+
+int GltfLoader::GetTextureImage(const JsonValue& textureInfo) const {
+	if (!textureInfo.IsObject()) return -1;
+	int image = document["textures"][textureInfo["index"].GetInt()]["source"].GetInt(-1);
+	return image < static_cast<int>(images.size()) ? image : -1;
+}
+
+GltfLoader::MaterialImages GltfLoader::GetMaterialImages(int material) const {
+	MaterialImages out;
+	const JsonValue& json = document["materials"][material];
+	out.baseColor = GetTextureImage(json["pbrMetallicRoughness"]["baseColorTexture"]);
+	out.metallicRoughness = GetTextureImage(json["pbrMetallicRoughness"]["metallicRoughnessTexture"]);
+	out.normal = GetTextureImage(json["normalTexture"]);
+	out.occlusion = GetTextureImage(json["occlusionTexture"]);
+	out.emissive = GetTextureImage(json["emissiveTexture"]);
+	return out;
+}
+
+void GltfLoader::ConvertPrimitive(size_t index, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) const {
+	const Primitive& primitive = primitives[index];
+	const AccessorView& positions = primitive.positions;
+	//meshes without normals reuse the positions, the same as the assimp path
+	const AccessorView& normals = primitive.normals.count > 0 ? primitive.normals : positions;
+	const AccessorView& texCoords = primitive.texCoords;
+	size_t vertexCount = positions.count;
+	vertices.resize(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++) {
+		Vertex& v = vertices[i];
+		ReadElement(positions.data, positions.stride, positions.componentType, positions.normalized, i, &v.position.x, 3);
+		ReadElement(normals.data, normals.stride, normals.componentType, normals.normalized, i, &v.normal.x, 3);
+		if (texCoords.count > 0) {
+			ReadElement(texCoords.data, texCoords.stride, texCoords.componentType, texCoords.normalized, i, &v.texCoords.x, 2);
+			//images are flipped on load, assimp's gltf importer flips v to match
+			v.texCoords.y = 1.0f - v.texCoords.y;
+		}
+		else v.texCoords = glm::vec2(0.0f);
+	}
+
+	//the index list as stored, or 0..n-1 for non indexed primitives
+	std::vector<unsigned int> source;
+	std::vector<unsigned int>& list = primitive.mode == 4 ? indices : source;
+	const AccessorView& view = primitive.indices;
+	if (view.count > 0) {
+		list.resize(view.count);
+		if (view.componentType == UNSIGNED_INT && view.stride == sizeof(uint32_t)) {
+			memcpy(list.data(), view.data, view.count * sizeof(uint32_t));
+		}
+		else {
+			for (size_t i = 0; i < view.count; i++) list[i] = ReadIndex(view.data + i * view.stride, view.componentType);
+		}
+		for (unsigned int i : list) {
+			if (i >= vertexCount) throw std::runtime_error("failed to read gltf primitive, index out of range!");
+		}
+	}
+	else {
+		list.resize(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++) list[i] = static_cast<unsigned int>(i);
+	}
+	if (primitive.mode == 4) {
+		indices.resize(indices.size() / 3 * 3);
+		return;
+	}
+	//strips and fans become a triangle list, winding kept counter clockwise
+	indices.clear();
+	if (source.size() < 3) return;
+	indices.reserve((source.size() - 2) * 3);
+	for (size_t i = 2; i < source.size(); i++) {
+		if (primitive.mode == 5) {
+			bool odd = (i & 1) != 0;
+			indices.push_back(source[i - 2]);
+			indices.push_back(odd ? source[i] : source[i - 1]);
+			indices.push_back(odd ? source[i - 1] : source[i]);
+		}
+		else {
+			indices.push_back(source[0]);
+			indices.push_back(source[i - 1]);
+			indices.push_back(source[i]);
+		}
+	}
+}
+
+bool GltfLoader::Fail(const std::string& reason) const {
+	printf("Can't read %s natively : %s\n", fileName.c_str(), reason.c_str());
+	return false;
+}
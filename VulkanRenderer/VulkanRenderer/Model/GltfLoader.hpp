@@ -0,0 +1,91 @@
+#pragma once
+#ifndef GLTF_LOADER_HPP
+#define GLTF_LOADER_HPP
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "Geometry.hpp"
+#include "Tools/Json.hpp"
+#include "Tools/MappedFile.hpp"
+
+// Native glTF 2.0 reader (.gltf + .bin / .glb), used by ModelImporter instead of assimp for these files.
+// the file and its buffers are memory mapped and accessors are read in place, so the only copy of the
+// geometry is the one into the import vertices. covers what the renderer draws : triangle primitives,
+// POSITION / NORMAL / TEXCOORD_0 and the metallic roughness material textures.
+// Open() returns false for anything else (sparse accessors, required extensions ...) and the caller falls back to assimp.
+class GltfLoader {
+public:
+	//one image of the file, either a path or an encoded png / jpg in memory owned by the loader
+	struct Image {
+		std::string path;				//embedded images get "<file>#image<n>" so they stay unique
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+	};
+	//image indices of one material, -1 when the slot is empty
+	struct MaterialImages {
+		int baseColor = -1;
+		int metallicRoughness = -1;
+		int normal = -1;
+		int occlusion = -1;
+		int emissive = -1;
+	};
+
+	static bool IsGltf(const std::string& fn);
+
+	//false when the file is broken or uses something this reader doesn't cover, the reason is printed
+	bool Open(const std::string& fn);
+
+	//primitives of the default scene in node order, a mesh used by two nodes is listed twice (like ModelImporter's assimp path)
+	size_t GetPrimitiveCount() const { return primitives.size(); }
+	int GetPrimitiveMaterial(size_t primitive) const { return primitives[primitive].material; }
+	MaterialImages GetMaterialImages(int material) const;
+	const std::vector<Image>& GetImages() const { return images; }
+	//external buffer files (.bin) Open() read, images are not listed
+	const std::vector<std::string>& GetDependencies() const { return dependencies; }
+	//thread safe, everything was validated by Open()
+	void ConvertPrimitive(size_t primitive, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) const;
+private:
+	//accessor resolved to memory
+	struct AccessorView {
+		const uint8_t* data = nullptr;
+		size_t count = 0;
+		size_t stride = 0;
+		int componentType = 0;
+		int components = 0;
+		bool normalized = false;
+	};
+	struct Primitive {
+		int mode = 4;					//4 triangles, 5 strip, 6 fan
+		int material = -1;
+		AccessorView positions;
+		AccessorView normals;			//count 0 when missing
+		AccessorView texCoords;
+		AccessorView indices;			//count 0 -> not indexed
+	};
+	struct Buffer {
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+	};
+	std::string fileName;
+	MappedFile file;
+	JsonValue document;
+	std::vector<std::unique_ptr<MappedFile>> mappedBuffers;
+	std::vector<std::vector<uint8_t>> decodedBuffers;	//base64 data uris
+	std::vector<Buffer> buffers;
+	std::vector<Image> images;
+	std::vector<Primitive> primitives;
+	std::vector<std::string> dependencies;
+
+	bool Parse(const std::string& fn);
+	bool LoadBuffers(const uint8_t* binChunk, size_t binSize);
+	bool LoadImages();
+	bool CollectNode(int node, int depth);
+	bool AddMesh(int mesh);
+	bool GetAccessor(int accessor, AccessorView& out, bool isIndex) const;
+	int GetTextureImage(const JsonValue& textureInfo) const;
+	bool Fail(const std::string& reason) const;
+};
+
+#endif // !GLTF_LOADER_HPP
@@ -12,4 +12,20 @@ struct  Material{
 	int metalnessMapIdx = -1;
 	int ambOcclMapIdx = -1;
 };
+
+//every texture index of a Material, for code treating the slots alike
+inline constexpr int Material::* MATERIAL_TEXTURE_SLOTS[] = {
+	&Material::diffTexIdx, &Material::specTexIdx, &Material::bumpMapIdx, &Material::normalMapIdx, &Material::emissionMapIdx,
+	&Material::opacityMapIdx, &Material::roughnessMapIdx, &Material::metalnessMapIdx, &Material::ambOcclMapIdx
+};
+static_assert(sizeof(Material) == sizeof(MATERIAL_TEXTURE_SLOTS) / sizeof(MATERIAL_TEXTURE_SLOTS[0]) * sizeof(int), "a new Material slot is missing from MATERIAL_TEXTURE_SLOTS");
+
+//material with every set texture index (>= 0) replaced by remap(index), unset ones stay -1
+template<typename Remap>
+Material RemapTextureIndices(Material material, Remap remap) {
+	for (int Material::* slot : MATERIAL_TEXTURE_SLOTS) {
+		if (material.*slot >= 0) material.*slot = remap(material.*slot);
+	}
+	return material;
+}
 #endif // !MATERIAL_HPP
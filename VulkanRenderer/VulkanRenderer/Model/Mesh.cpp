@@ -1,11 +1,79 @@
 #include "Mesh.hpp"
+#include <algorithm>
 
 void Mesh::Draw(VkPipelineLayout pipelineLayout, VkCommandBuffer commandBuffer) {
+	PushMaterial(pipelineLayout, commandBuffer);
+	//vertex/index buffers are bound once by Model::Draw
+	DrawGeometry(commandBuffer);
+}
+
+void Mesh::PushMaterial(VkPipelineLayout pipelineLayout, VkCommandBuffer commandBuffer) {
 	GlobalStructs::TextureIndexPushConstant push_constant(material);
 	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(GlobalStructs::VertexShaderPushConstant), sizeof(GlobalStructs::TextureIndexPushConstant), &push_constant);
+}
+
+uint32_t Mesh::SelectLod(float errorScale, float maxPixelError, float hysteresis, uint32_t current) const {
+	if (lods.size() < 2) return 0;
+	uint32_t lod = 0;
+	for (uint32_t i = static_cast<uint32_t>(lods.size()) - 1; i > 0; i--) {
+		if (lods[i].error * errorScale <= maxPixelError) {
+			lod = i;
+			break;
+		}
+	}
+	if (lod > current) {
+		uint32_t coarser = current;
+		for (uint32_t i = lod; i > current; i--) {
+			if (lods[i].error * errorScale <= maxPixelError * (1.0f - hysteresis)) {
+				coarser = i;
+				break;
+			}
+		}
+		lod = coarser;
+	}
+	return lod;
+}
+
+void Mesh::DrawClusters(VkCommandBuffer commandBuffer, const CullView& view, const glm::mat4& modelMat, CullStats& stats) {
+	if (meshlets.empty()) {
+		DrawGeometry(commandBuffer);
+		stats.drawCalls++;
+		return;
+	}
+	//bounds are in mesh space, the cone test assumes a uniform scale
+	glm::mat3 basis(modelMat);
+	float scale = std::max(glm::length(basis[0]), std::max(glm::length(basis[1]), glm::length(basis[2])));
+	uint32_t runFirst = 0, runCount = 0;
+	auto flush = [&]() {
+		if (runCount == 0) return;
+		vkCmdDrawIndexed(commandBuffer, runCount, 1, firstIndex + runFirst, vertexOffset, 0);
+		stats.drawCalls++;
+		runCount = 0;
+	};
+	for (const auto& meshlet : meshlets) {
+		stats.meshletsTested++;
+		glm::vec3 center = glm::vec3(modelMat * glm::vec4(meshlet.center, 1.0f));
+		float radius = meshlet.radius * scale;
+		if (!view.IsSphereVisible(center, radius)) continue;
+		if (meshlet.coneCutoff < 1.0f && view.IsBackfacing(center, radius, glm::normalize(basis * meshlet.coneAxis), meshlet.coneCutoff)) continue;
+		stats.meshletsVisible++;
+		if (runCount > 0 && runFirst + runCount == meshlet.firstIndex) {
+			runCount += meshlet.indexCount;
+			continue;
+		}
+		flush();
+		runFirst = meshlet.firstIndex;
+		runCount = meshlet.indexCount;
+	}
+	flush();
+}
 
-	VkDeviceSize offsets[] = { 0 };
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
-	vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-	vkCmdDrawIndexed(commandBuffer,static_cast<uint32_t>(indices.size()),1,0,0,0);
-}
\ No newline at end of file
+void Mesh::DrawIndirect(VkCommandBuffer commandBuffer, VkBuffer commands, uint32_t maxDrawCount, CullStats& stats) {
+	//one command per meshlet, the culled ones draw no instance
+	for (uint32_t first = 0; first < meshletCount; first += maxDrawCount) {
+		uint32_t count = std::min(meshletCount - first, maxDrawCount);
+		vkCmdDrawIndexedIndirect(commandBuffer, commands, (firstMeshlet + first) * sizeof(VkDrawIndexedIndirectCommand), count, sizeof(VkDrawIndexedIndirectCommand));
+		stats.drawCalls++;
+	}
+	stats.meshletsTested += meshletCount;
+}
@@ -6,97 +6,115 @@
 #include <glm/glm.hpp>
 #include <array>
 #include <vector>
+#include <utility>
 #include "Material.hpp"
+#include "Geometry.hpp"
+#include "VertexLayout.hpp"
+#include "Meshlet.hpp"
 #include "Renderer.h"
-struct Vertex
-{
-	glm::vec3 position;
-	glm::vec3 normal;
-	glm::vec2 texCoords;
-	static VkVertexInputBindingDescription GetBindingDescription() {
-		VkVertexInputBindingDescription bindingDescription{};
-		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Vertex);
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		return bindingDescription;
-	}
-	static std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescriptons() {
-		std::array<VkVertexInputAttributeDescription, 3> attributeDescription{};
-		attributeDescription[0].binding = 0;
-		attributeDescription[0].location = 0;
-		attributeDescription[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescription[0].offset = offsetof(Vertex, position);
-
-		attributeDescription[1].binding = 0;
-		attributeDescription[1].location = 1;
-		attributeDescription[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescription[1].offset = offsetof(Vertex, normal);
-
-		attributeDescription[2].binding = 0;
-		attributeDescription[2].location = 2;
-		attributeDescription[2].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescription[2].offset = offsetof(Vertex, texCoords);
-		return attributeDescription;
-	}
-	bool operator==(const Vertex& other) const {
-		return position == other.position && normal == other.normal && texCoords == other.texCoords;
-	}
+//levels of detail one model last drew its meshes at, for one view of one instance. a model drawn twice keeps two,
+//passes following the same instance (shadow, main) may share one. Mesh::SelectLod()'s hysteresis is relative to it
+struct LodState {
+	std::vector<uint32_t> levels;	//per mesh, sized by Model::Draw()
 };
 
 class Mesh {
+	friend class Model;
 public:
-	Mesh(std::vector<Vertex>& _vertices, std::vector<unsigned int>& _indices, Material _material) :vertices(_vertices), indices(_indices), material(_material) {
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-		CreateBuffer(vertices.data(), bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,vertexBuffer, vertexBufferMemory, "vertexBuffer");
-		bufferSize = sizeof(indices[0]) * indices.size();
-		CreateBuffer(indices.data(), bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,indexBuffer, indexBufferMemory, "indexBuffer");
+	//geometry lives in the owning Model's arena, Model::UploadGeometry() fills firstIndex/vertexOffset.
+	//the vertex/index arrays are moved in, never copied.
+	Mesh(std::vector<Vertex>&& _vertices, std::vector<unsigned int>&& _indices, const Material& _material) :material(_material), vertices(std::move(_vertices)), indices(std::move(_indices)) {
+		indexCount = static_cast<uint32_t>(indices.size());
+		for (const auto& v : vertices) bounds.Expand(v.position);
+		bounds.Finalize();
+	}
+	//bounds already computed by the importer or stored in a cache, saves a pass over the vertices
+	Mesh(std::vector<Vertex>&& _vertices, std::vector<unsigned int>&& _indices, const Material& _material, const Bounds& _bounds) :material(_material), vertices(std::move(_vertices)), indices(std::move(_indices)), bounds(_bounds) {
+		indexCount = static_cast<uint32_t>(indices.size());
+	}
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+	Mesh(Mesh&&) noexcept = default;
+	Mesh& operator=(Mesh&&) noexcept = default;
+	//drawing description without the cpu geometry, for another Model drawing the same arena (AssetRegistry)
+	Mesh Instance() const {
+		Mesh out(std::vector<Vertex>(), std::vector<unsigned int>(), material, bounds);
+		out.indexCount = indexCount;
+		out.firstIndex = firstIndex;
+		out.vertexOffset = vertexOffset;
+		out.indexType = indexType;
+		out.quantization = quantization;
+		out.meshlets = meshlets;
+		out.firstMeshlet = firstMeshlet;
+		out.meshletCount = meshletCount;
+		out.lods = lods;
+		return out;
 	}
 
 	void Draw(VkPipelineLayout pipelineLayout, VkCommandBuffer commandBuffer);
+	void PushMaterial(VkPipelineLayout pipelineLayout, VkCommandBuffer commandBuffer);
+	//draw call only, no material push constant (depth passes)
+	void DrawGeometry(VkCommandBuffer commandBuffer) {
+		vkCmdDrawIndexed(commandBuffer, indexCount, 1, firstIndex, vertexOffset, 0);
+	}
+	//level 0 is the range DrawGeometry() draws
+	void DrawLod(VkCommandBuffer commandBuffer, uint32_t lod) {
+		if (lod == 0 || lod >= lods.size()) {
+			DrawGeometry(commandBuffer);
+			return;
+		}
+		vkCmdDrawIndexed(commandBuffer, lods[lod].indexCount, 1, firstIndex + lods[lod].firstIndex, vertexOffset, 0);
+	}
+	//coarsest level whose error stays under maxPixelError, errorScale = pixels per mesh unit at the mesh's distance.
+	//going coarser than current needs the error under maxPixelError * (1 - hysteresis), going finer happens right away.
+	uint32_t SelectLod(float errorScale, float maxPixelError, float hysteresis, uint32_t current) const;
+	//draws the meshlets that survive frustum and cone culling, adjacent survivors are merged into one draw.
+	//meshes without meshlets are drawn whole.
+	void DrawClusters(VkCommandBuffer commandBuffer, const CullView& view, const glm::mat4& modelMat, CullStats& stats);
+	//draws the meshlet commands Model::Cull() wrote into commands, one indirect call unless there are more than maxDrawCount
+	void DrawIndirect(VkCommandBuffer commandBuffer, VkBuffer commands, uint32_t maxDrawCount, CullStats& stats);
 public:
 	Material material;
 	void Clean() {
-		Renderer* instance = Renderer::GetInstance();
-		vkDestroyBuffer(instance->device, vertexBuffer, nullptr);
-		vkDestroyBuffer(instance->device, indexBuffer, nullptr);
-		vkFreeMemory(instance->device, vertexBufferMemory, nullptr);
-		vkFreeMemory(instance->device, indexBufferMemory, nullptr);
-		vertices.clear();
-		indices.clear();
+		std::vector<Vertex>().swap(vertices);
+		std::vector<unsigned int>().swap(indices);
+	}
+	//frees the cpu copy of the geometry, returns the bytes released.
+	//meshlets are drawing data and survive KeepBounds, KeepNothing drops them with the bounds
+	size_t ApplyRetention(GeometryRetention retention) {
+		if (retention == GeometryRetention::KeepAll) return 0;
+		size_t freed = vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int);
+		Clean();
+		if (retention == GeometryRetention::KeepNothing) {
+			bounds = Bounds{};
+			freed += meshlets.capacity() * sizeof(Meshlet);
+			std::vector<Meshlet>().swap(meshlets);
+		}
+		return freed;
 	}
+	bool HasCpuGeometry() const { return !vertices.empty() || indexCount == 0; }
+	const Bounds& GetBounds() const { return bounds; }
+	const std::vector<Vertex>& GetVertices() const { return vertices; }
+	const std::vector<unsigned int>& GetIndices() const { return indices; }
+	const std::vector<Meshlet>& GetMeshlets() const { return meshlets; }
+	const std::vector<MeshLod>& GetLods() const { return lods; }
+	uint32_t GetIndexCount() const { return indexCount; }
+	VkIndexType GetIndexType() const { return indexType; }
+	const Quantization& GetQuantization() const { return quantization; }
+	uint32_t GetFirstIndex() const { return firstIndex; }
+	int32_t GetVertexOffset() const { return vertexOffset; }
 private:
 	std::vector<Vertex>			vertices;
 	std::vector<unsigned int>	indices;
-	VkBuffer vertexBuffer = VK_NULL_HANDLE;
-	VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
-	VkBuffer indexBuffer = VK_NULL_HANDLE;
-	VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
-
-private:
-	//latter, need to implement single buffer(vertex + index)
-	template <typename T>
-	inline void CreateBuffer(T* src, VkDeviceSize bufferSize, VkBufferUsageFlagBits usages, VkBuffer& outBuffer, VkDeviceMemory& outBufferMemory, std::string purpose = "") {
-		Renderer* instance = Renderer::GetInstance();
-		if (instance == nullptr) {
-			printf("Fail to create %s Buffer. Please create Renderer instance or call Renderer::init()\n", purpose.c_str());
-			return;
-		}
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		Utils::CreateBuffer(instance->device, instance->physicalDevice, bufferSize,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			stagingBuffer, stagingBufferMemory, VK_SHARING_MODE_EXCLUSIVE
-		);
-		void* data;
-		vkMapMemory(instance->device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, src, (size_t)bufferSize);
-		vkUnmapMemory(instance->device, stagingBufferMemory);
-
-		Utils::CreateBuffer(instance->device, instance->physicalDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usages, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, outBuffer, outBufferMemory);
-		Utils::CopyBuffer(instance->device, instance->commandPool, instance->graphicsQueue, stagingBuffer, outBuffer, bufferSize);
-
-		vkDestroyBuffer(instance->device, stagingBuffer, nullptr);
-		vkFreeMemory(instance->device, stagingBufferMemory, nullptr);
-	}
+	uint32_t indexCount = 0;
+	uint32_t firstIndex = 0;	// in indices, from the start of the arena range of indexType
+	int32_t vertexOffset = 0;	// in vertices, added to every index
+	VkIndexType indexType = VK_INDEX_TYPE_UINT32;	// UINT16 when the mesh has fewer than 65536 vertices
+	Quantization quantization;	// position decode of a Compact arena, identity for Full
+	Bounds bounds;
+	std::vector<Meshlet> meshlets;	// index ranges of the cluster culling, level 0 only. empty -> drawn whole
+	uint32_t firstMeshlet = 0;		// range of the model's gpu meshlet table, kept by every retention
+	uint32_t meshletCount = 0;
+	std::vector<MeshLod> lods;		// empty -> level 0 only
 };
 #endif // !Mesh_HPP
@@ -0,0 +1,629 @@
+#include "MeshOptimizer.hpp"
+#include <unordered_map>
+#include <numeric>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+namespace {
+	struct VertexHasher {
+		size_t operator()(const Vertex& v) const {
+			//+0.0f folds -0.0 into 0.0, they compare equal so they must hash equal
+			float data[8] = { v.position.x + 0.0f, v.position.y + 0.0f, v.position.z + 0.0f,
+				v.normal.x + 0.0f, v.normal.y + 0.0f, v.normal.z + 0.0f, v.texCoords.x + 0.0f, v.texCoords.y + 0.0f };
+			uint32_t bits[8];
+			memcpy(bits, data, sizeof(bits));
+			size_t h = 2166136261u;
+			for (uint32_t b : bits) {
+				h = (h ^ b) * 16777619u;
+			}
+			return h;
+		}
+	};
+
+	//forsyth scoring constants
+	constexpr uint32_t FORSYTH_CACHE_SIZE = 32;
+	constexpr float CACHE_DECAY_POWER = 1.5f;
+	constexpr float LAST_TRI_SCORE = 0.75f;
+	constexpr float VALENCE_BOOST_SCALE = 2.0f;
+	constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+	float VertexScore(int cachePos, uint32_t remainingValence) {
+		if (remainingValence == 0) return -1.0f;
+		float score = 0.0f;
+		if (cachePos >= 0) {
+			if (cachePos < 3) {
+				score = LAST_TRI_SCORE;
+			}
+			else {
+				float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+				score = powf(1.0f - (cachePos - 3) * scaler, CACHE_DECAY_POWER);
+			}
+		}
+		score += VALENCE_BOOST_SCALE * powf(float(remainingValence), -VALENCE_BOOST_POWER);
+		return score;
+	}
+
+	//timestamp fifo : a vertex is cached while fewer than cacheSize misses happened since it was loaded
+	struct FifoCache {
+		std::vector<uint32_t> timestamps;
+		uint32_t time;
+		uint32_t size;
+		FifoCache(size_t vertexCount, uint32_t cacheSize) :timestamps(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+		bool Access(unsigned int v) {
+			if (time - timestamps[v] > size) {
+				timestamps[v] = time++;
+				return true;
+			}
+			return false;
+		}
+		void Flush() { time += size + 1; }
+	};
+
+	struct PositionHasher {
+		size_t operator()(const glm::vec3& p) const {
+			float data[3] = { p.x + 0.0f, p.y + 0.0f, p.z + 0.0f };
+			uint32_t bits[3];
+			memcpy(bits, data, sizeof(bits));
+			size_t h = 2166136261u;
+			for (uint32_t b : bits) {
+				h = (h ^ b) * 16777619u;
+			}
+			return h;
+		}
+	};
+
+	//sum of squared distances to a set of planes, area weighted (Garland & Heckbert)
+	struct Quadric {
+		double a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+		double b0 = 0, b1 = 0, b2 = 0, c = 0;
+		double weight = 0;
+
+		//plane dot(n, p) + d = 0, n normalized
+		static Quadric FromPlane(const glm::dvec3& n, double d, double w) {
+			Quadric q;
+			q.a00 = n.x * n.x * w; q.a11 = n.y * n.y * w; q.a22 = n.z * n.z * w;
+			q.a01 = n.x * n.y * w; q.a02 = n.x * n.z * w; q.a12 = n.y * n.z * w;
+			q.b0 = n.x * d * w; q.b1 = n.y * d * w; q.b2 = n.z * d * w;
+			q.c = d * d * w;
+			q.weight = w;
+			return q;
+		}
+		Quadric& operator+=(const Quadric& rhs) {
+			a00 += rhs.a00; a11 += rhs.a11; a22 += rhs.a22;
+			a01 += rhs.a01; a02 += rhs.a02; a12 += rhs.a12;
+			b0 += rhs.b0; b1 += rhs.b1; b2 += rhs.b2;
+			c += rhs.c;
+			weight += rhs.weight;
+			return *this;
+		}
+		//mean squared distance of p to the planes
+		double Error(const glm::vec3& p) const {
+			if (weight <= 0.0) return 0.0;
+			double x = p.x, y = p.y, z = p.z;
+			double r = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+				+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+			return std::fabs(r) / weight;
+		}
+	};
+
+	//open edges get a plane perpendicular to the surface so borders do not shrink
+	constexpr double BORDER_WEIGHT = 10.0;
+
+	enum class VertexKind : uint8_t {
+		Manifold,	//collapses to any neighbour
+		Border,		//collapses along open edges only
+		Locked		//uv / normal seam, several vertices share the position
+	};
+
+	//bounding sphere and normal cone of triangles [begin, end)
+	Meshlet MakeMeshlet(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t begin, size_t end) {
+		Meshlet meshlet{};
+		meshlet.firstIndex = static_cast<uint32_t>(begin * 3);
+		meshlet.indexCount = static_cast<uint32_t>((end - begin) * 3);
+		Bounds box;
+		for (size_t i = begin * 3; i < end * 3; i++) box.Expand(vertices[indices[i]].position);
+		box.Finalize();
+		meshlet.center = box.center;
+		for (size_t i = begin * 3; i < end * 3; i++) {
+			meshlet.radius = std::max(meshlet.radius, glm::length(vertices[indices[i]].position - box.center));
+		}
+		glm::vec3 normals[MESHLET_MAX_TRIANGLES];
+		uint32_t normalCount = 0;
+		glm::vec3 axis(0.0f);
+		for (size_t t = begin; t < end && normalCount < MESHLET_MAX_TRIANGLES; t++) {
+			const glm::vec3& a = vertices[indices[t * 3]].position;
+			const glm::vec3& b = vertices[indices[t * 3 + 1]].position;
+			const glm::vec3& c = vertices[indices[t * 3 + 2]].position;
+			glm::vec3 n = glm::cross(b - a, c - a);
+			float length = glm::length(n);
+			if (length <= 0.0f) continue;	//degenerate triangles face nowhere
+			normals[normalCount++] = n / length;
+			axis += n / length;
+		}
+		float axisLength = glm::length(axis);
+		if (normalCount == 0 || axisLength <= 0.0f) return meshlet;
+		axis /= axisLength;
+		float minDot = 1.0f;
+		for (uint32_t i = 0; i < normalCount; i++) minDot = std::min(minDot, glm::dot(axis, normals[i]));
+		meshlet.coneAxis = axis;
+		//a cone wider than 90 degrees is never fully backfacing, keep the cutoff at 1
+		if (minDot > 0.0f) meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+		return meshlet;
+	}
+
+	//quadric error edge collapse toward every target index count in turn (descending).
+	//onLevel(indices, error) is called once per target reached, and once more if the collapses stall.
+	//quadrics keep accumulating between targets, so every error is measured against the input.
+	template<typename OnLevel>
+	void SimplifyLevels(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<size_t>& targets, float maxError, OnLevel&& onLevel) {
+		std::vector<unsigned int> result = indices;
+		float error = 0.0f;
+		if (targets.empty() || vertices.empty()) return;
+
+		//vertices sharing a position are one point of the surface
+		std::vector<unsigned int> posId(vertices.size());
+		std::vector<uint32_t> wedgeCount(vertices.size(), 0);
+		{
+			std::unordered_map<glm::vec3, unsigned int, PositionHasher> lookup;
+			lookup.reserve(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++) {
+				unsigned int id = lookup.emplace(vertices[i].position, static_cast<unsigned int>(i)).first->second;
+				posId[i] = id;
+				wedgeCount[id]++;
+			}
+		}
+		auto edgeKey = [](unsigned int a, unsigned int b) { return (uint64_t(a) << 32) | b; };
+		//sorted half edges
+		std::vector<uint64_t> edges;
+		auto buildEdges = [&]() {
+			edges.clear();
+			for (size_t i = 0; i < result.size(); i += 3) {
+				for (int k = 0; k < 3; k++) edges.push_back(edgeKey(posId[result[i + k]], posId[result[i + (k + 1) % 3]]));
+			}
+			std::sort(edges.begin(), edges.end());
+		};
+		//an edge used by one triangle has no opposite half edge
+		auto isBorder = [&](unsigned int a, unsigned int b) { return !std::binary_search(edges.begin(), edges.end(), edgeKey(b, a)); };
+		buildEdges();
+
+		std::vector<VertexKind> kind(vertices.size(), VertexKind::Manifold);
+		std::vector<Quadric> quadrics(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++) {
+			if (wedgeCount[posId[i]] > 1) kind[posId[i]] = VertexKind::Locked;
+		}
+		for (size_t i = 0; i < result.size(); i += 3) {
+			glm::dvec3 p[3];
+			for (int k = 0; k < 3; k++) p[k] = glm::dvec3(vertices[result[i + k]].position);
+			glm::dvec3 n = glm::cross(p[1] - p[0], p[2] - p[0]);
+			double length = glm::length(n);
+			if (length <= 0.0) continue;
+			n /= length;
+			Quadric plane = Quadric::FromPlane(n, -glm::dot(n, p[0]), length * 0.5);
+			for (int k = 0; k < 3; k++) {
+				unsigned int a = posId[result[i + k]], b = posId[result[i + (k + 1) % 3]];
+				quadrics[a] += plane;
+				if (!isBorder(a, b)) continue;
+				if (kind[a] != VertexKind::Locked) kind[a] = VertexKind::Border;
+				if (kind[b] != VertexKind::Locked) kind[b] = VertexKind::Border;
+				glm::dvec3 edge = p[(k + 1) % 3] - p[k];
+				glm::dvec3 side = glm::cross(edge, n);
+				double sideLength = glm::length(side);
+				if (sideLength <= 0.0) continue;
+				side /= sideLength;
+				Quadric constraint = Quadric::FromPlane(side, -glm::dot(side, p[k]), glm::dot(edge, edge) * BORDER_WEIGHT);
+				quadrics[a] += constraint;
+				quadrics[b] += constraint;
+			}
+		}
+
+		struct Collapse {
+			unsigned int from, to;
+			double cost;
+		};
+		std::vector<Collapse> collapses;
+		std::vector<uint32_t> triangleOffsets, triangleList;
+		std::vector<uint8_t> locked(vertices.size());
+		std::vector<unsigned int> remap(vertices.size());
+		const double errorLimit = double(maxError) * double(maxError);
+		//each pass collapses independent edges in cost order, until the target or the error limit is hit
+		size_t level = 0;
+		while (level < targets.size()) {
+			size_t targetIndexCount = targets[level];
+			if (result.size() <= targetIndexCount) {
+				onLevel(result, error);
+				level++;
+				continue;
+			}
+			size_t triangleCount = result.size() / 3;
+			collapses.clear();
+			for (size_t i = 0; i < result.size(); i += 3) {
+				for (int k = 0; k < 3; k++) {
+					unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+					bool border = isBorder(posId[a], posId[b]);
+					//an inner edge is seen from both of its triangles, take it once
+					if (!border && posId[a] > posId[b]) continue;
+					for (int dir = 0; dir < 2; dir++) {
+						unsigned int from = dir == 0 ? a : b, to = dir == 0 ? b : a;
+						VertexKind fromKind = kind[posId[from]];
+						if (fromKind == VertexKind::Locked) continue;
+						if (fromKind == VertexKind::Border && !border) continue;
+						Quadric q = quadrics[posId[from]];
+						q += quadrics[posId[to]];
+						collapses.push_back({ from, to, q.Error(vertices[to].position) });
+					}
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) { return l.cost < r.cost; });
+
+			//vertex -> triangles
+			triangleOffsets.assign(vertices.size() + 1, 0);
+			for (unsigned int index : result) triangleOffsets[index + 1]++;
+			for (size_t i = 0; i < vertices.size(); i++) triangleOffsets[i + 1] += triangleOffsets[i];
+			triangleList.resize(result.size());
+			{
+				std::vector<uint32_t> cursor(triangleOffsets.begin(), triangleOffsets.end() - 1);
+				for (size_t i = 0; i < result.size(); i++) triangleList[cursor[result[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+
+			std::fill(locked.begin(), locked.end(), 0);
+			std::iota(remap.begin(), remap.end(), 0u);
+			size_t removeGoal = (result.size() - targetIndexCount + 2) / 3;
+			size_t removed = 0;
+			for (const auto& collapse : collapses) {
+				if (collapse.cost > errorLimit) break;
+				unsigned int pu = posId[collapse.from], pv = posId[collapse.to];
+				if (locked[pu] || locked[pv]) continue;
+				bool valid = true;
+				uint32_t dropped = 0;
+				for (uint32_t j = triangleOffsets[collapse.from]; j < triangleOffsets[collapse.from + 1] && valid; j++) {
+					const unsigned int* tri = &result[triangleList[j] * 3];
+					bool hasTarget = false;
+					for (int k = 0; k < 3; k++) {
+						if (locked[posId[tri[k]]]) valid = false;
+						if (posId[tri[k]] == pv) hasTarget = true;
+					}
+					if (hasTarget) {
+						dropped++;
+						continue;
+					}
+					//the triangles that stay must not flip
+					glm::vec3 before[3], after[3];
+					for (int k = 0; k < 3; k++) {
+						before[k] = vertices[tri[k]].position;
+						after[k] = tri[k] == collapse.from ? vertices[collapse.to].position : before[k];
+					}
+					glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+					glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+					if (glm::dot(n0, n1) <= 0.0f) valid = false;
+				}
+				if (!valid || dropped == 0) continue;
+				remap[collapse.from] = collapse.to;
+				quadrics[pv] += quadrics[pu];
+				for (uint32_t j = triangleOffsets[collapse.from]; j < triangleOffsets[collapse.from + 1]; j++) {
+					const unsigned int* tri = &result[triangleList[j] * 3];
+					for (int k = 0; k < 3; k++) locked[posId[tri[k]]] = 1;
+				}
+				error = std::max(error, static_cast<float>(std::sqrt(collapse.cost)));
+				removed += dropped;
+				if (removed >= removeGoal) break;
+			}
+			if (removed == 0) {
+				onLevel(result, error);
+				return;
+			}
+
+			size_t write = 0;
+			for (size_t t = 0; t < triangleCount; t++) {
+				unsigned int a = remap[result[t * 3]], b = remap[result[t * 3 + 1]], c = remap[result[t * 3 + 2]];
+				if (posId[a] == posId[b] || posId[b] == posId[c] || posId[a] == posId[c]) continue;
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+			result.resize(write);
+			buildEdges();
+		}
+	}
+}
+
+namespace MeshOptimizer {
+	Report& Report::operator+=(const Report& rhs) {
+		verticesBefore += rhs.verticesBefore;
+		verticesAfter += rhs.verticesAfter;
+		triangles += rhs.triangles;
+		missesBefore += rhs.missesBefore;
+		missesAfter += rhs.missesAfter;
+		return *this;
+	}
+
+	size_t CountCacheMisses(const std::vector<unsigned int>& indices, size_t vertexCount, uint32_t cacheSize) {
+		FifoCache cache(vertexCount, cacheSize);
+		size_t misses = 0;
+		for (unsigned int index : indices) {
+			if (cache.Access(index)) misses++;
+		}
+		return misses;
+	}
+
+	size_t WeldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+		std::unordered_map<Vertex, unsigned int, VertexHasher> unique;
+		unique.reserve(vertices.size());
+		std::vector<unsigned int> remap(vertices.size());
+		std::vector<Vertex> welded;
+		welded.reserve(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++) {
+			auto result = unique.emplace(vertices[i], static_cast<unsigned int>(welded.size()));
+			if (result.second) welded.push_back(vertices[i]);
+			remap[i] = result.first->second;
+		}
+		for (auto& index : indices) {
+			index = remap[index];
+		}
+		size_t removed = vertices.size() - welded.size();
+		vertices = std::move(welded);
+		return removed;
+	}
+
+	void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount) {
+		const size_t triCount = indices.size() / 3;
+		if (triCount == 0) return;
+		//vertex -> triangles adjacency, the live part of each list is [offsets[v], offsets[v] + remaining[v])
+		std::vector<uint32_t> remaining(vertexCount, 0);
+		for (unsigned int index : indices) remaining[index]++;
+		std::vector<uint32_t> offsets(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + remaining[v];
+		std::vector<uint32_t> adjacency(indices.size());
+		{
+			std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); i++) {
+				adjacency[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+		std::vector<int> cachePos(vertexCount, -1);
+		std::vector<float> vertexScore(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++) vertexScore[v] = VertexScore(-1, remaining[v]);
+		std::vector<float> triScore(triCount);
+		for (size_t t = 0; t < triCount; t++) {
+			triScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+		}
+		std::vector<char> emitted(triCount, 0);
+		std::vector<unsigned int> result;
+		result.reserve(indices.size());
+
+		uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+		uint32_t cacheCount = 0;
+		size_t scanCursor = 0;
+		int64_t best = 0;
+		for (size_t t = 1; t < triCount; t++) {
+			if (triScore[t] > triScore[best]) best = t;
+		}
+		while (result.size() < indices.size()) {
+			if (best < 0) {
+				//nothing in the cache has triangles left, continue with the next triangle in input order
+				while (emitted[scanCursor]) scanCursor++;
+				best = static_cast<int64_t>(scanCursor);
+			}
+			const unsigned int* tri = &indices[best * 3];
+			emitted[best] = 1;
+			result.insert(result.end(), tri, tri + 3);
+
+			uint32_t newCache[FORSYTH_CACHE_SIZE + 3];
+			uint32_t newCount = 0;
+			for (int k = 0; k < 3; k++) {
+				unsigned int v = tri[k];
+				//drop the triangle from the vertex's live list
+				uint32_t begin = offsets[v], end = offsets[v] + remaining[v];
+				for (uint32_t a = begin; a < end; a++) {
+					if (adjacency[a] == static_cast<uint32_t>(best)) {
+						std::swap(adjacency[a], adjacency[end - 1]);
+						remaining[v]--;
+						break;
+					}
+				}
+				newCache[newCount++] = v;
+			}
+			for (uint32_t c = 0; c < cacheCount; c++) {
+				uint32_t v = cache[c];
+				if (v != tri[0] && v != tri[1] && v != tri[2]) newCache[newCount++] = v;
+			}
+			//update scores of everything that moved in the cache, including the vertices that fell out of it
+			for (uint32_t c = 0; c < newCount; c++) {
+				uint32_t v = newCache[c];
+				cachePos[v] = c < FORSYTH_CACHE_SIZE ? static_cast<int>(c) : -1;
+				vertexScore[v] = VertexScore(cachePos[v], remaining[v]);
+			}
+			best = -1;
+			float bestScore = -1.0f;
+			for (uint32_t c = 0; c < newCount; c++) {
+				uint32_t v = newCache[c];
+				for (uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; a++) {
+					uint32_t t = adjacency[a];
+					float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+					triScore[t] = score;
+					if (c < FORSYTH_CACHE_SIZE && score > bestScore) {
+						bestScore = score;
+						best = t;
+					}
+				}
+			}
+			cacheCount = std::min(newCount, FORSYTH_CACHE_SIZE);
+			memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+		}
+		indices = std::move(result);
+	}
+
+	void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold) {
+		const size_t triCount = indices.size() / 3;
+		if (triCount == 0) return;
+		//hard boundaries : triangles where the cache optimizer restarted (all three vertices missed)
+		std::vector<size_t> hardBounds;
+		{
+			FifoCache cache(vertices.size(), ANALYZE_CACHE_SIZE);
+			for (size_t t = 0; t < triCount; t++) {
+				int misses = cache.Access(indices[t * 3]) + cache.Access(indices[t * 3 + 1]) + cache.Access(indices[t * 3 + 2]);
+				if (t == 0 || misses == 3) hardBounds.push_back(t);
+			}
+		}
+		hardBounds.push_back(triCount);
+		//soft boundaries : split a hard cluster wherever the acmr so far stays within threshold of the cluster's acmr
+		std::vector<size_t> clusters;
+		FifoCache cache(vertices.size(), ANALYZE_CACHE_SIZE);
+		for (size_t h = 0; h + 1 < hardBounds.size(); h++) {
+			size_t start = hardBounds[h], end = hardBounds[h + 1];
+			cache.Flush();
+			size_t clusterMisses = 0;
+			for (size_t t = start; t < end; t++) {
+				clusterMisses += cache.Access(indices[t * 3]) + cache.Access(indices[t * 3 + 1]) + cache.Access(indices[t * 3 + 2]);
+			}
+			float clusterAcmr = float(clusterMisses) / (end - start);
+			cache.Flush();
+			clusters.push_back(start);
+			size_t softStart = start, softMisses = 0;
+			for (size_t t = start; t < end; t++) {
+				softMisses += cache.Access(indices[t * 3]) + cache.Access(indices[t * 3 + 1]) + cache.Access(indices[t * 3 + 2]);
+				size_t softCount = t - softStart + 1;
+				if (t + 1 < end && float(softMisses) / softCount <= threshold * clusterAcmr) {
+					clusters.push_back(t + 1);
+					softStart = t + 1;
+					softMisses = 0;
+					cache.Flush();
+				}
+			}
+		}
+		clusters.push_back(triCount);
+
+		//sort key : how much a cluster faces away from the mesh center, those are drawn first
+		glm::vec3 meshCenter(0.0f);
+		for (const auto& v : vertices) meshCenter += v.position;
+		if (!vertices.empty()) meshCenter /= float(vertices.size());
+		struct Cluster { size_t start, end; float key; };
+		std::vector<Cluster> sorted;
+		sorted.reserve(clusters.size() - 1);
+		for (size_t c = 0; c + 1 < clusters.size(); c++) {
+			glm::vec3 center(0.0f), normal(0.0f);
+			float area = 0.0f;
+			for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+				const glm::vec3& p0 = vertices[indices[t * 3]].position;
+				const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+				const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+				glm::vec3 n = glm::cross(p1 - p0, p2 - p0);	// length = 2 * area
+				float a = glm::length(n);
+				center += (p0 + p1 + p2) * (a / 3.0f);
+				normal += n;
+				area += a;
+			}
+			if (area > 0.0f) center /= area;
+			float normalLength = glm::length(normal);
+			if (normalLength > 0.0f) normal /= normalLength;
+			sorted.push_back({ clusters[c], clusters[c + 1], glm::dot(center - meshCenter, normal) });
+		}
+		std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.key > b.key; });
+		std::vector<unsigned int> result;
+		result.reserve(indices.size());
+		for (const auto& cluster : sorted) {
+			result.insert(result.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+		}
+		indices = std::move(result);
+	}
+
+	void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+		std::vector<unsigned int> remap(vertices.size(), UINT32_MAX);
+		std::vector<Vertex> ordered;
+		ordered.reserve(vertices.size());
+		for (auto& index : indices) {
+			if (remap[index] == UINT32_MAX) {
+				remap[index] = static_cast<unsigned int>(ordered.size());
+				ordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		//unreferenced vertices are dropped
+		vertices = std::move(ordered);
+	}
+
+	std::vector<Meshlet> BuildMeshlets(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, uint32_t maxVertices, uint32_t maxTriangles) {
+		std::vector<Meshlet> meshlets;
+		size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0) return meshlets;
+		maxTriangles = std::min(std::max(maxTriangles, 1u), MESHLET_MAX_TRIANGLES);
+		maxVertices = std::max(maxVertices, 3u);
+		//stamp[v] == current meshlet id -> v is already in it
+		std::vector<uint32_t> stamp(vertices.size(), UINT32_MAX);
+		uint32_t id = 0, vertexCount = 0;
+		size_t begin = 0;
+		for (size_t t = 0; t < triangleCount; t++) {
+			const unsigned int* tri = &indices[t * 3];
+			uint32_t newVertices = (stamp[tri[0]] != id) + (stamp[tri[1]] != id) + (stamp[tri[2]] != id);
+			if (vertexCount + newVertices > maxVertices || t - begin >= maxTriangles) {
+				meshlets.push_back(MakeMeshlet(vertices, indices, begin, t));
+				begin = t;
+				vertexCount = 0;
+				id++;
+			}
+			for (int k = 0; k < 3; k++) {
+				if (stamp[tri[k]] != id) {
+					stamp[tri[k]] = id;
+					vertexCount++;
+				}
+			}
+		}
+		meshlets.push_back(MakeMeshlet(vertices, indices, begin, triangleCount));
+		return meshlets;
+	}
+
+	std::vector<unsigned int> Simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t targetIndexCount, float maxError, float* outError) {
+		std::vector<unsigned int> result = indices;
+		float resultError = 0.0f;
+		SimplifyLevels(vertices, indices, { targetIndexCount }, maxError, [&](const std::vector<unsigned int>& level, float error) {
+			result = level;
+			resultError = error;
+		});
+		if (outError != nullptr) *outError = resultError;
+		return result;
+	}
+
+	std::vector<MeshLod> BuildLodChain(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, uint32_t lodCount, float reduction, float maxError) {
+		std::vector<MeshLod> lods;
+		lods.push_back({ 0, static_cast<uint32_t>(indices.size()), 0.0f });
+		std::vector<size_t> targets;
+		float ratio = 1.0f;
+		for (uint32_t level = 1; level < lodCount; level++) {
+			ratio *= reduction;
+			size_t target = static_cast<size_t>(indices.size() / 3 * ratio) * 3;
+			if (target < 3) break;
+			targets.push_back(target);
+		}
+		std::vector<std::vector<unsigned int>> levels;
+		std::vector<float> errors;
+		SimplifyLevels(vertices, indices, targets, maxError, [&](const std::vector<unsigned int>& level, float error) {
+			levels.push_back(level);
+			errors.push_back(error);
+		});
+		for (size_t i = 0; i < levels.size(); i++) {
+			std::vector<unsigned int>& lod = levels[i];
+			//stalled at the error limit, coarser levels would not get any smaller
+			if (lod.size() < 3 || lod.size() > lods.back().indexCount * 0.9) break;
+			OptimizeVertexCache(lod, vertices.size());
+			lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lod.size()), errors[i] });
+			indices.insert(indices.end(), lod.begin(), lod.end());
+		}
+		return lods;
+	}
+
+	Report Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, float overdrawThreshold) {
+		Report report{};
+		report.verticesBefore = vertices.size();
+		report.triangles = indices.size() / 3;
+		report.missesBefore = CountCacheMisses(indices, vertices.size());
+		WeldVertices(vertices, indices);
+		OptimizeVertexCache(indices, vertices.size());
+		if (overdrawThreshold > 0.0f) {
+			OptimizeOverdraw(indices, vertices, overdrawThreshold);
+		}
+		OptimizeVertexFetch(vertices, indices);
+		report.verticesAfter = vertices.size();
+		report.missesAfter = CountCacheMisses(indices, vertices.size());
+		return report;
+	}
+}
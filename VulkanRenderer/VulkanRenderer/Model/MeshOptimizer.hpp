@@ -0,0 +1,60 @@
+#pragma once
+#ifndef MESH_OPTIMIZER_HPP
+#define MESH_OPTIMIZER_HPP
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "Geometry.hpp"
+#include "Meshlet.hpp"
+
+// import-time geometry optimization of one indexed triangle list.
+// order : WeldVertices -> OptimizeVertexCache -> OptimizeOverdraw -> OptimizeVertexFetch.
+namespace MeshOptimizer {
+	// fifo size used to measure ACMR, close to what current gpus reuse
+	constexpr uint32_t ANALYZE_CACHE_SIZE = 16;
+
+	struct Report {
+		size_t verticesBefore = 0;
+		size_t verticesAfter = 0;
+		size_t triangles = 0;
+		size_t missesBefore = 0;	// simulated vertex shader invocations
+		size_t missesAfter = 0;
+
+		float AcmrBefore() const { return triangles > 0 ? float(missesBefore) / triangles : 0.0f; }
+		float AcmrAfter() const { return triangles > 0 ? float(missesAfter) / triangles : 0.0f; }
+		Report& operator+=(const Report& rhs);
+	};
+
+	// vertices transformed by a fifo post-transform cache of cacheSize entries
+	size_t CountCacheMisses(const std::vector<unsigned int>& indices, size_t vertexCount, uint32_t cacheSize = ANALYZE_CACHE_SIZE);
+	// merges bitwise-equal vertices, returns how many were removed
+	size_t WeldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+	// reorders triangles for post-transform cache reuse (Forsyth, linear-speed vertex cache optimisation)
+	void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+	// splits the cache optimized order into clusters and draws outward facing clusters first.
+	// threshold : how much ACMR may grow to get more clusters, 1.05 = 5%
+	void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+	// reorders vertices by first use so fetches walk memory linearly
+	void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+	// splits the index list into contiguous clusters of at most maxVertices unique vertices / maxTriangles triangles.
+	// triangle order is kept, so run it after the ordering stages and the meshlets stay index ranges.
+	std::vector<Meshlet> BuildMeshlets(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+		uint32_t maxVertices = MESHLET_MAX_VERTICES, uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+	// quadric error edge collapse. vertices are kept as they are, only a new index list is returned,
+	// so every level of detail can share one vertex buffer. collapses stop at targetIndexCount or when the
+	// error (distance in mesh units) would exceed maxError. vertices sharing a position with different
+	// attributes (seams) are not moved, open borders only collapse along themselves.
+	std::vector<unsigned int> Simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+		size_t targetIndexCount, float maxError, float* outError = nullptr);
+	// appends lodCount - 1 coarser index lists to indices, each reduction times the triangles of the previous one.
+	// returns the ranges, level 0 is the original list. stops early when the simplifier stalls.
+	std::vector<MeshLod> BuildLodChain(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+		uint32_t lodCount, float reduction, float maxError);
+
+	// runs every stage, overdrawThreshold <= 0 skips the overdraw stage
+	Report Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, float overdrawThreshold = 1.05f);
+}
+
+#endif // !MESH_OPTIMIZER_HPP
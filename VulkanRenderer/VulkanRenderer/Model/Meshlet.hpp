@@ -0,0 +1,79 @@
+#pragma once
+#ifndef MESHLET_HPP
+#define MESHLET_HPP
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <cmath>
+
+//limits of one cluster, the usual mesh shader sizes
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+//a contiguous range of a mesh's index list, built by MeshOptimizer::BuildMeshlets().
+//bounds are in mesh space (uncompressed positions).
+struct Meshlet {
+	glm::vec3 center = glm::vec3(0);	//bounding sphere
+	float radius = 0.0f;
+	glm::vec3 coneAxis = glm::vec3(0);	//average facing of the triangles
+	float coneCutoff = 1.0f;			//sin of the normal cone half angle, 1 = never backfacing
+	uint32_t firstIndex = 0;			//relative to the mesh's first index
+	uint32_t indexCount = 0;
+};
+
+struct CullStats {
+	uint32_t meshesCulled = 0;
+	uint32_t meshletsTested = 0;
+	uint32_t meshletsVisible = 0;	//cpu culling only, gpu culled draws (Model::Cull) don't read their result back
+	uint32_t drawCalls = 0;
+};
+
+//frustum planes and eye of one pass, built from the same matrices the pass uploads
+struct CullView {
+	glm::vec4 planes[6];
+	glm::vec3 position = glm::vec3(0);	//eye, perspective projections
+	glm::vec3 direction = glm::vec3(0, 0, -1);	//view direction, orthographic projections
+	bool perspective = true;
+	bool coneCulling = true;
+	//level of detail selection, lodScale = pixels per unit at distance 1 (perspective) or at any distance (orthographic).
+	//0 keeps every mesh at the level of the LodState drawn with it (level 0 without one).
+	float lodScale = 0.0f;
+	float lodPixelError = 1.0f;
+	float lodHysteresis = 0.25f;
+
+	//viewportHeight > 0 enables level of detail selection
+	static CullView FromMatrices(const glm::mat4& view, const glm::mat4& proj, float viewportHeight = 0.0f) {
+		CullView out;
+		glm::mat4 m = proj * view;
+		for (int i = 0; i < 3; i++) {
+			glm::vec4 row(m[0][i], m[1][i], m[2][i], m[3][i]);
+			glm::vec4 w(m[0][3], m[1][3], m[2][3], m[3][3]);
+			out.planes[i * 2] = w + row;
+			out.planes[i * 2 + 1] = w - row;
+		}
+		for (auto& plane : out.planes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+		glm::mat4 invView = glm::inverse(view);
+		out.position = glm::vec3(invView[3]);
+		out.direction = -glm::normalize(glm::vec3(invView[2]));
+		out.perspective = proj[3][3] == 0.0f;
+		//proj[1][1] is 1 / tan(fov / 2) for perspective and 2 / (top - bottom) for orthographic, flipped for vulkan
+		out.lodScale = std::fabs(proj[1][1]) * viewportHeight * 0.5f;
+		return out;
+	}
+	bool IsSphereVisible(const glm::vec3& center, float radius) const {
+		for (const auto& plane : planes) {
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+		}
+		return true;
+	}
+	//true when every triangle of the cluster faces away from the eye
+	bool IsBackfacing(const glm::vec3& center, float radius, const glm::vec3& axis, float cutoff) const {
+		if (!coneCulling || cutoff >= 1.0f) return false;
+		if (!perspective) return glm::dot(direction, axis) >= cutoff;
+		glm::vec3 toCenter = center - position;
+		return glm::dot(toCenter, axis) >= cutoff * glm::length(toCenter) + radius;
+	}
+};
+
+#endif // !MESHLET_HPP
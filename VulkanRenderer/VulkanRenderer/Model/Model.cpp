@@ -1,48 +1,539 @@
 #include "Model.hpp"
+#include "ModelCache.hpp"
+#include "ModelLoadHandle.hpp"
+#include "AssetRegistry.hpp"
+#include <filesystem>
 #include <cstring>
+#include <deque>
+#include <future>
+#include <chrono>
 #include <stdexcept>
+#include <utility>
+#include <algorithm>
 #include <glm/gtc/matrix_transform.hpp>
 Model PrimitiveMesh::quad;
 
-void Model::Draw(VkCommandBuffer commadbuffer,VkPipelineLayout pipelineLayout ,VkDescriptorSet texDescriptorSet, VkSampler sampler, glm::mat4 modelMat) {
+GeometryArena::~GeometryArena() {
+	if (buffer != VK_NULL_HANDLE) {
+		//uploads are finished before anything draws the arena, so a drawn arena is free after its last frame
+		Renderer::GetInstance()->deletionQueue.PushBuffer(buffer, memory, lastUse.graphicsValue);
+	}
+}
+
+void Model::Draw(VkCommandBuffer commadbuffer,VkPipelineLayout pipelineLayout ,VkDescriptorSet texDescriptorSet, VkSampler sampler, glm::mat4 modelMat, const CullView* view, LodState* lods, const CullTarget* culled) {
 	Renderer* renderer = Renderer::GetInstance();
+	uint64_t frameValue = renderer->GetFrameTimelineValue();
 	if (texDescriptorSet != VK_NULL_HANDLE) {
 		for (int i = 0; i < texture_loaded.size(); i++) {
-			VkDescriptorImageInfo imageInfo = Initializer::InitDescriptorImageInfo(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture_loaded[i].textureImageView, sampler);
+			texture_loaded[i]->lastUse.graphicsValue = frameValue;
+			VkDescriptorImageInfo imageInfo = Initializer::InitDescriptorImageInfo(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture_loaded[i]->textureImageView, sampler);
 			VkWriteDescriptorSet write = Initializer::InitWriteDescriptorSet(texDescriptorSet, 0, i, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, nullptr, &imageInfo);
 			vkUpdateDescriptorSets(renderer->device, 1, &write, 0, nullptr);
 		}
 	}
 	if (pipelineLayout == VK_NULL_HANDLE) pipelineLayout = renderer->GetPipelineLayout();
-	for (int i = 0; i < meshes.size(); i++) {
-		GlobalStructs::VertexShaderPushConstant pushconstant{};
-		pushconstant.modelMat = GetModelMat(modelMat);
+	if (geometry == nullptr) return;
+	geometry->lastUse.graphicsValue = frameValue;
+	VkBuffer buffers[] = { geometry->buffer, geometry->buffer };
+	VkDeviceSize offsets[] = { 0, attributeOffset };
+	vkCmdBindVertexBuffers(commadbuffer, 0, 2, buffers, offsets);
+	DrawMeshes(commadbuffer, pipelineLayout, modelMat, true, view, lods, culled);
+}
+
+void Model::DrawDepth(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, glm::mat4 modelMat, const CullView* view, LodState* lods, const CullTarget* culled) {
+	if (geometry == nullptr) return;
+	geometry->lastUse.graphicsValue = Renderer::GetInstance()->GetFrameTimelineValue();
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &geometry->buffer, &offset);
+	DrawMeshes(commandBuffer, pipelineLayout, modelMat, false, view, lods, culled);
+}
+
+bool Model::Cull(VkCommandBuffer commandBuffer, const CullView& view, CullTarget& target, glm::mat4 modelMat) {
+	Renderer* renderer = Renderer::GetInstance();
+	if (geometry == nullptr || meshletTableCount == 0 || renderer->GetClusterCullPipeline() == VK_NULL_HANDLE) return false;
+	geometry->lastUse.graphicsValue = renderer->GetFrameTimelineValue();
+	CullTarget::Frame& frame = target.Prepare(*geometry, meshletTableOffset, meshletTableCount);
+	GpuCullView push = GpuCullView::FromView(view, GetModelMat(modelMat));
+	VkPipelineLayout layout = renderer->GetClusterCullPipelineLayout();
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->GetClusterCullPipeline());
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &frame.descriptorSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GpuCullView), &push);
+	vkCmdDispatch(commandBuffer, (meshletTableCount + CLUSTER_CULL_GROUP_SIZE - 1) / CLUSTER_CULL_GROUP_SIZE, 1, 1);
+	return true;
+}
+
+void Model::DrawMeshes(VkCommandBuffer commadbuffer, VkPipelineLayout pipelineLayout, const glm::mat4& modelMat, bool pushMaterial, const CullView* view, LodState* lods, const CullTarget* culled) {
+	glm::mat4 model = GetModelMat(modelMat);
+	cullStats = CullStats{};
+	const CullTarget::Frame* culledFrame = culled != nullptr ? culled->GetCulled(geometry.get()) : nullptr;
+	uint32_t maxDrawCount = Renderer::GetInstance()->GetMaxDrawIndirectCount();
+	GlobalStructs::VertexShaderPushConstant pushconstant{};
+	pushconstant.modelMat = model;
+	if (vertexFormat == VertexFormat::Full) {
 		vkCmdPushConstants(commadbuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GlobalStructs::VertexShaderPushConstant), &pushconstant);
-		meshes[i].Draw(pipelineLayout,commadbuffer);
+	}
+	VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+	//a new or reloaded model starts at level 0
+	if (lods != nullptr && lods->levels.size() != meshes.size()) lods->levels.assign(meshes.size(), 0);
+	for (int i = 0; i < meshes.size(); i++) {
+		Mesh& mesh = meshes[i];
+		uint32_t lod = lods != nullptr ? lods->levels[i] : 0;
+		if (view != nullptr && mesh.bounds.valid) {
+			glm::mat3 basis(model);
+			float scale = std::max(glm::length(basis[0]), std::max(glm::length(basis[1]), glm::length(basis[2])));
+			glm::vec3 center = glm::vec3(model * glm::vec4(mesh.bounds.center, 1.0f));
+			float radius = mesh.bounds.radius * scale;
+			if (!view->IsSphereVisible(center, radius)) {
+				cullStats.meshesCulled++;
+				continue;
+			}
+			//projected error from the nearest point of the bounding sphere
+			if (view->lodScale > 0.0f) {
+				float distance = view->perspective ? std::max(glm::length(center - view->position) - radius, 1e-3f) : 1.0f;
+				lod = mesh.SelectLod(view->lodScale * scale / distance, view->lodPixelError, view->lodHysteresis, lod);
+				if (lods != nullptr) lods->levels[i] = lod;
+			}
+		}
+		if (mesh.indexType != boundIndexType) {
+			boundIndexType = mesh.indexType;
+			vkCmdBindIndexBuffer(commadbuffer, geometry->buffer, boundIndexType == VK_INDEX_TYPE_UINT16 ? index16Offset : index32Offset, boundIndexType);
+		}
+		//compact positions are relative to the mesh box, the decode goes into the model matrix
+		if (vertexFormat == VertexFormat::Compact) {
+			pushconstant.modelMat = model * mesh.quantization.GetMatrix();
+			vkCmdPushConstants(commadbuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GlobalStructs::VertexShaderPushConstant), &pushconstant);
+		}
+		if (pushMaterial) mesh.PushMaterial(pipelineLayout, commadbuffer);
+		if (culledFrame != nullptr && lod == 0 && mesh.meshletCount > 0) {
+			mesh.DrawIndirect(commadbuffer, culledFrame->commands, maxDrawCount, cullStats);
+		}
+		else if (view != nullptr && lod == 0) {
+			mesh.DrawClusters(commadbuffer, *view, model, cullStats);
+		}
+		else {
+			mesh.DrawLod(commadbuffer, lod);
+			cullStats.drawCalls++;
+		}
 	}
 }
 
-void Model::Clean() {
+Model& Model::operator=(Model&& rhs) noexcept {
+	if (this == &rhs) return *this;
+	Clean();
+	position = rhs.position;
+	meshes = std::move(rhs.meshes);
+	texture_loaded = std::move(rhs.texture_loaded);
+	geometry = std::move(rhs.geometry);
+	meshSet = std::move(rhs.meshSet);
+	attributeOffset = rhs.attributeOffset;
+	index32Offset = rhs.index32Offset;
+	index16Offset = rhs.index16Offset;
+	meshletTableOffset = rhs.meshletTableOffset;
+	meshletTableCount = rhs.meshletTableCount;
+	vertexFormat = rhs.vertexFormat;
+	bounds = rhs.bounds;
+	optimizeReport = rhs.optimizeReport;
+	meshletCount = rhs.meshletCount;
+	lodCount = rhs.lodCount;
+	//a streaming load follows the model
+	pendingLoad = std::move(rhs.pendingLoad);
+	if (pendingLoad) pendingLoad->model = this;
+	rhs.meshes.clear();
+	rhs.texture_loaded.clear();
+	return *this;
+}
 
-	for (int i = 0; i < texture_loaded.size(); i++) {
-		texture_loaded[i].Clean();
+void Model::Clean() {
+	if (pendingLoad) {
+		pendingLoad->Cancel();
+		pendingLoad->model = nullptr;
+		pendingLoad.reset();
 	}
+
 	for (int i = 0; i < meshes.size(); i++) {
 		meshes[i].Clean();
 	}
+	//textures and the arena go to the deletion queue once no other model holds them
+	texture_loaded.clear();
+	meshes.clear();
+	geometry.reset();
+	meshSet.reset();
 }
 
-void Model::LoadModel(const Renderer* renderer ,const std::string& fn) {
-	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(fn, aiProcess_Triangulate);
-	std::string path = Utils::getPath(fn);
+void Model::LoadModel(const Renderer* renderer ,const std::string& fn, const ModelLoadOptions& options) {
+	std::string extension = std::filesystem::path(fn).extension().string();
+	if (extension == ModelCache::BUNDLE_EXTENSION) {
+		LoadBundle(fn, options);
+		return;
+	}
+	//a file some model already holds costs nothing but the lookup
+	uint64_t meshSetHash = AssetRegistry::HashMeshOptions(options);
+	if (Instantiate(AssetRegistry::FindMeshSet(fn, meshSetHash), fn)) return;
+	bool registers = meshes.empty() && texture_loaded.empty();
+	std::string cachePath;
+	uint64_t sourceHash = 0, optionsHash = 0;
+	if (options.useCache) {
+		sourceHash = ModelCache::HashFile(fn);
+		optionsHash = ModelCache::HashOptions(options);
+		cachePath = ModelCache::GetCachePath(fn, options);
+		//same bytes under another name
+		if (Instantiate(AssetRegistry::FindMeshSet(sourceHash, meshSetHash), fn)) return;
+		if (sourceHash != 0 && LoadCached(fn, cachePath, sourceHash, optionsHash, options)) {
+			if (registers) RegisterMeshSet(fn, sourceHash, meshSetHash);
+			return;
+		}
+	}
+	Renderer* instance = Renderer::GetInstance();
+	ModelImporter importer;
+	//compressed files the device can't sample are decoded on the workers
+	importer.SetSampledEncodings(Texture::GetSampledEncodings());
+	importer.Read(fn, instance->workers);
+	std::vector<ImportedTexture>& textures = importer.GetTextures();
+	//import texture index -> texture_loaded index, images some model already uploaded are shared and not decoded
+	std::vector<int> textureMap(textures.size(), -1);
+	bool sharesTextures = false;
+	for (size_t i = 0; i < textures.size(); i++) {
+		std::shared_ptr<Texture> shared = AssetRegistry::FindTexture(textures[i].path, textures[i].sRGB);
+		if (shared == nullptr) continue;
+		printf("Already loaded this texture : %s\n", textures[i].path.substr(textures[i].path.rfind('/') + 1).c_str());
+		textureMap[i] = static_cast<int>(texture_loaded.size());
+		texture_loaded.push_back(std::move(shared));
+		textures[i].skip = true;
+		sharesTextures = true;
+	}
+	//the cache is streamed from the import results : each mip chain is written once decoded and freed once uploaded,
+	//the meshes before their vectors move into the model
+	ModelCache::StreamWriter cache;
+	bool writeCache = options.useCache && sourceHash != 0 && !sharesTextures && cache.Open(cachePath, importer.GetMeshes().size(), textures, importer.GetDependencies());
+	//cpu work : mesh conversion / optimization as one worker job, image decoding as one job per image.
+	//gpu work stays on this thread, uploads are recorded while the rest is still decoding
+	std::future<void> meshJob = instance->workers.Submit([&importer, &options, instance]() { importer.ProcessMeshes(options, instance->workers); });
+	size_t firstTexture = texture_loaded.size();
+	size_t firstMesh = meshes.size();
+	std::vector<LoadedTexture> loaded;
+	try {
+		UploadBatch batch = instance->uploadContext.Begin();
+		UploadBatchGuard guard(instance->uploadContext, batch);
+		UploadImportedTextures(importer, options, writeCache ? &cache : nullptr, batch, textureMap, loaded);
+		meshJob.get();
+		std::vector<ImportedMesh>& imported = importer.GetMeshes();
+		optimizeReport = importer.GetReport();
+		meshletCount = importer.GetMeshletCount();
+		lodCount = importer.GetLodCount();
+		if (writeCache) {
+			cache.WriteMeshes(imported);
+			uint64_t written = cache.Finish(sourceHash, optionsHash);
+			if (written > 0) printf("Wrote model cache %s (%.2f MB)\n", cachePath.c_str(), written / (1024.0 * 1024.0));
+			else printf("Fail to write model cache %s\n", cachePath.c_str());
+		}
+		meshes.reserve(meshes.size() + imported.size());
+		for (auto& mesh : imported) {
+			Material material = RemapMaterial(mesh.material, textureMap);
+			AddImportedMesh(std::move(mesh), material);
+		}
+		FinishLoad(batch, fn, options);
+	}
+	catch (...) {
+		//the job may still use the importer. nothing of the load stays in the model and none of its textures were registered
+		if (meshJob.valid()) meshJob.wait();
+		texture_loaded.erase(texture_loaded.begin() + firstTexture, texture_loaded.end());
+		meshes.erase(meshes.begin() + firstMesh, meshes.end());
+		throw;
+	}
+	RegisterTextures(loaded);
+	if (registers) RegisterMeshSet(fn, sourceHash, meshSetHash);
+}
+
+bool Model::LoadCached(const std::string& fn, const std::string& cachePath, uint64_t sourceHash, uint64_t optionsHash, const ModelLoadOptions& options) {
+	ModelCache::Reader reader;
+	if (!reader.Open(cachePath) || !reader.IsCurrent(sourceHash, optionsHash)) return false;
+	LoadFromFile(reader, fn, options);
+	return true;
+}
+
+void Model::LoadBundle(const std::string& fn, const ModelLoadOptions& options) {
+	uint64_t meshSetHash = AssetRegistry::HashMeshOptions(options);
+	if (Instantiate(AssetRegistry::FindMeshSet(fn, meshSetHash), fn)) return;
+	bool registers = meshes.empty() && texture_loaded.empty();
+	ModelCache::Reader reader;
+	if (!reader.Open(fn)) {
+		throw std::runtime_error("failed to open model bundle!");
+	}
+	LoadFromFile(reader, fn, options);
+	if (registers) RegisterMeshSet(fn, 0, meshSetHash);
+}
+
+void Model::LoadFromFile(ModelCache::Reader& reader, const std::string& fn, const ModelLoadOptions& options) {
+	Renderer* instance = Renderer::GetInstance();
+	int firstTexture = static_cast<int>(texture_loaded.size());
+	size_t firstMesh = meshes.size();
+	std::vector<LoadedTexture> loaded;
+	try {
+		//payloads go from the mapping straight into staging memory
+		UploadBatch batch = instance->uploadContext.Begin();
+		UploadBatchGuard guard(instance->uploadContext, batch);
+		for (uint32_t i = 0; i < reader.GetTextureCount(); i++) {
+			const ModelCache::TextureRecord& record = reader.GetTexture(i);
+			std::string path = reader.GetTexturePath(record);
+			bool sRGB = record.sRGB != 0;
+			std::shared_ptr<Texture> texture = AssetRegistry::FindTexture(path, sRGB);
+			if (texture == nullptr) texture = AssetRegistry::FindTexture(record.contentHash, sRGB);
+			if (texture == nullptr) texture = FindLoaded(loaded, record.contentHash, sRGB);
+			if (texture == nullptr) {
+				texture = std::make_shared<Texture>(path);
+				texture->UploadMipChain(reader.Get<uint8_t>(record.dataOffset), record.width, record.height, record.mipLevels,
+					record.encoding, sRGB, &batch);
+				loaded.push_back({ path, record.contentHash, sRGB, texture });
+			}
+			texture_loaded.push_back(std::move(texture));
+		}
+		optimizeReport = MeshOptimizer::Report{};
+		meshletCount = 0;
+		lodCount = 0;
+		meshes.reserve(meshes.size() + reader.GetMeshCount());
+		for (uint32_t i = 0; i < reader.GetMeshCount(); i++) {
+			ImportedMesh mesh = reader.ReadMesh(i);
+			meshletCount += mesh.meshlets.size();
+			lodCount += mesh.lods.empty() ? 0 : mesh.lods.size() - 1;
+			Material material = ModelCache::OffsetMaterial(mesh.material, firstTexture);
+			AddImportedMesh(std::move(mesh), material);
+		}
+		printf("Loaded %s from %s (%.2f MB)\n", fn.c_str(), reader.IsBundle() ? "its bundle" : "the model cache", reader.GetSize() / (1024.0 * 1024.0));
+		FinishLoad(batch, fn, options);
+	}
+	catch (...) {
+		//nothing of the load stays in the model and none of its textures were registered
+		texture_loaded.erase(texture_loaded.begin() + firstTexture, texture_loaded.end());
+		meshes.erase(meshes.begin() + firstMesh, meshes.end());
+		throw;
+	}
+	RegisterTextures(loaded);
+}
+
+std::shared_ptr<Texture> Model::FindLoaded(const std::vector<LoadedTexture>& loaded, uint64_t contentHash, bool sRGB) {
+	if (contentHash == 0) return nullptr;
+	for (const auto& texture : loaded) {
+		if (texture.contentHash == contentHash && texture.sRGB == sRGB) return texture.texture;
+	}
+	return nullptr;
+}
 
-	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-		std::string errMsg = "ERROR::ASSIMP::";
-		errMsg.append(importer.GetErrorString());
-		throw std::runtime_error(errMsg.c_str());
+void Model::RegisterTextures(const std::vector<LoadedTexture>& loaded) {
+	for (const auto& texture : loaded) {
+		AssetRegistry::AddTexture(texture.path, texture.contentHash, texture.sRGB, texture.texture);
 	}
-	ProcessNode(renderer, scene->mRootNode, scene, path);
+}
+
+void Model::UploadImportedTextures(ModelImporter& importer, const ModelLoadOptions& options, ModelCache::StreamWriter* cache, UploadBatch& batch, std::vector<int>& textureMap,
+	std::vector<LoadedTexture>& loaded) {
+	Renderer* instance = Renderer::GetInstance();
+	std::vector<ImportedTexture>& textures = importer.GetTextures();
+	//the cache stores finished mip chains, so with it on they are built on the cpu instead of blitted on the gpu
+	bool buildMipChains = options.useCache;
+	struct Decode {
+		size_t index = 0;
+		uint64_t size = 0;
+		StagingRegion staging;
+		std::future<void> job;
+	};
+	//sizes come from the image headers, 0 -> unreadable header, the decode reports the error
+	std::vector<uint64_t> sizes(textures.size(), 0);
+	for (size_t i = 0; i < textures.size(); i++) {
+		if (!textures[i].skip) sizes[i] = importer.GetDecodedSize(i, buildMipChains);
+	}
+	std::deque<Decode> inFlight;
+	uint64_t inFlightBytes = 0, batchBytes = 0;
+	float decodeMilliseconds = 0.0f;
+	size_t decoded = 0;
+	auto start = std::chrono::steady_clock::now();
+	try {
+		size_t next = 0;
+		while (true) {
+			for (; next < textures.size(); next++) {
+				if (textures[next].skip) continue;
+				uint64_t size = sizes[next];
+				if (!inFlight.empty() && (inFlightBytes + size > options.decodeBudget || batchBytes >= options.decodeBudget)) break;
+				if (batchBytes >= options.decodeBudget) {
+					//nothing is writing into the batch's staging any more, once it is submitted the ring can reuse it
+					instance->uploadContext.Submit(batch, false);
+					batch = instance->uploadContext.Begin();
+					batchBytes = 0;
+				}
+				Decode decode;
+				decode.index = next;
+				decode.size = size;
+				uint8_t* out = nullptr;
+				if (cache == nullptr && size > 0) {
+					decode.staging = instance->uploadContext.AllocateStaging(size, 16);
+					out = static_cast<uint8_t*>(decode.staging.mapped);
+				}
+				decode.job = instance->workers.Submit([&importer, index = next, buildMipChains, out, cache]() {
+					importer.DecodeTexture(index, buildMipChains, out);
+					if (cache != nullptr) cache->WriteTexture(index, importer.GetTextures()[index]);
+				});
+				inFlightBytes += size;
+				batchBytes += size;
+				inFlight.push_back(std::move(decode));
+			}
+			if (inFlight.empty()) break;
+			//uploads keep the import order, the oldest decode is usually the first to finish anyway
+			Decode decode = std::move(inFlight.front());
+			inFlight.pop_front();
+			decode.job.get();
+			inFlightBytes -= decode.size;
+			ImportedTexture& source = textures[decode.index];
+			decodeMilliseconds += source.decodeMilliseconds;
+			decoded++;
+			textureMap[decode.index] = static_cast<int>(texture_loaded.size());
+			//the same image under another name, its staging is simply left unused
+			std::shared_ptr<Texture> texture = AssetRegistry::FindTexture(source.contentHash, source.sRGB);
+			if (texture == nullptr) texture = FindLoaded(loaded, source.contentHash, source.sRGB);
+			if (texture != nullptr) {
+				printf("Same image as %s : %s\n", texture->path.c_str(), source.path.c_str());
+				texture_loaded.push_back(std::move(texture));
+				source.image = DecodedImage{};
+				std::vector<uint8_t>().swap(source.mipChain);
+				continue;
+			}
+			texture = std::make_shared<Texture>(source.path);
+			const DecodedImage& image = source.image;
+			//ktx2 / dds files always come as a chain in their own encoding
+			bool isChain = buildMipChains || source.prebaked;
+			if (decode.staging.mapped != nullptr) {
+				if (isChain) texture->UploadMipChain(decode.staging, image.width, image.height, source.mipLevels, source.encoding, source.sRGB, &batch);
+				else texture->Upload(decode.staging, image, source.sRGB, source.genMipmap, VK_IMAGE_TILING_OPTIMAL, &batch);
+			}
+			else if (isChain) {
+				texture->UploadMipChain(source.mipChain.data(), image.width, image.height, source.mipLevels, source.encoding, source.sRGB, &batch);
+				//copied into staging and, with the cache on, into its file
+				std::vector<uint8_t>().swap(source.mipChain);
+			}
+			else {
+				texture->Upload(image, source.sRGB, source.genMipmap, VK_IMAGE_TILING_OPTIMAL, &batch);
+				//the pixels are in the staging ring now
+				source.image = DecodedImage{};
+			}
+			loaded.push_back({ source.path, source.contentHash, source.sRGB, texture });
+			texture_loaded.push_back(std::move(texture));
+		}
+	}
+	catch (...) {
+		//the workers still write into the import and the staging regions
+		for (auto& decode : inFlight) {
+			if (decode.job.valid()) decode.job.wait();
+		}
+		throw;
+	}
+	if (decoded > 0) {
+		float elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		printf("Decoded %zu textures in %.1f ms (%.1f ms of decoding on %u workers)\n", decoded, elapsed, decodeMilliseconds, instance->workers.GetThreadCount());
+	}
+}
+
+void Model::FinishLoad(UploadBatch& batch, const std::string& fn, const ModelLoadOptions& options) {
+	Renderer* instance = Renderer::GetInstance();
+	UploadGeometry(&batch);
+	uint32_t commandCount = batch.commandCount;
+	instance->uploadContext.Submit(batch);
+	printf("Uploaded %s with %u commands in one submit\n", fn.c_str(), commandCount);
+	size_t freed = ApplyRetention(options.retention);
+	if (freed > 0) {
+		printf("Released %.2f MB of cpu geometry of %s\n", freed / (1024.0 * 1024.0), fn.c_str());
+	}
+}
+
+void Model::AddImportedMesh(ImportedMesh&& mesh, const Material& material) {
+	meshes.emplace_back(std::move(mesh.vertices), std::move(mesh.indices), material, mesh.bounds);
+	Mesh& added = meshes.back();
+	added.meshlets = std::move(mesh.meshlets);
+	if (!mesh.lods.empty()) {
+		added.indexCount = mesh.lods[0].indexCount;
+		added.lods = std::move(mesh.lods);
+	}
+}
+
+Material Model::RemapMaterial(Material material, const std::vector<int>& textureMap) {
+	return RemapTextureIndices(material, [&textureMap](int index) { return textureMap[index]; });
+}
+
+std::shared_ptr<ModelLoadHandle> Model::LoadModelAsync(const std::string& fn, const ModelLoadOptions& options, UploadPriority priority) {
+	Renderer* instance = Renderer::GetInstance();
+	if (pendingLoad) {
+		pendingLoad->Cancel();
+		pendingLoad->model = nullptr;
+	}
+	std::shared_ptr<ModelLoadHandle> handle = std::make_shared<ModelLoadHandle>(fn, options, priority);
+	//a file some model already holds replaces the content right away
+	std::shared_ptr<MeshSet> set = AssetRegistry::FindMeshSet(fn, AssetRegistry::HashMeshOptions(options));
+	if (set != nullptr) {
+		Model shared;
+		shared.Instantiate(set, fn);
+		glm::vec3 keep = position;
+		*this = std::move(shared);
+		position = keep;
+		handle->state = ModelLoadState::Ready;
+		return handle;
+	}
+	handle->model = this;
+	pendingLoad = handle;
+	instance->workers.Submit([handle]() { handle->Import(); });
+	instance->AddFrameTask([handle]() { return handle->Step(); });
+	return handle;
+}
+
+bool Model::Instantiate(const std::shared_ptr<MeshSet>& set, const std::string& fn) {
+	if (set == nullptr || !meshes.empty() || !texture_loaded.empty()) return false;
+	geometry = set->geometry;
+	attributeOffset = set->attributeOffset;
+	index32Offset = set->index32Offset;
+	index16Offset = set->index16Offset;
+	meshletTableOffset = set->meshletTableOffset;
+	meshletTableCount = set->meshletTableCount;
+	vertexFormat = set->vertexFormat;
+	bounds = set->bounds;
+	optimizeReport = set->optimizeReport;
+	meshletCount = set->meshletCount;
+	lodCount = set->lodCount;
+	texture_loaded = set->textures;
+	meshes.reserve(set->meshes.size());
+	for (const auto& mesh : set->meshes) meshes.push_back(mesh.Instance());
+	meshSet = set;
+	printf("Shared %s with a model that already loaded it\n", fn.c_str());
+	return true;
+}
+
+void Model::RegisterMeshSet(const std::string& fn, uint64_t contentHash, uint64_t optionsHash) {
+	if (geometry == nullptr) return;
+	std::shared_ptr<MeshSet> set = std::make_shared<MeshSet>();
+	set->geometry = geometry;
+	set->attributeOffset = attributeOffset;
+	set->index32Offset = index32Offset;
+	set->index16Offset = index16Offset;
+	set->meshletTableOffset = meshletTableOffset;
+	set->meshletTableCount = meshletTableCount;
+	set->vertexFormat = vertexFormat;
+	set->bounds = bounds;
+	set->optimizeReport = optimizeReport;
+	set->meshletCount = meshletCount;
+	set->lodCount = lodCount;
+	set->textures = texture_loaded;
+	set->meshes.reserve(meshes.size());
+	for (const auto& mesh : meshes) set->meshes.push_back(mesh.Instance());
+	meshSet = set;
+	AssetRegistry::AddMeshSet(fn, contentHash, optionsHash, set);
+}
+
+bool Model::IsShared() const {
+	return meshSet != nullptr && meshSet.use_count() > 1;
+}
+
+size_t Model::ApplyRetention(GeometryRetention retention) {
+	size_t freed = 0;
+	for (auto& mesh : meshes) {
+		freed += mesh.ApplyRetention(retention);
+	}
+	if (retention == GeometryRetention::KeepNothing) bounds = Bounds{};
+	return freed;
 }
 
 void Model::SetPosition(float x, float y, float z) {
@@ -58,139 +549,132 @@ void Model::SetPosition(glm::vec3 pos) {
 glm::mat4 Model::GetModelMat(glm::mat4 modelMat) {
 	return glm::translate(glm::mat4(1.0f), position) * modelMat;
 }
-void Model::ProcessNode(const Renderer* renderer, aiNode* node, const aiScene* scene, const std::string& path) {
-	for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.push_back(ProcessMesh(renderer, mesh, scene, path));
-	}
-	for (unsigned int i = 0; i < node->mNumChildren; i++) {
-		ProcessNode(renderer, node->mChildren[i], scene, path);
-	}
-}
-
-Mesh Model::ProcessMesh(const Renderer* renderer, aiMesh* mesh, const aiScene* scene, const std::string& path) {
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
-	Material material;
-	aiString file;
-	aiGetMaterialString(scene->mMaterials[mesh->mMaterialIndex], AI_MATKEY_NAME, &file);
-	//process vertex
-	for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-		Vertex vertex;
-		glm::vec3 vector;
-		vector.x = mesh->mVertices[i].x;
-		vector.y = mesh->mVertices[i].y;
-		vector.z = mesh->mVertices[i].z;
-		vertex.position = vector;
-		if (mesh->HasNormals()) {
-			vector.x = mesh->mNormals[i].x;
-			vector.y = mesh->mNormals[i].y;
-			vector.z = mesh->mNormals[i].z;
-		}
-		else {
-
-		}
-		vertex.normal = vector;
-		if (mesh->mTextureCoords[0]) {
-			glm::vec2 vec;
-			vec.x = mesh->mTextureCoords[0][i].x;
-			vec.y = mesh->mTextureCoords[0][i].y;
-			vertex.texCoords = vec;
-		}
-		vertices.push_back(vertex);
+void Model::PushMesh(Mesh&& mesh) {
+	meshes.push_back(std::move(mesh));
+}
+void Model::UploadGeometry(UploadBatch* batch) {
+	Renderer* instance = Renderer::GetInstance();
+	if (instance == nullptr) {
+		printf("Fail to create geometry Buffer. Please create Renderer instance or call Renderer::init()\n");
+		return;
 	}
-	//process indices
-	for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-		aiFace face = mesh->mFaces[i];
-		for (unsigned int j = 0; j < face.mNumIndices; j++) {
-			indices.push_back(face.mIndices[j]);
+	for (auto& mesh : meshes) {
+		if (!mesh.HasCpuGeometry()) {
+			printf("Fail to upload geometry. A mesh was loaded with a retention policy that dropped its vertices\n");
+			return;
 		}
 	}
-	//process material
-	if (mesh->mMaterialIndex >= 0) {
-		aiMaterial* mat = scene->mMaterials[mesh->mMaterialIndex];
-		if (mat->GetTexture(aiTextureType_DIFFUSE, 0, &file) == AI_SUCCESS) {
-			printf("Loading diffuse map : %s\n", file.C_Str());
-			material.diffTexIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true);
-		}
-		if (mat->GetTexture(aiTextureType_SPECULAR, 0, &file) == AI_SUCCESS) {
-			printf("Loading specular map : %s\n", file.C_Str());
-			material.specTexIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true);
-		}
-		if (mat->GetTexture(aiTextureType_EMISSIVE, 0, &file) == AI_SUCCESS) {
-			printf("Loading emissive map : %s\n", file.C_Str());
-			material.emissionMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true);
-		}
-		if (mat->GetTexture(aiTextureType_HEIGHT, 0, &file) == AI_SUCCESS) {
-			printf("Loading height map : %s\n", file.C_Str());
-			material.bumpMapIdx= TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true);
-		}
-		if (mat->GetTexture(aiTextureType_NORMALS, 0, &file) == AI_SUCCESS) {
-			printf("Loading Normal map : %s\n", file.C_Str());
-			material.normalMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), false);
-		}
-		if (mat->GetTexture(aiTextureType_SHININESS, 0, &file) == AI_SUCCESS) {
-			printf("Loading shininess map : %s\n", file.C_Str());
-			material.roughnessMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true);
-		}
-		if (mat->GetTexture(aiTextureType_OPACITY, 0, &file) == AI_SUCCESS) {
-			printf("Loading opacity map : %s\n", file.C_Str());
-			material.opacityMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true, false);
-		}
-		if (mat->GetTexture(aiTextureType_DISPLACEMENT, 0, &file) == AI_SUCCESS) {
-			printf("Loading displacement map (as bump) : %s\n", file.C_Str());
-			material.bumpMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true);
-		}
-		if (mat->GetTexture(aiTextureType_REFLECTION, 0, &file) == AI_SUCCESS) {
-			printf("Loading reflection map (as spec) : %s\n", file.C_Str());
-			material.specTexIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true);
-		}
-		if (mat->GetTexture(aiTextureType_BASE_COLOR, 0, &file) == AI_SUCCESS) {
-			printf("Loading base color map (as diff) : %s\n", file.C_Str());
-			material.diffTexIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true);
+	//a new arena, models sharing the old one keep it
+	geometry.reset();
+	meshSet.reset();
+	size_t vertexCount = 0, index32Count = 0, index16Count = 0;
+	bounds = Bounds{};
+	for (auto& mesh : meshes) {
+		bounds.Expand(mesh.bounds);
+		mesh.vertexOffset = static_cast<int32_t>(vertexCount);
+		//every level of detail is uploaded, indexCount stays the level 0 range
+		mesh.indexCount = mesh.lods.empty() ? static_cast<uint32_t>(mesh.indices.size()) : mesh.lods[0].indexCount;
+		//indices are local to the mesh, vertexOffset is added at draw time
+		mesh.indexType = mesh.vertices.size() < 65536 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+		if (mesh.indexType == VK_INDEX_TYPE_UINT16) {
+			mesh.firstIndex = static_cast<uint32_t>(index16Count);
+			index16Count += mesh.indices.size();
 		}
-		if (mat->GetTexture(aiTextureType_NORMAL_CAMERA, 0, &file) == AI_SUCCESS) {
-			printf("Loading normal camera map (as normal): %s\n", file.C_Str());
-			material.normalMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), false);
+		else {
+			mesh.firstIndex = static_cast<uint32_t>(index32Count);
+			index32Count += mesh.indices.size();
 		}
-		if (mat->GetTexture(aiTextureType_EMISSION_COLOR, 0, &file) == AI_SUCCESS) {
-			printf("Loading emission color map (as emissive): %s\n", file.C_Str());
-			material.emissionMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true);
+		mesh.quantization = vertexFormat == VertexFormat::Compact ? Quantization::FromBox(mesh.bounds.min, mesh.bounds.max) : Quantization{};
+		vertexCount += mesh.vertices.size();
+	}
+	bounds.Finalize();
+	if (vertexCount == 0 || index32Count + index16Count == 0) return;
+	const uint32_t positionStride = GetPositionStride(vertexFormat);
+	const uint32_t attributeStride = GetAttributeStride(vertexFormat);
+	//every stride is a multiple of 4, so all streams and index ranges stay aligned
+	attributeOffset = vertexCount * positionStride;
+	index32Offset = attributeOffset + vertexCount * attributeStride;
+	index16Offset = index32Offset + index32Count * sizeof(uint32_t);
+	VkDeviceSize bufferSize = index16Offset + index16Count * sizeof(uint16_t);
+	//meshlet table of the gpu culling, at an offset every device accepts for storage buffers
+	meshletTableCount = 0;
+	for (auto& mesh : meshes) {
+		mesh.firstMeshlet = meshletTableCount;
+		mesh.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+		meshletTableCount += mesh.meshletCount;
+	}
+	meshletTableOffset = (bufferSize + 255) & ~VkDeviceSize(255);
+	if (meshletTableCount > 0) bufferSize = meshletTableOffset + meshletTableCount * sizeof(GpuMeshlet);
+
+	StagingRegion staging = instance->uploadContext.AllocateStaging(bufferSize);
+	char* base = static_cast<char*>(staging.mapped);
+	char* positionDst = base;
+	char* attributeDst = base + attributeOffset;
+	uint32_t* index32Dst = reinterpret_cast<uint32_t*>(base + index32Offset);
+	uint16_t* index16Dst = reinterpret_cast<uint16_t*>(base + index16Offset);
+	for (auto& mesh : meshes) {
+		if (vertexFormat == VertexFormat::Compact) {
+			CompactPosition* positions = reinterpret_cast<CompactPosition*>(positionDst);
+			CompactAttributes* attributes = reinterpret_cast<CompactAttributes*>(attributeDst);
+			for (size_t i = 0; i < mesh.vertices.size(); i++) {
+				positions[i] = CompactPosition::Encode(mesh.vertices[i], mesh.quantization);
+				attributes[i] = CompactAttributes::Encode(mesh.vertices[i]);
+			}
 		}
-		if (mat->GetTexture(aiTextureType_METALNESS, 0, &file) == AI_SUCCESS) {
-			printf("Loading metalness map : %s\n", file.C_Str());
-			material.metalnessMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), false);
+		else {
+			FullPosition* positions = reinterpret_cast<FullPosition*>(positionDst);
+			FullAttributes* attributes = reinterpret_cast<FullAttributes*>(attributeDst);
+			for (size_t i = 0; i < mesh.vertices.size(); i++) {
+				positions[i] = FullPosition::Encode(mesh.vertices[i]);
+				attributes[i] = FullAttributes::Encode(mesh.vertices[i]);
+			}
 		}
-		if (mat->GetTexture(aiTextureType_AMBIENT_OCCLUSION, 0, &file) == AI_SUCCESS) {
-			printf("Loading amb occlusion map : %s\n", file.C_Str());
-			material.ambOcclMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), false);
+		positionDst += mesh.vertices.size() * positionStride;
+		attributeDst += mesh.vertices.size() * attributeStride;
+		if (mesh.indexType == VK_INDEX_TYPE_UINT16) {
+			for (unsigned int index : mesh.indices) *index16Dst++ = static_cast<uint16_t>(index);
 		}
-		if (mat->GetTexture(AI_MATKEY_GLTF_PBRMETALLICROUGHNESS_METALLICROUGHNESS_TEXTURE, &file) == AI_SUCCESS) {
-			printf("Loading PBR Roughness map : %s\n", file.C_Str());
-			material.roughnessMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), false);
+		else {
+			memcpy(index32Dst, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+			index32Dst += mesh.indices.size();
 		}
 	}
-	return Mesh(vertices,indices,material);
-}
-void Model::PushMesh(Mesh& mesh) {
-	meshes.push_back(mesh);
-}
-int Model::TestLoadMaterialTexture(const Renderer* renderer, aiMaterial* mat, const std::string& path, bool sRGB, bool genMipmap) {
-	for (unsigned int i = 0; i < texture_loaded.size(); i++) {
-		if (std::strcmp(texture_loaded[i].path.c_str(), path.c_str()) == 0) {
-			printf("Already loaded this texture : %s\n", path.substr(path.rfind('/') + 1, path.size()).c_str());
-			return i;
-		}
+	GpuMeshlet* meshletDst = reinterpret_cast<GpuMeshlet*>(base + meshletTableOffset);
+	for (auto& mesh : meshes) {
+		for (const auto& meshlet : mesh.meshlets) *meshletDst++ = GpuMeshlet::Encode(meshlet, mesh.firstIndex, mesh.vertexOffset);
+	}
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+	VkAccessFlags access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+	VkPipelineStageFlags stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+	if (meshletTableCount > 0) {
+		usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		access |= VK_ACCESS_SHADER_READ_BIT;
+		stages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 	}
-	texture_loaded.emplace_back(path);
-	texture_loaded.back().Load(path, sRGB, false, genMipmap);
-	return texture_loaded.size() - 1;
-	
-	return 0;
+	geometry = std::make_shared<GeometryArena>();
+	Utils::CreateBuffer(instance->device, instance->allocator, bufferSize, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, geometry->buffer, geometry->memory);
+	UploadBatch ownBatch{};
+	UploadBatchGuard guard(instance->uploadContext, ownBatch);
+	if (batch == nullptr) {
+		ownBatch = instance->uploadContext.Begin();
+		batch = &ownBatch;
+	}
+	VkBufferCopy copyRegion{};
+	copyRegion.srcOffset = staging.offset;
+	copyRegion.size = bufferSize;
+	vkCmdCopyBuffer(batch->commandBuffer, staging.buffer, geometry->buffer, 1, &copyRegion);
+	batch->commandCount++;
+	instance->uploadContext.TransferBufferOwnership(*batch, geometry->buffer, 0, VK_WHOLE_SIZE, access, stages);
+	if (batch == &ownBatch) {
+		instance->uploadContext.Submit(ownBatch);
+	}
+	VkDeviceSize fullSize = vertexCount * sizeof(Vertex) + (index32Count + index16Count) * sizeof(uint32_t);
+	printf("Model geometry : %zu meshes, %zu vertices, %zu indices (%zu 16 bit) in one %.2f KB buffer, %.0f%% of the 32 bit layout\n",
+		meshes.size(), vertexCount, index32Count + index16Count, index16Count, bufferSize / 1024.0, 100.0 * bufferSize / fullSize);
 }
 
 
-void PrimitiveMesh::createQuad() {
+void PrimitiveMesh::createQuad(Model& out, VertexFormat format) {
 	std::vector<Vertex> vertices = {
 		{{-1.0f, -1.0f, 0.0f}, {0.0f,0.0f,-1.0f}, {0.0f, 1.0f}},
 		{{-1.0f,  1.0f, 0.0f}, {0.0f,0.0f,-1.0f}, {0.0f, 0.0f}},
@@ -198,18 +682,18 @@ void PrimitiveMesh::createQuad() {
 		{{ 1.0f, -1.0f, 0.0f}, {0.0f,0.0f,-1.0f}, {1.0f, 1.0f}}
 	};
 	std::vector<unsigned int>indices = {0, 1, 2, 2, 3, 0};
-	Mesh temp = Mesh(vertices, indices, Material{});
-	quad.PushMesh(temp);
+	out.SetVertexFormat(format);
+	out.EmplaceMesh(std::move(vertices), std::move(indices), Material{});
+	out.UploadGeometry();
 }
 
 Model PrimitiveMesh::CreateQuad() {
-	if (quad.GetMeshCount() < 1) {
-		createQuad();
-	}
-	return quad;
+	Model model;
+	createQuad(model, VertexFormat::Compact);
+	return model;
 }
 
 void PrimitiveMesh::RenderQuad(VkCommandBuffer commandBuffer, glm::mat4 modelMat, VkPipelineLayout pipelineLayout, VkDescriptorSet texDescriptorSet, VkSampler sampler) {
-	if (quad.GetMeshCount() < 1) CreateQuad();
+	if (quad.GetMeshCount() < 1) createQuad(quad, VertexFormat::Full);
 	quad.Draw(commandBuffer,pipelineLayout,texDescriptorSet,sampler);
 }
\ No newline at end of file
@@ -3,12 +3,28 @@
 #define MODEL_HPP
 #include "Mesh.hpp"
 #include "Texture.hpp"
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
-#include <assimp/GltfMaterial.h>
+#include "MeshOptimizer.hpp"
+#include "ModelImporter.hpp"
+#include "ClusterCulling.hpp"
 #include <vector>
+#include <memory>
 #include <glm/glm.hpp>
+namespace ModelCache { class Reader; class StreamWriter; }
+class ModelLoadHandle;
+struct MeshSet;
+
+//one vertex + index buffer : [positions][normals, uvs][32 bit indices][16 bit indices][gpu meshlet table].
+//shared by the Models drawing the same mesh set, goes to the deletion queue with the last of them
+struct GeometryArena {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	MemoryAllocation memory;
+	TimelineTag lastUse;	//frame that last drew it, set by Model::Draw / DrawDepth
+	GeometryArena() {}
+	GeometryArena(const GeometryArena&) = delete;
+	GeometryArena& operator=(const GeometryArena&) = delete;
+	~GeometryArena();
+};
+
 class Model {
 public:
 	glm::vec3 position = glm::vec3(0);
@@ -17,32 +33,124 @@ public:
 	Model(const Renderer* renderer, char* fn) {
 		LoadModel(renderer, fn);
 	}
+	//holds its geometry arena and textures, shared with other Models loading the same files (AssetRegistry). move only
+	Model(const Model&) = delete;
+	Model& operator=(const Model&) = delete;
+	Model(Model&& rhs) noexcept { *this = std::move(rhs); }
+	Model& operator=(Model&& rhs) noexcept;
+	~Model() { Clean(); }
+	//safe to call more than once, gpu objects go to the renderer's deletion queue.
+	//cancels a LoadModelAsync() in progress
 	void Clean();
-	void Draw(VkCommandBuffer commandBuffer ,VkPipelineLayout pipelineLayout = VK_NULL_HANDLE ,VkDescriptorSet texDescriptorSet = VK_NULL_HANDLE, VkSampler sampler = VK_NULL_HANDLE, glm::mat4 modelMat = glm::mat4(1));
-	void LoadModel(const Renderer* renderer, const std::string& fn);
-	void PushMesh(Mesh& mesh);
+	//view != nullptr culls meshes and meshlets against it, see GetCullStats().
+	//lods keeps the level of detail selection of this view / instance between frames, nullptr selects without hysteresis.
+	//culled = the target Cull() filled this frame : meshes at level 0 draw its indirect commands instead of culling on the cpu
+	void Draw(VkCommandBuffer commandBuffer ,VkPipelineLayout pipelineLayout = VK_NULL_HANDLE ,VkDescriptorSet texDescriptorSet = VK_NULL_HANDLE, VkSampler sampler = VK_NULL_HANDLE, glm::mat4 modelMat = glm::mat4(1), const CullView* view = nullptr, LodState* lods = nullptr, const CullTarget* culled = nullptr);
+	//binds only the position stream, for pipelines built with CompactDepthLayout / FullDepthLayout
+	void DrawDepth(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, glm::mat4 modelMat = glm::mat4(1), const CullView* view = nullptr, LodState* lods = nullptr, const CullTarget* culled = nullptr);
+	//records the compute pass culling every meshlet against view into target, outside render passes.
+	//call CullTarget::Barrier() after the last Cull() of the frame, then Draw / DrawDepth with the same modelMat and target.
+	//false when the model has no meshlets on the gpu or the device can't draw indirectly, the draws cull on the cpu then
+	bool Cull(VkCommandBuffer commandBuffer, const CullView& view, CullTarget& target, glm::mat4 modelMat = glm::mat4(1));
+	//culling result of the last Draw / DrawDepth
+	const CullStats& GetCullStats() const { return cullStats; }
+	//.vrbundle files (AssetCooker output) go to LoadBundle(), everything else through assimp or the model cache.
+	//into an empty model, a file another Model already loaded with the same options is shared instead
+	void LoadModel(const Renderer* renderer, const std::string& fn, const ModelLoadOptions& options = ModelLoadOptions{});
+	//loads a cooked bundle as it is, only options.retention and options.vertexFormat apply
+	void LoadBundle(const std::string& fn, const ModelLoadOptions& options = ModelLoadOptions{});
+	//returns right away, import / cache read runs on the renderer's workers and the uploads go through its upload scheduler.
+	//the model keeps drawing its current content until the new geometry is on the gpu, then replaces it and
+	//draws untextured until each texture arrives. a load already in progress is cancelled
+	std::shared_ptr<ModelLoadHandle> LoadModelAsync(const std::string& fn, const ModelLoadOptions& options = ModelLoadOptions{},
+		UploadPriority priority = UploadPriority::Normal);
+	void PushMesh(Mesh&& mesh);
+	template<typename... Args>
+	Mesh& EmplaceMesh(Args&&... args) {
+		meshes.emplace_back(std::forward<Args>(args)...);
+		return meshes.back();
+	}
+	//packs every mesh into one vertex + index buffer. call after PushMesh()
+	//batch == nullptr -> submits and waits on its own
+	//fails if a mesh already dropped its cpu geometry
+	void UploadGeometry(UploadBatch* batch = nullptr);
+	//drops cpu geometry of every mesh after upload, returns the bytes released
+	size_t ApplyRetention(GeometryRetention retention);
+	const Bounds& GetBounds() const { return bounds; }
+	//takes effect at the next UploadGeometry()
+	void SetVertexFormat(VertexFormat format) { vertexFormat = format; }
+	VertexFormat GetVertexFormat() const { return vertexFormat; }
 	int GetMeshCount() const { return meshes.size(); }
 	void SetPosition(float x, float y, float z);
 	void SetPosition(glm::vec3 pos);
 	glm::mat4 GetModelMat(glm::mat4 modelMat = glm::mat4(1));
 
-	VkImageView GetTextureView(int idx) { return texture_loaded[idx].textureImageView; }
+	VkImageView GetTextureView(int idx) { return texture_loaded[idx]->textureImageView; }
+	//true when the geometry and textures come from a load another Model did
+	bool IsShared() const;
 private:
 	std::vector<Mesh> meshes;
-	std::vector<Texture> texture_loaded;
+	std::vector<std::shared_ptr<Texture>> texture_loaded;
+	std::shared_ptr<GeometryArena> geometry;
+	VkDeviceSize attributeOffset = 0;
+	VkDeviceSize index32Offset = 0;
+	VkDeviceSize index16Offset = 0;
+	VkDeviceSize meshletTableOffset = 0;
+	uint32_t meshletTableCount = 0;		//GpuMeshlet records, every mesh's meshlets in mesh order
+	VertexFormat vertexFormat = VertexFormat::Compact;
+	Bounds bounds;	//union of the mesh bounds, kept unless retention is KeepNothing
+	MeshOptimizer::Report optimizeReport;
+	size_t meshletCount = 0;
+	size_t lodCount = 0;
+	CullStats cullStats;
+	std::shared_ptr<ModelLoadHandle> pendingLoad;
+	std::shared_ptr<MeshSet> meshSet;	//registered content, nullptr once the model changes its geometry
 private:
-	void ProcessNode(const Renderer* renderer, aiNode* node, const aiScene* scene, const std::string& path);
-	Mesh ProcessMesh(const Renderer* renderer, aiMesh* mesh, const aiScene* scene, const std::string& path);
-	int TestLoadMaterialTexture(const Renderer* renderer, aiMaterial * mat, const std::string& path, bool sRGB, bool genMipmap = true);
+	friend class ModelLoadHandle;
+	//a texture uploaded by LoadModel() / LoadFromFile(), registered (AssetRegistry) only once the load's last batch is
+	//submitted, so no other model shares an image whose upload was dropped
+	struct LoadedTexture {
+		std::string path;
+		uint64_t contentHash;
+		bool sRGB;
+		std::shared_ptr<Texture> texture;
+	};
+	//false when the cache is missing or stale, nothing is loaded then
+	bool LoadCached(const std::string& fn, const std::string& cachePath, uint64_t sourceHash, uint64_t optionsHash, const ModelLoadOptions& options);
+	//meshes and textures of an opened cache or bundle
+	void LoadFromFile(ModelCache::Reader& reader, const std::string& fn, const ModelLoadOptions& options);
+	//geometry upload, submit of the load's batch and the retention policy
+	void FinishLoad(UploadBatch& batch, const std::string& fn, const ModelLoadOptions& options);
+	//decodes the import's textures on the workers, at most options.decodeBudget bytes at once, and records each upload here
+	//as soon as its decode is done. cache != nullptr -> the workers write each chain into it and the chain is freed once
+	//uploaded, otherwise they decode straight into staging memory. batch may be submitted and replaced in between.
+	//new textures go to loaded
+	void UploadImportedTextures(ModelImporter& importer, const ModelLoadOptions& options, ModelCache::StreamWriter* cache, UploadBatch& batch, std::vector<int>& textureMap,
+		std::vector<LoadedTexture>& loaded);
+	//the same image earlier in the same load, contentHash == 0 -> nullptr
+	static std::shared_ptr<Texture> FindLoaded(const std::vector<LoadedTexture>& loaded, uint64_t contentHash, bool sRGB);
+	static void RegisterTextures(const std::vector<LoadedTexture>& loaded);
+	void AddImportedMesh(ImportedMesh&& mesh, const Material& material);
+	//import texture indices -> texture_loaded indices, slots mapped to -1 stay unset
+	static Material RemapMaterial(Material material, const std::vector<int>& textureMap);
+	//takes set's content when the model is empty, false otherwise
+	bool Instantiate(const std::shared_ptr<MeshSet>& set, const std::string& fn);
+	//makes the current content findable by later loads of fn
+	void RegisterMeshSet(const std::string& fn, uint64_t contentHash, uint64_t optionsHash);
+	void DrawMeshes(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const glm::mat4& modelMat, bool pushMaterial, const CullView* view, LodState* lods, const CullTarget* culled);
 };
 
 
 struct PrimitiveMesh {
 	static Model quad;
+	//returns a new quad with its own geometry, move it into place. Compact, for the default pipelines
 	static Model CreateQuad();
+	//the shared quad is Full, its positions reach pipelines without a model matrix (TextureDebug) as they are
 	static void RenderQuad(VkCommandBuffer commandBuffer, glm::mat4 modelMat = glm::mat4(1), VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, VkDescriptorSet texDescriptorSet = VK_NULL_HANDLE, VkSampler sampler = VK_NULL_HANDLE);
+	//releases the shared quad used by RenderQuad()
+	static void Clean() { quad.Clean(); }
 private:
-	static void createQuad();
+	static void createQuad(Model& out, VertexFormat format);
 };
 
 #endif // !1
\ No newline at end of file
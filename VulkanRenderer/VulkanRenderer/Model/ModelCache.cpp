@@ -0,0 +1,457 @@
+#include "ModelCache.hpp"
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+namespace {
+	constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+	constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+	constexpr uint64_t PAYLOAD_ALIGNMENT = 16;
+	static_assert(sizeof(Material) == 9 * sizeof(int), "cached materials are copied as 9 texture indices");
+
+	inline uint64_t Rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+	inline uint64_t MixWord(uint64_t h, uint64_t word) {
+		word *= PRIME2;
+		word = Rotl(word, 31);
+		word *= PRIME1;
+		h ^= word;
+		return Rotl(h, 27) * PRIME1 + 0x52DCE729;
+	}
+	inline uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+namespace ModelCache {
+	uint64_t Hash(const void* data, size_t size, uint64_t seed) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		uint64_t h = seed ^ (static_cast<uint64_t>(size) * PRIME1);
+		size_t i = 0;
+		//8 bytes per step, file hashing runs at memory speed
+		for (; i + 8 <= size; i += 8) {
+			uint64_t word;
+			memcpy(&word, bytes + i, 8);
+			h = MixWord(h, word);
+		}
+		if (i < size) {
+			uint64_t word = 0;
+			memcpy(&word, bytes + i, size - i);
+			h = MixWord(h, word);
+		}
+		h ^= h >> 33;
+		h *= PRIME2;
+		h ^= h >> 29;
+		h *= PRIME1;
+		h ^= h >> 32;
+		return h;
+	}
+
+	uint64_t HashFile(const std::string& path) {
+		MappedFile file;
+		if (!file.Open(path)) return 0;
+		return Hash(file.GetData(), file.GetSize());
+	}
+
+	uint64_t HashOptions(const ModelLoadOptions& options) {
+		struct {
+			uint32_t version;
+			uint32_t optimizeGeometry;
+			float overdrawThreshold;
+			uint32_t buildMeshlets;
+			uint32_t lodCount;
+			float lodReduction;
+			float lodMaxError;
+		} key = { VERSION, options.optimizeGeometry, options.overdrawThreshold, options.buildMeshlets,
+			options.lodCount, options.lodReduction, options.lodMaxError };
+		return Hash(&key, sizeof(key));
+	}
+
+	std::string GetCachePath(const std::string& fn, const ModelLoadOptions& options) {
+		if (options.cacheDirectory.empty()) return fn + EXTENSION;
+		std::filesystem::path name = std::filesystem::path(fn).filename();
+		return (std::filesystem::path(options.cacheDirectory) / name).string() + EXTENSION;
+	}
+
+	bool GetFileStamp(const std::string& path, uint64_t& size, int64_t& time) {
+		//size and time stay untouched (0 in a fresh record) when the file is missing, file_size() returns -1 then
+		std::error_code error;
+		uint64_t fileSize = std::filesystem::file_size(path, error);
+		if (error) return false;
+		auto writeTime = std::filesystem::last_write_time(path, error);
+		if (error) return false;
+		size = fileSize;
+		time = static_cast<int64_t>(writeTime.time_since_epoch().count());
+		return true;
+	}
+
+	Material OffsetMaterial(Material material, int offset) {
+		return RemapTextureIndices(material, [offset](int index) { return index + offset; });
+	}
+
+	void Writer::AddMesh(const Material& material, const Bounds& bounds, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+		const std::vector<Meshlet>& meshlets, const std::vector<MeshLod>& lods) {
+		PendingMesh pending{};
+		pending.vertices = &vertices;
+		pending.indices = &indices;
+		pending.meshlets = &meshlets;
+		pending.lods = &lods;
+		MeshRecord& record = pending.record;
+		record.material = material;
+		record.vertexCount = static_cast<uint32_t>(vertices.size());
+		record.indexCount = static_cast<uint32_t>(indices.size());
+		record.meshletCount = static_cast<uint32_t>(meshlets.size());
+		record.lodCount = static_cast<uint32_t>(lods.size());
+		record.boundsMin = bounds.min;
+		record.boundsMax = bounds.max;
+		meshes.push_back(pending);
+	}
+
+	void Writer::AddTexture(const std::string& path, uint32_t width, uint32_t height, uint32_t mipLevels, int nChannels, bool sRGB,
+		TextureEncoding encoding, const std::vector<uint8_t>& payload, uint64_t contentHash) {
+		PendingTexture pending{};
+		pending.path = path;
+		pending.payload = &payload;
+		TextureRecord& record = pending.record;
+		record.pathLength = static_cast<uint32_t>(path.size());
+		record.width = width;
+		record.height = height;
+		record.mipLevels = mipLevels;
+		record.nChannels = nChannels;
+		record.sRGB = sRGB ? 1 : 0;
+		record.encoding = encoding;
+		record.dataSize = payload.size();
+		record.contentHash = contentHash;
+		GetFileStamp(path, record.sourceSize, record.sourceTime);
+		textures.push_back(std::move(pending));
+	}
+
+	uint64_t Writer::Save(const std::string& path, uint64_t sourceHash, uint64_t optionsHash, uint32_t flags) const {
+		//offsets first, then one sequential write
+		std::vector<MeshRecord> meshRecords(meshes.size());
+		std::vector<TextureRecord> textureRecords(textures.size());
+		uint64_t offset = sizeof(FileHeader) + meshes.size() * sizeof(MeshRecord) + textures.size() * sizeof(TextureRecord);
+		for (size_t i = 0; i < textures.size(); i++) {
+			textureRecords[i] = textures[i].record;
+			textureRecords[i].pathOffset = offset;
+			offset += textures[i].path.size();
+		}
+		auto place = [&offset](uint64_t size) {
+			offset = AlignUp(offset, PAYLOAD_ALIGNMENT);
+			uint64_t placed = offset;
+			offset += size;
+			return placed;
+		};
+		for (size_t i = 0; i < meshes.size(); i++) {
+			MeshRecord& record = meshRecords[i];
+			record = meshes[i].record;
+			record.vertexOffset = place(record.vertexCount * sizeof(Vertex));
+			record.indexOffset = place(record.indexCount * sizeof(uint32_t));
+			record.meshletOffset = place(record.meshletCount * sizeof(Meshlet));
+			record.lodOffset = place(record.lodCount * sizeof(MeshLod));
+		}
+		for (auto& record : textureRecords) {
+			record.dataOffset = place(record.dataSize);
+		}
+		FileHeader header{};
+		memcpy(header.magic, MAGIC, sizeof(header.magic));
+		header.version = VERSION;
+		header.meshCount = static_cast<uint32_t>(meshes.size());
+		header.textureCount = static_cast<uint32_t>(textures.size());
+		header.flags = flags;
+		header.sourceHash = sourceHash;
+		header.optionsHash = optionsHash;
+		header.fileSize = offset;
+
+		std::string tempPath = path + ".tmp";
+		{
+			std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+			if (!out.is_open()) return 0;
+			uint64_t written = 0;
+			auto write = [&](const void* data, uint64_t size) {
+				if (size == 0) return;
+				out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+				written += size;
+			};
+			auto pad = [&](uint64_t to) {
+				static const char zeros[PAYLOAD_ALIGNMENT] = {};
+				write(zeros, to - written);
+			};
+			write(&header, sizeof(header));
+			write(meshRecords.data(), meshRecords.size() * sizeof(MeshRecord));
+			write(textureRecords.data(), textureRecords.size() * sizeof(TextureRecord));
+			for (const auto& texture : textures) write(texture.path.data(), texture.path.size());
+			for (size_t i = 0; i < meshes.size(); i++) {
+				const PendingMesh& mesh = meshes[i];
+				const MeshRecord& record = meshRecords[i];
+				pad(record.vertexOffset);
+				write(mesh.vertices->data(), record.vertexCount * sizeof(Vertex));
+				pad(record.indexOffset);
+				write(mesh.indices->data(), record.indexCount * sizeof(uint32_t));
+				pad(record.meshletOffset);
+				write(mesh.meshlets->data(), record.meshletCount * sizeof(Meshlet));
+				pad(record.lodOffset);
+				write(mesh.lods->data(), record.lodCount * sizeof(MeshLod));
+			}
+			for (size_t i = 0; i < textures.size(); i++) {
+				pad(textureRecords[i].dataOffset);
+				write(textures[i].payload->data(), textureRecords[i].dataSize);
+			}
+			if (!out.good()) {
+				out.close();
+				std::remove(tempPath.c_str());
+				return 0;
+			}
+		}
+		std::error_code error;
+		std::filesystem::rename(tempPath, path, error);
+		if (error) {
+			std::remove(tempPath.c_str());
+			return 0;
+		}
+		return header.fileSize;
+	}
+
+	bool StreamWriter::Open(const std::string& _path, size_t meshCount, const std::vector<ImportedTexture>& textures, const std::vector<std::string>& dependencies) {
+		Abandon();
+		path = _path;
+		tempPath = path + ".tmp";
+		out.open(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out.is_open()) return false;
+		failed = false;
+		meshRecords.assign(meshCount, MeshRecord{});
+		textureRecords.assign(textures.size(), TextureRecord{});
+		dependencyRecords.assign(dependencies.size(), DependencyRecord{});
+		written.assign(meshCount + textures.size(), false);
+		offset = sizeof(FileHeader) + meshCount * sizeof(MeshRecord) + textures.size() * sizeof(TextureRecord) + dependencies.size() * sizeof(DependencyRecord);
+		//records are written over the zeros by Finish()
+		std::vector<char> reserved(offset, 0);
+		out.write(reserved.data(), static_cast<std::streamsize>(reserved.size()));
+		for (size_t i = 0; i < textures.size(); i++) {
+			textureRecords[i].pathOffset = offset;
+			textureRecords[i].pathLength = static_cast<uint32_t>(textures[i].path.size());
+			out.write(textures[i].path.data(), static_cast<std::streamsize>(textures[i].path.size()));
+			offset += textures[i].path.size();
+		}
+		for (size_t i = 0; i < dependencies.size(); i++) {
+			DependencyRecord& record = dependencyRecords[i];
+			record.pathOffset = offset;
+			record.pathLength = static_cast<uint32_t>(dependencies[i].size());
+			record.found = GetFileStamp(dependencies[i], record.size, record.time) ? 1 : 0;
+			out.write(dependencies[i].data(), static_cast<std::streamsize>(dependencies[i].size()));
+			offset += dependencies[i].size();
+		}
+		if (!out.good()) {
+			Abandon();
+			return false;
+		}
+		return true;
+	}
+
+	uint64_t StreamWriter::Append(const void* data, uint64_t size) {
+		static const char zeros[PAYLOAD_ALIGNMENT] = {};
+		uint64_t placed = AlignUp(offset, PAYLOAD_ALIGNMENT);
+		out.write(zeros, static_cast<std::streamsize>(placed - offset));
+		if (size > 0) out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		offset = placed + size;
+		if (!out.good()) failed = true;
+		return placed;
+	}
+
+	void StreamWriter::WriteMeshes(const std::vector<ImportedMesh>& meshes) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!out.is_open()) return;
+		if (meshes.size() != meshRecords.size()) {
+			failed = true;
+			return;
+		}
+		for (size_t i = 0; i < meshes.size(); i++) {
+			const ImportedMesh& mesh = meshes[i];
+			MeshRecord& record = meshRecords[i];
+			record.material = mesh.material;
+			record.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+			record.indexCount = static_cast<uint32_t>(mesh.indices.size());
+			record.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+			record.lodCount = static_cast<uint32_t>(mesh.lods.size());
+			record.boundsMin = mesh.bounds.min;
+			record.boundsMax = mesh.bounds.max;
+			record.vertexOffset = Append(mesh.vertices.data(), record.vertexCount * sizeof(Vertex));
+			record.indexOffset = Append(mesh.indices.data(), record.indexCount * sizeof(uint32_t));
+			record.meshletOffset = Append(mesh.meshlets.data(), record.meshletCount * sizeof(Meshlet));
+			record.lodOffset = Append(mesh.lods.data(), record.lodCount * sizeof(MeshLod));
+			written[i] = true;
+		}
+	}
+
+	void StreamWriter::WriteTexture(size_t index, const ImportedTexture& texture) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!out.is_open() || index >= textureRecords.size()) return;
+		TextureRecord& record = textureRecords[index];
+		record.width = texture.image.width;
+		record.height = texture.image.height;
+		record.mipLevels = texture.mipLevels;
+		record.nChannels = texture.image.nChannels;
+		record.sRGB = texture.sRGB ? 1 : 0;
+		record.encoding = texture.encoding;
+		record.dataSize = texture.mipChain.size();
+		record.contentHash = texture.contentHash;
+		GetFileStamp(texture.path, record.sourceSize, record.sourceTime);
+		record.dataOffset = Append(texture.mipChain.data(), record.dataSize);
+		written[meshRecords.size() + index] = true;
+	}
+
+	uint64_t StreamWriter::Finish(uint64_t sourceHash, uint64_t optionsHash) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!out.is_open()) return 0;
+		bool complete = !failed;
+		for (bool done : written) complete = complete && done;
+		if (!complete) {
+			out.close();
+			std::remove(tempPath.c_str());
+			return 0;
+		}
+		FileHeader header{};
+		memcpy(header.magic, MAGIC, sizeof(header.magic));
+		header.version = VERSION;
+		header.meshCount = static_cast<uint32_t>(meshRecords.size());
+		header.textureCount = static_cast<uint32_t>(textureRecords.size());
+		header.dependencyCount = static_cast<uint32_t>(dependencyRecords.size());
+		header.sourceHash = sourceHash;
+		header.optionsHash = optionsHash;
+		header.fileSize = offset;
+		out.seekp(0);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(meshRecords.data()), static_cast<std::streamsize>(meshRecords.size() * sizeof(MeshRecord)));
+		out.write(reinterpret_cast<const char*>(textureRecords.data()), static_cast<std::streamsize>(textureRecords.size() * sizeof(TextureRecord)));
+		out.write(reinterpret_cast<const char*>(dependencyRecords.data()), static_cast<std::streamsize>(dependencyRecords.size() * sizeof(DependencyRecord)));
+		bool good = out.good();
+		out.close();
+		std::error_code error;
+		if (good) std::filesystem::rename(tempPath, path, error);
+		if (!good || error) {
+			std::remove(tempPath.c_str());
+			return 0;
+		}
+		return header.fileSize;
+	}
+
+	void StreamWriter::Abandon() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!out.is_open()) return;
+		out.close();
+		std::remove(tempPath.c_str());
+	}
+
+	bool Reader::Open(const std::string& _path) {
+		path = _path;
+		if (!file.Open(path)) return false;
+		if (file.GetSize() < sizeof(FileHeader)) return Reject("truncated");
+		const FileHeader& header = GetHeader();
+		if (memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0) return Reject("not a model cache or bundle");
+		if (header.version != VERSION) return Reject("other version");
+		if (header.fileSize != file.GetSize()) return Reject("truncated");
+		uint64_t tables = sizeof(FileHeader) + uint64_t(header.meshCount) * sizeof(MeshRecord) + uint64_t(header.textureCount) * sizeof(TextureRecord)
+			+ uint64_t(header.dependencyCount) * sizeof(DependencyRecord);
+		if (!InRange(0, tables)) return Reject("truncated");
+		for (uint32_t i = 0; i < header.meshCount; i++) {
+			const MeshRecord& record = GetMesh(i);
+			if (!InRange(record.vertexOffset, uint64_t(record.vertexCount) * sizeof(Vertex)) ||
+				!InRange(record.indexOffset, uint64_t(record.indexCount) * sizeof(uint32_t)) ||
+				!InRange(record.meshletOffset, uint64_t(record.meshletCount) * sizeof(Meshlet)) ||
+				!InRange(record.lodOffset, uint64_t(record.lodCount) * sizeof(MeshLod))) {
+				return Reject("corrupt mesh table");
+			}
+			//nothing out of range may reach the gpu : texture slots, vertex indices and the index ranges drawn
+			for (int Material::* slot : MATERIAL_TEXTURE_SLOTS) {
+				int texture = record.material.*slot;
+				if (texture < -1 || (texture >= 0 && uint32_t(texture) >= header.textureCount)) return Reject("corrupt material");
+			}
+			const uint32_t* indices = Get<uint32_t>(record.indexOffset);
+			uint32_t maxIndex = 0;
+			for (uint32_t j = 0; j < record.indexCount; j++) maxIndex = std::max(maxIndex, indices[j]);
+			if (record.indexCount > 0 && maxIndex >= record.vertexCount) return Reject("index out of range");
+			const MeshLod* lods = Get<MeshLod>(record.lodOffset);
+			for (uint32_t j = 0; j < record.lodCount; j++) {
+				if (uint64_t(lods[j].firstIndex) + lods[j].indexCount > record.indexCount) return Reject("corrupt level of detail");
+			}
+			//meshlets split level 0
+			uint32_t levelZero = record.lodCount > 0 ? lods[0].indexCount : record.indexCount;
+			if (record.lodCount > 0 && lods[0].firstIndex != 0) return Reject("corrupt level of detail");
+			const Meshlet* meshlets = Get<Meshlet>(record.meshletOffset);
+			for (uint32_t j = 0; j < record.meshletCount; j++) {
+				if (uint64_t(meshlets[j].firstIndex) + meshlets[j].indexCount > levelZero) return Reject("corrupt meshlet");
+			}
+		}
+		for (uint32_t i = 0; i < header.textureCount; i++) {
+			const TextureRecord& record = GetTexture(i);
+			if (!TextureCompression::IsValid(record.encoding)) {
+				return Reject("unknown texture encoding");
+			}
+			if (!InRange(record.pathOffset, record.pathLength) || !InRange(record.dataOffset, record.dataSize) ||
+				record.dataSize != TextureCompression::GetMipChainSize(record.encoding, record.width, record.height, record.mipLevels)) {
+				return Reject("corrupt texture table");
+			}
+		}
+		for (uint32_t i = 0; i < header.dependencyCount; i++) {
+			const DependencyRecord& record = GetDependency(i);
+			if (!InRange(record.pathOffset, record.pathLength)) return Reject("corrupt dependency table");
+		}
+		return true;
+	}
+
+	ImportedMesh Reader::ReadMesh(uint32_t i) const {
+		const MeshRecord& record = GetMesh(i);
+		ImportedMesh out;
+		const Vertex* vertices = Get<Vertex>(record.vertexOffset);
+		const uint32_t* indices = Get<uint32_t>(record.indexOffset);
+		const Meshlet* meshlets = Get<Meshlet>(record.meshletOffset);
+		out.vertices.assign(vertices, vertices + record.vertexCount);
+		out.indices.assign(indices, indices + record.indexCount);
+		out.meshlets.assign(meshlets, meshlets + record.meshletCount);
+		if (record.lodCount > 0) {
+			const MeshLod* lods = Get<MeshLod>(record.lodOffset);
+			out.lods.assign(lods, lods + record.lodCount);
+		}
+		out.material = record.material;
+		if (record.vertexCount > 0) {
+			out.bounds.Expand(record.boundsMin);
+			out.bounds.Expand(record.boundsMax);
+			out.bounds.Finalize();
+		}
+		return out;
+	}
+
+	bool Reader::IsCurrent(uint64_t sourceHash, uint64_t optionsHash) {
+		const FileHeader& header = GetHeader();
+		if (header.sourceHash != sourceHash) return Reject("source changed");
+		if (header.optionsHash != optionsHash) return Reject("import options changed");
+		for (uint32_t i = 0; i < header.textureCount; i++) {
+			const TextureRecord& record = GetTexture(i);
+			//embedded images (glb) have no stamp, the source hash covers them
+			if (record.sourceSize == 0 && record.sourceTime == 0) continue;
+			//images are not hashed, a changed size or write time invalidates the file
+			uint64_t size = 0;
+			int64_t time = 0;
+			if (!GetFileStamp(GetTexturePath(record), size, time) || size != record.sourceSize || time != record.sourceTime) {
+				return Reject("a texture changed");
+			}
+		}
+		for (uint32_t i = 0; i < header.dependencyCount; i++) {
+			const DependencyRecord& record = GetDependency(i);
+			uint64_t size = 0;
+			int64_t time = 0;
+			bool found = GetFileStamp(std::string(Get<char>(record.pathOffset), record.pathLength), size, time);
+			if (found != (record.found != 0) || (found && (size != record.size || time != record.time))) {
+				return Reject("a material library or buffer changed");
+			}
+		}
+		return true;
+	}
+
+	bool Reader::Reject(const char* reason) {
+		printf("Ignoring %s : %s\n", path.c_str(), reason);
+		file.Close();
+		return false;
+	}
+}
@@ -0,0 +1,191 @@
+#pragma once
+#ifndef MODEL_CACHE_HPP
+#define MODEL_CACHE_HPP
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include "ModelImporter.hpp"
+#include "TextureCompression.hpp"
+#include "Tools/MappedFile.hpp"
+
+// Binary file of one imported model : processed geometry, bounds, materials and full mip chains.
+// the file is memory mapped and its payloads are copied straight into staging memory, nothing is parsed.
+// layout : [FileHeader][MeshRecord * meshCount][TextureRecord * textureCount][DependencyRecord * dependencyCount]
+//          [texture paths][dependency paths][payloads, 16 byte aligned]
+// two kinds share the layout :
+//  cache  : written by Model::LoadModel(), valid for the same source bytes, import options, VERSION, texture files
+//           and side files of the import (ModelImporter::GetDependencies())
+//  bundle : written by the offline cooker (AssetCooker), loaded as it is, textures may be block compressed
+namespace ModelCache {
+	//bump when the layout or the import result changes, older files are rebuilt
+	constexpr uint32_t VERSION = 4;
+	constexpr char MAGIC[8] = "VRCACHE";
+	constexpr const char* EXTENSION = ".vrcache";
+	constexpr const char* BUNDLE_EXTENSION = ".vrbundle";
+	constexpr uint32_t FLAG_BUNDLE = 1;
+
+	struct FileHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t meshCount;
+		uint32_t textureCount;
+		uint32_t flags;			// FLAG_BUNDLE
+		uint32_t dependencyCount;
+		uint32_t padding;
+		uint64_t sourceHash;
+		uint64_t optionsHash;
+		uint64_t fileSize;		// a truncated write fails validation
+	};
+	struct MeshRecord {
+		Material material;		// texture indices relative to the model's first cached texture
+		uint32_t vertexCount;
+		uint32_t indexCount;	// every level of detail
+		uint32_t meshletCount;
+		uint32_t lodCount;		// 0 -> level 0 only
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		uint32_t padding;
+		uint64_t vertexOffset;	// Vertex, from the start of the file
+		uint64_t indexOffset;	// uint32_t
+		uint64_t meshletOffset;	// Meshlet
+		uint64_t lodOffset;		// MeshLod
+	};
+	struct TextureRecord {
+		uint64_t pathOffset;
+		uint32_t pathLength;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+		int32_t nChannels;		// of the source image
+		uint32_t sRGB;
+		TextureEncoding encoding;
+		uint32_t padding;
+		uint64_t sourceSize;	// the image file when the cache was written, 0 for images embedded in the model
+		int64_t sourceTime;
+		uint64_t dataOffset;	// mip chain in encoding, level 0 first
+		uint64_t dataSize;
+		uint64_t contentHash;	// Hash() of the encoded source image, 0 when unknown. AssetRegistry key
+	};
+	// a file the import read besides the model and its textures (.mtl, .bin), stamped like the textures
+	struct DependencyRecord {
+		uint64_t pathOffset;
+		uint32_t pathLength;
+		uint32_t found;			// 0 : it was missing when the cache was written
+		uint64_t size;
+		int64_t time;
+	};
+
+	uint64_t Hash(const void* data, size_t size, uint64_t seed = 0);
+	//0 when the file can't be read
+	uint64_t HashFile(const std::string& path);
+	//only the options that change the cached data
+	uint64_t HashOptions(const ModelLoadOptions& options);
+	//fn + EXTENSION, or the file name inside options.cacheDirectory
+	std::string GetCachePath(const std::string& fn, const ModelLoadOptions& options);
+	//size and modification time of a dependency, false when it is missing
+	bool GetFileStamp(const std::string& path, uint64_t& size, int64_t& time);
+	//material texture indices shifted by offset, unset ones stay -1
+	Material OffsetMaterial(Material material, int offset);
+
+	class Writer {
+	public:
+		//the vectors are referenced until Save(), they must outlive it.
+		//material texture indices are relative to the first texture added
+		void AddMesh(const Material& material, const Bounds& bounds, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+			const std::vector<Meshlet>& meshlets, const std::vector<MeshLod>& lods);
+		void AddMesh(const ImportedMesh& mesh) { AddMesh(mesh.material, mesh.bounds, mesh.vertices, mesh.indices, mesh.meshlets, mesh.lods); }
+		void AddTexture(const std::string& path, uint32_t width, uint32_t height, uint32_t mipLevels, int nChannels, bool sRGB,
+			TextureEncoding encoding, const std::vector<uint8_t>& payload, uint64_t contentHash = 0);
+		//writes a temporary file and renames it over path, so readers never see half a file.
+		//returns the bytes written, 0 on failure
+		uint64_t Save(const std::string& path, uint64_t sourceHash, uint64_t optionsHash, uint32_t flags = 0) const;
+	private:
+		struct PendingMesh {
+			MeshRecord record;
+			const std::vector<Vertex>* vertices;
+			const std::vector<unsigned int>* indices;
+			const std::vector<Meshlet>* meshlets;
+			const std::vector<MeshLod>* lods;
+		};
+		struct PendingTexture {
+			TextureRecord record;
+			std::string path;
+			const std::vector<uint8_t>* payload;
+		};
+		std::vector<PendingMesh> meshes;
+		std::vector<PendingTexture> textures;
+	};
+
+	// Cache of an import still in progress : payloads are appended to the temporary file as they are ready and
+	// the caller frees them right after, so a load never holds every mip chain at once. the records go in last.
+	// textures may be written from any thread and in any order, payloads then follow the meshes in that order.
+	class StreamWriter {
+	public:
+		StreamWriter() = default;
+		StreamWriter(const StreamWriter&) = delete;
+		StreamWriter& operator=(const StreamWriter&) = delete;
+		~StreamWriter() { Abandon(); }
+		//creates the temporary file and reserves the records of meshCount meshes and textures (their paths are written now).
+		//dependencies are stamped now
+		bool Open(const std::string& path, size_t meshCount, const std::vector<ImportedTexture>& textures, const std::vector<std::string>& dependencies);
+		bool IsOpen() const { return out.is_open(); }
+		//every mesh at once, meshCount of them
+		void WriteMeshes(const std::vector<ImportedMesh>& meshes);
+		//textures[index] as Open() got it, its rgba8 mip chain (or prebaked levels) in mipChain
+		void WriteTexture(size_t index, const ImportedTexture& texture);
+		//records and rename once everything was written, returns the bytes written, 0 on failure
+		uint64_t Finish(uint64_t sourceHash, uint64_t optionsHash);
+		//drops the temporary file, a no-op after Finish()
+		void Abandon();
+	private:
+		std::mutex mutex;
+		std::ofstream out;
+		std::string path, tempPath;
+		uint64_t offset = 0;
+		std::vector<MeshRecord> meshRecords;
+		std::vector<TextureRecord> textureRecords;
+		std::vector<DependencyRecord> dependencyRecords;
+		std::vector<bool> written;	//meshes first, then textures
+		bool failed = false;
+
+		//at the next aligned offset, returns it. mutex held
+		uint64_t Append(const void* data, uint64_t size);
+	};
+
+	class Reader {
+	public:
+		//maps the file and checks its structure, false on a missing, truncated or corrupt file or another version
+		bool Open(const std::string& path);
+		//cache validation : false when the source, the import options or a texture file changed
+		bool IsCurrent(uint64_t sourceHash, uint64_t optionsHash);
+		void Close() { file.Close(); }
+		bool IsBundle() const { return (GetHeader().flags & FLAG_BUNDLE) != 0; }
+
+		uint32_t GetMeshCount() const { return GetHeader().meshCount; }
+		uint32_t GetTextureCount() const { return GetHeader().textureCount; }
+		const MeshRecord& GetMesh(uint32_t i) const { return Get<MeshRecord>(sizeof(FileHeader))[i]; }
+		const TextureRecord& GetTexture(uint32_t i) const { return Get<TextureRecord>(sizeof(FileHeader) + GetMeshCount() * sizeof(MeshRecord))[i]; }
+		std::string GetTexturePath(const TextureRecord& record) const {
+			return std::string(Get<char>(record.pathOffset), record.pathLength);
+		}
+		uint32_t GetDependencyCount() const { return GetHeader().dependencyCount; }
+		const DependencyRecord& GetDependency(uint32_t i) const {
+			return Get<DependencyRecord>(sizeof(FileHeader) + GetMeshCount() * sizeof(MeshRecord) + GetTextureCount() * sizeof(TextureRecord))[i];
+		}
+		//copy of mesh i in import form, texture indices stay relative to the file's first texture
+		ImportedMesh ReadMesh(uint32_t i) const;
+		template<typename T>
+		const T* Get(uint64_t offset) const { return reinterpret_cast<const T*>(file.GetData() + offset); }
+		size_t GetSize() const { return file.GetSize(); }
+	private:
+		MappedFile file;
+		const FileHeader& GetHeader() const { return *Get<FileHeader>(0); }
+		std::string path;
+		bool InRange(uint64_t offset, uint64_t size) const { return offset <= file.GetSize() && size <= file.GetSize() - offset; }
+		bool Reject(const char* reason);
+	};
+}
+
+#endif // !MODEL_CACHE_HPP
@@ -0,0 +1,487 @@
+#include "ModelImporter.hpp"
+#include "ModelCache.hpp"
+#include "TextureCompression.hpp"
+#include "TextureContainer.hpp"
+#include "Tools/MappedFile.hpp"
+#include <assimp/DefaultIOSystem.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <stdexcept>
+#include <utility>
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MODEL_IMPORT_SSE
+#endif
+
+namespace {
+	//directory of fn with its trailing slash, material textures are relative to it
+	std::string GetDirectory(const std::string& fn) {
+		size_t slash = fn.find_last_of('/');
+		return slash == std::string::npos ? "" : fn.substr(0, slash + 1);
+	}
+	//assimp's file access, every other file it looks for besides the model (material libraries, buffers) is recorded
+	class RecordingIOSystem : public Assimp::DefaultIOSystem {
+	public:
+		RecordingIOSystem(const std::string& _model, std::vector<std::string>& _opened) : model(_model), opened(_opened) {}
+		bool Exists(const char* file) const override {
+			Record(file);
+			return DefaultIOSystem::Exists(file);
+		}
+		Assimp::IOStream* Open(const char* file, const char* mode = "rb") override {
+			Record(file);
+			return DefaultIOSystem::Open(file, mode);
+		}
+	private:
+		std::string model;
+		std::vector<std::string>& opened;
+		void Record(const char* file) const {
+			if (model != file && std::find(opened.begin(), opened.end(), file) == opened.end()) opened.push_back(file);
+		}
+	};
+	//interleaves assimp's separate position / normal / uv arrays into Vertex.
+	//uvs == nullptr -> zero uvs
+	void ConvertVertices(const aiVector3D* positions, const aiVector3D* normals, const aiVector3D* uvs, size_t count, Vertex* out) {
+		static_assert(sizeof(aiVector3D) == 3 * sizeof(float) && sizeof(Vertex) == 8 * sizeof(float), "ConvertVertices expects float aiVector3D and a 32 byte Vertex");
+		if (count == 0) return;
+		const float* p = &positions[0].x;
+		const float* n = &normals[0].x;
+		const float* t = uvs != nullptr ? &uvs[0].x : nullptr;
+		float* dst = reinterpret_cast<float*>(out);
+		size_t i = 0;
+#ifdef MODEL_IMPORT_SSE
+		//one vertex per iteration : three unaligned loads, two 16 byte stores (px py pz nx | ny nz u v).
+		//the loads read one float past the vertex, so the last vertex takes the scalar path.
+		const __m128 zero = _mm_setzero_ps();
+		for (; i + 1 < count; i++) {
+			__m128 pos = _mm_loadu_ps(p + i * 3);
+			__m128 nrm = _mm_loadu_ps(n + i * 3);
+			__m128 uv = t != nullptr ? _mm_loadu_ps(t + i * 3) : zero;
+			__m128 mid = _mm_shuffle_ps(pos, nrm, _MM_SHUFFLE(0, 0, 2, 2));
+			_mm_storeu_ps(dst + i * 8, _mm_shuffle_ps(pos, mid, _MM_SHUFFLE(2, 0, 1, 0)));
+			_mm_storeu_ps(dst + i * 8 + 4, _mm_shuffle_ps(nrm, uv, _MM_SHUFFLE(1, 0, 2, 1)));
+		}
+#endif
+		for (; i < count; i++) {
+			out[i].position = glm::vec3(p[i * 3], p[i * 3 + 1], p[i * 3 + 2]);
+			out[i].normal = glm::vec3(n[i * 3], n[i * 3 + 1], n[i * 3 + 2]);
+			out[i].texCoords = t != nullptr ? glm::vec2(t[i * 3], t[i * 3 + 1]) : glm::vec2(0.0f);
+		}
+	}
+}
+
+void ModelImporter::Read(const std::string& fn, ThreadPool& workers) {
+	fileName = fn;
+	scene = nullptr;
+	gltf.reset();
+	obj.reset();
+	sceneMeshes.clear();
+	meshes.clear();
+	textures.clear();
+	dependencies.clear();
+	if (GltfLoader::IsGltf(fn)) {
+		auto loader = std::make_unique<GltfLoader>();
+		if (loader->Open(fn)) {
+			gltf = std::move(loader);
+			dependencies = gltf->GetDependencies();
+			meshes.resize(gltf->GetPrimitiveCount());
+			for (size_t i = 0; i < meshes.size(); i++) {
+				meshes[i].material = ProcessGltfMaterial(gltf->GetPrimitiveMaterial(i));
+			}
+			return;
+		}
+		printf("Importing %s with assimp\n", fn.c_str());
+	}
+	if (ObjLoader::IsObj(fn)) {
+		auto loader = std::make_unique<ObjLoader>();
+		if (loader->Open(fn, workers)) {
+			obj = std::move(loader);
+			dependencies = obj->GetDependencies();
+			std::string path = GetDirectory(fn);
+			meshes.resize(obj->GetMeshCount());
+			for (size_t i = 0; i < meshes.size(); i++) {
+				meshes[i].material = ProcessObjMaterial(obj->GetMeshMaterial(i), path);
+			}
+			return;
+		}
+		printf("Importing %s with assimp\n", fn.c_str());
+	}
+	//the importer owns the io system
+	importer.SetIOHandler(new RecordingIOSystem(fn, dependencies));
+	scene = importer.ReadFile(fn, aiProcess_Triangulate);
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+		std::string errMsg = "ERROR::ASSIMP::";
+		errMsg.append(importer.GetErrorString());
+		throw std::runtime_error(errMsg.c_str());
+	}
+	std::string path = GetDirectory(fn);
+	CollectMeshes(scene->mRootNode, scene, sceneMeshes);
+	//materials only register their textures here, nothing is decoded yet
+	meshes.resize(sceneMeshes.size());
+	for (size_t i = 0; i < sceneMeshes.size(); i++) {
+		meshes[i].material = ProcessMaterial(sceneMeshes[i], scene, path);
+	}
+}
+
+void ModelImporter::Process(const ModelLoadOptions& options, ThreadPool& workers, bool buildMipChains) {
+	//textures first as they are the longest jobs
+	size_t textureJobs = textures.size();
+	finishedJobs = 0;
+	jobCount = textureJobs + meshes.size();
+	workers.ParallelFor(textureJobs + meshes.size(), [&](size_t job) {
+		if (cancel != nullptr && cancel->load()) return;
+		if (job < textureJobs) {
+			if (!textures[job].skip) DecodeTexture(job, buildMipChains);
+		}
+		else {
+			ProcessMesh(options, job - textureJobs);
+		}
+		finishedJobs++;
+	});
+	if (cancel != nullptr && cancel->load()) return;
+	SummarizeMeshes(options);
+}
+
+void ModelImporter::ProcessMeshes(const ModelLoadOptions& options, ThreadPool& workers) {
+	finishedJobs = 0;
+	jobCount = meshes.size();
+	workers.ParallelFor(meshes.size(), [&](size_t mesh) {
+		if (cancel != nullptr && cancel->load()) return;
+		ProcessMesh(options, mesh);
+		finishedJobs++;
+	});
+	if (cancel != nullptr && cancel->load()) return;
+	SummarizeMeshes(options);
+}
+
+void ModelImporter::DecodeTexture(size_t index, bool buildMipChain, uint8_t* out) {
+	auto start = std::chrono::steady_clock::now();
+	ImportedTexture& texture = textures[index];
+	DecodedImage& image = texture.image;
+	//the file is read once for the content hash and the decode
+	const uint8_t* encoded = texture.encoded;
+	size_t encodedSize = texture.encodedSize;
+	MappedFile file;
+	if (encoded == nullptr && file.Open(texture.path)) {
+		encoded = file.GetData();
+		encodedSize = file.GetSize();
+	}
+	if (encoded != nullptr && TextureContainer::IsContainer(encoded, encodedSize)) {
+		texture.contentHash = ModelCache::Hash(encoded, encodedSize);
+		ReadContainer(texture, encoded, encodedSize, out);
+		texture.decodeMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		printf("Read %s in %.1f ms\n", texture.path.c_str(), texture.decodeMilliseconds);
+		return;
+	}
+	if (encoded != nullptr) {
+		texture.contentHash = ModelCache::Hash(encoded, encodedSize);
+		image = DecodedImage::DecodeMemory(encoded, encodedSize, texture.path);
+	}
+	else {
+		image = DecodedImage::Decode(texture.path);
+	}
+	texture.mipLevels = texture.genMipmap ? DecodedImage::GetMipLevelCount(image.width, image.height) : 1;
+	if (out != nullptr) {
+		//out was sized from the header
+		if (buildMipChain) image.BuildMipChain(texture.sRGB, texture.mipLevels, out);
+		else memcpy(out, image.pixels, static_cast<size_t>(image.GetSize()));
+	}
+	else if (buildMipChain) {
+		texture.mipChain = image.BuildMipChain(texture.sRGB, texture.mipLevels);
+	}
+	if (out != nullptr || buildMipChain) {
+		//level 0 is in the chain now, the decode buffer can go
+		stbi_image_free(image.pixels);
+		image.pixels = nullptr;
+	}
+	texture.decodeMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printf("Decoded %s in %.1f ms\n", texture.path.c_str(), texture.decodeMilliseconds);
+}
+
+void ModelImporter::ReadContainer(ImportedTexture& texture, const uint8_t* encoded, size_t encodedSize, uint8_t* out) {
+	ContainerImage container = TextureContainer::Parse(encoded, encodedSize, texture.path);
+	DecodedImage& image = texture.image;
+	image = DecodedImage{};
+	image.width = static_cast<int>(container.width);
+	image.height = static_cast<int>(container.height);
+	image.nChannels = TextureCompression::GetChannelCount(container.encoding);
+	texture.prebaked = true;
+	texture.mipLevels = container.mipLevels;
+	//_SRGB formats stay sRGB whatever slot the material uses them in
+	texture.sRGB = texture.sRGB || container.sRGB;
+	bool sampled = (sampledEncodings & TextureCompression::GetEncodingBit(container.encoding)) != 0;
+	texture.encoding = sampled ? container.encoding : TextureEncoding::RGBA8;
+	if (out == nullptr) {
+		texture.mipChain.resize(static_cast<size_t>(TextureCompression::GetMipChainSize(texture.encoding, container.width, container.height, container.mipLevels)));
+		out = texture.mipChain.data();
+	}
+	bool flipped = true;
+	if (sampled) {
+		flipped = TextureContainer::CopyMipChain(container, out);
+	}
+	else {
+		//the device can't sample it. decoded as stored and flipped as rgba8, which always works
+		ContainerImage asStored = container;
+		asStored.topDown = false;
+		std::vector<uint8_t> stored(static_cast<size_t>(TextureCompression::GetMipChainSize(container.encoding, container.width, container.height, container.mipLevels)));
+		TextureContainer::CopyMipChain(asStored, stored.data());
+		std::vector<uint8_t> rgba(static_cast<size_t>(TextureCompression::GetMipChainSize(TextureEncoding::RGBA8, container.width, container.height, container.mipLevels)));
+		TextureCompression::Decompress(stored.data(), container.width, container.height, container.mipLevels, container.encoding, rgba.data());
+		if (container.topDown) {
+			uint8_t* level = rgba.data();
+			uint32_t width = container.width, height = container.height;
+			for (uint32_t i = 0; i < container.mipLevels; i++) {
+				TextureCompression::FlipLevel(level, width, height, TextureEncoding::RGBA8);
+				level += TextureCompression::GetLevelSize(TextureEncoding::RGBA8, width, height);
+				width = std::max(width / 2, 1u);
+				height = std::max(height / 2, 1u);
+			}
+		}
+		//out may be staging memory, it is only written
+		memcpy(out, rgba.data(), rgba.size());
+	}
+	if (!flipped) {
+		printf("%s is stored top down and can't be flipped, it is sampled upside down\n", texture.path.c_str());
+	}
+}
+
+uint64_t ModelImporter::GetDecodedSize(size_t index, bool buildMipChain) const {
+	const ImportedTexture& texture = textures[index];
+	if (TextureContainer::IsContainer(texture.path) || (texture.encoded != nullptr && TextureContainer::IsContainer(texture.encoded, texture.encodedSize))) {
+		MappedFile file;
+		const uint8_t* encoded = texture.encoded;
+		size_t encodedSize = texture.encodedSize;
+		if (encoded == nullptr) {
+			if (!file.Open(texture.path)) return 0;
+			encoded = file.GetData();
+			encodedSize = file.GetSize();
+		}
+		try {
+			ContainerImage container = TextureContainer::Parse(encoded, encodedSize, texture.path);
+			bool sampled = (sampledEncodings & TextureCompression::GetEncodingBit(container.encoding)) != 0;
+			return TextureCompression::GetMipChainSize(sampled ? container.encoding : TextureEncoding::RGBA8, container.width, container.height, container.mipLevels);
+		}
+		catch (const std::exception&) {
+			//the decode reports it
+			return 0;
+		}
+	}
+	int width = 0, height = 0;
+	bool read = texture.encoded != nullptr ? DecodedImage::ReadSize(texture.encoded, texture.encodedSize, width, height) : DecodedImage::ReadSize(texture.path, width, height);
+	if (!read || width <= 0 || height <= 0) return 0;
+	uint32_t levels = buildMipChain && texture.genMipmap ? DecodedImage::GetMipLevelCount(width, height) : 1;
+	return TextureCompression::GetMipChainSize(TextureEncoding::RGBA8, width, height, levels);
+}
+
+void ModelImporter::ProcessMesh(const ModelLoadOptions& options, size_t index) {
+	if (gltf) gltf->ConvertPrimitive(index, meshes[index].vertices, meshes[index].indices);
+	else if (obj) obj->ConvertMesh(index, meshes[index].vertices, meshes[index].indices);
+	else ConvertMesh(sceneMeshes[index], meshes[index]);
+	FinishMesh(options, meshes[index]);
+}
+
+void ModelImporter::SummarizeMeshes(const ModelLoadOptions& options) {
+	report = MeshOptimizer::Report{};
+	meshletCount = 0;
+	lodCount = 0;
+	for (const auto& mesh : meshes) {
+		report += mesh.report;
+		meshletCount += mesh.meshlets.size();
+		lodCount += mesh.lods.empty() ? 0 : mesh.lods.size() - 1;
+	}
+	if (options.optimizeGeometry && report.triangles > 0) {
+		printf("Optimized %s : %zu -> %zu vertices, ACMR %.3f -> %.3f (%zu triangles)\n", fileName.c_str(),
+			report.verticesBefore, report.verticesAfter, report.AcmrBefore(), report.AcmrAfter(), report.triangles);
+	}
+	if (meshletCount > 0) {
+		printf("Built %zu meshlets for %s\n", meshletCount, fileName.c_str());
+	}
+	if (lodCount > 0) {
+		printf("Built %zu coarser levels of detail for %s\n", lodCount, fileName.c_str());
+	}
+}
+
+void ModelImporter::CollectMeshes(aiNode* node, const aiScene* scene, std::vector<aiMesh*>& out) {
+	for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+		out.push_back(scene->mMeshes[node->mMeshes[i]]);
+	}
+	for (unsigned int i = 0; i < node->mNumChildren; i++) {
+		CollectMeshes(node->mChildren[i], scene, out);
+	}
+}
+
+Material ModelImporter::ProcessMaterial(aiMesh* mesh, const aiScene* scene, const std::string& path) {
+	Material material;
+	aiString file;
+	//process material
+	if (mesh->mMaterialIndex < scene->mNumMaterials) {
+		aiMaterial* mat = scene->mMaterials[mesh->mMaterialIndex];
+		aiGetMaterialString(mat, AI_MATKEY_NAME, &file);
+		if (mat->GetTexture(aiTextureType_DIFFUSE, 0, &file) == AI_SUCCESS) {
+			printf("Loading diffuse map : %s\n", file.C_Str());
+			material.diffTexIdx = RegisterTexture(path + std::string(file.C_Str()), true);
+		}
+		if (mat->GetTexture(aiTextureType_SPECULAR, 0, &file) == AI_SUCCESS) {
+			printf("Loading specular map : %s\n", file.C_Str());
+			material.specTexIdx = RegisterTexture(path + std::string(file.C_Str()), true);
+		}
+		if (mat->GetTexture(aiTextureType_EMISSIVE, 0, &file) == AI_SUCCESS) {
+			printf("Loading emissive map : %s\n", file.C_Str());
+			material.emissionMapIdx = RegisterTexture(path + std::string(file.C_Str()), true);
+		}
+		if (mat->GetTexture(aiTextureType_HEIGHT, 0, &file) == AI_SUCCESS) {
+			printf("Loading height map : %s\n", file.C_Str());
+			material.bumpMapIdx= RegisterTexture(path + std::string(file.C_Str()), true);
+		}
+		if (mat->GetTexture(aiTextureType_NORMALS, 0, &file) == AI_SUCCESS) {
+			printf("Loading Normal map : %s\n", file.C_Str());
+			material.normalMapIdx = RegisterTexture(path + std::string(file.C_Str()), false);
+		}
+		if (mat->GetTexture(aiTextureType_SHININESS, 0, &file) == AI_SUCCESS) {
+			printf("Loading shininess map : %s\n", file.C_Str());
+			material.roughnessMapIdx = RegisterTexture(path + std::string(file.C_Str()), true);
+		}
+		if (mat->GetTexture(aiTextureType_OPACITY, 0, &file) == AI_SUCCESS) {
+			printf("Loading opacity map : %s\n", file.C_Str());
+			material.opacityMapIdx = RegisterTexture(path + std::string(file.C_Str()), true, false);
+		}
+		if (mat->GetTexture(aiTextureType_DISPLACEMENT, 0, &file) == AI_SUCCESS) {
+			printf("Loading displacement map (as bump) : %s\n", file.C_Str());
+			material.bumpMapIdx = RegisterTexture(path + std::string(file.C_Str()), true);
+		}
+		if (mat->GetTexture(aiTextureType_REFLECTION, 0, &file) == AI_SUCCESS) {
+			printf("Loading reflection map (as spec) : %s\n", file.C_Str());
+			material.specTexIdx = RegisterTexture(path + std::string(file.C_Str()), true);
+		}
+		if (mat->GetTexture(aiTextureType_BASE_COLOR, 0, &file) == AI_SUCCESS) {
+			printf("Loading base color map (as diff) : %s\n", file.C_Str());
+			material.diffTexIdx = RegisterTexture(path + std::string(file.C_Str()), true);
+		}
+		if (mat->GetTexture(aiTextureType_NORMAL_CAMERA, 0, &file) == AI_SUCCESS) {
+			printf("Loading normal camera map (as normal): %s\n", file.C_Str());
+			material.normalMapIdx = RegisterTexture(path + std::string(file.C_Str()), false);
+		}
+		if (mat->GetTexture(aiTextureType_EMISSION_COLOR, 0, &file) == AI_SUCCESS) {
+			printf("Loading emission color map (as emissive): %s\n", file.C_Str());
+			material.emissionMapIdx = RegisterTexture(path + std::string(file.C_Str()), true);
+		}
+		if (mat->GetTexture(aiTextureType_METALNESS, 0, &file) == AI_SUCCESS) {
+			printf("Loading metalness map : %s\n", file.C_Str());
+			material.metalnessMapIdx = RegisterTexture(path + std::string(file.C_Str()), false);
+		}
+		if (mat->GetTexture(aiTextureType_AMBIENT_OCCLUSION, 0, &file) == AI_SUCCESS) {
+			printf("Loading amb occlusion map : %s\n", file.C_Str());
+			material.ambOcclMapIdx = RegisterTexture(path + std::string(file.C_Str()), false);
+		}
+		if (mat->GetTexture(AI_MATKEY_GLTF_PBRMETALLICROUGHNESS_METALLICROUGHNESS_TEXTURE, &file) == AI_SUCCESS) {
+			printf("Loading PBR Roughness map : %s\n", file.C_Str());
+			material.roughnessMapIdx = RegisterTexture(path + std::string(file.C_Str()), false);
+		}
+	}
+	return material;
+}
+
+Material ModelImporter::ProcessGltfMaterial(int material) {
+	Material out;
+	if (material < 0) return out;
+	const std::vector<GltfLoader::Image>& images = gltf->GetImages();
+	GltfLoader::MaterialImages slots = gltf->GetMaterialImages(material);
+	auto Register = [&](int image, bool sRGB, const char* name) {
+		if (image < 0) return -1;
+		const GltfLoader::Image& source = images[image];
+		printf("Loading %s map : %s\n", name, source.path.c_str());
+		return RegisterTexture(source.path, sRGB, true, source.data, source.size);
+	};
+	//same slots assimp's gltf importer fills. metallic roughness packs both (b metal, g roughness)
+	out.diffTexIdx = Register(slots.baseColor, true, "base color");
+	out.normalMapIdx = Register(slots.normal, false, "normal");
+	out.emissionMapIdx = Register(slots.emissive, true, "emissive");
+	out.roughnessMapIdx = Register(slots.metallicRoughness, false, "metallic roughness");
+	out.metalnessMapIdx = out.roughnessMapIdx;
+	out.ambOcclMapIdx = Register(slots.occlusion, false, "amb occlusion");
+	return out;
+}
+
+Material ModelImporter::ProcessObjMaterial(int material, const std::string& path) {
+	Material out;
+	if (material < 0) return out;
+	const tinyobj::material_t& mtl = obj->GetMaterials()[material];
+	auto Register = [&](const std::string& file, int& slot, bool sRGB, const char* name, bool genMipmap = true) {
+		if (file.empty()) return;
+		printf("Loading %s map : %s\n", name, file.c_str());
+		slot = RegisterTexture(path + file, sRGB, genMipmap);
+	};
+	//the slots and order of ProcessMaterial() for the textures assimp's obj importer reads
+	Register(mtl.diffuse_texname, out.diffTexIdx, true, "diffuse");
+	Register(mtl.specular_texname, out.specTexIdx, true, "specular");
+	Register(mtl.emissive_texname, out.emissionMapIdx, true, "emissive");
+	Register(mtl.bump_texname, out.bumpMapIdx, true, "height");
+	Register(mtl.normal_texname, out.normalMapIdx, false, "Normal");
+	Register(mtl.specular_highlight_texname, out.roughnessMapIdx, true, "shininess");
+	Register(mtl.alpha_texname, out.opacityMapIdx, true, "opacity", false);
+	Register(mtl.displacement_texname, out.bumpMapIdx, true, "displacement (as bump)");
+	Register(mtl.reflection_texname, out.specTexIdx, true, "reflection (as spec)");
+	Register(mtl.metallic_texname, out.metalnessMapIdx, false, "metalness");
+	return out;
+}
+
+void ModelImporter::ConvertMesh(const aiMesh* mesh, ImportedMesh& out) {
+	std::vector<Vertex>& vertices = out.vertices;
+	std::vector<unsigned int>& indices = out.indices;
+	//process vertex, meshes without normals reuse the positions as before
+	vertices.resize(mesh->mNumVertices);
+	ConvertVertices(mesh->mVertices, mesh->HasNormals() ? mesh->mNormals : mesh->mVertices, mesh->mTextureCoords[0], mesh->mNumVertices, vertices.data());
+	//process indices, points and lines the triangulation leaves behind can't go into a triangle list
+	size_t triangleCount = 0;
+	for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+		if (mesh->mFaces[i].mNumIndices == 3) triangleCount++;
+	}
+	indices.resize(triangleCount * 3);
+	unsigned int* dst = indices.data();
+	for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+		const aiFace& face = mesh->mFaces[i];
+		if (face.mNumIndices != 3) continue;
+		dst[0] = face.mIndices[0];
+		dst[1] = face.mIndices[1];
+		dst[2] = face.mIndices[2];
+		dst += 3;
+	}
+}
+
+void ModelImporter::FinishMesh(const ModelLoadOptions& options, ImportedMesh& out) {
+	std::vector<Vertex>& vertices = out.vertices;
+	std::vector<unsigned int>& indices = out.indices;
+	if (options.optimizeGeometry) {
+		out.report = MeshOptimizer::Optimize(vertices, indices, options.overdrawThreshold);
+	}
+	//built on the final triangle order, each meshlet is an index range of the mesh
+	if (options.buildMeshlets) {
+		out.meshlets = MeshOptimizer::BuildMeshlets(vertices, indices);
+	}
+	for (const auto& v : vertices) out.bounds.Expand(v.position);
+	out.bounds.Finalize();
+	//coarser levels are appended to the same index list and share the vertices
+	if (options.lodCount > 1 && !indices.empty()) {
+		out.lods = MeshOptimizer::BuildLodChain(vertices, indices, options.lodCount, options.lodReduction, options.lodMaxError * out.bounds.radius);
+		if (out.lods.size() < 2) out.lods.clear();
+	}
+}
+
+int ModelImporter::RegisterTexture(const std::string& path, bool sRGB, bool genMipmap, const uint8_t* encoded, size_t encodedSize) {
+	for (size_t i = 0; i < textures.size(); i++) {
+		if (textures[i].path == path) {
+			printf("Already loaded this texture : %s\n", path.substr(path.rfind('/') + 1, path.size()).c_str());
+			return static_cast<int>(i);
+		}
+	}
+	//decoded on the workers by Process()
+	ImportedTexture texture;
+	texture.path = path;
+	texture.sRGB = sRGB;
+	texture.genMipmap = genMipmap;
+	texture.encoded = encoded;
+	texture.encodedSize = encodedSize;
+	textures.push_back(std::move(texture));
+	return static_cast<int>(textures.size()) - 1;
+}
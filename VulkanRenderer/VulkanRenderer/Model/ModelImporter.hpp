@@ -0,0 +1,147 @@
+#pragma once
+#ifndef MODEL_IMPORTER_HPP
+#define MODEL_IMPORTER_HPP
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <assimp/GltfMaterial.h>
+#include "Geometry.hpp"
+#include "Material.hpp"
+#include "Meshlet.hpp"
+#include "MeshOptimizer.hpp"
+#include "DecodedImage.hpp"
+#include "TextureCompression.hpp"
+#include "GltfLoader.hpp"
+#include "ObjLoader.hpp"
+#include "Tools/ThreadPool.hpp"
+
+struct ModelLoadOptions {
+	//production default : only what drawing and culling need stays resident
+	GeometryRetention retention = GeometryRetention::KeepBounds;
+	//weld, vertex cache, overdraw and vertex fetch optimization of every mesh
+	bool optimizeGeometry = true;
+	//acmr the overdraw pass may give up for better triangle order, <= 0 disables it
+	float overdrawThreshold = 1.05f;
+	//split every mesh into meshlets for cluster culling (Draw with a CullView)
+	bool buildMeshlets = true;
+	//levels of detail per mesh including the full one, 1 disables the chain
+	uint32_t lodCount = 4;
+	//triangles of each level relative to the previous one
+	float lodReduction = 0.5f;
+	//simplification error limit relative to the mesh radius
+	float lodMaxError = 0.05f;
+	//gpu vertex format, Compact halves the arena. pipelines use CompactLayout / FullLayout (or the Depth variants)
+	VertexFormat vertexFormat = VertexFormat::Compact;
+	//load from / write to a binary cache next to the file (see ModelCache), rebuilt when the file,
+	//its textures or the options above change
+	bool useCache = true;
+	//empty -> the cache is written next to the model
+	std::string cacheDirectory;
+	//bytes of pixels Model::LoadModel() and LoadModelAsync() let the workers decode and hold until uploaded (at least one
+	//image). it is also how much staging one upload batch of LoadModel() collects before it is submitted, so the staging
+	//ring can be reused during the load
+	uint64_t decodeBudget = 256ull * 1024 * 1024;
+};
+
+//cpu result of one aiMesh / glTF primitive
+struct ImportedMesh {
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;	//level 0 followed by the coarser levels
+	std::vector<Meshlet> meshlets;
+	std::vector<MeshLod> lods;
+	Material material;					//texture indices into ModelImporter::GetTextures()
+	Bounds bounds;
+	MeshOptimizer::Report report;
+};
+
+//one image referenced by the materials
+struct ImportedTexture {
+	std::string path;
+	bool sRGB = false;
+	bool genMipmap = true;
+	bool skip = false;					//set before Process() when the caller already has the image, it is not decoded
+	const uint8_t* encoded = nullptr;	//embedded image (glb, data uri) owned by the importer, nullptr -> decoded from path
+	size_t encodedSize = 0;
+	uint64_t contentHash = 0;			//ModelCache::Hash() of the encoded bytes, set by Process(). AssetRegistry key
+	DecodedImage image;					//pixels are released once mipChain is built
+	uint32_t mipLevels = 1;
+	std::vector<uint8_t> mipChain;		//only when Process() builds mip chains or the file is prebaked
+	TextureEncoding encoding = TextureEncoding::RGBA8;	//of mipChain
+	bool prebaked = false;				//ktx2 / dds file : mipChain holds its stored levels, whether mip chains were asked for or not
+	float decodeMilliseconds = 0.0f;	//read, hash, decode and mip chain of DecodeTexture()
+};
+
+// Vulkan free half of a model load : file import, mesh conversion / optimization and image decoding.
+// .gltf / .glb go through GltfLoader, .obj through ObjLoader, everything else (and files they can't read) through assimp.
+// shared by Model::LoadModel() and the offline cooker.
+// usage : Read() -> mark textures to skip -> Process() -> take meshes and textures.
+// callers that upload while decoding run ProcessMeshes() and DecodeTexture() for every texture instead of Process().
+class ModelImporter {
+public:
+	//throws when the import fails. collects the meshes and registers the material textures,
+	//nothing heavy yet except .obj files whose text is parsed on the workers
+	void Read(const std::string& fn, ThreadPool& workers);
+	//mesh conversion and image decoding on the workers, the calling thread helps.
+	//buildMipChains -> full rgba8 chains are built on the cpu as well
+	void Process(const ModelLoadOptions& options, ThreadPool& workers, bool buildMipChains);
+	//the mesh half of Process()
+	void ProcessMeshes(const ModelLoadOptions& options, ThreadPool& workers);
+	//decodes one texture on the calling thread, different textures may be decoded at once.
+	//out != nullptr -> the pixels (the mip chain when buildMipChain) go there instead of image / mipChain,
+	//GetDecodedSize() bytes of it. image keeps the size and channels of the file
+	void DecodeTexture(size_t index, bool buildMipChain, uint8_t* out = nullptr);
+	//bytes DecodeTexture() writes, read from the image header. 0 when the header can't be read
+	uint64_t GetDecodedSize(size_t index, bool buildMipChain) const;
+	//ktx2 / dds encodings outside mask (TextureCompression::GetEncodingBit() bits) are decoded to rgba8 by DecodeTexture().
+	//all by default, so the cooker keeps what the files hold
+	void SetSampledEncodings(uint32_t mask) { sampledEncodings = mask; }
+	//jobs of Process() still queued return at once when *flag is set, the results are incomplete then
+	void SetCancelFlag(const std::atomic<bool>* flag) { cancel = flag; }
+	//finished Process() jobs, may be read from any thread
+	float GetProgress() const { return jobCount > 0 ? float(finishedJobs.load()) / jobCount.load() : 0.0f; }
+
+	std::vector<ImportedMesh>& GetMeshes() { return meshes; }
+	std::vector<ImportedTexture>& GetTextures() { return textures; }
+	const MeshOptimizer::Report& GetReport() const { return report; }
+	size_t GetMeshletCount() const { return meshletCount; }
+	size_t GetLodCount() const { return lodCount; }
+	//files besides fn and the textures that Read() depends on : obj material libraries, gltf buffers, whatever assimp
+	//looked for. missing ones are listed too, the model cache is rebuilt when they change, appear or go away
+	const std::vector<std::string>& GetDependencies() const { return dependencies; }
+private:
+	Assimp::Importer importer;
+	const aiScene* scene = nullptr;
+	std::unique_ptr<GltfLoader> gltf;	//set when the native readers took the file
+	std::unique_ptr<ObjLoader> obj;
+	std::string fileName;
+	std::vector<aiMesh*> sceneMeshes;
+	std::vector<ImportedMesh> meshes;
+	std::vector<ImportedTexture> textures;
+	std::vector<std::string> dependencies;
+	MeshOptimizer::Report report;
+	size_t meshletCount = 0;
+	size_t lodCount = 0;
+	const std::atomic<bool>* cancel = nullptr;
+	uint32_t sampledEncodings = ~0u;
+	std::atomic<size_t> jobCount{ 0 };
+	std::atomic<size_t> finishedJobs{ 0 };
+
+	void CollectMeshes(aiNode* node, const aiScene* scene, std::vector<aiMesh*>& out);
+	Material ProcessMaterial(aiMesh* mesh, const aiScene* scene, const std::string& path);
+	Material ProcessGltfMaterial(int material);
+	Material ProcessObjMaterial(int material, const std::string& path);
+	int RegisterTexture(const std::string& path, bool sRGB, bool genMipmap = true, const uint8_t* encoded = nullptr, size_t encodedSize = 0);
+	void ProcessMesh(const ModelLoadOptions& options, size_t index);
+	//prebaked half of DecodeTexture()
+	void ReadContainer(ImportedTexture& texture, const uint8_t* encoded, size_t encodedSize, uint8_t* out);
+	void SummarizeMeshes(const ModelLoadOptions& options);
+	//thread safe, touch nothing but out
+	static void ConvertMesh(const aiMesh* mesh, ImportedMesh& out);
+	static void FinishMesh(const ModelLoadOptions& options, ImportedMesh& out);
+};
+
+#endif // !MODEL_IMPORTER_HPP
@@ -0,0 +1,393 @@
+#include "ModelLoadHandle.hpp"
+#include "Model.hpp"
+#include "AssetRegistry.hpp"
+#include <filesystem>
+#include <stdexcept>
+#include <utility>
+#include <chrono>
+
+ModelLoadHandle::ModelLoadHandle(const std::string& fn, const ModelLoadOptions& _options, UploadPriority _priority) :fileName(fn), options(_options), priority(_priority) {
+}
+
+bool ModelLoadHandle::IsDone() const {
+	ModelLoadState current = state;
+	return current == ModelLoadState::Ready || current == ModelLoadState::Failed || current == ModelLoadState::Cancelled;
+}
+
+float ModelLoadHandle::GetProgress() const {
+	switch (state.load())
+	{
+	case ModelLoadState::Importing:	return 0.5f * importer.GetProgress();
+	case ModelLoadState::Uploading:	return 0.5f;
+	case ModelLoadState::Streaming:	return textureBytes > 0 ? 0.6f + 0.4f * float(uploadedBytes.load()) / textureBytes : 1.0f;
+	case ModelLoadState::Ready:		return 1.0f;
+	default:						return 0.0f;
+	}
+}
+
+void ModelLoadHandle::Import() {
+	try {
+		Renderer* instance = Renderer::GetInstance();
+		bool fromFile = false;
+		std::string cachePath;
+		if (std::filesystem::path(fileName).extension().string() == ModelCache::BUNDLE_EXTENSION) {
+			if (!reader.Open(fileName)) {
+				throw std::runtime_error("failed to open model bundle!");
+			}
+			fromFile = true;
+		}
+		else if (options.useCache) {
+			sourceHash = ModelCache::HashFile(fileName);
+			optionsHash = ModelCache::HashOptions(options);
+			cachePath = ModelCache::GetCachePath(fileName, options);
+			fromFile = sourceHash != 0 && reader.Open(cachePath) && reader.IsCurrent(sourceHash, optionsHash);
+			if (!fromFile) reader.Close();
+		}
+		if (fromFile) {
+			uint32_t sampled = Texture::GetSampledEncodings();
+			//meshes are copied out, texture payloads stay in the mapping until they are uploaded
+			meshes.reserve(reader.GetMeshCount());
+			for (uint32_t i = 0; i < reader.GetMeshCount(); i++) {
+				meshes.push_back(reader.ReadMesh(i));
+				meshletCount += meshes.back().meshlets.size();
+				lodCount += meshes.back().lods.empty() ? 0 : meshes.back().lods.size() - 1;
+			}
+			for (uint32_t i = 0; i < reader.GetTextureCount(); i++) {
+				const ModelCache::TextureRecord& record = reader.GetTexture(i);
+				PendingTexture texture;
+				texture.path = reader.GetTexturePath(record);
+				texture.sRGB = record.sRGB != 0;
+				texture.mipChain = reader.Get<uint8_t>(record.dataOffset);
+				texture.width = record.width;
+				texture.height = record.height;
+				texture.mipLevels = record.mipLevels;
+				texture.encoding = record.encoding;
+				texture.contentHash = record.contentHash;
+				texture.shared = AssetRegistry::FindTexture(texture.path, texture.sRGB);
+				if (texture.shared == nullptr) texture.shared = AssetRegistry::FindTexture(texture.contentHash, texture.sRGB);
+				texture.size = texture.shared == nullptr ? record.dataSize : 0;
+				//payloads the device can't sample are decoded here, upload jobs must not throw or stall the frame with it
+				if (texture.shared == nullptr && (sampled & TextureCompression::GetEncodingBit(record.encoding)) == 0) {
+					texture.decoded.resize(static_cast<size_t>(TextureCompression::GetMipChainSize(TextureEncoding::RGBA8, record.width, record.height, record.mipLevels)));
+					TextureCompression::Decompress(texture.mipChain, record.width, record.height, record.mipLevels, record.encoding, texture.decoded.data());
+					texture.mipChain = texture.decoded.data();
+					texture.encoding = TextureEncoding::RGBA8;
+					texture.size = texture.decoded.size();
+				}
+				textureBytes += texture.size;
+				textures.push_back(std::move(texture));
+			}
+			printf("Read %s from %s (%.2f MB)\n", fileName.c_str(), reader.IsBundle() ? "its bundle" : "the model cache", reader.GetSize() / (1024.0 * 1024.0));
+		}
+		else {
+			importer.SetCancelFlag(&cancelRequested);
+			importer.SetSampledEncodings(Texture::GetSampledEncodings());
+			importer.Read(fileName, instance->workers);
+			//images some model already uploaded are not decoded
+			std::vector<ImportedTexture>& imported = importer.GetTextures();
+			std::vector<std::shared_ptr<Texture>> shared(imported.size());
+			bool sharesTextures = false;
+			for (size_t i = 0; i < imported.size(); i++) {
+				shared[i] = AssetRegistry::FindTexture(imported[i].path, imported[i].sRGB);
+				imported[i].skip = shared[i] != nullptr;
+				sharesTextures |= imported[i].skip;
+			}
+			//images are decoded by Step() once the geometry is in, within options.decodeBudget
+			importer.ProcessMeshes(options, instance->workers);
+			if (!cancelRequested) {
+				buildMipChains = options.useCache;
+				//skipped images would be missing from the cache. the meshes go in now, each mip chain once it is decoded
+				std::vector<ImportedMesh>& processed = importer.GetMeshes();
+				if (options.useCache && sourceHash != 0 && !sharesTextures && cache.Open(cachePath, processed.size(), imported, importer.GetDependencies())) {
+					cache.WriteMeshes(processed);
+				}
+				meshes = std::move(processed);
+				report = importer.GetReport();
+				meshletCount = importer.GetMeshletCount();
+				lodCount = importer.GetLodCount();
+				for (size_t i = 0; i < imported.size(); i++) {
+					ImportedTexture& source = imported[i];
+					PendingTexture texture;
+					texture.path = source.path;
+					texture.sRGB = source.sRGB;
+					texture.shared = shared[i];
+					if (texture.shared != nullptr) {
+						textures.push_back(std::move(texture));
+						continue;
+					}
+					texture.imported = &source;
+					texture.decode = true;
+					//from the image header, 0 when it can't be read and the decode reports it
+					texture.size = importer.GetDecodedSize(i, buildMipChains);
+					textureBytes += texture.size;
+					textures.push_back(std::move(texture));
+				}
+			}
+		}
+	}
+	catch (const std::exception& e) {
+		error = e.what();
+	}
+	cpuFinished = true;
+}
+
+bool ModelLoadHandle::Step() {
+	UploadScheduler& scheduler = Renderer::GetInstance()->uploadScheduler;
+	if (priorityChanged.exchange(false)) {
+		for (uint64_t id : jobs) scheduler.SetPriority(id, priority);
+	}
+	if (cancelRequested || model == nullptr) {
+		//queued jobs are dropped, recorded ones still complete. the worker job still uses the importer
+		for (uint64_t id : jobs) {
+			if (scheduler.Cancel(id)) pendingJobs--;
+		}
+		jobs.clear();
+		//running decodes still write into the import
+		for (size_t i = 0; i < decodes.size();) {
+			if (decodes[i].job.wait_for(std::chrono::seconds(0)) == std::future_status::ready) decodes.erase(decodes.begin() + i);
+			else i++;
+		}
+		if (!cpuFinished || pendingJobs > 0 || !decodes.empty()) return true;
+		Finish(ModelLoadState::Cancelled);
+		return false;
+	}
+	if (state == ModelLoadState::Importing) {
+		if (!cpuFinished) return true;
+		if (error.empty()) {
+			try {
+				ScheduleGeometry();
+				return true;
+			}
+			catch (const std::exception& e) {
+				error = e.what();
+			}
+		}
+		Finish(ModelLoadState::Failed);
+		return false;
+	}
+	//the geometry job failed
+	if (!error.empty()) {
+		if (pendingJobs > 0) return true;
+		Finish(ModelLoadState::Failed);
+		return false;
+	}
+	if (state == ModelLoadState::Streaming) StepDecodes();
+	if (pendingJobs > 0 || !decodes.empty() || nextDecode < textures.size()) return true;
+	Finish(ModelLoadState::Ready);
+	return false;
+}
+
+void ModelLoadHandle::ScheduleGeometry() {
+	building = std::make_unique<Model>();
+	building->SetVertexFormat(options.vertexFormat);
+	building->optimizeReport = report;
+	building->meshletCount = meshletCount;
+	building->lodCount = lodCount;
+	//every mesh draws untextured until its textures arrive
+	UploadJob job;
+	uint32_t vertexStride = GetPositionStride(options.vertexFormat) + GetAttributeStride(options.vertexFormat);
+	materials.reserve(meshes.size());
+	for (auto& mesh : meshes) {
+		job.bytes += mesh.vertices.size() * vertexStride + mesh.indices.size() * sizeof(uint32_t);
+		materials.push_back(mesh.material);
+		building->AddImportedMesh(std::move(mesh), Material{});
+	}
+	meshes.clear();
+	textureMap.assign(textures.size(), -1);
+	std::shared_ptr<ModelLoadHandle> self = shared_from_this();
+	job.priority = priority;
+	job.record = [self](UploadBatch& batch) { self->building->UploadGeometry(&batch); };
+	job.complete = [self]() { self->OnGeometryReady(); };
+	job.fail = [self](const std::string& message) {
+		//the model keeps its previous content, Step() fails the load
+		self->pendingJobs--;
+		self->building.reset();
+		self->error = message;
+	};
+	jobs.push_back(Renderer::GetInstance()->uploadScheduler.Schedule(std::move(job)));
+	pendingJobs++;
+	state = ModelLoadState::Uploading;
+}
+
+void ModelLoadHandle::OnGeometryReady() {
+	pendingJobs--;
+	if (model == nullptr || cancelRequested) {
+		//whatever was uploaded goes to the deletion queue
+		building.reset();
+		return;
+	}
+	//the new geometry replaces the model's content, the old one is released after the frames drawing it
+	std::shared_ptr<ModelLoadHandle> keep = std::move(model->pendingLoad);
+	glm::vec3 position = model->position;
+	*model = std::move(*building);
+	model->position = position;
+	model->pendingLoad = std::move(keep);
+	building.reset();
+	size_t freed = model->ApplyRetention(options.retention);
+	if (freed > 0) {
+		printf("Released %.2f MB of cpu geometry of %s\n", freed / (1024.0 * 1024.0), fileName.c_str());
+	}
+	state = ModelLoadState::Streaming;
+	ScheduleTextures();
+}
+
+void ModelLoadHandle::ScheduleTextures() {
+	jobs.clear();
+	for (size_t i = 0; i < textures.size(); i++) {
+		const PendingTexture& source = textures[i];
+		if (source.shared != nullptr) {
+			AttachTexture(i, source.shared);
+			continue;
+		}
+		//images of a fresh import are scheduled once StepDecodes() has them
+		if (!source.decode) ScheduleTexture(i);
+	}
+	StepDecodes();
+}
+
+void ModelLoadHandle::ScheduleTexture(size_t index) {
+	std::shared_ptr<ModelLoadHandle> self = shared_from_this();
+	const PendingTexture& source = textures[index];
+	auto onReady = [self, index](Texture&& texture) { self->OnTextureReady(index, std::move(texture)); };
+	auto onFailed = [self, index](const std::string& message) { self->OnTextureFailed(index, message); };
+	if (source.mipChain != nullptr) {
+		jobs.push_back(Texture::ScheduleMipChain(source.path, source.mipChain, source.width, source.height, source.mipLevels, source.encoding, source.sRGB, priority, onReady, onFailed));
+	}
+	else {
+		jobs.push_back(Texture::ScheduleUpload(source.path, &source.imported->image, source.sRGB, source.imported->genMipmap, priority, onReady, onFailed));
+	}
+	pendingJobs++;
+}
+
+void ModelLoadHandle::StepDecodes() {
+	for (size_t i = 0; i < decodes.size();) {
+		if (decodes[i].job.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			i++;
+			continue;
+		}
+		size_t index = decodes[i].index;
+		std::future<void> job = std::move(decodes[i].job);
+		decodes.erase(decodes.begin() + i);
+		try {
+			job.get();
+			OnDecoded(index);
+		}
+		catch (const std::exception& e) {
+			//the meshes draw without this image, the cache would miss it
+			printf("Fail to decode %s : %s\n", textures[index].path.c_str(), e.what());
+			ReleaseDecoded(index);
+			cache.Abandon();
+		}
+	}
+	//decodes start in import order while the decoded bytes not uploaded yet fit the budget, at least one at a time
+	std::shared_ptr<ModelLoadHandle> self = shared_from_this();
+	for (; nextDecode < textures.size(); nextDecode++) {
+		const PendingTexture& texture = textures[nextDecode];
+		if (!texture.decode) continue;
+		if (heldBytes > 0 && heldBytes + texture.size > options.decodeBudget) break;
+		heldBytes += texture.size;
+		Decode decode;
+		decode.index = nextDecode;
+		decode.job = Renderer::GetInstance()->workers.Submit([self, index = nextDecode]() {
+			self->importer.DecodeTexture(index, self->buildMipChains);
+			//written before the upload frees it, a no-op once the cache is abandoned
+			self->cache.WriteTexture(index, self->importer.GetTextures()[index]);
+		});
+		decodes.push_back(std::move(decode));
+	}
+	if (nextDecode == textures.size() && decodes.empty() && cache.IsOpen()) {
+		uint64_t written = cache.Finish(sourceHash, optionsHash);
+		if (written > 0) printf("Wrote model cache %s (%.2f MB)\n", ModelCache::GetCachePath(fileName, options).c_str(), written / (1024.0 * 1024.0));
+		else printf("Fail to write model cache %s\n", ModelCache::GetCachePath(fileName, options).c_str());
+	}
+}
+
+void ModelLoadHandle::OnDecoded(size_t index) {
+	PendingTexture& texture = textures[index];
+	const ImportedTexture& source = *texture.imported;
+	texture.contentHash = source.contentHash;
+	texture.width = source.image.width;
+	texture.height = source.image.height;
+	//ktx2 / dds files are read as a chain in their own encoding
+	if (buildMipChains || source.prebaked) {
+		texture.mipChain = source.mipChain.data();
+		texture.mipLevels = source.mipLevels;
+		texture.encoding = source.encoding;
+	}
+	//the same image under another name
+	texture.shared = AssetRegistry::FindTexture(texture.contentHash, texture.sRGB);
+	if (texture.shared != nullptr) {
+		ReleaseDecoded(index);
+		uploadedBytes += texture.size;
+		AttachTexture(index, texture.shared);
+		return;
+	}
+	ScheduleTexture(index);
+}
+
+void ModelLoadHandle::ReleaseDecoded(size_t index) {
+	PendingTexture& source = textures[index];
+	if (!source.decoded.empty()) {
+		std::vector<uint8_t>().swap(source.decoded);
+		source.mipChain = nullptr;
+	}
+	if (source.imported == nullptr) return;
+	source.imported->image = DecodedImage{};
+	std::vector<uint8_t>().swap(source.imported->mipChain);
+	source.imported = nullptr;
+	source.mipChain = nullptr;
+	if (source.decode) heldBytes -= source.size;
+}
+
+void ModelLoadHandle::OnTextureReady(size_t index, Texture&& texture) {
+	pendingJobs--;
+	PendingTexture& source = textures[index];
+	//the pixels are on the gpu now, the next decodes may start
+	ReleaseDecoded(index);
+	uploadedBytes += source.size;
+	if (model == nullptr) return;
+	std::shared_ptr<Texture> uploaded = std::make_shared<Texture>(std::move(texture));
+	AssetRegistry::AddTexture(source.path, source.contentHash, source.sRGB, uploaded);
+	AttachTexture(index, std::move(uploaded));
+}
+
+void ModelLoadHandle::OnTextureFailed(size_t index, const std::string& message) {
+	pendingJobs--;
+	PendingTexture& source = textures[index];
+	//like a failed decode, the meshes draw without this image
+	printf("Fail to upload %s : %s\n", source.path.c_str(), message.c_str());
+	ReleaseDecoded(index);
+	uploadedBytes += source.size;
+}
+
+void ModelLoadHandle::AttachTexture(size_t index, std::shared_ptr<Texture> texture) {
+	textureMap[index] = static_cast<int>(model->texture_loaded.size());
+	model->texture_loaded.push_back(std::move(texture));
+	//meshes pick up the texture, the rest of their slots stay unset
+	for (size_t i = 0; i < materials.size() && i < model->meshes.size(); i++) {
+		model->meshes[i].material = Model::RemapMaterial(materials[i], textureMap);
+	}
+}
+
+void ModelLoadHandle::Finish(ModelLoadState result) {
+	state = result;
+	if (result == ModelLoadState::Ready && model != nullptr) {
+		model->RegisterMeshSet(fileName, sourceHash, AssetRegistry::HashMeshOptions(options));
+	}
+	switch (result)
+	{
+	case ModelLoadState::Ready:		printf("Streamed %s, %zu textures (%.2f MB)\n", fileName.c_str(), textures.size(), textureBytes / (1024.0 * 1024.0)); break;
+	case ModelLoadState::Failed:	printf("Fail to load %s : %s\n", fileName.c_str(), error.c_str()); break;
+	default:						printf("Cancelled loading %s\n", fileName.c_str()); break;
+	}
+	building.reset();
+	jobs.clear();
+	cache.Abandon();
+	std::vector<ImportedMesh>().swap(meshes);
+	std::vector<PendingTexture>().swap(textures);
+	reader.Close();
+	if (model != nullptr && model->pendingLoad.get() == this) {
+		//the frame task still holds the handle
+		model->pendingLoad.reset();
+	}
+}
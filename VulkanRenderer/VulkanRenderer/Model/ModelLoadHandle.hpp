@@ -0,0 +1,121 @@
+#pragma once
+#ifndef MODEL_LOAD_HANDLE_HPP
+#define MODEL_LOAD_HANDLE_HPP
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <future>
+#include "Texture.hpp"
+#include "ModelImporter.hpp"
+#include "ModelCache.hpp"
+class Model;
+
+enum class ModelLoadState {
+	Importing,	//cpu work on the workers, the model still draws its previous content
+	Uploading,	//geometry copy queued or in flight
+	Streaming,	//the model draws the new meshes, textures arrive over the next frames
+	Ready,
+	Failed,
+	Cancelled
+};
+
+// Progress of one Model::LoadModelAsync().
+// the import or cache read runs as one job on Renderer::workers, the gpu half goes through Renderer::uploadScheduler :
+// the geometry goes first and replaces the model's content once its copy has completed, then every texture is its own
+// job. images of a fresh import are decoded on the workers meanwhile, at most options.decodeBudget bytes of them
+// waiting for their upload at once, and streamed into the cache as they come. until a texture is in, the material
+// slots using it stay unset and the meshes draw with the shaders' untextured fallback. nothing waits on the gpu.
+class ModelLoadHandle : public std::enable_shared_from_this<ModelLoadHandle> {
+public:
+	ModelLoadHandle(const std::string& fn, const ModelLoadOptions& options, UploadPriority priority);
+	ModelLoadHandle(const ModelLoadHandle&) = delete;
+	ModelLoadHandle& operator=(const ModelLoadHandle&) = delete;
+
+	ModelLoadState GetState() const { return state; }
+	//Ready, Failed or Cancelled
+	bool IsDone() const;
+	//0 ~ 1, the import makes the first half, geometry, texture decodes and uploads the second
+	float GetProgress() const;
+	//stops at the next step. geometry or textures already in the model stay, the rest is dropped
+	void Cancel() { cancelRequested = true; }
+	//upload jobs not recorded yet move to the new priority, e.g. Visible once the model comes into view
+	void SetPriority(UploadPriority _priority) { priority = _priority; priorityChanged = true; }
+	const std::string& GetFileName() const { return fileName; }
+	//reason of Failed, read it once IsDone()
+	const std::string& GetError() const { return error; }
+private:
+	friend class Model;
+	//one image to upload : a finished mip chain (cache, bundle or built by the import) or a decoded image mipmapped on the gpu
+	struct PendingTexture {
+		std::string path;
+		bool sRGB = false;
+		ImportedTexture* imported = nullptr;	//import results, released once uploaded
+		bool decode = false;					//imported is decoded by StepDecodes()
+		const uint8_t* mipChain = nullptr;		//nullptr -> imported->image, mipmapped with blits
+		std::vector<uint8_t> decoded;			//rgba8 chain of a cache / bundle payload the device can't sample
+		uint32_t width = 0, height = 0, mipLevels = 1;
+		TextureEncoding encoding = TextureEncoding::RGBA8;
+		uint64_t size = 0;						//estimated from the header until decoded
+		uint64_t contentHash = 0;
+		std::shared_ptr<Texture> shared;		//already on the gpu for another model (AssetRegistry), nothing to upload
+	};
+	std::string fileName;
+	ModelLoadOptions options;
+	Model* model = nullptr;		//target, kept up to date when the model moves, nullptr once it is cleaned
+	std::atomic<ModelLoadState> state{ ModelLoadState::Importing };
+	std::atomic<bool> cancelRequested{ false };
+	std::atomic<bool> cpuFinished{ false };
+	std::atomic<UploadPriority> priority;
+	std::atomic<bool> priorityChanged{ false };
+	std::string error;
+
+	//cpu results, owned here until the upload is done
+	ModelImporter importer;
+	ModelCache::Reader reader;
+	std::vector<ImportedMesh> meshes;		//material texture indices into textures
+	std::vector<PendingTexture> textures;
+	uint64_t textureBytes = 0;
+	uint64_t sourceHash = 0;
+	uint64_t optionsHash = 0;
+	bool buildMipChains = false;			//rgba8 chains on the cpu for the cache
+	ModelCache::StreamWriter cache;			//open while a fresh import writes its cache
+	MeshOptimizer::Report report;
+	size_t meshletCount = 0;
+	size_t lodCount = 0;
+
+	//gpu steps, render thread only
+	std::unique_ptr<Model> building;		//geometry until its copy has completed
+	std::vector<Material> materials;		//per mesh, indices into textures
+	std::vector<int> textureMap;			//textures index -> model texture index, -1 until uploaded
+	std::vector<uint64_t> jobs;				//upload scheduler ids
+	size_t pendingJobs = 0;					//scheduled and not completed
+	struct Decode {
+		size_t index = 0;
+		std::future<void> job;
+	};
+	std::vector<Decode> decodes;			//running on the workers
+	size_t nextDecode = 0;					//textures before it are decoded or decoding
+	uint64_t heldBytes = 0;					//decoding or decoded and not uploaded yet, kept within options.decodeBudget
+	std::atomic<uint64_t> uploadedBytes{ 0 };
+
+	//worker job
+	void Import();
+	//frame task, false once the load is done
+	bool Step();
+	void ScheduleGeometry();
+	void OnGeometryReady();
+	void ScheduleTextures();
+	void ScheduleTexture(size_t index);
+	//collects finished decodes and starts new ones within the budget, finishes the cache after the last one
+	void StepDecodes();
+	void OnDecoded(size_t index);
+	//frees the decoded pixels of textures[index]
+	void ReleaseDecoded(size_t index);
+	void OnTextureReady(size_t index, Texture&& texture);
+	void OnTextureFailed(size_t index, const std::string& message);
+	void AttachTexture(size_t index, std::shared_ptr<Texture> texture);
+	void Finish(ModelLoadState result);
+};
+
+#endif // !MODEL_LOAD_HANDLE_HPP
@@ -0,0 +1,287 @@
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "ObjLoader.hpp"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <streambuf>
+#include <istream>
+#include <stdexcept>
+
+namespace {
+	//smaller files are not worth splitting
+	constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+
+	std::string GetDirectory(const std::string& fn) {
+		size_t slash = fn.find_last_of('/');
+		return slash == std::string::npos ? "" : fn.substr(0, slash + 1);
+	}
+	//istream over a range of the mapped file, tiny_obj_loader reads it without a copy
+	class MemoryBuffer : public std::streambuf {
+	public:
+		MemoryBuffer(const char* begin, const char* end) {
+			setg(const_cast<char*>(begin), const_cast<char*>(begin), const_cast<char*>(end));
+		}
+	};
+	//mtllib lines are only recorded, the libraries are read once after the merge
+	class LibraryRecorder : public tinyobj::MaterialReader {
+	public:
+		explicit LibraryRecorder(std::vector<std::string>& _libraries) :libraries(_libraries) {}
+		bool operator()(const std::string& matId, std::vector<tinyobj::material_t>*, std::map<std::string, int>*, std::string*, std::string*) override {
+			if (std::find(libraries.begin(), libraries.end(), matId) == libraries.end()) libraries.push_back(matId);
+			return false;
+		}
+	private:
+		std::vector<std::string>& libraries;
+	};
+}
+
+bool ObjLoader::IsObj(const std::string& fn) {
+	size_t dot = fn.find_last_of('.');
+	if (dot == std::string::npos) return false;
+	std::string extension = fn.substr(dot);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+	return extension == ".obj";
+}
+
+bool ObjLoader::Open(const std::string& fn, ThreadPool& workers) {
+	fileName = fn;
+	chunks.clear();
+	meshes.clear();
+	materials.clear();
+	materialMap.clear();
+	if (!file.Open(fn)) return Fail("can't map the file");
+	const char* data = reinterpret_cast<const char*>(file.GetData());
+	size_t size = file.GetSize();
+	//a few chunks per thread so a slow chunk doesn't hold the others up, every chunk ends after a newline
+	size_t chunkCount = std::max<size_t>(1, std::min<size_t>(size / MIN_CHUNK_SIZE, (workers.GetThreadCount() + 1) * 4));
+	chunks.resize(chunkCount);
+	const char* begin = data;
+	for (size_t i = 0; i < chunkCount; i++) {
+		const char* end = data + size;
+		if (i + 1 < chunkCount) {
+			end = std::max(begin, data + size / chunkCount * (i + 1));
+			const char* newline = static_cast<const char*>(memchr(end, '\n', data + size - end));
+			end = newline != nullptr ? newline + 1 : data + size;
+		}
+		chunks[i].begin = begin;
+		chunks[i].end = end;
+		begin = end;
+	}
+	workers.ParallelFor(chunks.size(), [&](size_t i) { ParseChunk(chunks[i]); });
+
+	//file order indices : every chunk starts where the earlier ones end
+	size_t positionCount = 0, normalCount = 0, texCoordCount = 0;
+	for (auto& chunk : chunks) {
+		chunk.positionBase = positionCount;
+		chunk.normalBase = normalCount;
+		chunk.texCoordBase = texCoordCount;
+		positionCount += chunk.positions.size() / 3;
+		normalCount += chunk.normals.size() / 3;
+		texCoordCount += chunk.texCoords.size() / 2;
+	}
+	positions.resize(positionCount * 3);
+	normals.resize(normalCount * 3);
+	texCoords.resize(texCoordCount * 2);
+	workers.ParallelFor(chunks.size(), [&](size_t i) {
+		Chunk& chunk = chunks[i];
+		std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionBase * 3);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalBase * 3);
+		std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + chunk.texCoordBase * 2);
+		std::vector<float>().swap(chunk.positions);
+		std::vector<float>().swap(chunk.normals);
+		std::vector<float>().swap(chunk.texCoords);
+		//relative indices were resolved against the chunk, move them to file order
+		const size_t bases[3] = { chunk.positionBase, chunk.texCoordBase, chunk.normalBase };
+		for (uint64_t slot : chunk.relative) {
+			int32_t& index = chunk.corners[slot / 3].index[slot % 3];
+			index = static_cast<int32_t>(static_cast<int64_t>(bases[slot % 3]) + index);
+		}
+	});
+	LoadMaterials();
+	BuildMeshes();
+	printf("Parsed %s in %zu chunks : %zu positions, %zu meshes\n", fn.c_str(), chunks.size(), positionCount, meshes.size());
+	return true;
+}
+
+void ObjLoader::ParseChunk(Chunk& chunk) {
+	struct State {
+		Chunk* chunk;
+		std::vector<Corner> polygon;
+		std::vector<uint8_t> polygonRelative;	//bit k set -> index[k] is chunk relative
+	} state{ &chunk, {}, {} };
+	chunk.segments.emplace_back();
+
+	tinyobj::callback_t callback;
+	callback.vertex_cb = [](void* user, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z, tinyobj::real_t) {
+		std::vector<float>& out = static_cast<State*>(user)->chunk->positions;
+		out.push_back(x);
+		out.push_back(y);
+		out.push_back(z);
+	};
+	callback.normal_cb = [](void* user, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z) {
+		std::vector<float>& out = static_cast<State*>(user)->chunk->normals;
+		out.push_back(x);
+		out.push_back(y);
+		out.push_back(z);
+	};
+	callback.texcoord_cb = [](void* user, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t) {
+		std::vector<float>& out = static_cast<State*>(user)->chunk->texCoords;
+		out.push_back(x);
+		out.push_back(y);
+	};
+	callback.index_cb = [](void* user, tinyobj::index_t* indices, int count) {
+		State& s = *static_cast<State*>(user);
+		Chunk& c = *s.chunk;
+		if (count < 3) return;
+		const size_t counts[3] = { c.positions.size() / 3, c.texCoords.size() / 2, c.normals.size() / 3 };
+		s.polygon.resize(count);
+		s.polygonRelative.assign(count, 0);
+		for (int i = 0; i < count; i++) {
+			const int raw[3] = { indices[i].vertex_index, indices[i].texcoord_index, indices[i].normal_index };
+			for (int k = 0; k < 3; k++) {
+				//obj indices are 1 based, negative ones count back from the last element read
+				if (raw[k] > 0) s.polygon[i].index[k] = raw[k] - 1;
+				else if (raw[k] == 0) s.polygon[i].index[k] = -1;
+				else {
+					s.polygon[i].index[k] = static_cast<int32_t>(static_cast<int64_t>(counts[k]) + raw[k]);
+					s.polygonRelative[i] |= 1 << k;
+				}
+			}
+		}
+		//fan
+		for (int i = 2; i < count; i++) {
+			const int corners[3] = { 0, i - 1, i };
+			for (int corner : corners) {
+				for (int k = 0; k < 3; k++) {
+					if (s.polygonRelative[corner] & (1 << k)) c.relative.push_back(c.corners.size() * 3 + k);
+				}
+				c.corners.push_back(s.polygon[corner]);
+			}
+		}
+	};
+	callback.usemtl_cb = [](void* user, const char* name, int) {
+		Chunk& c = *static_cast<State*>(user)->chunk;
+		Segment& segment = BeginSegment(c);
+		segment.setsMaterial = true;
+		segment.material = name;
+	};
+	callback.group_cb = [](void* user, const char** names, int count) {
+		Chunk& c = *static_cast<State*>(user)->chunk;
+		Segment& segment = BeginSegment(c);
+		segment.setsObject = true;
+		segment.object = "g";
+		for (int i = 0; i < count; i++) segment.object += std::string(" ") + names[i];
+	};
+	callback.object_cb = [](void* user, const char* name) {
+		Chunk& c = *static_cast<State*>(user)->chunk;
+		Segment& segment = BeginSegment(c);
+		segment.setsObject = true;
+		segment.object = std::string("o ") + name;
+	};
+	MemoryBuffer buffer(chunk.begin, chunk.end);
+	std::istream stream(&buffer);
+	LibraryRecorder libraries(chunk.materialLibraries);
+	tinyobj::LoadObjWithCallback(stream, callback, &state, &libraries);
+}
+
+ObjLoader::Segment& ObjLoader::BeginSegment(Chunk& chunk) {
+	//state changes before the first face of a segment fold into it
+	size_t triangle = chunk.corners.size() / 3;
+	if (chunk.segments.back().firstTriangle != triangle) {
+		chunk.segments.emplace_back();
+		chunk.segments.back().firstTriangle = triangle;
+	}
+	return chunk.segments.back();
+}
+
+void ObjLoader::LoadMaterials() {
+	std::string directory = GetDirectory(fileName);
+	tinyobj::MaterialFileReader reader(directory);
+	std::vector<std::string> loaded;
+	for (const auto& chunk : chunks) {
+		for (const auto& library : chunk.materialLibraries) {
+			if (std::find(loaded.begin(), loaded.end(), library) != loaded.end()) continue;
+			loaded.push_back(library);
+			dependencies.push_back(directory + library);
+			std::string warn, err;
+			if (!reader(library, &materials, &materialMap, &warn, &err)) {
+				printf("Fail to load material library %s : %s\n", library.c_str(), err.c_str());
+			}
+		}
+	}
+}
+
+void ObjLoader::BuildMeshes() {
+	//walk the segments in file order, a new mesh starts whenever the object or the material changes
+	std::string object, material;
+	for (uint32_t c = 0; c < chunks.size(); c++) {
+		const Chunk& chunk = chunks[c];
+		size_t triangleCount = chunk.corners.size() / 3;
+		for (size_t s = 0; s < chunk.segments.size(); s++) {
+			const Segment& segment = chunk.segments[s];
+			if (segment.setsObject) object = segment.object;
+			if (segment.setsMaterial) material = segment.material;
+			size_t end = s + 1 < chunk.segments.size() ? chunk.segments[s + 1].firstTriangle : triangleCount;
+			if (end == segment.firstTriangle) continue;
+			if (meshes.empty() || meshes.back().object != object || meshes.back().materialName != material) {
+				meshes.emplace_back();
+				ObjMesh& mesh = meshes.back();
+				mesh.object = object;
+				mesh.materialName = material;
+				auto found = materialMap.find(material);
+				mesh.material = found != materialMap.end() ? found->second : -1;
+			}
+			ObjMesh& mesh = meshes.back();
+			mesh.ranges.push_back({ c, segment.firstTriangle, end - segment.firstTriangle });
+			mesh.triangleCount += end - segment.firstTriangle;
+		}
+	}
+}
+
+void ObjLoader::ConvertMesh(size_t index, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) const {
+	struct CornerHash {
+		size_t operator()(const Corner& corner) const {
+			uint64_t h = static_cast<uint32_t>(corner.index[0]);
+			h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(corner.index[1]);
+			h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(corner.index[2]);
+			return static_cast<size_t>(h ^ (h >> 29));
+		}
+	};
+	const ObjMesh& mesh = meshes[index];
+	const size_t positionCount = positions.size() / 3, texCoordCount = texCoords.size() / 2, normalCount = normals.size() / 3;
+	//one vertex per distinct index tuple, in first use order
+	std::unordered_map<Corner, unsigned int, CornerHash> vertexMap;
+	vertexMap.reserve(mesh.triangleCount);
+	vertices.clear();
+	vertices.reserve(mesh.triangleCount);
+	indices.resize(mesh.triangleCount * 3);
+	unsigned int* dst = indices.data();
+	for (const Range& range : mesh.ranges) {
+		const Corner* corners = chunks[range.chunk].corners.data() + range.firstTriangle * 3;
+		for (size_t i = 0; i < range.triangleCount * 3; i++) {
+			const Corner& corner = corners[i];
+			auto inserted = vertexMap.emplace(corner, static_cast<unsigned int>(vertices.size()));
+			if (inserted.second) {
+				int32_t p = corner.index[0], t = corner.index[1], n = corner.index[2];
+				//t and n may be -1 (missing), anything else out of range is a broken file
+				if (p < 0 || size_t(p) >= positionCount || t < -1 || size_t(t + 1) > texCoordCount || n < -1 || size_t(n + 1) > normalCount) {
+					throw std::runtime_error("failed to read obj face, index out of range!");
+				}
+				const float* position = &positions[size_t(p) * 3];
+				Vertex v;
+				v.position = glm::vec3(position[0], position[1], position[2]);
+				//faces without normals reuse the positions, the same as the assimp path
+				v.normal = n >= 0 ? glm::vec3(normals[size_t(n) * 3], normals[size_t(n) * 3 + 1], normals[size_t(n) * 3 + 2]) : v.position;
+				v.texCoords = t >= 0 ? glm::vec2(texCoords[size_t(t) * 2], texCoords[size_t(t) * 2 + 1]) : glm::vec2(0.0f);
+				vertices.push_back(v);
+			}
+			*dst++ = inserted.first->second;
+		}
+	}
+}
+
+bool ObjLoader::Fail(const std::string& reason) const {
+	printf("Can't read %s natively : %s\n", fileName.c_str(), reason.c_str());
+	return false;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#ifndef OBJ_LOADER_HPP
+#define OBJ_LOADER_HPP
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <tiny_obj_loader.h>
+#include "Geometry.hpp"
+#include "Tools/MappedFile.hpp"
+#include "Tools/ThreadPool.hpp"
+
+// Parallel .obj reader, used by ModelImporter instead of assimp for these files.
+// the mapped file is cut into line aligned chunks that tiny_obj_loader parses on the workers, the chunks are
+// merged in file order afterwards. a mesh is a run of faces with the same object / group and material,
+// the same split assimp's obj importer makes. polygons are fanned into triangles.
+class ObjLoader {
+public:
+	static bool IsObj(const std::string& fn);
+
+	//false when the file can't be read, the reason is printed
+	bool Open(const std::string& fn, ThreadPool& workers);
+
+	size_t GetMeshCount() const { return meshes.size(); }
+	//index into GetMaterials(), -1 = no material
+	int GetMeshMaterial(size_t mesh) const { return meshes[mesh].material; }
+	const std::vector<tinyobj::material_t>& GetMaterials() const { return materials; }
+	//material libraries the file names, read or missing
+	const std::vector<std::string>& GetDependencies() const { return dependencies; }
+	//thread safe. corners sharing a position / uv / normal index tuple become one vertex
+	void ConvertMesh(size_t mesh, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) const;
+private:
+	//one corner of a triangle : position, uv and normal index in file order, -1 = missing
+	struct Corner {
+		int32_t index[3];
+		bool operator==(const Corner& rhs) const { return index[0] == rhs.index[0] && index[1] == rhs.index[1] && index[2] == rhs.index[2]; }
+	};
+	//object / material state change inside a chunk, applies from firstTriangle on
+	struct Segment {
+		bool setsObject = false;
+		bool setsMaterial = false;
+		std::string object;
+		std::string material;
+		size_t firstTriangle = 0;
+	};
+	struct Chunk {
+		const char* begin = nullptr;
+		const char* end = nullptr;
+		std::vector<float> positions;	//xyz
+		std::vector<float> normals;		//xyz
+		std::vector<float> texCoords;	//uv
+		std::vector<Corner> corners;	//3 per triangle
+		std::vector<Segment> segments;	//the first one inherits the state of the previous chunk
+		std::vector<uint64_t> relative;	//corner * 3 + attribute of indices that are chunk relative until the merge
+		std::vector<std::string> materialLibraries;
+		size_t positionBase = 0, normalBase = 0, texCoordBase = 0;	//counts of every earlier chunk
+	};
+	struct Range {
+		uint32_t chunk;
+		size_t firstTriangle;
+		size_t triangleCount;
+	};
+	struct ObjMesh {
+		std::string object;
+		std::string materialName;
+		int material = -1;
+		std::vector<Range> ranges;
+		size_t triangleCount = 0;
+	};
+	std::string fileName;
+	MappedFile file;
+	std::vector<Chunk> chunks;
+	std::vector<float> positions, normals, texCoords;	//merged, file order
+	std::vector<ObjMesh> meshes;
+	std::vector<tinyobj::material_t> materials;
+	std::map<std::string, int> materialMap;
+	std::vector<std::string> dependencies;
+
+	static void ParseChunk(Chunk& chunk);
+	static Segment& BeginSegment(Chunk& chunk);
+	void LoadMaterials();
+	void BuildMeshes();
+	bool Fail(const std::string& reason) const;
+};
+
+#endif // !OBJ_LOADER_HPP
@@ -1,11 +1,6 @@
 #include "Texture.hpp";
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
 #include "Model/Model.hpp"
 void Texture::Show(VkCommandBuffer commandBuffer, uint32_t currentFrame, VkImageLayout imgeLayout, VkSampler sampler) {
-	if (PrimitiveMesh::quad.GetMeshCount() < 1) {
-		PrimitiveMesh::CreateQuad();
-	}
 	Renderer* instance = Renderer::GetInstance();
 	VkPipelineLayout pipelineLayout = instance->GetTextureDebugPipelineLayout();
 	VkPipeline pipeline = instance->GetTextureDebugPipeline();
@@ -18,6 +13,7 @@ void Texture::Show(VkCommandBuffer commandBuffer, uint32_t currentFrame, VkImage
 	VkDescriptorImageInfo imageInfo = Initializer::InitDescriptorImageInfo(imgeLayout, textureImageView, sampler);
 	VkWriteDescriptorSet write = Initializer::InitWriteDescriptorSet(descriptorSet, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, nullptr, &imageInfo);
 	vkUpdateDescriptorSets(instance->device, 1, &write, 0, nullptr);
+	lastUse.graphicsValue = instance->GetFrameTimelineValue();
 	PrimitiveMesh::RenderQuad(commandBuffer,glm::mat4(1),instance->GetTextureDebugPipelineLayout());
 }
 namespace Utils {
@@ -4,8 +4,15 @@
 #include<iostream>
 #include<stdexcept>
 #include<string>
-#include<stb_image.h>
+#include<utility>
+#include<vector>
+#include<memory>
+#include<functional>
+#include "DecodedImage.hpp"
+#include "TextureCompression.hpp"
+#include "TextureContainer.hpp"
 #include "Tools/Utils.hpp"
+#include "Tools/MappedFile.hpp"
 #include "Renderer.h"
 
 using namespace std;
@@ -16,21 +23,44 @@ struct Texture{
 	uint32_t mipLevels = 1;
 	VkImage textureImage = VK_NULL_HANDLE;
 	VkImageView textureImageView = VK_NULL_HANDLE;
-	VkDeviceMemory textureImageMemory = VK_NULL_HANDLE;
+	MemoryAllocation textureImageMemory;
+	TimelineTag lastUse;	//set by Model::Draw and Show(), Clean() retires the image with it
 	string path = "";
 public:
 	Texture(const string& _path) :path(_path) {};
 	Texture() {
 
 	}
+	//owns its image, move only
+	Texture(const Texture&) = delete;
+	Texture& operator=(const Texture&) = delete;
+	Texture(Texture&& rhs) noexcept { *this = std::move(rhs); }
+	Texture& operator=(Texture&& rhs) noexcept {
+		if (this == &rhs) return *this;
+		Clean();
+		textureSize = rhs.textureSize;
+		mipLevels = rhs.mipLevels;
+		textureImage = std::exchange(rhs.textureImage, VK_NULL_HANDLE);
+		textureImageView = std::exchange(rhs.textureImageView, VK_NULL_HANDLE);
+		textureImageMemory = std::exchange(rhs.textureImageMemory, MemoryAllocation{});
+		lastUse = rhs.lastUse;
+		path = std::move(rhs.path);
+		return *this;
+	}
+	~Texture() { Clean(); }
 
+	//does not wait for the gpu, the image is destroyed after the frames that may still sample it.
+	//safe to call more than once.
 	void Clean() {
+		if (textureImage == VK_NULL_HANDLE && textureImageView == VK_NULL_HANDLE) return;
 		Renderer* instance = Renderer::GetInstance();
-		vkDestroyImageView(instance->device, textureImageView, nullptr);
-		vkDestroyImage(instance->device, textureImage, nullptr);
-		vkFreeMemory(instance->device, textureImageMemory, nullptr);
+		//0 (never drawn) waits for everything submitted so far, uploads included. drawn images were uploaded before
+		instance->deletionQueue.PushImageView(textureImageView, lastUse.graphicsValue);
+		instance->deletionQueue.PushImage(textureImage, textureImageMemory, lastUse.graphicsValue);
+		lastUse = TimelineTag{};
 	}
-	void Create(float width, float height, VkFormat format, VkImageUsageFlags usages, VkImageAspectFlagBits flagBits, VkImageLayout nextLayout) {
+	//the layout transition goes through the upload context like every other upload, batch as in Load()
+	void Create(float width, float height, VkFormat format, VkImageUsageFlags usages, VkImageAspectFlagBits flagBits, VkImageLayout nextLayout, UploadBatch* batch = nullptr) {
 		textureSize.width = width;
 		textureSize.height = height;
 		if (textureImage != VK_NULL_HANDLE) {
@@ -42,69 +72,197 @@ public:
 			return;
 		}
 		VkImageCreateInfo imageInfo = Initializer::InitImageCreateInfo(VK_IMAGE_TYPE_2D, width, height, 1, 1, format, VK_IMAGE_TILING_OPTIMAL, usages);
-		Utils::CreateImage(instance->device, instance->physicalDevice, textureImage, textureImageMemory, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageInfo);
+		Utils::CreateImage(instance->device, instance->allocator, textureImage, textureImageMemory, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageInfo);
 		textureImageView = Utils::CreateImageView(instance->device, textureImage, format, VK_IMAGE_VIEW_TYPE_2D, flagBits);
-		Utils::transitionImageLayout(instance->device, instance->commandPool, instance->graphicsQueue, textureImage, format, VK_IMAGE_LAYOUT_UNDEFINED, nextLayout, 1);
+		UploadBatch ownBatch{};
+		UploadBatchGuard guard(instance->uploadContext, ownBatch);
+		if (batch == nullptr) {
+			ownBatch = instance->uploadContext.Begin();
+			batch = &ownBatch;
+		}
+		//attachment layouts need the graphics queue, nothing is copied so no ownership changes hands
+		Utils::CmdTransitionImageLayout(batch->graphicsCommandBuffer, textureImage, format, VK_IMAGE_LAYOUT_UNDEFINED, nextLayout, 1);
+		batch->commandCount++;
+		if (batch == &ownBatch) {
+			instance->uploadContext.Submit(ownBatch);
+		}
 	}
-	void Load(const string& fn, bool sRGB = false, bool isHdr = false, bool genMipmap = true, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL) {
-		Renderer* renderer = Renderer::GetInstance();
-		if (renderer == nullptr) {
-			std::cout << "renderer instance is nullptr! please create renderer instance  calling GetInstance(GlfwWindow, rendererCustomFuncs)!";
+	//batch != nullptr -> commands are recorded into it and run when the owner submits it.
+	//batch == nullptr -> the texture gets its own batch, submitted and waited once.
+	//.ktx2 / .dds files upload their stored encoding and mips (isHdr, genMipmap and tiling don't apply), everything else goes through stb
+	void Load(const string& fn, bool sRGB = false, bool isHdr = false, bool genMipmap = true, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL, UploadBatch* batch = nullptr) {
+		if (TextureContainer::IsContainer(fn)) {
+			LoadContainer(fn, sRGB, batch);
 			return;
 		}
-		void* buf = nullptr;
-		int width = 0, height = 0, nChannels = 0;
-		//4ä̹ ƴϸ 4äη   1äΰ 3ä STBI_rgb_alpha  Ǵµ 2ä  ߰
-		stbi_set_flip_vertically_on_load(true);
-		if (isHdr) {
-			buf = (float*)stbi_loadf(fn.c_str(), &width, &height, &nChannels, STBI_rgb_alpha);
-		}
-		else {
-			buf = (unsigned char*)stbi_load(fn.c_str(), &width, &height, &nChannels, STBI_rgb_alpha);
+		Upload(DecodedImage::Decode(fn, isHdr), sRGB, genMipmap, tiling, batch);
+	}
+	//_SRGB formats of the file are sampled as sRGB whatever sRGB says
+	void LoadContainer(const string& fn, bool sRGB = false, UploadBatch* batch = nullptr) {
+		MappedFile file;
+		if (!file.Open(fn)) {
+			throw std::runtime_error("failed to load texture image!");
 		}
-
-		if (buf) {
-			cout << fn << " image load success! width : " << width << " height : " << height << " channels : " << nChannels << std::endl;
+		ContainerImage image = TextureContainer::Parse(file.GetData(), file.GetSize(), fn);
+		std::vector<uint8_t> chain(static_cast<size_t>(TextureCompression::GetMipChainSize(image.encoding, image.width, image.height, image.mipLevels)));
+		if (!TextureContainer::CopyMipChain(image, chain.data())) {
+			printf("%s is stored top down and can't be flipped, it is sampled upside down\n", fn.c_str());
 		}
-		else {
-			throw std::runtime_error("failed to load texture image!");
+		printf("%s texture load success! width : %u height : %u levels : %u\n", fn.c_str(), image.width, image.height, image.mipLevels);
+		UploadMipChain(chain.data(), image.width, image.height, image.mipLevels, image.encoding, sRGB || image.sRGB, batch);
+	}
+	//gpu half of Load(), image is usually decoded on a worker thread
+	void Upload(const DecodedImage& image, bool sRGB = false, bool genMipmap = true, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL, UploadBatch* batch = nullptr) {
+		Renderer* renderer = Renderer::GetInstance();
+		if (renderer == nullptr) {
+			std::cout << "renderer instance is nullptr! please create renderer instance  calling GetInstance(GlfwWindow, rendererCustomFuncs)!";
+			return;
 		}
-		VkFormat format = GetTextureFormat(sRGB, isHdr, nChannels);
+		VkDeviceSize imageSize = image.GetSize();
+		//staging memory from the renderer's ring, stb owns its decode buffer so one copy is left
+		StagingRegion staging = renderer->uploadContext.AllocateStaging(imageSize, 16);
+		memcpy(staging.mapped, image.pixels, static_cast<size_t>(imageSize));
+		Upload(staging, image, sRGB, genMipmap, tiling, batch);
+	}
+	//Upload() of pixels somebody already wrote to staging, e.g. a worker decoding straight into it. only the size and
+	//channels of image are used. staging must come from the batch's recording, a submitted batch retires it
+	void Upload(const StagingRegion& staging, const DecodedImage& image, bool sRGB = false, bool genMipmap = true, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL, UploadBatch* batch = nullptr) {
+		Renderer* renderer = Renderer::GetInstance();
+		int width = image.width, height = image.height;
+		VkFormat format = GetTextureFormat(sRGB, image.isHdr, image.nChannels);
 		mipLevels = genMipmap ? static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1 : 1;
-		
-		VkDeviceSize imageSize = width * height * 4;
-		//staging buffer
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		Utils::CreateBuffer(renderer->device, renderer->physicalDevice, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-			stagingBuffer, stagingBufferMemory
-		);
-		void* data;
-		vkMapMemory(renderer->device, stagingBufferMemory, 0, imageSize, 0, &data);
-		memcpy(data, buf, static_cast<size_t>(imageSize));
-		vkUnmapMemory(renderer->device, stagingBufferMemory);
-		stbi_image_free(buf);
 		VkImageCreateInfo imageInfo = Initializer::InitImageCreateInfo(VK_IMAGE_TYPE_2D,static_cast<uint32_t>(width), static_cast<uint32_t>(height),1,mipLevels,format,tiling,
 			VK_IMAGE_USAGE_TRANSFER_SRC_BIT|VK_IMAGE_USAGE_TRANSFER_DST_BIT|VK_IMAGE_USAGE_SAMPLED_BIT);  //to generate mipmap add VK_IMAGE_USAGE_TRANSFER_SRC_BUT to usage flags
 		VkImageFormatProperties proper{};
 		VkResult result = vkGetPhysicalDeviceImageFormatProperties(renderer->physicalDevice, VK_FORMAT_R8G8_SRGB, VK_IMAGE_TYPE_2D, tiling, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 0, &proper);
-		Utils::CreateImage(renderer->device, renderer->physicalDevice, textureImage, textureImageMemory, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageInfo);
+		Utils::CreateImage(renderer->device, renderer->allocator, textureImage, textureImageMemory, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageInfo);
 		//to generate mipmap, change VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL.
-		Utils::transitionImageLayout(renderer->device, renderer->commandPool, renderer->graphicsQueue, textureImage, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
-		copyBufferToImage(renderer->device, renderer->commandPool, renderer->graphicsQueue, stagingBuffer, textureImage, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
-		generateMipmaps(renderer->device, renderer->commandPool, renderer->graphicsQueue, renderer->physicalDevice, textureImage, format, width, height, mipLevels);
-		vkDestroyBuffer(renderer->device, stagingBuffer, nullptr);
-		vkFreeMemory(renderer->device, stagingBufferMemory, nullptr);
+		UploadBatch ownBatch{};
+		UploadBatchGuard guard(renderer->uploadContext, ownBatch);
+		if (batch == nullptr) {
+			ownBatch = renderer->uploadContext.Begin();
+			batch = &ownBatch;
+		}
+		Utils::CmdTransitionImageLayout(batch->commandBuffer, textureImage, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+		copyBufferToImage(batch->commandBuffer, staging.buffer, staging.offset, textureImage, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+		//copies run on the transfer queue, blits need the graphics queue
+		renderer->uploadContext.TransferImageOwnership(*batch, textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels,
+			VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		generateMipmaps(batch->graphicsCommandBuffer, renderer->physicalDevice, textureImage, format, width, height, mipLevels);
+		batch->commandCount += 2 + mipLevels;
+		if (batch == &ownBatch) {
+			renderer->uploadContext.Submit(ownBatch);
+		}
 
 		//create texture image view
 		textureImageView = Utils::CreateImageView(renderer->device, textureImage, format, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
 	}
+	//uploads a mip chain built on the cpu (DecodedImage::BuildMipChain(), a model cache, a cooked bundle or a ktx2 / dds file), no blits.
+	//data is copied into staging right away, it only has to live for the call.
+	//encodings the device can't sample are decoded to rgba8 here, on the calling thread
+	void UploadMipChain(const void* data, uint32_t width, uint32_t height, uint32_t levels, TextureEncoding encoding, bool sRGB, UploadBatch* batch = nullptr) {
+		Renderer* renderer = Renderer::GetInstance();
+		if (renderer == nullptr) {
+			std::cout << "renderer instance is nullptr! please create renderer instance  calling GetInstance(GlfwWindow, rendererCustomFuncs)!";
+			return;
+		}
+		if ((GetSampledEncodings() & TextureCompression::GetEncodingBit(encoding)) == 0) {
+			std::vector<uint8_t> rgba(static_cast<size_t>(TextureCompression::GetMipChainSize(TextureEncoding::RGBA8, width, height, levels)));
+			TextureCompression::Decompress(static_cast<const uint8_t*>(data), width, height, levels, encoding, rgba.data());
+			UploadMipChain(rgba.data(), width, height, levels, TextureEncoding::RGBA8, sRGB, batch);
+			return;
+		}
+		VkDeviceSize imageSize = TextureCompression::GetMipChainSize(encoding, width, height, levels);
+		StagingRegion staging = renderer->uploadContext.AllocateStaging(imageSize, 16);
+		memcpy(staging.mapped, data, static_cast<size_t>(imageSize));
+		UploadMipChain(staging, width, height, levels, encoding, sRGB, batch);
+	}
+	//UploadMipChain() of a chain already in staging, same rules as the staged Upload()
+	void UploadMipChain(const StagingRegion& staging, uint32_t width, uint32_t height, uint32_t levels, TextureEncoding encoding, bool sRGB, UploadBatch* batch = nullptr) {
+		Renderer* renderer = Renderer::GetInstance();
+		if ((GetSampledEncodings() & TextureCompression::GetEncodingBit(encoding)) == 0) {
+			throw std::runtime_error("failed to upload texture, the device can't sample its compressed format!");
+		}
+		VkFormat format = GetTextureFormat(encoding, sRGB);
+		textureSize = { width, height };
+		mipLevels = levels;
+		VkImageCreateInfo imageInfo = Initializer::InitImageCreateInfo(VK_IMAGE_TYPE_2D, width, height, 1, mipLevels, format, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+		Utils::CreateImage(renderer->device, renderer->allocator, textureImage, textureImageMemory, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageInfo);
+		UploadBatch ownBatch{};
+		UploadBatchGuard guard(renderer->uploadContext, ownBatch);
+		if (batch == nullptr) {
+			ownBatch = renderer->uploadContext.Begin();
+			batch = &ownBatch;
+		}
+		Utils::CmdTransitionImageLayout(batch->commandBuffer, textureImage, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+		//every level in one copy command
+		std::vector<VkBufferImageCopy> regions(mipLevels);
+		VkDeviceSize offset = staging.offset;
+		uint32_t mipWidth = width, mipHeight = height;
+		for (uint32_t i = 0; i < mipLevels; i++) {
+			regions[i] = Initializer::InitBufferImageCopy(offset, 0, 0, VK_IMAGE_ASPECT_COLOR_BIT, { 0,0,0 }, { mipWidth, mipHeight, 1 }, i);
+			offset += TextureCompression::GetLevelSize(encoding, mipWidth, mipHeight);
+			mipWidth = std::max(mipWidth / 2, 1u);
+			mipHeight = std::max(mipHeight / 2, 1u);
+		}
+		vkCmdCopyBufferToImage(batch->commandBuffer, staging.buffer, textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, regions.data());
+		renderer->uploadContext.TransferImageOwnership(*batch, textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		Utils::CmdTransitionImageLayout(batch->graphicsCommandBuffer, textureImage, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+		batch->commandCount += 3;
+		if (batch == &ownBatch) {
+			renderer->uploadContext.Submit(ownBatch);
+		}
+		textureImageView = Utils::CreateImageView(renderer->device, textureImage, format, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+	}
+	//Upload() as a job of the renderer's upload scheduler : the copy and the mip blits are recorded within its frame budget.
+	//image must live until the job has been recorded, onReady gets the texture once the gpu has finished it,
+	//onFailed the error when the upload could not be recorded or submitted (the texture is released then). returns the job id
+	static uint64_t ScheduleUpload(const string& path, const DecodedImage* image, bool sRGB, bool genMipmap, UploadPriority priority, std::function<void(Texture&&)> onReady,
+		std::function<void(const std::string&)> onFailed = nullptr) {
+		std::shared_ptr<Texture> texture = std::make_shared<Texture>(path);
+		UploadJob job;
+		job.bytes = image->GetSize();
+		job.priority = priority;
+		job.record = [texture, image, sRGB, genMipmap](UploadBatch& batch) { texture->Upload(*image, sRGB, genMipmap, VK_IMAGE_TILING_OPTIMAL, &batch); };
+		job.complete = [texture, onReady]() { onReady(std::move(*texture)); };
+		job.fail = onFailed;
+		return Renderer::GetInstance()->uploadScheduler.Schedule(std::move(job));
+	}
+	//UploadMipChain() as a scheduler job, data must live until the job has been recorded. onReady / onFailed as ScheduleUpload().
+	//encoding should be one GetSampledEncodings() has, anything else is decoded inside the frame's upload budget
+	static uint64_t ScheduleMipChain(const string& path, const void* data, uint32_t width, uint32_t height, uint32_t levels, TextureEncoding encoding, bool sRGB,
+		UploadPriority priority, std::function<void(Texture&&)> onReady, std::function<void(const std::string&)> onFailed = nullptr) {
+		std::shared_ptr<Texture> texture = std::make_shared<Texture>(path);
+		UploadJob job;
+		job.bytes = TextureCompression::GetMipChainSize(encoding, width, height, levels);
+		job.priority = priority;
+		job.record = [texture, data, width, height, levels, encoding, sRGB](UploadBatch& batch) { texture->UploadMipChain(data, width, height, levels, encoding, sRGB, &batch); };
+		job.complete = [texture, onReady]() { onReady(std::move(*texture)); };
+		job.fail = onFailed;
+		return Renderer::GetInstance()->uploadScheduler.Schedule(std::move(job));
+	}
+	//encodings the device samples as they are, a mask of TextureCompression::GetEncodingBit()
+	static uint32_t GetSampledEncodings() {
+		const VkPhysicalDeviceFeatures& features = Renderer::GetInstance()->enabledFeatures;
+		uint32_t mask = TextureCompression::GetEncodingBit(TextureEncoding::RGBA8);
+		if (features.textureCompressionBC) {
+			for (TextureEncoding encoding : { TextureEncoding::BC1, TextureEncoding::BC3, TextureEncoding::BC4, TextureEncoding::BC5, TextureEncoding::BC7 }) {
+				mask |= TextureCompression::GetEncodingBit(encoding);
+			}
+		}
+		if (features.textureCompressionASTC_LDR) {
+			for (TextureEncoding encoding : { TextureEncoding::ASTC4x4, TextureEncoding::ASTC6x6, TextureEncoding::ASTC8x8 }) {
+				mask |= TextureCompression::GetEncodingBit(encoding);
+			}
+		}
+		return mask;
+	}
 	void Show(VkCommandBuffer commandBuffer, uint32_t currentFrame, VkImageLayout imgeLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VkSampler sampler = VK_NULL_HANDLE);
 private:
-inline void copyBufferToImage(VkDevice device, VkCommandPool commandPool, VkQueue submitQueue, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t depth = 1) {
-		VkCommandBuffer commandbuffer = Utils::BeginSingleTimeCommand(device, commandPool);
-		VkBufferImageCopy region = Initializer::InitBufferImageCopy(0, 0, 0, VK_IMAGE_ASPECT_COLOR_BIT, { 0,0,0 }, { width,height,depth});
+inline void copyBufferToImage(VkCommandBuffer commandbuffer, VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width, uint32_t height, uint32_t depth = 1) {
+		VkBufferImageCopy region = Initializer::InitBufferImageCopy(bufferOffset, 0, 0, VK_IMAGE_ASPECT_COLOR_BIT, { 0,0,0 }, { width,height,depth});
 		vkCmdCopyBufferToImage(
 			commandbuffer,
 			buffer,
@@ -113,18 +271,15 @@ inline void copyBufferToImage(VkDevice device, VkCommandPool commandPool, VkQueu
 			1,
 			&region
 		);
-		Utils::EndSingleTimeCommand(device, commandPool, submitQueue, commandbuffer);
 	}
 
-inline void generateMipmaps(VkDevice device, VkCommandPool commandPool, VkQueue submitQueue, VkPhysicalDevice physicalDevice ,VkImage image, VkFormat imageFormat,int32_t width, int32_t height, uint32_t mipLevels) {
+inline void generateMipmaps(VkCommandBuffer commandBuffer, VkPhysicalDevice physicalDevice ,VkImage image, VkFormat imageFormat,int32_t width, int32_t height, uint32_t mipLevels) {
 	VkFormatProperties formatProperties;
 	vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat, &formatProperties);
 	if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
 		throw std::runtime_error("texture image format dose not support linear bliting!");
 		//other way is resizing the image using stb_image_resize.
 	}
-	VkCommandBuffer commandBuffer = Utils::BeginSingleTimeCommand(device, commandPool);
-
 	VkImageMemoryBarrier barrier = Initializer::InitImageMemoryBarrier(image,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,1);
 	int32_t mipWidth = width;
 	int32_t mipHeight = height;
@@ -172,7 +327,22 @@ inline void generateMipmaps(VkDevice device, VkCommandPool commandPool, VkQueue
 		0, nullptr,
 		1, &barrier
 	);
-	Utils::EndSingleTimeCommand(device, commandPool, submitQueue, commandBuffer);
+}
+
+//format of a stored mip chain. BC4 / BC5 have no sRGB formats, they hold data (roughness, normals)
+inline VkFormat GetTextureFormat(TextureEncoding encoding, bool sRGB) {
+	switch (encoding)
+	{
+	case TextureEncoding::BC1:		return sRGB ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	case TextureEncoding::BC3:		return sRGB ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+	case TextureEncoding::BC4:		return VK_FORMAT_BC4_UNORM_BLOCK;
+	case TextureEncoding::BC5:		return VK_FORMAT_BC5_UNORM_BLOCK;
+	case TextureEncoding::BC7:		return sRGB ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+	case TextureEncoding::ASTC4x4:	return sRGB ? VK_FORMAT_ASTC_4x4_SRGB_BLOCK : VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+	case TextureEncoding::ASTC6x6:	return sRGB ? VK_FORMAT_ASTC_6x6_SRGB_BLOCK : VK_FORMAT_ASTC_6x6_UNORM_BLOCK;
+	case TextureEncoding::ASTC8x8:	return sRGB ? VK_FORMAT_ASTC_8x8_SRGB_BLOCK : VK_FORMAT_ASTC_8x8_UNORM_BLOCK;
+	default:						return sRGB ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	}
 }
 
 inline VkFormat GetTextureFormat(bool sRGB, bool isHdr, int nChannels) {
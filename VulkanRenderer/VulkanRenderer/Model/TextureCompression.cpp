@@ -0,0 +1,505 @@
+#include "TextureCompression.hpp"
+#include "AstcDecoder.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <climits>
+#include <stdexcept>
+
+namespace {
+	uint16_t Pack565(const float c[3]) {
+		int r = std::min(std::max(static_cast<int>(c[0] * 31.0f / 255.0f + 0.5f), 0), 31);
+		int g = std::min(std::max(static_cast<int>(c[1] * 63.0f / 255.0f + 0.5f), 0), 63);
+		int b = std::min(std::max(static_cast<int>(c[2] * 31.0f / 255.0f + 0.5f), 0), 31);
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+	void Unpack565(uint16_t c, int out[3]) {
+		int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+		out[0] = (r << 3) | (r >> 2);
+		out[1] = (g << 2) | (g >> 4);
+		out[2] = (b << 3) | (b >> 2);
+	}
+	void WriteLE(uint8_t* dst, uint64_t value, int bytes) {
+		for (int i = 0; i < bytes; i++) dst[i] = static_cast<uint8_t>(value >> (8 * i));
+	}
+
+	//4 color BC1 block. endpoints are the extremes along the principal axis, inset a little
+	void EncodeColorBlock(const uint8_t texels[64], uint8_t out[8]) {
+		float mean[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; i++) {
+			for (int c = 0; c < 3; c++) mean[c] += texels[i * 4 + c];
+		}
+		for (int c = 0; c < 3; c++) mean[c] /= 16.0f;
+		float cov[6] = { 0, 0, 0, 0, 0, 0 };	// rr rg rb gg gb bb
+		for (int i = 0; i < 16; i++) {
+			float r = texels[i * 4] - mean[0], g = texels[i * 4 + 1] - mean[1], b = texels[i * 4 + 2] - mean[2];
+			cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+			cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+		}
+		float axis[3] = { 1, 1, 1 };
+		for (int iteration = 0; iteration < 4; iteration++) {
+			float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+			float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+			float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+			float length = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+			if (length <= 0.0f) break;
+			axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+		}
+		float minT = 1e30f, maxT = -1e30f;
+		for (int i = 0; i < 16; i++) {
+			float t = (texels[i * 4] - mean[0]) * axis[0] + (texels[i * 4 + 1] - mean[1]) * axis[1] + (texels[i * 4 + 2] - mean[2]) * axis[2];
+			minT = std::min(minT, t);
+			maxT = std::max(maxT, t);
+		}
+		float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+		if (axisLength2 > 0.0f) {
+			minT /= axisLength2;
+			maxT /= axisLength2;
+		}
+		float inset = (maxT - minT) / 16.0f;
+		float hi[3], lo[3];
+		for (int c = 0; c < 3; c++) {
+			hi[c] = mean[c] + axis[c] * (maxT - inset);
+			lo[c] = mean[c] + axis[c] * (minT + inset);
+		}
+		uint16_t c0 = Pack565(hi), c1 = Pack565(lo);
+		if (c0 < c1) std::swap(c0, c1);
+		uint32_t indices = 0;
+		//c0 == c1 would switch the block to 3 color mode, index 0 is the only color then
+		if (c0 != c1) {
+			int palette[4][3];
+			Unpack565(c0, palette[0]);
+			Unpack565(c1, palette[1]);
+			for (int c = 0; c < 3; c++) {
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			for (int i = 0; i < 16; i++) {
+				int best = 0, bestDistance = INT32_MAX;
+				for (int p = 0; p < 4; p++) {
+					int dr = texels[i * 4] - palette[p][0], dg = texels[i * 4 + 1] - palette[p][1], db = texels[i * 4 + 2] - palette[p][2];
+					int distance = dr * dr + dg * dg + db * db;
+					if (distance < bestDistance) {
+						bestDistance = distance;
+						best = p;
+					}
+				}
+				indices |= static_cast<uint32_t>(best) << (2 * i);
+			}
+		}
+		WriteLE(out, c0, 2);
+		WriteLE(out + 2, c1, 2);
+		WriteLE(out + 4, indices, 4);
+	}
+
+	//8 value alpha block (a0 > a1)
+	void EncodeAlphaBlock(const uint8_t texels[64], uint8_t out[8]) {
+		int a0 = 0, a1 = 255;
+		for (int i = 0; i < 16; i++) {
+			a0 = std::max(a0, static_cast<int>(texels[i * 4 + 3]));
+			a1 = std::min(a1, static_cast<int>(texels[i * 4 + 3]));
+		}
+		uint64_t indices = 0;
+		if (a0 != a1) {
+			int palette[8] = { a0, a1 };
+			for (int p = 1; p < 7; p++) palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+			for (int i = 0; i < 16; i++) {
+				int alpha = texels[i * 4 + 3];
+				int best = 0, bestDistance = 256;
+				for (int p = 0; p < 8; p++) {
+					int distance = std::abs(alpha - palette[p]);
+					if (distance < bestDistance) {
+						bestDistance = distance;
+						best = p;
+					}
+				}
+				indices |= static_cast<uint64_t>(best) << (3 * i);
+			}
+		}
+		out[0] = static_cast<uint8_t>(a0);
+		out[1] = static_cast<uint8_t>(a1);
+		WriteLE(out + 2, indices, 6);
+	}
+
+	uint64_t ReadLE(const uint8_t* src, int bytes) {
+		uint64_t value = 0;
+		for (int i = 0; i < bytes; i++) value |= static_cast<uint64_t>(src[i]) << (8 * i);
+		return value;
+	}
+
+	//BC1 color block -> 16 rgba texels. BC3 color blocks always use 4 colors
+	void DecodeColorBlock(const uint8_t block[8], bool alwaysFourColors, uint8_t texels[64]) {
+		uint16_t c0 = static_cast<uint16_t>(ReadLE(block, 2)), c1 = static_cast<uint16_t>(ReadLE(block + 2, 2));
+		int palette[4][3];
+		Unpack565(c0, palette[0]);
+		Unpack565(c1, palette[1]);
+		for (int c = 0; c < 3; c++) {
+			if (c0 > c1 || alwaysFourColors) {
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			else {
+				//3 color mode, the last index is black (opaque, the rgb format ignores the punch through alpha)
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+		uint32_t indices = static_cast<uint32_t>(ReadLE(block + 4, 4));
+		for (int i = 0; i < 16; i++) {
+			const int* color = palette[(indices >> (2 * i)) & 3];
+			texels[i * 4] = static_cast<uint8_t>(color[0]);
+			texels[i * 4 + 1] = static_cast<uint8_t>(color[1]);
+			texels[i * 4 + 2] = static_cast<uint8_t>(color[2]);
+			texels[i * 4 + 3] = 255;
+		}
+	}
+
+	//BC3 alpha / BC4 block -> channel of 16 rgba texels
+	void DecodeAlphaBlock(const uint8_t block[8], uint8_t texels[64], int channel) {
+		int a0 = block[0], a1 = block[1];
+		int palette[8] = { a0, a1 };
+		if (a0 > a1) {
+			for (int p = 1; p < 7; p++) palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+		}
+		else {
+			for (int p = 1; p < 5; p++) palette[p + 1] = ((5 - p) * a0 + p * a1) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+		uint64_t indices = ReadLE(block + 2, 6);
+		for (int i = 0; i < 16; i++) {
+			texels[i * 4 + channel] = static_cast<uint8_t>(palette[(indices >> (3 * i)) & 7]);
+		}
+	}
+
+	//BC7 : mode m starts with m zero bits and a one
+	struct Bc7Mode {
+		uint8_t subsets, partitionBits, rotationBits, selectorBits, colorBits, alphaBits, endpointPBits, sharedPBits, indexBits, index2Bits;
+	};
+	constexpr Bc7Mode BC7_MODES[8] = {
+		{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+		{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+		{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+		{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+		{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+		{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+		{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+		{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+	};
+	//subset of every texel, bit i of the 2 subset masks and bits 2i ~ 2i + 1 of the 3 subset ones
+	constexpr uint16_t BC7_PARTITIONS2[64] = {
+		0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+		0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+		0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+		0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+	};
+	constexpr uint32_t BC7_PARTITIONS3[64] = {
+		0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+		0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+		0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+		0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+		0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+		0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+		0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+		0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254
+	};
+	//texels whose index drops its top bit : 0 for subset 0, these for the others
+	constexpr uint8_t BC7_ANCHORS2[64] = {
+		15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+		15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6, 6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15
+	};
+	constexpr uint8_t BC7_ANCHORS3A[64] = {
+		3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3, 3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+		8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15, 3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3
+	};
+	constexpr uint8_t BC7_ANCHORS3B[64] = {
+		15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8, 15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+		15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8, 15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8
+	};
+	constexpr uint8_t BC7_WEIGHTS2[4] = { 0, 21, 43, 64 };
+	constexpr uint8_t BC7_WEIGHTS3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	constexpr uint8_t BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct BlockBits {
+		const uint8_t* data;
+		uint32_t position;
+		uint32_t Read(uint32_t count) {
+			uint32_t value = 0;
+			for (uint32_t i = 0; i < count; i++, position++) value |= ((data[position >> 3] >> (position & 7)) & 1u) << i;
+			return value;
+		}
+	};
+	int InterpolateBc7(int e0, int e1, uint32_t index, uint32_t bits) {
+		const uint8_t* weights = bits == 2 ? BC7_WEIGHTS2 : bits == 3 ? BC7_WEIGHTS3 : BC7_WEIGHTS4;
+		return ((64 - weights[index]) * e0 + weights[index] * e1 + 32) >> 6;
+	}
+
+	//BC7 block -> 16 rgba texels, the reserved mode decodes to transparent black
+	void DecodeBc7Block(const uint8_t block[16], uint8_t texels[64]) {
+		uint32_t mode = 0;
+		while (mode < 8 && (block[0] & (1u << mode)) == 0) mode++;
+		if (mode == 8) {
+			memset(texels, 0, 64);
+			return;
+		}
+		const Bc7Mode& m = BC7_MODES[mode];
+		BlockBits bits{ block, mode + 1 };
+		uint32_t partition = bits.Read(m.partitionBits);
+		uint32_t rotation = bits.Read(m.rotationBits);
+		uint32_t selector = bits.Read(m.selectorBits);
+		//[subset][endpoint][channel], r g b for every subset then alpha
+		int endpoints[3][2][4] = {};
+		for (int c = 0; c < 4; c++) {
+			uint32_t channelBits = c < 3 ? m.colorBits : m.alphaBits;
+			for (uint32_t s = 0; s < m.subsets; s++) {
+				for (int e = 0; e < 2; e++) endpoints[s][e][c] = static_cast<int>(bits.Read(channelBits));
+			}
+		}
+		uint32_t precision[4] = { m.colorBits, m.colorBits, m.colorBits, m.alphaBits };
+		if (m.endpointPBits || m.sharedPBits) {
+			int pbits[3][2];
+			for (uint32_t s = 0; s < m.subsets; s++) {
+				if (m.endpointPBits) {
+					pbits[s][0] = static_cast<int>(bits.Read(1));
+					pbits[s][1] = static_cast<int>(bits.Read(1));
+				}
+				else {
+					pbits[s][0] = pbits[s][1] = static_cast<int>(bits.Read(1));
+				}
+			}
+			for (int c = 0; c < 4; c++) {
+				if (precision[c] == 0) continue;
+				for (uint32_t s = 0; s < m.subsets; s++) {
+					for (int e = 0; e < 2; e++) endpoints[s][e][c] = (endpoints[s][e][c] << 1) | pbits[s][e];
+				}
+				precision[c]++;
+			}
+		}
+		//expanded by repeating the top bits, modes without alpha are opaque
+		for (int c = 0; c < 4; c++) {
+			for (uint32_t s = 0; s < m.subsets; s++) {
+				for (int e = 0; e < 2; e++) {
+					int& v = endpoints[s][e][c];
+					v = precision[c] == 0 ? 255 : (v << (8 - precision[c])) | (v >> (2 * precision[c] - 8));
+				}
+			}
+		}
+		uint32_t subsets[16];
+		for (int i = 0; i < 16; i++) {
+			if (m.subsets == 1) subsets[i] = 0;
+			else if (m.subsets == 2) subsets[i] = (BC7_PARTITIONS2[partition] >> i) & 1;
+			else subsets[i] = (BC7_PARTITIONS3[partition] >> (2 * i)) & 3;
+		}
+		auto isAnchor = [&](uint32_t i) {
+			if (i == 0) return true;
+			if (m.subsets == 2) return i == BC7_ANCHORS2[partition];
+			return m.subsets == 3 && (i == BC7_ANCHORS3A[partition] || i == BC7_ANCHORS3B[partition]);
+		};
+		uint32_t indices[16], indices2[16] = {};
+		for (uint32_t i = 0; i < 16; i++) indices[i] = bits.Read(m.indexBits - (isAnchor(i) ? 1 : 0));
+		if (m.index2Bits) {
+			for (uint32_t i = 0; i < 16; i++) indices2[i] = bits.Read(m.index2Bits - (i == 0 ? 1 : 0));
+		}
+		for (int i = 0; i < 16; i++) {
+			const int* e0 = endpoints[subsets[i]][0];
+			const int* e1 = endpoints[subsets[i]][1];
+			//modes 4 and 5 index color and alpha separately, the selector swaps the two sets
+			uint32_t colorIndex = indices[i], colorBits = m.indexBits;
+			uint32_t alphaIndex = indices[i], alphaBits = m.indexBits;
+			if (m.index2Bits) {
+				alphaIndex = indices2[i];
+				alphaBits = m.index2Bits;
+				if (selector) {
+					std::swap(colorIndex, alphaIndex);
+					std::swap(colorBits, alphaBits);
+				}
+			}
+			uint8_t* texel = texels + i * 4;
+			for (int c = 0; c < 3; c++) texel[c] = static_cast<uint8_t>(InterpolateBc7(e0[c], e1[c], colorIndex, colorBits));
+			texel[3] = static_cast<uint8_t>(InterpolateBc7(e0[3], e1[3], alphaIndex, alphaBits));
+			if (rotation > 0) std::swap(texel[3], texel[rotation - 1]);
+		}
+	}
+
+	void DecompressLevel(const uint8_t* data, uint32_t width, uint32_t height, TextureEncoding encoding, uint8_t* out) {
+		uint32_t blockWidth = TextureCompression::GetBlockWidth(encoding), blockHeight = TextureCompression::GetBlockHeight(encoding);
+		uint32_t blocksX = (width + blockWidth - 1) / blockWidth, blocksY = (height + blockHeight - 1) / blockHeight;
+		uint32_t blockBytes = TextureCompression::GetBlockBytes(encoding);
+		uint8_t texels[8 * 8 * 4];
+		for (uint32_t by = 0; by < blocksY; by++) {
+			for (uint32_t bx = 0; bx < blocksX; bx++) {
+				const uint8_t* block = data + (size_t(by) * blocksX + bx) * blockBytes;
+				switch (encoding) {
+				case TextureEncoding::BC1:
+					DecodeColorBlock(block, false, texels);
+					break;
+				case TextureEncoding::BC3:
+					DecodeColorBlock(block + 8, true, texels);
+					DecodeAlphaBlock(block, texels, 3);
+					break;
+				case TextureEncoding::BC7:
+					DecodeBc7Block(block, texels);
+					break;
+				case TextureEncoding::ASTC4x4:
+				case TextureEncoding::ASTC6x6:
+				case TextureEncoding::ASTC8x8:
+					AstcDecoder::DecodeBlock(block, blockWidth, blockHeight, texels);
+					break;
+				default:
+					//BC4 / BC5, channels the block does not store read as 0 and alpha as 1
+					for (int i = 0; i < 16; i++) {
+						texels[i * 4 + 1] = texels[i * 4 + 2] = 0;
+						texels[i * 4 + 3] = 255;
+					}
+					DecodeAlphaBlock(block, texels, 0);
+					if (encoding == TextureEncoding::BC5) DecodeAlphaBlock(block + 8, texels, 1);
+					break;
+				}
+				//edge blocks only write the texels inside the level
+				for (uint32_t y = 0; y < blockHeight && by * blockHeight + y < height; y++) {
+					uint32_t count = std::min(blockWidth, width - bx * blockWidth);
+					memcpy(out + ((size_t(by) * blockHeight + y) * width + bx * blockWidth) * 4, texels + y * blockWidth * 4, count * 4);
+				}
+			}
+		}
+	}
+
+	//rows[y] of the flipped block = row order[y] of the block
+	void FlipColorIndices(uint8_t indices[4], const int order[4]) {
+		uint8_t rows[4] = { indices[0], indices[1], indices[2], indices[3] };
+		for (int y = 0; y < 4; y++) indices[y] = rows[order[y]];
+	}
+	void FlipAlphaIndices(uint8_t block[8], const int order[4]) {
+		uint64_t indices = ReadLE(block + 2, 6), flipped = 0;
+		for (int y = 0; y < 4; y++) {
+			flipped |= ((indices >> (12 * order[y])) & 0xFFF) << (12 * y);
+		}
+		WriteLE(block + 2, flipped, 6);
+	}
+	void FlipBlock(uint8_t* block, TextureEncoding encoding, const int order[4]) {
+		switch (encoding) {
+		case TextureEncoding::BC1:	FlipColorIndices(block + 4, order); break;
+		case TextureEncoding::BC3:	FlipAlphaIndices(block, order); FlipColorIndices(block + 12, order); break;
+		case TextureEncoding::BC4:	FlipAlphaIndices(block, order); break;
+		case TextureEncoding::BC5:	FlipAlphaIndices(block, order); FlipAlphaIndices(block + 8, order); break;
+		default:					break;
+		}
+	}
+
+	void CompressLevel(const uint8_t* rgba, uint32_t width, uint32_t height, TextureEncoding encoding, uint8_t* out) {
+		uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+		uint32_t blockBytes = TextureCompression::GetBlockBytes(encoding);
+		uint8_t texels[64];
+		for (uint32_t by = 0; by < blocksY; by++) {
+			for (uint32_t bx = 0; bx < blocksX; bx++) {
+				//edge blocks repeat the last row / column
+				for (uint32_t y = 0; y < 4; y++) {
+					uint32_t sy = std::min(by * 4 + y, height - 1);
+					for (uint32_t x = 0; x < 4; x++) {
+						uint32_t sx = std::min(bx * 4 + x, width - 1);
+						memcpy(texels + (y * 4 + x) * 4, rgba + (size_t(sy) * width + sx) * 4, 4);
+					}
+				}
+				uint8_t* block = out + (size_t(by) * blocksX + bx) * blockBytes;
+				if (encoding == TextureEncoding::BC3) {
+					EncodeAlphaBlock(texels, block);
+					EncodeColorBlock(texels, block + 8);
+				}
+				else {
+					EncodeColorBlock(texels, block);
+				}
+			}
+		}
+	}
+}
+
+namespace TextureCompression {
+	uint64_t GetLevelSize(TextureEncoding encoding, uint32_t width, uint32_t height) {
+		if (!IsBlockCompressed(encoding)) return uint64_t(width) * height * 4;
+		uint32_t blockWidth = GetBlockWidth(encoding), blockHeight = GetBlockHeight(encoding);
+		return uint64_t((width + blockWidth - 1) / blockWidth) * ((height + blockHeight - 1) / blockHeight) * GetBlockBytes(encoding);
+	}
+
+	uint64_t GetMipChainSize(TextureEncoding encoding, uint32_t width, uint32_t height, uint32_t mipLevels) {
+		uint64_t size = 0;
+		for (uint32_t i = 0; i < mipLevels; i++) {
+			size += GetLevelSize(encoding, width, height);
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+		}
+		return size;
+	}
+
+	TextureEncoding ChooseEncoding(const uint8_t* rgba, uint32_t width, uint32_t height) {
+		size_t count = size_t(width) * height;
+		for (size_t i = 0; i < count; i++) {
+			if (rgba[i * 4 + 3] != 255) return TextureEncoding::BC3;
+		}
+		return TextureEncoding::BC1;
+	}
+
+	std::vector<uint8_t> CompressMipChain(const std::vector<uint8_t>& rgbaChain, uint32_t width, uint32_t height, uint32_t mipLevels, TextureEncoding encoding) {
+		if (!IsBlockCompressed(encoding)) return rgbaChain;
+		std::vector<uint8_t> out(static_cast<size_t>(GetMipChainSize(encoding, width, height, mipLevels)));
+		size_t src = 0, dst = 0;
+		for (uint32_t i = 0; i < mipLevels; i++) {
+			CompressLevel(rgbaChain.data() + src, width, height, encoding, out.data() + dst);
+			src += static_cast<size_t>(GetLevelSize(TextureEncoding::RGBA8, width, height));
+			dst += static_cast<size_t>(GetLevelSize(encoding, width, height));
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+		}
+		return out;
+	}
+
+	void Decompress(const uint8_t* data, uint32_t width, uint32_t height, uint32_t mipLevels, TextureEncoding encoding, uint8_t* out) {
+		if (!IsValid(encoding)) {
+			throw std::runtime_error("failed to decompress texture, unknown encoding!");
+		}
+		size_t src = 0, dst = 0;
+		for (uint32_t i = 0; i < mipLevels; i++) {
+			if (IsBlockCompressed(encoding)) DecompressLevel(data + src, width, height, encoding, out + dst);
+			else memcpy(out + dst, data + src, static_cast<size_t>(GetLevelSize(encoding, width, height)));
+			src += static_cast<size_t>(GetLevelSize(encoding, width, height));
+			dst += static_cast<size_t>(GetLevelSize(TextureEncoding::RGBA8, width, height));
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+		}
+	}
+
+	bool FlipLevel(uint8_t* data, uint32_t width, uint32_t height, TextureEncoding encoding) {
+		if (!IsBlockCompressed(encoding)) {
+			size_t pitch = size_t(width) * 4;
+			std::vector<uint8_t> row(pitch);
+			for (uint32_t y = 0; y < height / 2; y++) {
+				uint8_t* top = data + y * pitch;
+				uint8_t* bottom = data + (height - 1 - y) * pitch;
+				memcpy(row.data(), top, pitch);
+				memcpy(top, bottom, pitch);
+				memcpy(bottom, row.data(), pitch);
+			}
+			return true;
+		}
+		if (encoding == TextureEncoding::BC7 || IsAstc(encoding)) return false;
+		//rows below height in the last block row are padding, so only whole block rows or a single one can be reordered
+		if (height > 4 && height % 4 != 0) return false;
+		static const int orders[4][4] = { { 0, 1, 2, 3 }, { 0, 1, 2, 3 }, { 1, 0, 2, 3 }, { 2, 1, 0, 3 } };
+		static const int full[4] = { 3, 2, 1, 0 };
+		const int* order = height < 4 ? orders[height] : full;
+		uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+		size_t blockBytes = GetBlockBytes(encoding), pitch = blocksX * blockBytes;
+		std::vector<uint8_t> row(pitch);
+		for (uint32_t by = 0; by < blocksY / 2; by++) {
+			uint8_t* top = data + by * pitch;
+			uint8_t* bottom = data + (blocksY - 1 - by) * pitch;
+			memcpy(row.data(), top, pitch);
+			memcpy(top, bottom, pitch);
+			memcpy(bottom, row.data(), pitch);
+		}
+		for (size_t i = 0; i < size_t(blocksX) * blocksY; i++) {
+			FlipBlock(data + i * blockBytes, encoding, order);
+		}
+		return true;
+	}
+}
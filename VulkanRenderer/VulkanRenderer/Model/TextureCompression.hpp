@@ -0,0 +1,77 @@
+#pragma once
+#ifndef TEXTURE_COMPRESSION_HPP
+#define TEXTURE_COMPRESSION_HPP
+#include <vector>
+#include <cstdint>
+
+// payload format of a cooked / cached texture or a ktx2 / dds file. compressed payloads are blocks (4x4 for BCn),
+// rows of blocks tightly packed, levels smaller than a block still take one block.
+// the cooker writes BC1 / BC3, the others only come from ktx2 / dds files.
+enum class TextureEncoding : uint32_t {
+	RGBA8 = 0,
+	BC1 = 1,		// 8 bytes per block, opaque rgb
+	BC3 = 2,		// 16 bytes per block, rgb + interpolated alpha
+	BC4 = 3,		// 8 bytes per block, one channel (r)
+	BC5 = 4,		// 16 bytes per block, two channels (rg), normal maps
+	BC7 = 5,		// 16 bytes per block, rgba
+	ASTC4x4 = 6,	// 16 bytes per block, ldr
+	ASTC6x6 = 7,
+	ASTC8x8 = 8,
+	COUNT
+};
+
+// cpu side block compression, runs in the offline cooker, and the cpu decode for devices that can't sample
+// an encoding (every one has a decoder, ASTC through AstcDecoder). no vulkan.
+namespace TextureCompression {
+	inline bool IsValid(TextureEncoding encoding) { return encoding < TextureEncoding::COUNT; }
+	inline bool IsBlockCompressed(TextureEncoding encoding) { return encoding != TextureEncoding::RGBA8; }
+	inline bool IsAstc(TextureEncoding encoding) { return encoding >= TextureEncoding::ASTC4x4 && encoding <= TextureEncoding::ASTC8x8; }
+	inline uint32_t GetBlockBytes(TextureEncoding encoding) {
+		switch (encoding) {
+		case TextureEncoding::BC1:
+		case TextureEncoding::BC4:	return 8;
+		case TextureEncoding::RGBA8:
+		case TextureEncoding::COUNT:	return 0;
+		default:					return 16;
+		}
+	}
+	// texels per block side, 1 for RGBA8
+	inline uint32_t GetBlockWidth(TextureEncoding encoding) {
+		switch (encoding) {
+		case TextureEncoding::RGBA8:	return 1;
+		case TextureEncoding::ASTC6x6:	return 6;
+		case TextureEncoding::ASTC8x8:	return 8;
+		default:						return 4;
+		}
+	}
+	inline uint32_t GetBlockHeight(TextureEncoding encoding) { return GetBlockWidth(encoding); }
+	// channels the encoding stores, what the model cache records as nChannels
+	inline int GetChannelCount(TextureEncoding encoding) {
+		switch (encoding) {
+		case TextureEncoding::BC1:	return 3;
+		case TextureEncoding::BC4:	return 1;
+		case TextureEncoding::BC5:	return 2;
+		default:					return 4;
+		}
+	}
+	// bit of encoding in a mask of encodings, see ModelImporter::SetSampledEncodings()
+	inline uint32_t GetEncodingBit(TextureEncoding encoding) { return 1u << static_cast<uint32_t>(encoding); }
+	uint64_t GetLevelSize(TextureEncoding encoding, uint32_t width, uint32_t height);
+	uint64_t GetMipChainSize(TextureEncoding encoding, uint32_t width, uint32_t height, uint32_t mipLevels);
+
+	// chain in encoding, level 0 first -> rgba8 chain of GetMipChainSize(RGBA8, ...) bytes at out.
+	// channels come out the way the gpu samples them : BC4 (r, 0, 0, 1), BC5 (r, g, 0, 1), BC1 opaque.
+	// hdr ASTC blocks come out magenta like on an ldr only device. throws on an invalid encoding
+	void Decompress(const uint8_t* data, uint32_t width, uint32_t height, uint32_t mipLevels, TextureEncoding encoding, uint8_t* out);
+	// reverses the rows of one level in place, the bottom up order stb decodes images in.
+	// BCn blocks are flipped as blocks, false when that is not possible (BC7, ASTC, heights > 4 that are not a multiple of 4)
+	bool FlipLevel(uint8_t* data, uint32_t width, uint32_t height, TextureEncoding encoding);
+
+	// BC1 when every texel is opaque, BC3 otherwise
+	TextureEncoding ChooseEncoding(const uint8_t* rgba, uint32_t width, uint32_t height);
+	// rgbaChain as built by DecodedImage::BuildMipChain(), level 0 first. encoding RGBA8 returns a copy.
+	// blocks are fit in the stored space, sRGB images are compressed as they are.
+	std::vector<uint8_t> CompressMipChain(const std::vector<uint8_t>& rgbaChain, uint32_t width, uint32_t height, uint32_t mipLevels, TextureEncoding encoding);
+}
+
+#endif // !TEXTURE_COMPRESSION_HPP
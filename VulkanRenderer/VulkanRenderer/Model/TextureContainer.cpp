@@ -0,0 +1,286 @@
+#include "TextureContainer.hpp"
+#include <cstring>
+#include <cctype>
+#include <stdexcept>
+#include <algorithm>
+
+namespace {
+	const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	constexpr size_t KTX2_HEADER_SIZE = 80;		// identifier, header and index, the level index follows
+	constexpr uint32_t DDS_MAGIC = 0x20534444;	// "DDS "
+	constexpr size_t DDS_HEADER_SIZE = 128;		// magic and DDS_HEADER
+	constexpr size_t DDS_DX10_SIZE = 20;
+	constexpr uint32_t DDPF_FOURCC = 0x4;
+	constexpr uint32_t DDPF_RGB = 0x40;
+	constexpr uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+	constexpr uint32_t DDSCAPS2_CUBEMAP = 0x200;
+	constexpr uint32_t DDSCAPS2_VOLUME = 0x200000;
+	constexpr uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+	constexpr uint32_t DDS_MISC_TEXTURECUBE = 0x4;
+	constexpr uint32_t MAX_DIMENSION = 16384;	// keeps the level sizes far from overflowing
+
+	//VkFormat values ktx2 stores
+	enum KtxFormat {
+		R8G8B8A8_UNORM = 37,
+		R8G8B8A8_SRGB = 43,
+		B8G8R8A8_UNORM = 44,
+		B8G8R8A8_SRGB = 50,
+		BC1_RGB_UNORM = 131,
+		BC1_RGB_SRGB = 132,
+		BC1_RGBA_UNORM = 133,
+		BC1_RGBA_SRGB = 134,
+		BC3_UNORM = 137,
+		BC3_SRGB = 138,
+		BC4_UNORM = 139,
+		BC5_UNORM = 141,
+		BC7_UNORM = 145,
+		BC7_SRGB = 146,
+		ASTC_4x4_UNORM = 157,
+		ASTC_4x4_SRGB = 158,
+		ASTC_6x6_UNORM = 165,
+		ASTC_6x6_SRGB = 166,
+		ASTC_8x8_UNORM = 171,
+		ASTC_8x8_SRGB = 172
+	};
+	//DXGI_FORMAT values of the dds DX10 header
+	enum DxgiFormat {
+		DXGI_R8G8B8A8_UNORM = 28,
+		DXGI_R8G8B8A8_SRGB = 29,
+		DXGI_BC1_UNORM = 71,
+		DXGI_BC1_SRGB = 72,
+		DXGI_BC3_UNORM = 77,
+		DXGI_BC3_SRGB = 78,
+		DXGI_BC4_UNORM = 80,
+		DXGI_BC5_UNORM = 83,
+		DXGI_B8G8R8A8_UNORM = 87,
+		DXGI_B8G8R8A8_SRGB = 91,
+		DXGI_BC7_UNORM = 98,
+		DXGI_BC7_SRGB = 99
+	};
+
+	constexpr uint32_t MakeFourCC(char a, char b, char c, char d) {
+		return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+	}
+	uint32_t Read32(const uint8_t* data, size_t offset) {
+		uint32_t value;
+		memcpy(&value, data + offset, sizeof(value));
+		return value;
+	}
+	uint64_t Read64(const uint8_t* data, size_t offset) {
+		uint64_t value;
+		memcpy(&value, data + offset, sizeof(value));
+		return value;
+	}
+	[[noreturn]] void Fail(const std::string& name, const char* reason) {
+		throw std::runtime_error("failed to read texture " + name + " : " + reason + "!");
+	}
+	//offsets come from the file, offset + length could wrap
+	bool InBounds(uint64_t offset, uint64_t length, size_t size) {
+		return offset <= size && length <= size - offset;
+	}
+	//levels past the 1x1 one are rejected too
+	void CheckExtent(const ContainerImage& image, const std::string& name) {
+		if (image.width > MAX_DIMENSION || image.height > MAX_DIMENSION) Fail(name, "texture is too large");
+		uint32_t fullChain = 1;
+		for (uint32_t extent = std::max(image.width, image.height); extent > 1; extent /= 2) fullChain++;
+		if (image.mipLevels > fullChain) Fail(name, "more mip levels than the texture has");
+	}
+
+	bool FromKtxFormat(uint32_t format, ContainerImage& out) {
+		switch (format)
+		{
+		case R8G8B8A8_UNORM:
+		case R8G8B8A8_SRGB:		out.encoding = TextureEncoding::RGBA8; break;
+		case B8G8R8A8_UNORM:
+		case B8G8R8A8_SRGB:		out.encoding = TextureEncoding::RGBA8; out.bgra = true; break;
+		//punch through alpha is read as opaque, BC1 is sampled as rgb
+		case BC1_RGB_UNORM:
+		case BC1_RGB_SRGB:
+		case BC1_RGBA_UNORM:
+		case BC1_RGBA_SRGB:		out.encoding = TextureEncoding::BC1; break;
+		case BC3_UNORM:
+		case BC3_SRGB:			out.encoding = TextureEncoding::BC3; break;
+		case BC4_UNORM:			out.encoding = TextureEncoding::BC4; break;
+		case BC5_UNORM:			out.encoding = TextureEncoding::BC5; break;
+		case BC7_UNORM:
+		case BC7_SRGB:			out.encoding = TextureEncoding::BC7; break;
+		case ASTC_4x4_UNORM:
+		case ASTC_4x4_SRGB:		out.encoding = TextureEncoding::ASTC4x4; break;
+		case ASTC_6x6_UNORM:
+		case ASTC_6x6_SRGB:		out.encoding = TextureEncoding::ASTC6x6; break;
+		case ASTC_8x8_UNORM:
+		case ASTC_8x8_SRGB:		out.encoding = TextureEncoding::ASTC8x8; break;
+		default:				return false;
+		}
+		out.sRGB = format == R8G8B8A8_SRGB || format == B8G8R8A8_SRGB || format == BC1_RGB_SRGB || format == BC1_RGBA_SRGB ||
+			format == BC3_SRGB || format == BC7_SRGB || format == ASTC_4x4_SRGB || format == ASTC_6x6_SRGB || format == ASTC_8x8_SRGB;
+		return true;
+	}
+
+	bool FromDxgiFormat(uint32_t format, ContainerImage& out) {
+		switch (format)
+		{
+		case DXGI_R8G8B8A8_UNORM:
+		case DXGI_R8G8B8A8_SRGB:	out.encoding = TextureEncoding::RGBA8; break;
+		case DXGI_B8G8R8A8_UNORM:
+		case DXGI_B8G8R8A8_SRGB:	out.encoding = TextureEncoding::RGBA8; out.bgra = true; break;
+		case DXGI_BC1_UNORM:
+		case DXGI_BC1_SRGB:			out.encoding = TextureEncoding::BC1; break;
+		case DXGI_BC3_UNORM:
+		case DXGI_BC3_SRGB:			out.encoding = TextureEncoding::BC3; break;
+		case DXGI_BC4_UNORM:		out.encoding = TextureEncoding::BC4; break;
+		case DXGI_BC5_UNORM:		out.encoding = TextureEncoding::BC5; break;
+		case DXGI_BC7_UNORM:
+		case DXGI_BC7_SRGB:			out.encoding = TextureEncoding::BC7; break;
+		default:					return false;
+		}
+		out.sRGB = format == DXGI_R8G8B8A8_SRGB || format == DXGI_B8G8R8A8_SRGB || format == DXGI_BC1_SRGB || format == DXGI_BC3_SRGB || format == DXGI_BC7_SRGB;
+		return true;
+	}
+
+	//levels stored back to back from offset, dds
+	void AddPackedLevels(const uint8_t* data, size_t size, size_t offset, const std::string& name, ContainerImage& out) {
+		uint32_t width = out.width, height = out.height;
+		for (uint32_t i = 0; i < out.mipLevels; i++) {
+			uint64_t levelSize = TextureCompression::GetLevelSize(out.encoding, width, height);
+			if (!InBounds(offset, levelSize, size)) Fail(name, "truncated mip level");
+			out.levels.push_back(data + offset);
+			offset += static_cast<size_t>(levelSize);
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+		}
+	}
+
+	//"KTXorientation" = "rd" (default, top down) or "ru", the key value data is a list of length prefixed, 4 byte aligned pairs
+	bool IsKtxBottomUp(const uint8_t* data, size_t size, uint32_t kvdOffset, uint32_t kvdLength) {
+		if (kvdLength == 0 || !InBounds(kvdOffset, kvdLength, size)) return false;
+		const char key[] = "KTXorientation";
+		size_t offset = kvdOffset, end = size_t(kvdOffset) + kvdLength;
+		while (offset + 4 <= end) {
+			uint32_t length = Read32(data, offset);
+			offset += 4;
+			if (length > end - offset) break;
+			const char* pair = reinterpret_cast<const char*>(data + offset);
+			if (length > sizeof(key) + 1 && memcmp(pair, key, sizeof(key)) == 0) {
+				return pair[sizeof(key) + 1] == 'u';
+			}
+			offset += (length + 3) & ~size_t(3);
+		}
+		return false;
+	}
+
+	ContainerImage ParseKtx2(const uint8_t* data, size_t size, const std::string& name) {
+		if (size < KTX2_HEADER_SIZE) Fail(name, "truncated ktx2 header");
+		ContainerImage out;
+		uint32_t vkFormat = Read32(data, 12);
+		out.width = Read32(data, 20);
+		out.height = Read32(data, 24);
+		uint32_t depth = Read32(data, 28), layers = Read32(data, 32), faces = Read32(data, 36);
+		uint32_t levelCount = Read32(data, 40), supercompression = Read32(data, 44);
+		if (vkFormat == 0) Fail(name, "basis universal ktx2 files need transcoding");
+		if (supercompression != 0) Fail(name, "supercompressed ktx2 files are not supported");
+		if (out.width == 0 || out.height == 0 || depth > 1 || layers > 1 || faces != 1) Fail(name, "only 2d textures are supported");
+		if (!FromKtxFormat(vkFormat, out)) Fail(name, "unsupported ktx2 format");
+		//0 asks the loader to build the mips, the stored level is all there is
+		out.mipLevels = std::max(levelCount, 1u);
+		CheckExtent(out, name);
+		if (KTX2_HEADER_SIZE + size_t(out.mipLevels) * 24 > size) Fail(name, "truncated ktx2 level index");
+		uint32_t width = out.width, height = out.height;
+		for (uint32_t i = 0; i < out.mipLevels; i++) {
+			uint64_t offset = Read64(data, KTX2_HEADER_SIZE + i * 24);
+			uint64_t length = Read64(data, KTX2_HEADER_SIZE + i * 24 + 8);
+			if (length != TextureCompression::GetLevelSize(out.encoding, width, height) || !InBounds(offset, length, size)) Fail(name, "bad ktx2 mip level");
+			out.levels.push_back(data + offset);
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+		}
+		out.topDown = !IsKtxBottomUp(data, size, Read32(data, 56), Read32(data, 60));
+		return out;
+	}
+
+	ContainerImage ParseDds(const uint8_t* data, size_t size, const std::string& name) {
+		if (size < DDS_HEADER_SIZE || Read32(data, 4) != 124) Fail(name, "truncated dds header");
+		ContainerImage out;
+		uint32_t flags = Read32(data, 8);
+		out.height = Read32(data, 12);
+		out.width = Read32(data, 16);
+		out.mipLevels = (flags & DDSD_MIPMAPCOUNT) != 0 ? std::max(Read32(data, 28), 1u) : 1;
+		uint32_t formatFlags = Read32(data, 80), fourCC = Read32(data, 84);
+		if (out.width == 0 || out.height == 0 || (Read32(data, 112) & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) != 0) Fail(name, "only 2d textures are supported");
+		CheckExtent(out, name);
+		size_t offset = DDS_HEADER_SIZE;
+		if ((formatFlags & DDPF_FOURCC) != 0 && fourCC == MakeFourCC('D', 'X', '1', '0')) {
+			if (size < DDS_HEADER_SIZE + DDS_DX10_SIZE) Fail(name, "truncated dds dx10 header");
+			if (Read32(data, 132) != DDS_DIMENSION_TEXTURE2D || (Read32(data, 136) & DDS_MISC_TEXTURECUBE) != 0 || Read32(data, 140) > 1) {
+				Fail(name, "only 2d textures are supported");
+			}
+			if (!FromDxgiFormat(Read32(data, 128), out)) Fail(name, "unsupported dxgi format");
+			offset += DDS_DX10_SIZE;
+		}
+		else if ((formatFlags & DDPF_FOURCC) != 0) {
+			if (fourCC == MakeFourCC('D', 'X', 'T', '1')) out.encoding = TextureEncoding::BC1;
+			else if (fourCC == MakeFourCC('D', 'X', 'T', '5')) out.encoding = TextureEncoding::BC3;
+			else if (fourCC == MakeFourCC('A', 'T', 'I', '1') || fourCC == MakeFourCC('B', 'C', '4', 'U')) out.encoding = TextureEncoding::BC4;
+			else if (fourCC == MakeFourCC('A', 'T', 'I', '2') || fourCC == MakeFourCC('B', 'C', '5', 'U')) out.encoding = TextureEncoding::BC5;
+			else Fail(name, "unsupported dds fourcc");
+		}
+		else if ((formatFlags & DDPF_RGB) != 0 && Read32(data, 88) == 32) {
+			//8 bit channels in either byte order
+			uint32_t redMask = Read32(data, 92);
+			if (redMask == 0x000000FF) out.encoding = TextureEncoding::RGBA8;
+			else if (redMask == 0x00FF0000) { out.encoding = TextureEncoding::RGBA8; out.bgra = true; }
+			else Fail(name, "unsupported dds channel layout");
+		}
+		else {
+			Fail(name, "unsupported dds pixel format");
+		}
+		AddPackedLevels(data, size, offset, name, out);
+		return out;
+	}
+}
+
+namespace TextureContainer {
+	bool IsContainer(const std::string& fn) {
+		size_t dot = fn.find_last_of('.');
+		if (dot == std::string::npos) return false;
+		std::string extension = fn.substr(dot);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return extension == ".ktx2" || extension == ".dds";
+	}
+
+	bool IsContainer(const uint8_t* data, size_t size) {
+		if (size >= sizeof(KTX2_IDENTIFIER) && memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0) return true;
+		return size >= 4 && Read32(data, 0) == DDS_MAGIC;
+	}
+
+	ContainerImage Parse(const uint8_t* data, size_t size, const std::string& name) {
+		if (size >= sizeof(KTX2_IDENTIFIER) && memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0) return ParseKtx2(data, size, name);
+		if (size >= 4 && Read32(data, 0) == DDS_MAGIC) return ParseDds(data, size, name);
+		Fail(name, "not a ktx2 or dds file");
+	}
+
+	bool CopyMipChain(const ContainerImage& image, uint8_t* out) {
+		uint32_t width = image.width, height = image.height;
+		bool flipped = true;
+		//swizzles and flips happen in cached memory, out is only written (it may be staging memory)
+		std::vector<uint8_t> scratch;
+		for (uint32_t i = 0; i < image.mipLevels; i++) {
+			size_t levelSize = static_cast<size_t>(TextureCompression::GetLevelSize(image.encoding, width, height));
+			if (image.bgra || image.topDown) {
+				scratch.assign(image.levels[i], image.levels[i] + levelSize);
+				if (image.bgra) {
+					for (size_t p = 0; p < levelSize; p += 4) std::swap(scratch[p], scratch[p + 2]);
+				}
+				if (image.topDown) flipped &= TextureCompression::FlipLevel(scratch.data(), width, height, image.encoding);
+				memcpy(out, scratch.data(), levelSize);
+			}
+			else {
+				memcpy(out, image.levels[i], levelSize);
+			}
+			out += levelSize;
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+		}
+		return flipped;
+	}
+}
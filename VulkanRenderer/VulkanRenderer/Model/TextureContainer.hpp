@@ -0,0 +1,38 @@
+#pragma once
+#ifndef TEXTURE_CONTAINER_HPP
+#define TEXTURE_CONTAINER_HPP
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "TextureCompression.hpp"
+
+//a .ktx2 / .dds file as it is stored : one 2d image, its mip levels in one encoding.
+//levels point into the parsed bytes, they have to outlive it
+struct ContainerImage {
+	TextureEncoding encoding = TextureEncoding::RGBA8;
+	uint32_t width = 0, height = 0;
+	uint32_t mipLevels = 1;
+	bool sRGB = false;			//the file's format is an _SRGB one
+	bool bgra = false;			//RGBA8 stored as bgra, swapped while copying
+	bool topDown = true;		//row 0 is the top of the image, ktx2 files may say otherwise
+	std::vector<const uint8_t*> levels;	//level 0 first, TextureCompression::GetLevelSize() bytes each
+};
+
+// reader of pre-compressed, pre-mipped textures : KTX 2.0 (no supercompression) and DDS (legacy fourcc and DX10 headers).
+// BC1 / BC3 / BC4 / BC5 / BC7, ASTC 4x4 / 6x6 / 8x8 (ldr) and 8 bit rgba / bgra. cube maps, arrays and volumes are rejected.
+// no vulkan, the cooker and the importer read them on any thread.
+namespace TextureContainer {
+	//by extension
+	bool IsContainer(const std::string& fn);
+	//by the file's magic
+	bool IsContainer(const uint8_t* data, size_t size);
+	//throws when the file is malformed or holds something the renderer can't upload. name is only for messages
+	ContainerImage Parse(const uint8_t* data, size_t size, const std::string& name);
+	//packs the levels, level 0 first, into GetMipChainSize(encoding, ...) bytes at out. top down files are flipped to the
+	//bottom up rows stb images get. BC7 / ASTC blocks and BCn levels of odd heights can't be flipped, they stay as they are
+	//and false is returned (write such files bottom up, KTXorientation "ru")
+	bool CopyMipChain(const ContainerImage& image, uint8_t* out);
+}
+
+#endif // !TEXTURE_CONTAINER_HPP
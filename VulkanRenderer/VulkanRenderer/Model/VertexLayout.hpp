@@ -0,0 +1,161 @@
+#pragma once
+#ifndef VERTEX_LAYOUT_HPP
+#define VERTEX_LAYOUT_HPP
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include "Geometry.hpp"
+
+struct VertexAttribute {
+	uint32_t location;
+	VkFormat format;
+	uint32_t offset;
+};
+
+// Compile time vertex input description of one or more vertex streams.
+// stream i is bound to binding i, each stream type provides ATTRIBUTE_COUNT and GetAttributes(), its stride is sizeof.
+// shaders keep the same locations for every layout : 0 position, 1 normal, 2 uv.
+template<typename... Streams>
+struct VertexLayout {
+	static constexpr uint32_t BINDING_COUNT = sizeof...(Streams);
+	static constexpr uint32_t ATTRIBUTE_COUNT = (Streams::ATTRIBUTE_COUNT + ...);
+
+	static std::array<VkVertexInputBindingDescription, BINDING_COUNT> GetBindingDescriptions() {
+		std::array<VkVertexInputBindingDescription, BINDING_COUNT> bindingDescription{};
+		const uint32_t strides[] = { static_cast<uint32_t>(sizeof(Streams))... };
+		for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+			bindingDescription[i].binding = i;
+			bindingDescription[i].stride = strides[i];
+			bindingDescription[i].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		}
+		return bindingDescription;
+	}
+	static std::array<VkVertexInputAttributeDescription, ATTRIBUTE_COUNT> GetAttributeDescriptions() {
+		std::array<VkVertexInputAttributeDescription, ATTRIBUTE_COUNT> attributeDescription{};
+		uint32_t count = 0, binding = 0;
+		(AppendAttributes<Streams>(attributeDescription, count, binding++), ...);
+		return attributeDescription;
+	}
+	// descriptions live in static storage, so the create info can be kept and copied around
+	static VkPipelineVertexInputStateCreateInfo GetInputState() {
+		static const auto bindings = GetBindingDescriptions();
+		static const auto attributes = GetAttributeDescriptions();
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
+		vertexInputInfo.pVertexBindingDescriptions = bindings.data();
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+		vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
+		return vertexInputInfo;
+	}
+private:
+	template<typename S>
+	static void AppendAttributes(std::array<VkVertexInputAttributeDescription, ATTRIBUTE_COUNT>& out, uint32_t& count, uint32_t binding) {
+		for (const auto& attribute : S::GetAttributes()) {
+			out[count].binding = binding;
+			out[count].location = attribute.location;
+			out[count].format = attribute.format;
+			out[count].offset = attribute.offset;
+			count++;
+		}
+	}
+};
+
+// gpu streams. positions are a separate tightly packed stream, so depth only passes fetch nothing else.
+// full : 12 byte position + 20 byte attributes
+struct FullPosition {
+	glm::vec3 position;
+
+	static constexpr uint32_t ATTRIBUTE_COUNT = 1;
+	static std::array<VertexAttribute, ATTRIBUTE_COUNT> GetAttributes() {
+		return { { { 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(FullPosition, position) } } };
+	}
+	static FullPosition Encode(const Vertex& v) { return { v.position }; }
+};
+
+struct FullAttributes {
+	glm::vec3 normal;
+	glm::vec2 texCoords;
+
+	static constexpr uint32_t ATTRIBUTE_COUNT = 2;
+	static std::array<VertexAttribute, ATTRIBUTE_COUNT> GetAttributes() {
+		return { {
+			{ 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(FullAttributes, normal) },
+			{ 2, VK_FORMAT_R32G32_SFLOAT, offsetof(FullAttributes, texCoords) }
+		} };
+	}
+	static FullAttributes Encode(const Vertex& v) { return { v.normal, v.texCoords }; }
+};
+
+// compact : 8 byte unorm16 position + 8 byte octahedral snorm16 normal / half float uv
+struct CompactPosition {
+	uint16_t position[4];	// w is padding
+
+	static constexpr uint32_t ATTRIBUTE_COUNT = 1;
+	static std::array<VertexAttribute, ATTRIBUTE_COUNT> GetAttributes() {
+		return { { { 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(CompactPosition, position) } } };
+	}
+	static CompactPosition Encode(const Vertex& v, const Quantization& q) {
+		CompactPosition out{};
+		glm::vec3 p = glm::clamp((v.position - q.origin) / q.scale, 0.0f, 1.0f);
+		for (int i = 0; i < 3; i++) {
+			out.position[i] = static_cast<uint16_t>(std::lround(p[i] * 65535.0f));
+		}
+		out.position[3] = 0;
+		return out;
+	}
+};
+
+struct CompactAttributes {
+	int16_t normal[2];		// octahedral, DefaultVertexShader.vert decodes it
+	uint16_t texCoords[2];
+
+	static constexpr uint32_t ATTRIBUTE_COUNT = 2;
+	static std::array<VertexAttribute, ATTRIBUTE_COUNT> GetAttributes() {
+		return { {
+			{ 1, VK_FORMAT_R16G16_SNORM, offsetof(CompactAttributes, normal) },
+			{ 2, VK_FORMAT_R16G16_SFLOAT, offsetof(CompactAttributes, texCoords) }
+		} };
+	}
+	static CompactAttributes Encode(const Vertex& v) {
+		CompactAttributes out{};
+		glm::vec2 octahedral = EncodeOctahedral(v.normal);
+		for (int i = 0; i < 2; i++) {
+			out.normal[i] = static_cast<int16_t>(std::lround(glm::clamp(octahedral[i], -1.0f, 1.0f) * 32767.0f));
+		}
+		out.texCoords[0] = glm::packHalf1x16(v.texCoords.x);
+		out.texCoords[1] = glm::packHalf1x16(v.texCoords.y);
+		return out;
+	}
+	// the unit normal projected on the octahedron |x| + |y| + |z| = 1, lower half folded over the diagonals.
+	// about the same precision in every direction, under 0.05 degrees at 16 bits (snorm8 xyz was ~0.5)
+	static glm::vec2 EncodeOctahedral(const glm::vec3& normal) {
+		float sum = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+		if (sum <= 0.0f) return glm::vec2(0.0f);
+		glm::vec3 n = normal / sum;
+		if (n.z >= 0.0f) return glm::vec2(n.x, n.y);
+		return glm::vec2((1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+	}
+};
+static_assert(sizeof(CompactPosition) == 8 && sizeof(CompactAttributes) == 8, "compact streams must stay tightly packed");
+
+// pipeline layouts of a Model's geometry arena. binding 0 = positions, binding 1 = attributes.
+// depth only pipelines (shadow maps, depth prepass) bind the position stream alone.
+using FullLayout = VertexLayout<FullPosition, FullAttributes>;
+using FullDepthLayout = VertexLayout<FullPosition>;
+using CompactLayout = VertexLayout<CompactPosition, CompactAttributes>;
+using CompactDepthLayout = VertexLayout<CompactPosition>;
+
+inline uint32_t GetPositionStride(VertexFormat format) {
+	return format == VertexFormat::Compact ? sizeof(CompactPosition) : sizeof(FullPosition);
+}
+inline uint32_t GetAttributeStride(VertexFormat format) {
+	return format == VertexFormat::Compact ? sizeof(CompactAttributes) : sizeof(FullAttributes);
+}
+
+#endif // !VERTEX_LAYOUT_HPP
@@ -8,6 +8,7 @@
 #include<algorithm>
 #include <array>
 #include <Tools/DescriptorBuilder.hpp>
+#include "Model/ClusterCulling.hpp"
 
 using namespace Utils;
 Renderer* Renderer::rendererInstance = nullptr;
@@ -21,6 +22,11 @@ Renderer::Renderer(GLFWwindow* wd, RendererCustomFuncs* funcs) : window(wd) {
 	checkSwapPresentModeFunc = funcs->checkSwapPresentModeFunc;
 	checkSwapSurfaceFormatFunc = funcs->checkSwapSurfaceFormatFunc;
 	renderFunc = funcs->renderFunc;
+	if (funcs->stagingRingSize > 0) stagingRingSize = funcs->stagingRingSize;
+	useTransferQueue = funcs->useTransferQueue;
+	workerThreads = funcs->workerThreads;
+	SetFramesInFlight(funcs->framesInFlight);
+	lowLatencyMode = funcs->lowLatencyMode;
 	Init();
 	if (rendererInstance == nullptr) {
 		rendererInstance = this;
@@ -50,6 +56,9 @@ void Renderer::Init() {
 	CreateSurface();
 	PickFirstPhysicalDevice();
 	CreateLogicalDevice();
+	allocator.Init(device, physicalDevice);
+	stagingRing.Init(device, &allocator, stagingRingSize);
+	workers.Init(workerThreads);
 	CreateSwapChain();
 	CreateImageViews();
 	PipelineBuilder::CreateDefaultRenderPass(defaultRenderpass, device, physicalDevice, swapChainImageFormat);
@@ -60,23 +69,28 @@ void Renderer::Init() {
 	DescriptorBuilder::CreateBindlessDescriptorSets(device, texDescriptorSetLayout, texDescriptorPool, texDescriptorSets, MAX_FRAMES_IN_FLIGHT);
 	CreateDefaultSampler();
 	std::vector<VkDescriptorSetLayout> desc_layouts = { defaultDescriptorSetLayout,texDescriptorSetLayout };
-	PipelineBuilder::CreateGraphicsPipeline(defaultPipeline, defaultPipelineLayout, device, "DefaultVertexShader.spv", "DefaultFragmentShader.spv", defaultRenderpass, desc_layouts);
+	PipelineBuilder::CreateGraphicsPipeline(defaultPipeline, defaultPipelineLayout, device, "DefaultVertexShader.vert", "DefaultFragmentShader.frag", defaultRenderpass, desc_layouts);
 	CreateCommandPool();
+	graphicsTimeline.Init(device, "graphics");
+	if (transferFamilyIndex != graphicsFamilyIndex) transferTimeline.Init(device, "transfer");
+	deletionQueue.Init(device, &allocator, &graphicsTimeline);
+	uploadContext.Init(device, transferQueue, transferFamilyIndex, transferFamilyIndex != graphicsFamilyIndex ? &transferTimeline : &graphicsTimeline,
+		graphicsQueue, graphicsFamilyIndex, &graphicsTimeline, &stagingRing);
+	uploadScheduler.Init(&uploadContext);
 	CreateDepthResources();
 	CreateFramebuffers();
 	CreateCommandBuffers();
 	CreateSyncObject();
 	CreateTextureDebugResources();
+	CreateClusterCullResources();
 	isInitialized = true;
 }
 void Renderer::Clean() {
 	CleanUpSwapChain();
 	vkDestroySampler(device, defaultSampler, nullptr);
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		vkDestroyBuffer(device, vertexUniformBuffers[i], nullptr);
-		vkDestroyBuffer(device, fragUniformBuffers[i], nullptr);
-		vkFreeMemory(device, vertexUniformBuffersMemory[i], nullptr);
-		vkFreeMemory(device, fragUniformBuffersMemory[i], nullptr);
+		DestroyBuffer(device, allocator, vertexUniformBuffers[i], vertexUniformBuffersMemory[i]);
+		DestroyBuffer(device, allocator, fragUniformBuffers[i], fragUniformBuffersMemory[i]);
 	}
 	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 	vkDestroyDescriptorSetLayout(device, defaultDescriptorSetLayout, nullptr);
@@ -85,7 +99,6 @@ void Renderer::Clean() {
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 		vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
 		vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-		vkDestroyFence(device, inFlightFences[i], nullptr);
 	}
 	vkDestroyCommandPool(device, commandPool, nullptr);
 	vkDestroyPipeline(device, defaultPipeline, nullptr);
@@ -97,7 +110,21 @@ void Renderer::Clean() {
 	vkDestroyPipelineLayout(device, textureDebugPipelineLayout, nullptr);
 	vkDestroyPipeline(device, textureDebugPipeline, nullptr);
 
-
+	vkDestroyPipeline(device, clusterCullPipeline, nullptr);
+	vkDestroyPipelineLayout(device, clusterCullPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, clusterCullDescriptorSetLayout, nullptr);
+
+	frameTasks.clear();
+	uploadScheduler.Clean();
+	workers.Clean();
+	deletionQueue.Clean();
+	uploadContext.Clean();
+	stagingRing.Clean();
+	graphicsTimeline.WaitIdle();
+	graphicsTimeline.Clean();
+	transferTimeline.Clean();
+	allocator.PrintStats();
+	allocator.Clean();
 	vkDestroyDevice(device, nullptr);
 	vkDestroySurfaceKHR(instance, surface, nullptr);
 	if (enableValidationLayer) {
@@ -209,6 +236,8 @@ void Renderer::CreateLogicalDevice() {
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 	std::set<uint32_t> uniqueQueueFamiles = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+	bool dedicatedTransfer = useTransferQueue && indices.transferFamily.has_value();
+	if (dedicatedTransfer) uniqueQueueFamiles.insert(indices.transferFamily.value());
 	float queuePriority(1.0f);
 	for (uint32_t queueFamily : uniqueQueueFamiles) {
 		VkDeviceQueueCreateInfo queueCreateInfo{};
@@ -221,6 +250,13 @@ void Renderer::CreateLogicalDevice() {
 
 	VkPhysicalDeviceFeatures deviceFeatures{  };
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	//cooked bundles and ktx2 / dds files may hold BC or ASTC compressed textures, the rest is decoded on the cpu
+	VkPhysicalDeviceFeatures supportedFeatures{};
+	vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+	deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+	deviceFeatures.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
+	//gpu cluster culling draws every mesh's meshlets with one indirect call
+	deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
 	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
 	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
 	indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
@@ -229,8 +265,14 @@ void Renderer::CreateLogicalDevice() {
 	indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
 	indexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
 	indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+	//timeline semaphores hand uploads over from the transfer queue to the graphics queue
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	timelineFeatures.timelineSemaphore = VK_TRUE;
+	indexingFeatures.pNext = &timelineFeatures;
 	
 	setPhysicalDeviceFeaturesFunc(deviceFeatures);
+	enabledFeatures = deviceFeatures;
 	VkDeviceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
@@ -251,6 +293,10 @@ void Renderer::CreateLogicalDevice() {
 	vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue); //write 2024-08-15__03:10
 	vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue); //write 2024-08-15__03:56.
 	//In case the queue family are the same, two handles will most likely have the same value now.
+	graphicsFamilyIndex = indices.graphicsFamily.value();
+	transferFamilyIndex = dedicatedTransfer ? indices.transferFamily.value() : graphicsFamilyIndex;
+	vkGetDeviceQueue(device, transferFamilyIndex, 0, &transferQueue);
+	printf("Upload queue family : %u%s\n", transferFamilyIndex, dedicatedTransfer ? " (dedicated transfer)" : " (graphics)");
 }
 
 VkSurfaceFormatKHR Renderer::ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
@@ -422,9 +468,9 @@ void Renderer::CreateUniforBuffers() {
 	vertexUniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
 
 	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		CreateBuffer(device, physicalDevice, buffersize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		CreateBuffer(device, allocator, buffersize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vertexUniformBuffers[i], vertexUniformBuffersMemory[i]);
-		vkMapMemory(device, vertexUniformBuffersMemory[i], 0, buffersize, 0, &vertexUniformBuffersMapped[i]); //persistent mapping
+		vertexUniformBuffersMapped[i] = vertexUniformBuffersMemory[i].mapped; //persistent mapping
 	}
 
 	buffersize = sizeof(GlobalStructs::FragmentShaderUBO);
@@ -433,9 +479,9 @@ void Renderer::CreateUniforBuffers() {
 	fragUniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
 
 	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		CreateBuffer(device, physicalDevice, buffersize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		CreateBuffer(device, allocator, buffersize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, fragUniformBuffers[i], fragUniformBuffersMemory[i]);
-		vkMapMemory(device, fragUniformBuffersMemory[i], 0, buffersize, 0, &fragUniformBuffersMapped[i]); //persistent mapping
+		fragUniformBuffersMapped[i] = fragUniformBuffersMemory[i].mapped; //persistent mapping
 	}
 }
 
@@ -450,7 +496,7 @@ void Renderer::CreateDefaultSampler() {
 void Renderer::CreateDepthResources() {
 	VkFormat depthFormat = findDepthFormat(physicalDevice);
 	VkImageCreateInfo imageInfo =  Initializer::InitImageCreateInfo(VK_IMAGE_TYPE_2D, swapChainExtent.width, swapChainExtent.height, 1, 1, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
-	CreateImage(device, physicalDevice, depthImage, depthImageMemory, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageInfo);
+	CreateImage(device, allocator, depthImage, depthImageMemory, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageInfo);
 	depthImageView = CreateImageView(device, depthImage, depthFormat, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_DEPTH_BIT,1);
 	transitionImageLayout(device, commandPool, graphicsQueue, depthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
 }
@@ -490,20 +536,15 @@ void Renderer::CreateCommandBuffers() {
 void Renderer::CreateSyncObject() {
 	imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
 	renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
 
 	VkSemaphoreCreateInfo semaphoreInfo = Initializer::InitSemaphoreCreateInfo();
-	// On first frame, which immediately waits on inFlightFence to be signaled.
-	// inFlightFence is only signaled after a frame has finished rendering
-	// ,yet since this is the first frame, so vkWaitForFence blocks indefinitly.
-	// one ofe the many solutions is create fence in the signaled state.
-	VkFenceCreateInfo fenceInfo = Initializer::InitFenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+	// frames wait on graphicsTimeline instead of fences, a frame slot that was never submitted has value 0
+	// which the timeline has already reached, so the first frames do not block.
 	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		frameTimelineValues[i] = 0;
 		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS
 			||
-			vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS
-			||
-			vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+			vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create semaphores!");
 		}
 	}
@@ -530,13 +571,61 @@ void Renderer::CreateTextureDebugResources() {
 		throw std::runtime_error("failed to allocate descriptor sets!");
 	}
 	std::vector<VkDescriptorSetLayout> desc_layout = { textureDebugDescriptorSetLayout };
-	PipelineBuilder::CreateGraphicsPipeline(textureDebugPipeline, textureDebugPipelineLayout, device, "TextureDebugVert.spv", "TextureDebugFrag.spv", defaultRenderpass, desc_layout);//pipeline
+	//the shader takes clip space positions, PrimitiveMesh::RenderQuad() draws a Full quad for it
+	PipelineBuilder::PipelineCreateInfos infos;
+	infos.SetVertexLayout<FullLayout>();
+	PipelineBuilder::CreateGraphicsPipeline(textureDebugPipeline, textureDebugPipelineLayout, device, "TextureDebug.vert", "TextureDebug.frag", defaultRenderpass, desc_layout, infos);//pipeline
 
 }
 
-void Renderer::Render() {
+void Renderer::CreateClusterCullResources() {
+	//the culling dispatch is recorded into the frame's command buffer, so the graphics queue has to run compute too
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+	if (!enabledFeatures.multiDrawIndirect || (families[graphicsFamilyIndex].queueFlags & VK_QUEUE_COMPUTE_BIT) == 0) {
+		printf("Meshlet culling stays on the cpu, the device can't draw it indirectly\n");
+		return;
+	}
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	maxDrawIndirectCount = properties.limits.maxDrawIndirectCount;
+	//meshlet table of the model, draw commands of the target
+	VkDescriptorSetLayoutBinding bindings[2] = {
+		Initializer::InitDescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT),
+		Initializer::InitDescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT)
+	};
+	VkDescriptorSetLayoutCreateInfo createInfo = Initializer::InitDescriptorSetLayoutCreateInfo(2, bindings);
+	if (vkCreateDescriptorSetLayout(device, &createInfo, nullptr, &clusterCullDescriptorSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor set layout");
+	}
+	std::vector<VkDescriptorSetLayout> desc_layout = { clusterCullDescriptorSetLayout };
+	std::vector<VkPushConstantRange> push_constant(1);
+	push_constant[0].offset = 0;
+	push_constant[0].size = sizeof(GpuCullView);
+	push_constant[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	PipelineBuilder::CreateComputePipeline(clusterCullPipeline, clusterCullPipelineLayout, device, "ClusterCull.comp", desc_layout, push_constant);
+}
 
-	vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+void Renderer::Render() {
+	//the cpu only waits until this frame's resources are free again, up to framesInFlight frames stay queued
+	//a failed wait (device lost) leaves the frame's command buffer and uniforms possibly in use
+	if (!graphicsTimeline.WaitFor(frameTimelineValues[currentFrame])) {
+		throw std::runtime_error("failed to wait for the previous frame in this slot!");
+	}
+	if (lowLatencyMode && lastSubmittedFrame != UINT32_MAX && !graphicsTimeline.WaitFor(frameTimelineValues[lastSubmittedFrame])) {
+		throw std::runtime_error("failed to wait for the last submitted frame!");
+	}
+	deletionQueue.Collect();
+	//tasks may add tasks
+	std::vector<std::function<bool()>> tasks;
+	tasks.swap(frameTasks);
+	for (auto& task : tasks) {
+		if (task()) frameTasks.push_back(std::move(task));
+	}
+	//upload submits signal the graphics timeline, so they go before this frame reserves its value
+	uploadScheduler.Run();
 
 	uint32_t imageIdx;
 	VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIdx);
@@ -548,7 +637,8 @@ void Renderer::Render() {
 	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
 		throw std::runtime_error("failed to acquire swap chain image!");
 	}
-	vkResetFences(device, 1, &inFlightFences[currentFrame]); //Delay resetting the fence until after we know for sure we will be submitting work with it.
+	//reserved only once we know for sure this frame will be submitted
+	recordingFrameValue = graphicsTimeline.Reserve();
 
 	vkResetCommandBuffer(commandBuffers[currentFrame], 0);
 	VkCommandBufferBeginInfo beginInfo = Initializer::InitCommandBufferBeginInfo();
@@ -568,10 +658,20 @@ void Renderer::Render() {
 	VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
 	VkPipelineStageFlags waitStage[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 	VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-	VkSubmitInfo submitInfo = Initializer::InitSubmitInfo(1, waitSemaphores,waitStage,1, &commandBuffers[currentFrame], 1, signalSemaphores);
-	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+	//binary renderFinished for present + the frame's graphicsTimeline value
+	VkSemaphore submitSignals[] = { renderFinishedSemaphores[currentFrame], graphicsTimeline.GetSemaphore() };
+	uint64_t submitSignalValues[] = { 0, recordingFrameValue };
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.signalSemaphoreValueCount = 2;
+	timelineInfo.pSignalSemaphoreValues = submitSignalValues;
+	VkSubmitInfo submitInfo = Initializer::InitSubmitInfo(1, waitSemaphores,waitStage,1, &commandBuffers[currentFrame], 2, submitSignals);
+	submitInfo.pNext = &timelineInfo;
+	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
 		throw std::runtime_error("failed to submit draw command buffer!");
 	}
+	frameTimelineValues[currentFrame] = recordingFrameValue;
+	lastSubmittedFrame = currentFrame;
 	VkPresentInfoKHR presentInfo = Initializer::InitPresentInfo(1, signalSemaphores, 1, &swapChain, &imageIdx);
 	result = vkQueuePresentKHR(presentQueue, &presentInfo);
 	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
@@ -581,14 +681,17 @@ void Renderer::Render() {
 	else if (result != VK_SUCCESS) {
 		throw std::runtime_error("failed to present swap chain image!");
 	}
-	vkQueueWaitIdle(presentQueue);
-	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	currentFrame = (currentFrame + 1) % framesInFlight;
+}
+
+void Renderer::SetFramesInFlight(uint32_t count) {
+	framesInFlight = std::max(1u, std::min(count, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT)));
+	currentFrame = currentFrame % framesInFlight;
 }
 
 void Renderer::CleanUpSwapChain() {
 	vkDestroyImageView(device, depthImageView, nullptr);
-	vkDestroyImage(device, depthImage, nullptr);
-	vkFreeMemory(device, depthImageMemory, nullptr);
+	DestroyImage(device, allocator, depthImage, depthImageMemory);
 	for (size_t i = 0; i < swapChainFramebuffers.size(); i++) {
 		vkDestroyFramebuffer(device, swapChainFramebuffers[i], nullptr);
 	}
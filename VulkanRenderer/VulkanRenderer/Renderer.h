@@ -6,6 +6,12 @@
 #include <stdexcept>
 #include <functional>
 #include "Tools/Utils.hpp"
+#include "Tools/StagingRing.hpp"
+#include "Tools/UploadBatch.hpp"
+#include "Tools/UploadScheduler.hpp"
+#include "Tools/GpuTimeline.hpp"
+#include "Tools/DeletionQueue.hpp"
+#include "Tools/ThreadPool.hpp"
 #include "GlobalStructs.hpp"
 
 struct RendererCustomFuncs {
@@ -14,8 +20,14 @@ struct RendererCustomFuncs {
 	std::function<bool(const VkSurfaceFormatKHR& availableFormat)>checkSwapSurfaceFormatFunc = nullptr;
 	std::function<bool(const VkPresentModeKHR& availableFormat)>checkSwapPresentModeFunc = nullptr;
 	std::function<void(VkCommandBuffer, VkFramebuffer, uint32_t)> renderFunc = nullptr;
+	VkDeviceSize stagingRingSize = StagingRing::DEFAULT_SIZE;
+	bool useTransferQueue = true;	//false -> uploads run on the graphics queue
+	uint32_t framesInFlight = 2;	//1 ~ MAX_FRAMES_IN_FLIGHT, can be changed later with SetFramesInFlight()
+	bool lowLatencyMode = false;
+	uint32_t workerThreads = 0;	//import worker threads, 0 -> hardware threads - 1
 };
-const int MAX_FRAMES_IN_FLIGHT = 2;
+//per frame resources are created for MAX_FRAMES_IN_FLIGHT frames, how many are actually used is set at runtime
+const int MAX_FRAMES_IN_FLIGHT = 3;
 const int MAX_NUM_TEXTURE_BINDING = 8;
 
 class Renderer {
@@ -37,7 +49,25 @@ public:
 	VkDevice device = { VK_NULL_HANDLE };
 	VkQueue graphicsQueue = { VK_NULL_HANDLE };
 	VkQueue presentQueue = { VK_NULL_HANDLE };
+	VkQueue transferQueue = { VK_NULL_HANDLE };	//same as graphicsQueue when there is no dedicated transfer family
+	uint32_t graphicsFamilyIndex = 0;
+	uint32_t transferFamilyIndex = 0;
 	VkCommandPool commandPool = { VK_NULL_HANDLE };
+	MemoryAllocator allocator;
+	StagingRing stagingRing;
+	UploadContext uploadContext;
+	//budgeted uploads, drained a little every Render(). see GetFrameStats() for the last frame's numbers
+	UploadScheduler uploadScheduler;
+	//every graphics queue submit (frames and upload acquires) signals graphicsTimeline.
+	//transferTimeline is only used with a dedicated transfer family.
+	GpuTimeline graphicsTimeline;
+	GpuTimeline transferTimeline;
+	//objects released by Clean() calls are destroyed here once the gpu has finished the frames using them
+	DeletionQueue deletionQueue;
+	//features the device was created with, optional ones (textureCompressionBC / ASTC_LDR) are on when supported
+	VkPhysicalDeviceFeatures enabledFeatures{};
+	//cpu workers for asset import, never record or submit vulkan commands from them
+	ThreadPool workers;
 	std::vector<VkDescriptorSet>texDescriptorSets;
 	VkDescriptorSetLayout texDescriptorSetLayout = VK_NULL_HANDLE;
 	VkDescriptorPool texDescriptorPool = VK_NULL_HANDLE;
@@ -70,18 +100,18 @@ private:
 	VkPipeline defaultPipeline = { VK_NULL_HANDLE };
 	VkPipelineLayout defaultPipelineLayout = { VK_NULL_HANDLE };
 	VkImage depthImage = VK_NULL_HANDLE;
-	VkDeviceMemory depthImageMemory = VK_NULL_HANDLE;
+	MemoryAllocation depthImageMemory;
 	VkImageView depthImageView = VK_NULL_HANDLE;
 
 	std::vector<VkFramebuffer> swapChainFramebuffers;
 	std::vector<VkCommandBuffer> commandBuffers;
 	
 	std::vector<VkBuffer> vertexUniformBuffers;
-	std::vector<VkDeviceMemory> vertexUniformBuffersMemory;
+	std::vector<MemoryAllocation> vertexUniformBuffersMemory;
 	std::vector<void*> vertexUniformBuffersMapped;
 
 	std::vector<VkBuffer> fragUniformBuffers;
-	std::vector<VkDeviceMemory> fragUniformBuffersMemory;
+	std::vector<MemoryAllocation> fragUniformBuffersMemory;
 	std::vector<void*> fragUniformBuffersMapped;
 	
 	VkPipeline textureDebugPipeline;
@@ -90,11 +120,25 @@ private:
 	VkDescriptorPool textureDebugDescriptorPool;
 	std::vector<VkDescriptorSet> textureDebugDescriptorSets;
 
+	//meshlet culling of Model::Cull(), VK_NULL_HANDLE when the device can't draw its output indirectly
+	VkPipeline clusterCullPipeline = VK_NULL_HANDLE;
+	VkPipelineLayout clusterCullPipelineLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout clusterCullDescriptorSetLayout = VK_NULL_HANDLE;
+	uint32_t maxDrawIndirectCount = 1;
+
 	uint32_t currentFrame = 0;
+	uint32_t framesInFlight = 2;
+	bool lowLatencyMode = false;
+	uint32_t lastSubmittedFrame = UINT32_MAX;
 	std::vector<VkSemaphore> imageAvailableSemaphores;
 	std::vector<VkSemaphore> renderFinishedSemaphores;
-	std::vector<VkFence> inFlightFences;
+	uint64_t frameTimelineValues[MAX_FRAMES_IN_FLIGHT] = {};	//graphicsTimeline value signaled by each frame slot's last submit
+	uint64_t recordingFrameValue = 0;
 	bool framebufferResized = false;
+	std::vector<std::function<bool()>> frameTasks;
+	VkDeviceSize stagingRingSize = StagingRing::DEFAULT_SIZE;
+	bool useTransferQueue = true;
+	uint32_t workerThreads = 0;
 	float deltaTime = 0.0f;
 	float lastTime = 0.0f;
 public:
@@ -105,6 +149,13 @@ public:
 	static Renderer* GetInstance(GLFWwindow* window, RendererCustomFuncs* funcs);
 	void UpdateVertexUniformBuffer(uint32_t currentImage, GlobalStructs::VertexShaderUBO& ubo);
 	void UpdateFragUniformBuffer(uint32_t currentImage, GlobalStructs::FragmentShaderUBO& ubo);
+	//how far the cpu may run ahead of the gpu, clamped to 1 ~ MAX_FRAMES_IN_FLIGHT
+	void SetFramesInFlight(uint32_t count);
+	//waits for the previous frame before recording the next one, at most one frame is queued
+	void SetLowLatencyMode(bool enable) { lowLatencyMode = enable; }
+	//runs at the start of every Render() before uploadScheduler, tasks may schedule or submit uploads.
+	//a task returning false is dropped. used by streaming loads (Model::LoadModelAsync)
+	void AddFrameTask(std::function<bool()> task) { frameTasks.push_back(std::move(task)); }
 
 #pragma region Getter Functions
 	//Gettter Functions
@@ -121,6 +172,18 @@ public:
 	const VkPipelineLayout GetTextureDebugPipelineLayout() const{ return textureDebugPipelineLayout; };
 	const VkPipeline GetTextureDebugPipeline() const { return textureDebugPipeline; }
 	const VkDescriptorSet GetTextureDebugDescriptorSet(uint32_t currentFrame) const { return textureDebugDescriptorSets[currentFrame]; }
+	const VkPipeline GetClusterCullPipeline() const { return clusterCullPipeline; }
+	const VkPipelineLayout GetClusterCullPipelineLayout() const { return clusterCullPipelineLayout; }
+	const VkDescriptorSetLayout GetClusterCullDescriptorSetLayout() const { return clusterCullDescriptorSetLayout; }
+	//draws one vkCmdDrawIndexedIndirect may take
+	const uint32_t GetMaxDrawIndirectCount() const { return maxDrawIndirectCount; }
+	const uint32_t GetFramesInFlight() const { return framesInFlight; }
+	const uint32_t GetCurrentFrame() const { return currentFrame; }
+	const bool IsLowLatencyMode() const { return lowLatencyMode; }
+	//graphicsTimeline value the frame being recorded will signal, valid inside renderFunc.
+	//resources drawn in renderFunc remember it, uploads must not be submitted from renderFunc
+	//because the frame submit has to signal its value before any later reservation.
+	const uint64_t GetFrameTimelineValue() const { return recordingFrameValue; }
 	const float GetDeltaTime() { 
 		float curTime = glfwGetTime();
 		deltaTime = curTime - lastTime;
@@ -156,6 +219,7 @@ private:
 	void CreateSyncObject();
 	void CreateDefaultSampler();
 	void CreateTextureDebugResources();
+	void CreateClusterCullResources();
 
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device);
 	bool IsDeviceSuitable(VkPhysicalDevice device);
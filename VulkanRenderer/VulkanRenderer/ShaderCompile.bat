@@ -1,7 +0,0 @@
-C:\VulkanSDK\1.3.275.0\Bin\glslc.exe DefaultVertexShader.vert -o DefaultVertexShader.spv
-C:\VulkanSDK\1.3.275.0\Bin\glslc.exe DefaultFragmentShader.frag -o DefaultFragmentShader.spv
-C:\VulkanSDK\1.3.275.0\Bin\glslc.exe ShadowMapping.vert -o ShadowMappingVert.spv
-C:\VulkanSDK\1.3.275.0\Bin\glslc.exe ShadowMapping.frag -o ShadowMappingFrag.spv
-C:\VulkanSDK\1.3.275.0\Bin\glslc.exe TextureDebug.vert -o TextureDebugVert.spv
-C:\VulkanSDK\1.3.275.0\Bin\glslc.exe TextureDebug.frag -o TextureDebugFrag.spv
-pause
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include <Tools/DeletionQueue.hpp>
+#include <Tools/Utils.hpp>
+#include <cstdio>
+
+template<typename T>
+static uint64_t ToHandle(T handle) { return (uint64_t)(handle); }
+template<typename T>
+static T FromHandle(uint64_t handle) { return (T)(handle); }
+
+void DeletionQueue::Init(VkDevice _device, MemoryAllocator* _allocator, GpuTimeline* _timeline) {
+	device = _device;
+	allocator = _allocator;
+	timeline = _timeline;
+}
+
+void DeletionQueue::Clean() {
+	std::deque<Entry> entries;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		entries.swap(pending);
+	}
+	//a lost device runs nothing anymore, its objects are still destroyed
+	if (!entries.empty() && !timeline->WaitIdle()) {
+		printf("DeletionQueue : destroying %zu objects without the gpu finishing\n", entries.size());
+	}
+	for (auto& entry : entries) {
+		Destroy(entry);
+	}
+	if (destroyedCount > 0) {
+		printf("DeletionQueue : %u objects destroyed\n", destroyedCount);
+	}
+}
+
+void DeletionQueue::Push(Type type, uint64_t handle, uint64_t afterValue, uint64_t owner, const MemoryAllocation* memory) {
+	//a null handle may still come with memory (e.g. a buffer whose creation failed after the allocation)
+	if (handle == 0 && (memory == nullptr || memory->memory == VK_NULL_HANDLE)) return;
+	Entry entry{};
+	entry.type = type;
+	entry.handle = handle;
+	entry.owner = owner;
+	//a frame may be recording with the reserved value, so the last reserved value is the safe default
+	entry.value = afterValue != 0 ? afterValue : timeline->GetLastReserved();
+	if (memory != nullptr) entry.memory = *memory;
+	std::lock_guard<std::mutex> lock(mutex);
+	pending.push_back(entry);
+}
+
+void DeletionQueue::PushBuffer(VkBuffer& buffer, MemoryAllocation& memory, uint64_t afterValue) {
+	Push(Type::Buffer, ToHandle(buffer), afterValue, 0, &memory);
+	buffer = VK_NULL_HANDLE;
+	memory = MemoryAllocation{};
+}
+
+void DeletionQueue::PushImage(VkImage& image, MemoryAllocation& memory, uint64_t afterValue) {
+	Push(Type::Image, ToHandle(image), afterValue, 0, &memory);
+	image = VK_NULL_HANDLE;
+	memory = MemoryAllocation{};
+}
+
+void DeletionQueue::PushImageView(VkImageView& view, uint64_t afterValue) {
+	Push(Type::ImageView, ToHandle(view), afterValue);
+	view = VK_NULL_HANDLE;
+}
+
+void DeletionQueue::PushSampler(VkSampler& sampler, uint64_t afterValue) {
+	Push(Type::Sampler, ToHandle(sampler), afterValue);
+	sampler = VK_NULL_HANDLE;
+}
+
+void DeletionQueue::PushFramebuffer(VkFramebuffer& framebuffer, uint64_t afterValue) {
+	Push(Type::Framebuffer, ToHandle(framebuffer), afterValue);
+	framebuffer = VK_NULL_HANDLE;
+}
+
+void DeletionQueue::PushPipeline(VkPipeline& pipeline, uint64_t afterValue) {
+	Push(Type::Pipeline, ToHandle(pipeline), afterValue);
+	pipeline = VK_NULL_HANDLE;
+}
+
+void DeletionQueue::PushPipelineLayout(VkPipelineLayout& layout, uint64_t afterValue) {
+	Push(Type::PipelineLayout, ToHandle(layout), afterValue);
+	layout = VK_NULL_HANDLE;
+}
+
+void DeletionQueue::PushDescriptorSet(VkDescriptorPool pool, VkDescriptorSet& set, uint64_t afterValue) {
+	Push(Type::DescriptorSet, ToHandle(set), afterValue, ToHandle(pool));
+	set = VK_NULL_HANDLE;
+}
+
+void DeletionQueue::PushDescriptorPool(VkDescriptorPool& pool, uint64_t afterValue) {
+	Push(Type::DescriptorPool, ToHandle(pool), afterValue);
+	pool = VK_NULL_HANDLE;
+}
+
+size_t DeletionQueue::GetPendingCount() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return pending.size();
+}
+
+void DeletionQueue::Collect() {
+	std::lock_guard<std::mutex> lock(mutex);
+	//values are pushed almost in order, stop at the first one the gpu has not reached
+	while (!pending.empty() && timeline->HasCompleted(pending.front().value)) {
+		Destroy(pending.front());
+		pending.pop_front();
+	}
+}
+
+void DeletionQueue::Destroy(Entry& entry) {
+	switch (entry.type) {
+	case Type::Buffer: {
+		VkBuffer buffer = FromHandle<VkBuffer>(entry.handle);
+		Utils::DestroyBuffer(device, *allocator, buffer, entry.memory);
+		break;
+	}
+	case Type::Image: {
+		VkImage image = FromHandle<VkImage>(entry.handle);
+		Utils::DestroyImage(device, *allocator, image, entry.memory);
+		break;
+	}
+	case Type::ImageView:
+		vkDestroyImageView(device, FromHandle<VkImageView>(entry.handle), nullptr);
+		break;
+	case Type::Sampler:
+		vkDestroySampler(device, FromHandle<VkSampler>(entry.handle), nullptr);
+		break;
+	case Type::Framebuffer:
+		vkDestroyFramebuffer(device, FromHandle<VkFramebuffer>(entry.handle), nullptr);
+		break;
+	case Type::Pipeline:
+		vkDestroyPipeline(device, FromHandle<VkPipeline>(entry.handle), nullptr);
+		break;
+	case Type::PipelineLayout:
+		vkDestroyPipelineLayout(device, FromHandle<VkPipelineLayout>(entry.handle), nullptr);
+		break;
+	case Type::DescriptorSet: {
+		VkDescriptorSet set = FromHandle<VkDescriptorSet>(entry.handle);
+		vkFreeDescriptorSets(device, FromHandle<VkDescriptorPool>(entry.owner), 1, &set);
+		break;
+	}
+	case Type::DescriptorPool:
+		vkDestroyDescriptorPool(device, FromHandle<VkDescriptorPool>(entry.handle), nullptr);
+		break;
+	}
+	destroyedCount++;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#ifndef DELETION_QUEUE_HPP
+#define DELETION_QUEUE_HPP
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <deque>
+#include <mutex>
+#include "MemoryAllocator.hpp"
+#include "GpuTimeline.hpp"
+
+// Destroys vulkan objects once the gpu is done with them, so Clean() never has to wait for the device.
+// each object is retired with a graphics timeline value, afterValue == 0 means "everything submitted or
+// being recorded so far", which is always safe. Collect() is called once per frame by the renderer.
+// objects are destroyed in the order they were pushed. Push*() may be called from any thread (the last reference
+// to a shared texture or geometry can drop on a worker), Collect() and Clean() run on the render thread.
+class DeletionQueue {
+public:
+	void Init(VkDevice _device, MemoryAllocator* _allocator, GpuTimeline* _timeline);
+	// waits for the gpu and destroys everything that is left
+	void Clean();
+
+	void PushBuffer(VkBuffer& buffer, MemoryAllocation& memory, uint64_t afterValue = 0);
+	void PushImage(VkImage& image, MemoryAllocation& memory, uint64_t afterValue = 0);
+	void PushImageView(VkImageView& view, uint64_t afterValue = 0);
+	void PushSampler(VkSampler& sampler, uint64_t afterValue = 0);
+	void PushFramebuffer(VkFramebuffer& framebuffer, uint64_t afterValue = 0);
+	void PushPipeline(VkPipeline& pipeline, uint64_t afterValue = 0);
+	void PushPipelineLayout(VkPipelineLayout& layout, uint64_t afterValue = 0);
+	// the pool must have been created with VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
+	void PushDescriptorSet(VkDescriptorPool pool, VkDescriptorSet& set, uint64_t afterValue = 0);
+	void PushDescriptorPool(VkDescriptorPool& pool, uint64_t afterValue = 0);
+
+	// destroy every object whose timeline value has been reached
+	void Collect();
+	size_t GetPendingCount() const;
+	uint32_t GetDestroyedCount() const { return destroyedCount; }
+private:
+	enum class Type { Buffer, Image, ImageView, Sampler, Framebuffer, Pipeline, PipelineLayout, DescriptorSet, DescriptorPool };
+	struct Entry {
+		Type type;
+		uint64_t value = 0;
+		uint64_t handle = 0;	// non-dispatchable handles are 64 bit on every platform
+		uint64_t owner = 0;		// descriptor pool of a descriptor set
+		MemoryAllocation memory;
+	};
+	VkDevice device = VK_NULL_HANDLE;
+	MemoryAllocator* allocator = nullptr;
+	GpuTimeline* timeline = nullptr;
+	std::deque<Entry> pending;
+	mutable std::mutex mutex;	// guards pending
+	uint32_t destroyedCount = 0;
+
+	void Push(Type type, uint64_t handle, uint64_t afterValue, uint64_t owner = 0, const MemoryAllocation* memory = nullptr);
+	void Destroy(Entry& entry);
+};
+
+#endif // !DELETION_QUEUE_HPP
@@ -5,8 +5,9 @@
 void FrameBuffer::Clean() {
 	Renderer* instance = Renderer::GetInstance();
 	for (size_t i = 0; i < framebuffers.size(); i++) {
-		vkDestroyFramebuffer(instance->device, framebuffers[i], nullptr);
+		instance->deletionQueue.PushFramebuffer(framebuffers[i]);
 	}
+	framebuffers.clear();
 }
 void FrameBuffer::SetUp(VkExtent2D extent, std::vector<VkImageView>& attachments, VkRenderPass renderPass, const uint32_t frameCount) {
 	Renderer* instnace = Renderer::GetInstance();
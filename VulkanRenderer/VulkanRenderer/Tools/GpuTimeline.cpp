@@ -0,0 +1,57 @@
+#include <Tools/GpuTimeline.hpp>
+#include <Tools/Utils.hpp>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdio>
+
+void GpuTimeline::Init(VkDevice _device, const std::string& _name) {
+	device = _device;
+	name = _name;
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = 0;
+	VkSemaphoreCreateInfo semaphoreInfo = Initializer::InitSemaphoreCreateInfo();
+	semaphoreInfo.pNext = &typeInfo;
+	if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create " + name + " timeline semaphore!");
+	}
+	lastReserved = 0;
+	completed = 0;
+}
+
+void GpuTimeline::Clean() {
+	if (semaphore == VK_NULL_HANDLE) return;
+	vkDestroySemaphore(device, semaphore, nullptr);
+	semaphore = VK_NULL_HANDLE;
+}
+
+uint64_t GpuTimeline::GetCompletedValue() {
+	if (completed < lastReserved) {
+		vkGetSemaphoreCounterValue(device, semaphore, &completed);
+	}
+	return completed;
+}
+
+bool GpuTimeline::HasCompleted(uint64_t value) {
+	if (value <= completed) return true;
+	return value <= GetCompletedValue();
+}
+
+bool GpuTimeline::WaitFor(uint64_t value, uint64_t timeout) {
+	if (HasCompleted(value)) return true;
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &semaphore;
+	waitInfo.pValues = &value;
+	VkResult result = vkWaitSemaphores(device, &waitInfo, timeout);
+	if (result == VK_SUCCESS) {
+		completed = std::max(completed, value);
+		return true;
+	}
+	if (result != VK_TIMEOUT) {
+		printf("%s timeline : wait for %llu failed (VkResult %d)\n", name.c_str(), static_cast<unsigned long long>(value), static_cast<int>(result));
+	}
+	return false;
+}
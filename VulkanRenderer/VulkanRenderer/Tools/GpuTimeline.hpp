@@ -0,0 +1,45 @@
+#pragma once
+#ifndef GPU_TIMELINE_HPP
+#define GPU_TIMELINE_HPP
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <string>
+#include <atomic>
+
+// Monotonic GPU progress counter of one queue, backed by a timeline semaphore.
+// every submit on the queue signals Reserve()'d value, submits must happen in reservation order.
+// resources remember the value of the last submit that used them and are free once HasCompleted(value).
+class GpuTimeline {
+public:
+	void Init(VkDevice _device, const std::string& _name);
+	void Clean();
+
+	// value the next submit on this queue will signal. reserving and submitting stay on the render thread,
+	// GetLastReserved() may be read from any thread (DeletionQueue::Push)
+	uint64_t Reserve() { return ++lastReserved; }
+	uint64_t GetLastReserved() const { return lastReserved; }
+	// value reached by the gpu, cached until the next query
+	uint64_t GetCompletedValue();
+	bool HasCompleted(uint64_t value);
+	// false when value wasn't reached : timeout, or the wait failed (device lost), which is also printed.
+	// nothing the caller waited for may be reused or reset then
+	bool WaitFor(uint64_t value, uint64_t timeout = UINT64_MAX);
+	bool WaitIdle() { return WaitFor(lastReserved); }
+
+	VkSemaphore GetSemaphore() const { return semaphore; }
+	const std::string& GetName() const { return name; }
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+	std::atomic<uint64_t> lastReserved{ 0 };
+	uint64_t completed = 0;
+	std::string name;
+};
+
+// last use of a resource, 0 means never used. graphics values only : the graphics half of every upload batch
+// waits on its transfer submit, so a graphics value also covers the copies (and ownership releases) before it
+struct TimelineTag {
+	uint64_t graphicsValue = 0;
+};
+
+#endif // !GPU_TIMELINE_HPP
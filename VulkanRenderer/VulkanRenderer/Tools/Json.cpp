@@ -0,0 +1,202 @@
+#include <Tools/Json.hpp>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+
+class JsonParser {
+public:
+	JsonParser(const char* _text, size_t _size) :text(_text), end(_text + _size), cursor(_text) {}
+
+	JsonValue ParseDocument() {
+		JsonValue value = ParseValue(0);
+		SkipWhitespace();
+		if (cursor != end) Fail("trailing characters");
+		return value;
+	}
+private:
+	//deeper documents are certainly broken or hostile
+	static constexpr int MAX_DEPTH = 256;
+	const char* text;
+	const char* end;
+	const char* cursor;
+
+	[[noreturn]] void Fail(const char* reason) {
+		throw std::runtime_error(std::string("failed to parse json : ") + reason + " at offset " + std::to_string(cursor - text));
+	}
+	void SkipWhitespace() {
+		while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r')) cursor++;
+	}
+	bool Consume(const char* literal) {
+		size_t length = strlen(literal);
+		if (size_t(end - cursor) < length || memcmp(cursor, literal, length) != 0) return false;
+		cursor += length;
+		return true;
+	}
+	JsonValue ParseValue(int depth) {
+		if (depth > MAX_DEPTH) Fail("nested too deep");
+		SkipWhitespace();
+		if (cursor == end) Fail("unexpected end");
+		JsonValue value;
+		switch (*cursor) {
+		case '{':
+			value.type = JsonValue::Type::Object;
+			cursor++;
+			SkipWhitespace();
+			if (cursor < end && *cursor == '}') {
+				cursor++;
+				return value;
+			}
+			for (;;) {
+				SkipWhitespace();
+				if (cursor == end || *cursor != '"') Fail("expected a member name");
+				std::string key = ParseString();
+				SkipWhitespace();
+				if (cursor == end || *cursor != ':') Fail("expected ':'");
+				cursor++;
+				value.members.emplace_back(std::move(key), ParseValue(depth + 1));
+				SkipWhitespace();
+				if (cursor < end && *cursor == ',') { cursor++; continue; }
+				if (cursor < end && *cursor == '}') { cursor++; break; }
+				Fail("expected ',' or '}'");
+			}
+			return value;
+		case '[':
+			value.type = JsonValue::Type::Array;
+			cursor++;
+			SkipWhitespace();
+			if (cursor < end && *cursor == ']') {
+				cursor++;
+				return value;
+			}
+			for (;;) {
+				value.elements.push_back(ParseValue(depth + 1));
+				SkipWhitespace();
+				if (cursor < end && *cursor == ',') { cursor++; continue; }
+				if (cursor < end && *cursor == ']') { cursor++; break; }
+				Fail("expected ',' or ']'");
+			}
+			return value;
+		case '"':
+			value.type = JsonValue::Type::String;
+			value.text = ParseString();
+			return value;
+		case 't':
+		case 'f':
+			value.type = JsonValue::Type::Bool;
+			if (Consume("true")) value.boolean = true;
+			else if (!Consume("false")) Fail("unknown literal");
+			return value;
+		case 'n':
+			if (!Consume("null")) Fail("unknown literal");
+			return value;
+		default:
+			value.type = JsonValue::Type::Number;
+			value.number = ParseNumber();
+			return value;
+		}
+	}
+	double ParseNumber() {
+		//strtod needs a terminated string, numbers are short
+		char buffer[64];
+		size_t length = 0;
+		while (cursor + length < end && length < sizeof(buffer) - 1 && strchr("+-0123456789.eE", cursor[length]) != nullptr) length++;
+		if (length == 0) Fail("unexpected character");
+		memcpy(buffer, cursor, length);
+		buffer[length] = '\0';
+		char* parsed = nullptr;
+		double number = strtod(buffer, &parsed);
+		if (parsed != buffer + length) Fail("malformed number");
+		cursor += length;
+		return number;
+	}
+	uint32_t ParseHex4() {
+		if (end - cursor < 4) Fail("short unicode escape");
+		uint32_t code = 0;
+		for (int i = 0; i < 4; i++) {
+			char c = *cursor++;
+			code <<= 4;
+			if (c >= '0' && c <= '9') code |= c - '0';
+			else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+			else Fail("bad unicode escape");
+		}
+		return code;
+	}
+	static void AppendUtf8(std::string& out, uint32_t code) {
+		if (code < 0x80) out += static_cast<char>(code);
+		else if (code < 0x800) {
+			out += static_cast<char>(0xC0 | (code >> 6));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+		else if (code < 0x10000) {
+			out += static_cast<char>(0xE0 | (code >> 12));
+			out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+		else {
+			out += static_cast<char>(0xF0 | (code >> 18));
+			out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+			out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+	}
+	std::string ParseString() {
+		cursor++;	// opening quote
+		std::string out;
+		for (;;) {
+			if (cursor == end) Fail("unterminated string");
+			char c = *cursor++;
+			if (c == '"') return out;
+			if (c != '\\') {
+				out += c;
+				continue;
+			}
+			if (cursor == end) Fail("unterminated string");
+			char escape = *cursor++;
+			switch (escape) {
+			case '"': out += '"'; break;
+			case '\\': out += '\\'; break;
+			case '/': out += '/'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u': {
+				uint32_t code = ParseHex4();
+				//surrogate pair
+				if (code >= 0xD800 && code < 0xDC00 && end - cursor >= 6 && cursor[0] == '\\' && cursor[1] == 'u') {
+					cursor += 2;
+					uint32_t low = ParseHex4();
+					code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+				}
+				AppendUtf8(out, code);
+				break;
+			}
+			default: Fail("unknown escape");
+			}
+		}
+	}
+};
+
+JsonValue JsonValue::Parse(const char* text, size_t size) {
+	return JsonParser(text, size).ParseDocument();
+}
+
+const JsonValue& JsonValue::Null() {
+	static const JsonValue null;
+	return null;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const {
+	if (type != Type::Array || index >= elements.size()) return Null();
+	return elements[index];
+}
+
+const JsonValue& JsonValue::operator[](const char* key) const {
+	if (type != Type::Object) return Null();
+	for (const auto& member : members) {
+		if (member.first == key) return member.second;
+	}
+	return Null();
+}
@@ -0,0 +1,51 @@
+#pragma once
+#ifndef JSON_HPP
+#define JSON_HPP
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+// Minimal read only json document, enough for asset formats (glTF).
+// missing members and out of range elements return a shared null value, so lookups can be chained :
+// doc["meshes"][0]["primitives"].Size()
+class JsonValue {
+public:
+	enum class Type { Null, Bool, Number, String, Array, Object };
+
+	// throws std::runtime_error on malformed input
+	static JsonValue Parse(const char* text, size_t size);
+
+	Type GetType() const { return type; }
+	bool IsNull() const { return type == Type::Null; }
+	bool IsNumber() const { return type == Type::Number; }
+	bool IsString() const { return type == Type::String; }
+	bool IsArray() const { return type == Type::Array; }
+	bool IsObject() const { return type == Type::Object; }
+
+	double GetNumber(double fallback = 0.0) const { return type == Type::Number ? number : fallback; }
+	int GetInt(int fallback = -1) const { return type == Type::Number ? static_cast<int>(number) : fallback; }
+	bool GetBool(bool fallback = false) const { return type == Type::Bool ? boolean : fallback; }
+	const std::string& GetString() const { return text; }
+
+	// elements of an array, members of an object
+	size_t Size() const { return type == Type::Array ? elements.size() : type == Type::Object ? members.size() : 0; }
+	const JsonValue& operator[](size_t index) const;
+	const JsonValue& operator[](int index) const { return index < 0 ? Null() : (*this)[static_cast<size_t>(index)]; }
+	const JsonValue& operator[](const char* key) const;
+	bool Has(const char* key) const { return !(*this)[key].IsNull(); }
+	const std::vector<std::pair<std::string, JsonValue>>& GetMembers() const { return members; }
+private:
+	Type type = Type::Null;
+	bool boolean = false;
+	double number = 0.0;
+	std::string text;
+	std::vector<JsonValue> elements;
+	std::vector<std::pair<std::string, JsonValue>> members;
+
+	static const JsonValue& Null();
+	friend class JsonParser;
+};
+
+#endif // !JSON_HPP
@@ -0,0 +1,34 @@
+#pragma once
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Read only memory mapping of a whole file. the pages are filled by the os on first touch,
+// so reading a cache file costs no parse and no extra copy before the staging memcpy.
+class MappedFile {
+public:
+	MappedFile() {}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { Close(); }
+
+	// false when the file is missing, empty or can't be mapped
+	bool Open(const std::string& path);
+	// safe to call more than once
+	void Close();
+
+	const uint8_t* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+	bool IsOpen() const { return data != nullptr; }
+private:
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
+
+#endif // !MAPPED_FILE_HPP
@@ -0,0 +1,335 @@
+#include <Tools/MemoryAllocator.hpp>
+#include <Tools/Utils.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+	return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+static uint32_t CountBits(uint32_t value) {
+	uint32_t count = 0;
+	for (; value != 0; value &= value - 1) count++;
+	return count;
+}
+
+#pragma region MemoryBlock
+bool MemoryBlock::Allocate(VkDeviceSize allocSize, VkDeviceSize alignment, VkDeviceSize& outOffset) {
+	//best fit, so big ranges stay big for textures. candidates are scored at their aligned offset :
+	//the padding in front is lost space too, and on a tie the smaller padding wins since a fragment below
+	//the alignment is hardly ever reused
+	auto best = freeRanges.end();
+	VkDeviceSize bestWaste = ~0ull;
+	VkDeviceSize bestPadding = ~0ull;
+	for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+		VkDeviceSize aligned = AlignUp(it->first, alignment);
+		VkDeviceSize rangeEnd = it->first + it->second;
+		if (aligned > rangeEnd || allocSize > rangeEnd - aligned) continue;
+		VkDeviceSize padding = aligned - it->first;
+		VkDeviceSize waste = padding + (rangeEnd - aligned - allocSize);
+		if (waste < bestWaste || (waste == bestWaste && padding < bestPadding)) {
+			bestWaste = waste;
+			bestPadding = padding;
+			best = it;
+			if (waste == 0) break;
+		}
+	}
+	if (best == freeRanges.end()) return false;
+
+	VkDeviceSize rangeOffset = best->first;
+	VkDeviceSize rangeEnd = best->first + best->second;
+	VkDeviceSize aligned = AlignUp(rangeOffset, alignment);
+	freeRanges.erase(best);
+	if (aligned > rangeOffset) freeRanges[rangeOffset] = aligned - rangeOffset;
+	if (aligned + allocSize < rangeEnd) freeRanges[aligned + allocSize] = rangeEnd - (aligned + allocSize);
+	used += allocSize;
+	allocationCount++;
+	outOffset = aligned;
+	return true;
+}
+
+void MemoryBlock::Free(VkDeviceSize offset, VkDeviceSize allocSize) {
+	auto inserted = freeRanges.emplace(offset, allocSize).first;
+	//merge with next range
+	auto next = std::next(inserted);
+	if (next != freeRanges.end() && inserted->first + inserted->second == next->first) {
+		inserted->second += next->second;
+		freeRanges.erase(next);
+	}
+	//merge with previous range
+	if (inserted != freeRanges.begin()) {
+		auto prev = std::prev(inserted);
+		if (prev->first + prev->second == inserted->first) {
+			prev->second += inserted->second;
+			freeRanges.erase(inserted);
+		}
+	}
+	used -= allocSize;
+	allocationCount--;
+}
+#pragma endregion
+
+void MemoryAllocator::Init(VkDevice _device, VkPhysicalDevice _physicalDevice) {
+	device = _device;
+	physicalDevice = _physicalDevice;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+	pools.resize(memProperties.memoryTypeCount * 2);
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		VkDeviceSize heapSize = memProperties.memoryHeaps[memProperties.memoryTypes[i].heapIndex].size;
+		//small heaps(e.g. 256MB host visible device local) get smaller blocks
+		VkDeviceSize blockSize = std::min(DEFAULT_BLOCK_SIZE, heapSize / 8);
+		blockSize = std::max(SLAB_SIZE, blockSize / SLAB_SIZE * SLAB_SIZE);
+		for (uint32_t j = 0; j < 2; j++) {
+			pools[i * 2 + j].memoryTypeIndex = i;
+			pools[i * 2 + j].blockSize = blockSize;
+			pools[i * 2 + j].slabs.resize(SizeClassIndex(MAX_SIZE_CLASS) + 1);
+		}
+	}
+}
+
+void MemoryAllocator::Clean() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (liveAllocationCount > 0) {
+		printf("MemoryAllocator : %llu allocations are still alive at Clean()\n", (unsigned long long)liveAllocationCount);
+	}
+	for (auto& pool : pools) {
+		for (auto& blocks : pool.slabs) blocks.clear();
+		for (auto& block : pool.blocks) DestroyBlock(block.get());
+		pool.blocks.clear();
+	}
+	pools.clear();
+}
+
+uint32_t MemoryAllocator::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+	//the type with the fewest flags beyond the requested ones, so device local buffers stay out of the small
+	//host visible heap and staging stays out of device local memory. ties keep the driver's order
+	uint32_t best = UINT32_MAX;
+	uint32_t bestExtra = UINT32_MAX;
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		VkMemoryPropertyFlags flags = memProperties.memoryTypes[i].propertyFlags;
+		if (!(typeFilter & (1u << i)) || (flags & properties) != properties) continue;
+		uint32_t extra = CountBits(flags & ~properties);
+		if (extra < bestExtra) {
+			best = i;
+			bestExtra = extra;
+		}
+	}
+	if (best == UINT32_MAX) throw std::runtime_error("failed to find suitable memory type!");
+	return best;
+}
+
+uint32_t MemoryAllocator::SizeClassIndex(VkDeviceSize size) {
+	uint32_t idx = 0;
+	VkDeviceSize classSize = MIN_SIZE_CLASS;
+	while (classSize < size) {
+		classSize <<= 1;
+		idx++;
+	}
+	return idx;
+}
+
+MemoryBlock* MemoryAllocator::CreateBlock(Pool& pool, VkDeviceSize size) {
+	auto block = std::make_unique<MemoryBlock>();
+	VkMemoryAllocateInfo allocInfo = Initializer::InitMemoryAllocateInfo(size, pool.memoryTypeIndex);
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate memory block!");
+	}
+	block->size = size;
+	block->freeRanges[0] = size;
+	if (memProperties.memoryTypes[pool.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped); //persistent mapping
+	}
+	pool.blocks.push_back(std::move(block));
+	return pool.blocks.back().get();
+}
+
+void MemoryAllocator::DestroyBlock(MemoryBlock* block) {
+	if (block->mapped) vkUnmapMemory(device, block->memory);
+	vkFreeMemory(device, block->memory, nullptr);
+	block->memory = VK_NULL_HANDLE;
+}
+
+bool MemoryAllocator::AllocateFromPool(Pool& pool, VkDeviceSize size, VkDeviceSize alignment, MemoryAllocation& out) {
+	for (auto& block : pool.blocks) {
+		VkDeviceSize offset;
+		if (block->Allocate(size, alignment, offset)) {
+			out.block = block.get();
+			out.memory = block->memory;
+			out.offset = offset;
+			out.mapped = block->mapped ? static_cast<char*>(block->mapped) + offset : nullptr;
+			return true;
+		}
+	}
+	MemoryBlock* block = CreateBlock(pool, pool.blockSize);
+	VkDeviceSize offset;
+	if (!block->Allocate(size, alignment, offset)) return false;
+	out.block = block;
+	out.memory = block->memory;
+	out.offset = offset;
+	out.mapped = block->mapped ? static_cast<char*>(block->mapped) + offset : nullptr;
+	return true;
+}
+
+bool MemoryAllocator::AllocateFromSlab(Pool& pool, uint32_t sizeClass, MemoryAllocation& out) {
+	auto& slabs = pool.slabs[sizeClass];
+	MemorySlab* slab = nullptr;
+	for (auto& s : slabs) {
+		if (!s->freeSlots.empty()) {
+			slab = s.get();
+			break;
+		}
+	}
+	if (slab == nullptr) {
+		VkDeviceSize slotSize = MIN_SIZE_CLASS << sizeClass;
+		MemoryAllocation range{};
+		if (!AllocateFromPool(pool, SLAB_SIZE, slotSize, range)) return false;
+		auto newSlab = std::make_unique<MemorySlab>();
+		newSlab->block = range.block;
+		newSlab->offset = range.offset;
+		newSlab->slotSize = slotSize;
+		newSlab->slotCount = static_cast<uint32_t>(SLAB_SIZE / slotSize);
+		newSlab->freeSlots.reserve(newSlab->slotCount);
+		for (uint32_t i = newSlab->slotCount; i > 0; i--) newSlab->freeSlots.push_back(i - 1);
+		slabs.push_back(std::move(newSlab));
+		slab = slabs.back().get();
+	}
+	uint32_t slot = slab->freeSlots.back();
+	slab->freeSlots.pop_back();
+	out.block = slab->block;
+	out.slab = slab;
+	out.memory = slab->block->memory;
+	out.offset = slab->offset + slot * slab->slotSize;
+	out.mapped = slab->block->mapped ? static_cast<char*>(slab->block->mapped) + out.offset : nullptr;
+	return true;
+}
+
+MemoryAllocation MemoryAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear, bool dedicated, VkImage dedicatedImage) {
+	std::lock_guard<std::mutex> lock(mutex);
+	MemoryAllocation result{};
+	result.memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, properties);
+	result.size = requirements.size;
+	result.poolIdx = result.memoryTypeIndex * 2 + (linear ? 0 : 1);
+	Pool& pool = pools[result.poolIdx];
+
+	if (dedicated || requirements.size > pool.blockSize / 2) {
+		VkMemoryAllocateInfo allocInfo = Initializer::InitMemoryAllocateInfo(requirements.size, result.memoryTypeIndex);
+		VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+		if (dedicatedImage != VK_NULL_HANDLE) {
+			dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+			dedicatedInfo.image = dedicatedImage;
+			allocInfo.pNext = &dedicatedInfo;
+		}
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &result.memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate dedicated memory!");
+		}
+		if (memProperties.memoryTypes[result.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			vkMapMemory(device, result.memory, 0, VK_WHOLE_SIZE, 0, &result.mapped);
+		}
+		dedicatedCount++;
+		dedicatedBytes += requirements.size;
+	}
+	else if (requirements.size <= MAX_SIZE_CLASS && requirements.alignment <= MAX_SIZE_CLASS) {
+		uint32_t sizeClass = SizeClassIndex(std::max(requirements.size, requirements.alignment));
+		if (!AllocateFromSlab(pool, sizeClass, result)) {
+			throw std::runtime_error("failed to sub-allocate small object memory!");
+		}
+	}
+	else if (!AllocateFromPool(pool, requirements.size, requirements.alignment, result)) {
+		throw std::runtime_error("failed to sub-allocate memory!");
+	}
+	liveAllocationCount++;
+	totalAllocationCount++;
+	return result;
+}
+
+MemoryAllocation MemoryAllocator::AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties) {
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+	return Allocate(memRequirements, properties, true);
+}
+
+MemoryAllocation MemoryAllocator::AllocateForImage(VkImage image, VkMemoryPropertyFlags properties, VkImageTiling tiling) {
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(device, image, &memRequirements);
+	bool dedicated = memRequirements.size >= DEDICATED_IMAGE_THRESHOLD;
+	return Allocate(memRequirements, properties, tiling == VK_IMAGE_TILING_LINEAR, dedicated, image);
+}
+
+void MemoryAllocator::ReleaseRange(Pool& pool, MemoryBlock* block, VkDeviceSize offset, VkDeviceSize size) {
+	block->Free(offset, size);
+	//keep one empty block per pool to avoid allocate/free thrash on reload
+	if (block->allocationCount == 0 && pool.blocks.size() > 1) {
+		DestroyBlock(block);
+		pool.blocks.erase(std::remove_if(pool.blocks.begin(), pool.blocks.end(),
+			[block](const std::unique_ptr<MemoryBlock>& b) { return b.get() == block; }), pool.blocks.end());
+	}
+}
+
+void MemoryAllocator::Free(MemoryAllocation& allocation) {
+	if (allocation.memory == VK_NULL_HANDLE) return;
+	std::lock_guard<std::mutex> lock(mutex);
+	if (allocation.block == nullptr) {
+		if (allocation.mapped) vkUnmapMemory(device, allocation.memory);
+		vkFreeMemory(device, allocation.memory, nullptr);
+		dedicatedCount--;
+		dedicatedBytes -= allocation.size;
+	}
+	else if (allocation.slab != nullptr) {
+		Pool& pool = pools[allocation.poolIdx];
+		MemorySlab* slab = allocation.slab;
+		slab->freeSlots.push_back(static_cast<uint32_t>((allocation.offset - slab->offset) / slab->slotSize));
+		auto& slabs = pool.slabs[SizeClassIndex(slab->slotSize)];
+		if (slab->freeSlots.size() == slab->slotCount && slabs.size() > 1) {
+			MemoryBlock* block = slab->block;
+			VkDeviceSize offset = slab->offset;
+			slabs.erase(std::remove_if(slabs.begin(), slabs.end(),
+				[slab](const std::unique_ptr<MemorySlab>& s) { return s.get() == slab; }), slabs.end());
+			ReleaseRange(pool, block, offset, SLAB_SIZE);
+		}
+	}
+	else {
+		ReleaseRange(pools[allocation.poolIdx], allocation.block, allocation.offset, allocation.size);
+	}
+	liveAllocationCount--;
+	allocation = MemoryAllocation{};
+}
+
+MemoryStats MemoryAllocator::GetStats() {
+	std::lock_guard<std::mutex> lock(mutex);
+	MemoryStats stats{};
+	VkDeviceSize freeBytes = 0;
+	for (auto& pool : pools) {
+		for (auto& block : pool.blocks) {
+			stats.blockCount++;
+			stats.reservedBytes += block->size;
+			stats.usedBytes += block->used;
+			for (auto& range : block->freeRanges) {
+				freeBytes += range.second;
+				stats.largestFreeRange = std::max(stats.largestFreeRange, range.second);
+			}
+		}
+		for (auto& slabs : pool.slabs) {
+			for (auto& slab : slabs) {
+				stats.slabCount++;
+				stats.usedBytes -= slab->freeSlots.size() * slab->slotSize;
+			}
+		}
+	}
+	stats.dedicatedCount = dedicatedCount;
+	stats.dedicatedBytes = dedicatedBytes;
+	stats.deviceMemoryCount = stats.blockCount + dedicatedCount;
+	stats.allocationCount = liveAllocationCount;
+	stats.totalAllocationCount = totalAllocationCount;
+	stats.fragmentation = freeBytes > 0 ? 1.0f - static_cast<float>(stats.largestFreeRange) / static_cast<float>(freeBytes) : 0.0f;
+	return stats;
+}
+
+void MemoryAllocator::PrintStats() {
+	MemoryStats stats = GetStats();
+	printf("MemoryAllocator : %u vkDeviceMemory (%u blocks, %u dedicated), %llu live allocations (%llu total), %u slabs\n",
+		stats.deviceMemoryCount, stats.blockCount, stats.dedicatedCount,
+		(unsigned long long)stats.allocationCount, (unsigned long long)stats.totalAllocationCount, stats.slabCount);
+	printf("                  blocks used %.2f / %.2f MB, dedicated %.2f MB, largest free range %.2f MB, fragmentation %.1f%%\n",
+		stats.usedBytes / (1024.0 * 1024.0), stats.reservedBytes / (1024.0 * 1024.0), stats.dedicatedBytes / (1024.0 * 1024.0),
+		stats.largestFreeRange / (1024.0 * 1024.0), stats.fragmentation * 100.0f);
+}
@@ -0,0 +1,109 @@
+#pragma once
+#ifndef MEMORY_ALLOCATOR_HPP
+#define MEMORY_ALLOCATOR_HPP
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+
+struct MemoryBlock {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize size = 0;
+	VkDeviceSize used = 0;
+	void* mapped = nullptr;
+	uint32_t allocationCount = 0;
+	std::map<VkDeviceSize, VkDeviceSize> freeRanges; // offset, size
+
+	bool Allocate(VkDeviceSize allocSize, VkDeviceSize alignment, VkDeviceSize& outOffset);
+	void Free(VkDeviceSize offset, VkDeviceSize allocSize);
+};
+
+struct MemorySlab {
+	MemoryBlock* block = nullptr;
+	VkDeviceSize offset = 0;
+	VkDeviceSize slotSize = 0;
+	std::vector<uint32_t> freeSlots;
+	uint32_t slotCount = 0;
+};
+
+// one sub-allocated range of device memory.
+// memory + offset is what you bind, mapped is valid for HOST_VISIBLE memory types (persistently mapped).
+struct MemoryAllocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void* mapped = nullptr;
+	uint32_t memoryTypeIndex = UINT32_MAX;
+private:
+	friend class MemoryAllocator;
+	MemoryBlock* block = nullptr;	// nullptr -> dedicated allocation
+	MemorySlab* slab = nullptr;		// not nullptr -> size class slot
+	uint32_t poolIdx = 0;
+};
+
+struct MemoryStats {
+	uint32_t deviceMemoryCount = 0;		// live vkAllocateMemory objects
+	uint32_t blockCount = 0;
+	uint32_t dedicatedCount = 0;
+	uint32_t slabCount = 0;
+	uint64_t allocationCount = 0;		// live sub-allocations
+	uint64_t totalAllocationCount = 0;	// since Init()
+	VkDeviceSize reservedBytes = 0;		// bytes owned by blocks
+	VkDeviceSize usedBytes = 0;			// bytes handed out from blocks
+	VkDeviceSize dedicatedBytes = 0;
+	VkDeviceSize largestFreeRange = 0;
+	float fragmentation = 0.0f;			// 1 - largestFreeRange / free bytes, 0 means every free byte is in one range
+};
+
+// Block based sub-allocator.
+// - each memory type has two pools, one for linear resources(buffers, linear images) and one for optimal images,
+//   so bufferImageGranularity never has to be considered inside a block.
+// - small requests are rounded up to power of two size classes and served from slabs carved out of the blocks.
+// - requests bigger than half of a block (or flagged dedicated) get their own VkDeviceMemory.
+class MemoryAllocator {
+public:
+	static constexpr VkDeviceSize MIN_SIZE_CLASS = 256;
+	static constexpr VkDeviceSize MAX_SIZE_CLASS = 64 * 1024;
+	static constexpr VkDeviceSize SLAB_SIZE = 1024 * 1024;
+	static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+	static constexpr VkDeviceSize DEDICATED_IMAGE_THRESHOLD = 16 * 1024 * 1024;
+
+	void Init(VkDevice _device, VkPhysicalDevice _physicalDevice);
+	void Clean();
+
+	MemoryAllocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear, bool dedicated = false, VkImage dedicatedImage = VK_NULL_HANDLE);
+	MemoryAllocation AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties);
+	MemoryAllocation AllocateForImage(VkImage image, VkMemoryPropertyFlags properties, VkImageTiling tiling);
+	void Free(MemoryAllocation& allocation);
+
+	MemoryStats GetStats();
+	void PrintStats();
+private:
+	struct Pool {
+		uint32_t memoryTypeIndex = 0;
+		VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE;
+		std::vector<std::unique_ptr<MemoryBlock>> blocks;
+		std::vector<std::vector<std::unique_ptr<MemorySlab>>> slabs; // [size class]
+	};
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memProperties{};
+	std::vector<Pool> pools; // memoryTypeCount * 2
+	std::mutex mutex;
+	uint32_t dedicatedCount = 0;
+	VkDeviceSize dedicatedBytes = 0;
+	uint64_t liveAllocationCount = 0;
+	uint64_t totalAllocationCount = 0;
+
+	uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+	MemoryBlock* CreateBlock(Pool& pool, VkDeviceSize size);
+	void DestroyBlock(MemoryBlock* block);
+	bool AllocateFromPool(Pool& pool, VkDeviceSize size, VkDeviceSize alignment, MemoryAllocation& out);
+	bool AllocateFromSlab(Pool& pool, uint32_t sizeClass, MemoryAllocation& out);
+	void ReleaseRange(Pool& pool, MemoryBlock* block, VkDeviceSize offset, VkDeviceSize size);
+	static uint32_t SizeClassIndex(VkDeviceSize size);
+};
+
+#endif // !MEMORY_ALLOCATOR_HPP
@@ -1,11 +1,22 @@
 #include "PipelineBuilder.hpp"
+#include "ShaderCompiler.hpp"
+#include <filesystem>
 
 VkShaderModule PipelineBuilder::CreateShaderModule(VkDevice device, const std::string& fn) {
-	auto shaderCode = FileLoader::LoadShaderfile(fn);
 	VkShaderModuleCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = shaderCode.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+	std::vector<char> binary;
+	std::vector<uint32_t> compiled;
+	if (std::filesystem::path(fn).extension() == ".spv") {
+		binary = FileLoader::LoadShaderfile(fn);
+		createInfo.codeSize = binary.size();
+		createInfo.pCode = reinterpret_cast<const uint32_t*>(binary.data());
+	}
+	else {
+		compiled = ShaderCompiler::CompileFile(fn);
+		createInfo.codeSize = compiled.size() * sizeof(uint32_t);
+		createInfo.pCode = compiled.data();
+	}
 
 	VkShaderModule shaderModule;
 	if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
@@ -69,6 +80,36 @@ void PipelineBuilder::CreateGraphicsPipeline(VkPipeline& out_pipeline, VkPipelin
 	vkDestroyShaderModule(device, fragShaderModule, nullptr);
 	vkDestroyShaderModule(device, vertShaderModule, nullptr);
 }
+void PipelineBuilder::CreateComputePipeline(VkPipeline& out_pipeline, VkPipelineLayout& out_pipelineLayout, const VkDevice device, const std::string& csFilename, std::vector<VkDescriptorSetLayout>& descriptorSetLayout, std::vector<VkPushConstantRange>& pushConstants) {
+	VkShaderModule compShaderModule = CreateShaderModule(device, csFilename);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayout.size());
+	pipelineLayoutInfo.pSetLayouts = descriptorSetLayout.data();
+	pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstants.size());
+	pipelineLayoutInfo.pPushConstantRanges = pushConstants.data();
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &out_pipelineLayout) != VK_SUCCESS) {
+		vkDestroyShaderModule(device, compShaderModule, nullptr);
+		throw std::runtime_error("failed to create pipeline layout");
+	}
+
+	VkComputePipelineCreateInfo pipelineCreateInfo{};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineCreateInfo.stage.module = compShaderModule;
+	pipelineCreateInfo.stage.pName = "main";
+	pipelineCreateInfo.layout = out_pipelineLayout;
+	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineCreateInfo.basePipelineIndex = -1;
+	VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &out_pipeline);
+	vkDestroyShaderModule(device, compShaderModule, nullptr);
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("failed to create compute pipeline!");
+	}
+}
+
 void PipelineBuilder::CreateRenderPass(VkRenderPass& out, VkDevice device, RenderPassCreateInfos& infos) {
 	VkRenderPassCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -121,9 +162,10 @@ void PipelineBuilder::CreateDefaultRenderPass(VkRenderPass& out, VkDevice device
 	VkSubpassDependency dependency{};
 	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
 	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	//depth image is shared by every frame in flight, so wait for the previous frame's depth writes
+	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
 	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
 	std::vector<VkAttachmentDescription> attachments = { colorAttachment, depthAttachment };
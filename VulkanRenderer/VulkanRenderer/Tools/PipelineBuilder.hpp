@@ -18,8 +18,6 @@ namespace PipelineBuilder {
 			VK_DYNAMIC_STATE_SCISSOR,
 			VK_DYNAMIC_STATE_DEPTH_BIAS
 	};
-	static auto bindingDescription = Vertex::GetBindingDescription();
-	static auto attributeDescription = Vertex::GetAttributeDescriptons();
 
 	// no support stencil test, color blending, multisampling
 	typedef struct PipelineCreateInfos {
@@ -35,12 +33,13 @@ namespace PipelineBuilder {
 		VkPipelineColorBlendStateCreateInfo colorBlending{};
 		std::vector<VkPushConstantRange> push_constant{};
 
+		//models upload VertexFormat::Compact by default. pipelines for Full models use FullLayout,
+		//depth only pipelines use CompactDepthLayout / FullDepthLayout.
+		template<typename Layout>
+		void SetVertexLayout() { vertexInputInfo = Layout::GetInputState(); }
+
 		PipelineCreateInfos() {
-			vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-			vertexInputInfo.vertexBindingDescriptionCount = 1;
-			vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-			vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescription.size());
-			vertexInputInfo.pVertexAttributeDescriptions = attributeDescription.data();
+			SetVertexLayout<CompactLayout>();
 
 			inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
 			inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
@@ -124,9 +123,12 @@ namespace PipelineBuilder {
 
 	static PipelineCreateInfos defaultPipelineCreateInfo = PipelineCreateInfos();
 
+	//.spv files are loaded as they are, glsl sources (.vert .frag .comp) go through ShaderCompiler
 	VkShaderModule CreateShaderModule(VkDevice device, const std::string& fn);
 
 	void CreateGraphicsPipeline(VkPipeline& out_pipeline, VkPipelineLayout& out_pipelineLayout, const VkDevice device, const std::string& vsFilename, const std::string& fsFilename, const VkRenderPass renderpass, std::vector<VkDescriptorSetLayout>& descriptorSetLayout, PipelineCreateInfos infos = defaultPipelineCreateInfo, uint32_t subpass = 0);
+	//layout of descriptorSetLayout + pushConstants, the compute stage comes from csFilename
+	void CreateComputePipeline(VkPipeline& out_pipeline, VkPipelineLayout& out_pipelineLayout, const VkDevice device, const std::string& csFilename, std::vector<VkDescriptorSetLayout>& descriptorSetLayout, std::vector<VkPushConstantRange>& pushConstants);
 	void CreateRenderPass(VkRenderPass& out, VkDevice device, RenderPassCreateInfos& infos);
 
 	void CreateDefaultRenderPass(VkRenderPass& out, VkDevice device, VkPhysicalDevice physicalDevice, VkFormat swapChainFormat);
@@ -0,0 +1,44 @@
+#include <Tools/ShaderCompiler.hpp>
+#include <shaderc/shaderc.hpp>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+static shaderc_shader_kind GetShaderKind(const std::string& name) {
+	std::string extension = std::filesystem::path(name).extension().string();
+	if (extension == ".vert") return shaderc_vertex_shader;
+	if (extension == ".frag") return shaderc_fragment_shader;
+	if (extension == ".comp") return shaderc_compute_shader;
+	return shaderc_glsl_infer_from_source;
+}
+
+std::vector<uint32_t> ShaderCompiler::CompileFile(const std::string& fn) {
+	std::ifstream file(fn, std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open shader " + fn + "!");
+	}
+	std::stringstream source;
+	source << file.rdbuf();
+	return Compile(source.str(), fn);
+}
+
+std::vector<uint32_t> ShaderCompiler::Compile(const std::string& source, const std::string& name) {
+	//one compiler per call, shaderc compilers are not meant to be shared between threads
+	shaderc::Compiler compiler;
+	if (!compiler.IsValid()) {
+		throw std::runtime_error("failed to create shader compiler!");
+	}
+	shaderc::CompileOptions options;
+	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+#ifdef NDEBUG
+	options.SetOptimizationLevel(shaderc_optimization_level_performance);
+#else
+	options.SetGenerateDebugInfo();
+#endif
+	shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source, GetShaderKind(name), name.c_str(), options);
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+		throw std::runtime_error("failed to compile shader " + name + "!\n" + result.GetErrorMessage());
+	}
+	return std::vector<uint32_t>(result.cbegin(), result.cend());
+}
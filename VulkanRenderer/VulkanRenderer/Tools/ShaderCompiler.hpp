@@ -0,0 +1,16 @@
+#pragma once
+#ifndef SHADER_COMPILER_HPP
+#define SHADER_COMPILER_HPP
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// GLSL -> SPIR-V with the shaderc library of the Vulkan SDK, so pipelines are built from the shader sources and no
+// checked in binary can go stale. the stage comes from the extension : .vert .frag .comp (others are inferred from a
+// "#pragma shader_stage()" line). throws with the compiler's messages when the source doesn't compile.
+namespace ShaderCompiler {
+	std::vector<uint32_t> CompileFile(const std::string& fn);
+	std::vector<uint32_t> Compile(const std::string& source, const std::string& name);
+}
+
+#endif // !SHADER_COMPILER_HPP
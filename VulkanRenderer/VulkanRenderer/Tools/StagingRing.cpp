@@ -0,0 +1,161 @@
+#include <Tools/StagingRing.hpp>
+#include <Tools/Utils.hpp>
+#include <stdexcept>
+#include <cstdio>
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+	return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+void StagingRing::Init(VkDevice _device, MemoryAllocator* _allocator, VkDeviceSize _size) {
+	device = _device;
+	allocator = _allocator;
+	size = _size;
+	Utils::CreateBuffer(device, *allocator, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, bufferMemory);
+	if (bufferMemory.mapped == nullptr) {
+		throw std::runtime_error("failed to map staging ring!");
+	}
+	head = tail = 0;
+	empty = true;
+}
+
+void StagingRing::Clean() {
+	for (auto& submission : inFlight) {
+		if (submission.fence != VK_NULL_HANDLE) {
+			vkWaitForFences(device, 1, &submission.fence, VK_TRUE, UINT64_MAX);
+		}
+		ReleaseSubmission(submission);
+	}
+	inFlight.clear();
+	for (auto& fallback : openFallbackBuffers) {
+		Utils::DestroyBuffer(device, *allocator, fallback.first, fallback.second);
+	}
+	openFallbackBuffers.clear();
+	if (buffer != VK_NULL_HANDLE) {
+		Utils::DestroyBuffer(device, *allocator, buffer, bufferMemory);
+	}
+	if (fallbackCount > 0 || stallCount > 0) {
+		printf("StagingRing : %u uploads used a fallback buffer, %u allocations waited for the gpu\n", fallbackCount, stallCount);
+	}
+}
+
+bool StagingRing::TryAllocate(VkDeviceSize allocSize, VkDeviceSize alignment, VkDeviceSize& outOffset) {
+	if (empty) {
+		head = tail = 0;
+		if (allocSize > size) return false;
+		outOffset = 0;
+		head = allocSize;
+		return true;
+	}
+	if (head > tail) {
+		//free space : [head, size) and [0, tail)
+		VkDeviceSize aligned = AlignUp(head, alignment);
+		if (aligned + allocSize <= size) {
+			outOffset = aligned;
+			head = aligned + allocSize;
+			return true;
+		}
+		//wrap around, the bytes left at the end are skipped until tail passes them
+		if (allocSize <= tail) {
+			outOffset = 0;
+			head = allocSize;
+			return true;
+		}
+		return false;
+	}
+	if (head < tail) {
+		//free space : [head, tail)
+		VkDeviceSize aligned = AlignUp(head, alignment);
+		if (aligned + allocSize <= tail) {
+			outOffset = aligned;
+			head = aligned + allocSize;
+			return true;
+		}
+	}
+	return false; // head == tail, ring is full
+}
+
+StagingRegion StagingRing::AllocateFallback(VkDeviceSize allocSize) {
+	StagingRegion region{};
+	MemoryAllocation memory;
+	Utils::CreateBuffer(device, *allocator, allocSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, region.buffer, memory);
+	region.offset = 0;
+	region.size = allocSize;
+	region.mapped = memory.mapped;
+	region.fallback = true;
+	openFallbackBuffers.push_back({ region.buffer, memory });
+	fallbackCount++;
+	return region;
+}
+
+StagingRegion StagingRing::Allocate(VkDeviceSize allocSize, VkDeviceSize alignment) {
+	if (allocSize == 0 || allocSize > size) {
+		return AllocateFallback(allocSize > 0 ? allocSize : 1);
+	}
+	VkDeviceSize offset = 0;
+	bool success = TryAllocate(allocSize, alignment, offset);
+	if (!success) {
+		Reclaim();
+		success = TryAllocate(allocSize, alignment, offset);
+	}
+	//wait for the oldest submissions until enough space is free
+	while (!success && !inFlight.empty()) {
+		Submission& oldest = inFlight.front();
+		if (oldest.fence != VK_NULL_HANDLE) {
+			vkWaitForFences(device, 1, &oldest.fence, VK_TRUE, UINT64_MAX);
+		}
+		stallCount++;
+		Reclaim();
+		success = TryAllocate(allocSize, alignment, offset);
+	}
+	//the rest of the ring is held by regions that have not been submitted yet
+	if (!success) {
+		return AllocateFallback(allocSize);
+	}
+	empty = false;
+	hasOpenRegions = true;
+
+	StagingRegion region{};
+	region.buffer = buffer;
+	region.offset = offset;
+	region.size = allocSize;
+	region.mapped = static_cast<char*>(bufferMemory.mapped) + offset;
+	return region;
+}
+
+void StagingRing::Retire(VkFence fence) {
+	if (!hasOpenRegions && openFallbackBuffers.empty()) return;
+	Submission submission{};
+	submission.fence = fence;
+	submission.end = head;
+	submission.fallbackBuffers = std::move(openFallbackBuffers);
+	openFallbackBuffers.clear();
+	inFlight.push_back(std::move(submission));
+	hasOpenRegions = false;
+	if (fence == VK_NULL_HANDLE) {
+		Reclaim();
+	}
+}
+
+void StagingRing::ReleaseSubmission(Submission& submission) {
+	for (auto& fallback : submission.fallbackBuffers) {
+		Utils::DestroyBuffer(device, *allocator, fallback.first, fallback.second);
+	}
+	submission.fallbackBuffers.clear();
+}
+
+void StagingRing::Reclaim() {
+	while (!inFlight.empty()) {
+		Submission& oldest = inFlight.front();
+		if (oldest.fence != VK_NULL_HANDLE && vkGetFenceStatus(device, oldest.fence) != VK_SUCCESS) break;
+		tail = oldest.end;
+		ReleaseSubmission(oldest);
+		inFlight.pop_front();
+	}
+	if (inFlight.empty() && !hasOpenRegions) {
+		empty = true;
+		head = tail = 0;
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#ifndef STAGING_RING_HPP
+#define STAGING_RING_HPP
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <deque>
+#include "MemoryAllocator.hpp"
+
+// a piece of staging memory. copy from buffer + offset, write through mapped.
+struct StagingRegion {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void* mapped = nullptr;
+	bool fallback = false;	// true -> temporary buffer, the request did not fit in the ring
+};
+
+// Persistently mapped ring of staging memory shared by every upload.
+// usage : Allocate() -> write mapped -> record copies -> submit -> Retire(fence of that submit).
+// regions handed out since the last Retire() are reused once that fence signals.
+// not thread safe, uploads are recorded from one thread.
+class StagingRing {
+public:
+	static constexpr VkDeviceSize DEFAULT_SIZE = 64 * 1024 * 1024;
+
+	void Init(VkDevice _device, MemoryAllocator* _allocator, VkDeviceSize _size = DEFAULT_SIZE);
+	void Clean();
+
+	StagingRegion Allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+	// fence == VK_NULL_HANDLE means the copies have already completed (e.g. after vkQueueWaitIdle).
+	// the fence must stay alive and unreset until the ring has reclaimed it.
+	void Retire(VkFence fence);
+	// release every retired submission whose fence has signaled
+	void Reclaim();
+
+	VkDeviceSize GetSize() const { return size; }
+	uint32_t GetFallbackCount() const { return fallbackCount; }
+	uint32_t GetStallCount() const { return stallCount; }
+private:
+	struct Submission {
+		VkFence fence = VK_NULL_HANDLE;
+		VkDeviceSize end = 0;	// head after the last region of this submission
+		std::vector<std::pair<VkBuffer, MemoryAllocation>> fallbackBuffers;
+	};
+	VkDevice device = VK_NULL_HANDLE;
+	MemoryAllocator* allocator = nullptr;
+	VkBuffer buffer = VK_NULL_HANDLE;
+	MemoryAllocation bufferMemory;
+	VkDeviceSize size = 0;
+	VkDeviceSize head = 0;	// next write position
+	VkDeviceSize tail = 0;	// oldest byte still in use
+	bool empty = true;
+	bool hasOpenRegions = false;
+	std::vector<std::pair<VkBuffer, MemoryAllocation>> openFallbackBuffers;
+	std::deque<Submission> inFlight;
+	uint32_t fallbackCount = 0;
+	uint32_t stallCount = 0;
+
+	bool TryAllocate(VkDeviceSize allocSize, VkDeviceSize alignment, VkDeviceSize& outOffset);
+	StagingRegion AllocateFallback(VkDeviceSize allocSize);
+	void ReleaseSubmission(Submission& submission);
+};
+
+#endif // !STAGING_RING_HPP
@@ -0,0 +1,91 @@
+#include <Tools/ThreadPool.hpp>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+
+void ThreadPool::Init(uint32_t threadCount) {
+	if (threadCount == 0) {
+		uint32_t hardware = std::thread::hardware_concurrency();
+		threadCount = hardware > 1 ? hardware - 1 : 1;
+	}
+	stopping = false;
+	workers.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; i++) {
+		workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+void ThreadPool::Clean() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wakeup.notify_all();
+	for (auto& worker : workers) {
+		if (worker.joinable()) worker.join();
+	}
+	workers.clear();
+}
+
+void ThreadPool::Enqueue(std::function<void()> job) {
+	//without workers (not initialized or cleaned) jobs run inline
+	if (workers.empty()) {
+		job();
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+	}
+	wakeup.notify_one();
+}
+
+void ThreadPool::WorkerLoop() {
+	for (;;) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeup.wait(lock, [this]() { return stopping || !jobs.empty(); });
+			if (jobs.empty()) return;
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+		job();
+	}
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& job) {
+	if (count == 0) return;
+	struct Shared {
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> done{ 0 };
+		std::mutex mutex;
+		std::condition_variable finished;
+		std::exception_ptr error;
+	};
+	auto shared = std::make_shared<Shared>();
+	//every helper pulls indices until none are left, so uneven jobs balance themselves
+	auto run = [shared, count, &job]() {
+		for (size_t i = shared->next++; i < count; i = shared->next++) {
+			try {
+				job(i);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(shared->mutex);
+				if (!shared->error) shared->error = std::current_exception();
+			}
+			if (++shared->done == count) {
+				std::lock_guard<std::mutex> lock(shared->mutex);
+				shared->finished.notify_all();
+			}
+		}
+	};
+	size_t helpers = std::min(count - 1, workers.size());
+	for (size_t i = 0; i < helpers; i++) Enqueue(run);
+	run();
+	{
+		std::unique_lock<std::mutex> lock(shared->mutex);
+		shared->finished.wait(lock, [&]() { return shared->done == count; });
+	}
+	if (shared->error) std::rethrow_exception(shared->error);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <cstdint>
+
+// Fixed set of cpu worker threads for import work (mesh conversion, image decoding).
+// jobs must not touch vulkan objects, the gpu upload of their results stays on the calling thread.
+class ThreadPool {
+public:
+	// threadCount == 0 -> one worker per hardware thread minus the calling thread
+	void Init(uint32_t threadCount = 0);
+	// waits for the queued jobs, safe to call more than once
+	void Clean();
+
+	template<typename F>
+	auto Submit(F&& job) -> std::future<decltype(job())> {
+		using Result = decltype(job());
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+		std::future<Result> future = task->get_future();
+		Enqueue([task]() { (*task)(); });
+		return future;
+	}
+	// runs job(i) for every i in [0, count) on the workers and the calling thread, returns when all are done.
+	// the first exception thrown by a job is rethrown here.
+	void ParallelFor(size_t count, const std::function<void(size_t)>& job);
+
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	bool stopping = false;
+
+	void Enqueue(std::function<void()> job);
+	void WorkerLoop();
+};
+
+#endif // !THREAD_POOL_HPP
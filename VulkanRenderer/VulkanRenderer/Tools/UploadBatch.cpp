@@ -0,0 +1,256 @@
+#include <Tools/UploadBatch.hpp>
+#include <Tools/Utils.hpp>
+#include <stdexcept>
+
+VkCommandPool UploadContext::CreatePool(uint32_t queueFamily) {
+	VkCommandPool pool = VK_NULL_HANDLE;
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = queueFamily;
+	if (vkCreateCommandPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload command pool!");
+	}
+	return pool;
+}
+
+void UploadContext::Init(VkDevice _device, VkQueue _transferQueue, uint32_t _transferFamily, GpuTimeline* _transferTimeline,
+	VkQueue _graphicsQueue, uint32_t _graphicsFamily, GpuTimeline* _graphicsTimeline, StagingRing* _stagingRing) {
+	device = _device;
+	transferQueue = _transferQueue;
+	transferFamily = _transferFamily;
+	transferTimeline = _transferTimeline;
+	graphicsQueue = _graphicsQueue;
+	graphicsFamily = _graphicsFamily;
+	graphicsTimeline = _graphicsTimeline;
+	stagingRing = _stagingRing;
+	transferPool = CreatePool(transferFamily);
+	if (HasDedicatedQueue()) {
+		graphicsPool = CreatePool(graphicsFamily);
+	}
+}
+
+void UploadContext::Clean() {
+	for (auto& slot : slots) {
+		vkWaitForFences(device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+		vkDestroyFence(device, slot.fence, nullptr);
+	}
+	slots.clear();
+	if (graphicsPool != VK_NULL_HANDLE) vkDestroyCommandPool(device, graphicsPool, nullptr);
+	vkDestroyCommandPool(device, transferPool, nullptr);
+}
+
+UploadBatch UploadContext::Begin() {
+	if (isRecording) {
+		throw std::runtime_error("an upload batch is already recording!");
+	}
+	//reuse the first command buffer whose previous submit has finished
+	uint32_t slotIdx = UINT32_MAX;
+	for (uint32_t i = 0; i < slots.size(); i++) {
+		if (!slots[i].recording && vkGetFenceStatus(device, slots[i].fence) == VK_SUCCESS) {
+			slotIdx = i;
+			break;
+		}
+	}
+	if (slotIdx == UINT32_MAX) {
+		Slot slot{};
+		VkCommandBufferAllocateInfo allocInfo = Initializer::InitCommandBufferAllocateInfo(transferPool, 1);
+		if (vkAllocateCommandBuffers(device, &allocInfo, &slot.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate upload command buffer!");
+		}
+		slot.graphicsCommandBuffer = slot.commandBuffer;
+		if (HasDedicatedQueue()) {
+			allocInfo = Initializer::InitCommandBufferAllocateInfo(graphicsPool, 1);
+			if (vkAllocateCommandBuffers(device, &allocInfo, &slot.graphicsCommandBuffer) != VK_SUCCESS) {
+				vkFreeCommandBuffers(device, transferPool, 1, &slot.commandBuffer);
+				throw std::runtime_error("failed to allocate upload command buffer!");
+			}
+		}
+		VkFenceCreateInfo fenceInfo = Initializer::InitFenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+		if (vkCreateFence(device, &fenceInfo, nullptr, &slot.fence) != VK_SUCCESS) {
+			vkFreeCommandBuffers(device, transferPool, 1, &slot.commandBuffer);
+			if (HasDedicatedQueue()) vkFreeCommandBuffers(device, graphicsPool, 1, &slot.graphicsCommandBuffer);
+			throw std::runtime_error("failed to create upload fence!");
+		}
+		slots.push_back(slot);
+		slotIdx = static_cast<uint32_t>(slots.size() - 1);
+	}
+	Slot& slot = slots[slotIdx];
+	VkCommandBufferBeginInfo beginInfo = Initializer::InitCommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	//the slot stays free when it can't be begun
+	if (vkResetCommandBuffer(slot.commandBuffer, 0) != VK_SUCCESS || vkBeginCommandBuffer(slot.commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin upload command buffer!");
+	}
+	if (HasDedicatedQueue()) {
+		if (vkResetCommandBuffer(slot.graphicsCommandBuffer, 0) != VK_SUCCESS || vkBeginCommandBuffer(slot.graphicsCommandBuffer, &beginInfo) != VK_SUCCESS) {
+			vkResetCommandBuffer(slot.commandBuffer, 0);
+			throw std::runtime_error("failed to begin upload command buffer!");
+		}
+	}
+	slot.recording = true;
+	isRecording = true;
+
+	UploadBatch batch{};
+	batch.commandBuffer = slot.commandBuffer;
+	batch.graphicsCommandBuffer = slot.graphicsCommandBuffer;
+	batch.fence = slot.fence;
+	batch.slot = slotIdx;
+	return batch;
+}
+
+void UploadContext::Submit(UploadBatch& batch, bool wait) {
+	if (!batch.IsRecording()) return;
+	Slot& slot = slots[batch.slot];
+	//a submit that throws leaves the batch recording with nothing of it pending on the gpu, the caller Abort()s it
+	if (vkEndCommandBuffer(slot.commandBuffer) != VK_SUCCESS
+		|| (HasDedicatedQueue() && vkEndCommandBuffer(slot.graphicsCommandBuffer) != VK_SUCCESS)) {
+		throw std::runtime_error("failed to record upload batch!");
+	}
+	//regions retired with the slot's previous submit are reclaimed while its fence is still signaled
+	stagingRing->Reclaim();
+	if (HasDedicatedQueue()) {
+		uint64_t transferValue = transferTimeline->Reserve();
+		VkSemaphore transferSemaphore = transferTimeline->GetSemaphore();
+
+		VkTimelineSemaphoreSubmitInfo transferTimelineInfo{};
+		transferTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		transferTimelineInfo.signalSemaphoreValueCount = 1;
+		transferTimelineInfo.pSignalSemaphoreValues = &transferValue;
+		VkSubmitInfo transferSubmit = Initializer::InitSubmitInfo(0, VK_NULL_HANDLE, VK_NULL_HANDLE, 1, &slot.commandBuffer, 1, &transferSemaphore);
+		transferSubmit.pNext = &transferTimelineInfo;
+		if (vkQueueSubmit(transferQueue, 1, &transferSubmit, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload batch to transfer queue!");
+		}
+
+		uint64_t graphicsValue = graphicsTimeline->Reserve();
+		VkSemaphore graphicsSemaphore = graphicsTimeline->GetSemaphore();
+		VkTimelineSemaphoreSubmitInfo graphicsTimelineInfo{};
+		graphicsTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		graphicsTimelineInfo.waitSemaphoreValueCount = 1;
+		graphicsTimelineInfo.pWaitSemaphoreValues = &transferValue;
+		graphicsTimelineInfo.signalSemaphoreValueCount = 1;
+		graphicsTimelineInfo.pSignalSemaphoreValues = &graphicsValue;
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+		VkSubmitInfo graphicsSubmit = Initializer::InitSubmitInfo(1, &transferSemaphore, &waitStage, 1, &slot.graphicsCommandBuffer, 1, &graphicsSemaphore);
+		graphicsSubmit.pNext = &graphicsTimelineInfo;
+		//the fence is reset right before the submit signaling it, never while nothing is queued to signal it
+		vkResetFences(device, 1, &slot.fence);
+		if (vkQueueSubmit(graphicsQueue, 1, &graphicsSubmit, slot.fence) != VK_SUCCESS) {
+			//the copies already went, they must be done before the command buffer can be reset
+			if (!transferTimeline->WaitFor(transferValue)) {
+				//they may still be pending : the slot is never reused and the batch can't be aborted.
+				//its fence is replaced with a signaled one so Clean() doesn't wait on a fence nothing signals
+				RestoreFence(slot, batch);
+				isRecording = false;
+				batch.commandBuffer = VK_NULL_HANDLE;
+				batch.graphicsCommandBuffer = VK_NULL_HANDLE;
+				throw std::runtime_error("failed to submit upload batch to graphics queue, its copies didn't finish!");
+			}
+			RestoreFence(slot, batch);
+			throw std::runtime_error("failed to submit upload batch to graphics queue!");
+		}
+		batch.timelineValue = graphicsValue;
+	}
+	else {
+		uint64_t graphicsValue = graphicsTimeline->Reserve();
+		VkSemaphore graphicsSemaphore = graphicsTimeline->GetSemaphore();
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &graphicsValue;
+		VkSubmitInfo submitInfo = Initializer::InitSubmitInfo(0, VK_NULL_HANDLE, VK_NULL_HANDLE, 1, &slot.commandBuffer, 1, &graphicsSemaphore);
+		submitInfo.pNext = &timelineInfo;
+		vkResetFences(device, 1, &slot.fence);
+		if (vkQueueSubmit(transferQueue, 1, &submitInfo, slot.fence) != VK_SUCCESS) {
+			RestoreFence(slot, batch);
+			throw std::runtime_error("failed to submit upload batch!");
+		}
+		batch.timelineValue = graphicsValue;
+	}
+	stagingRing->Retire(slot.fence);
+	slot.recording = false;
+	isRecording = false;
+	submitCount++;
+	batch.commandBuffer = VK_NULL_HANDLE;
+	batch.graphicsCommandBuffer = VK_NULL_HANDLE;
+	if (wait) {
+		Wait(batch);
+	}
+}
+
+void UploadContext::RestoreFence(Slot& slot, UploadBatch& batch) {
+	//nothing will signal the reset fence, a new signaled one lets Begin() reuse the slot
+	VkFence fence = VK_NULL_HANDLE;
+	VkFenceCreateInfo fenceInfo = Initializer::InitFenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+	if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload fence!");
+	}
+	vkDestroyFence(device, slot.fence, nullptr);
+	slot.fence = fence;
+	batch.fence = fence;
+}
+
+void UploadContext::Abort(UploadBatch& batch) {
+	if (!batch.IsRecording()) return;
+	Slot& slot = slots[batch.slot];
+	//reset from the recording state, the pools have RESET_COMMAND_BUFFER
+	vkResetCommandBuffer(slot.commandBuffer, 0);
+	if (HasDedicatedQueue()) {
+		vkResetCommandBuffer(slot.graphicsCommandBuffer, 0);
+	}
+	//nothing was submitted, the regions are free right away (after the submissions still in flight before them)
+	stagingRing->Retire(VK_NULL_HANDLE);
+	slot.recording = false;
+	isRecording = false;
+	batch.commandBuffer = VK_NULL_HANDLE;
+	batch.graphicsCommandBuffer = VK_NULL_HANDLE;
+	batch.commandCount = 0;
+}
+
+void UploadContext::Wait(const UploadBatch& batch) {
+	if (batch.timelineValue == 0) return;
+	if (!graphicsTimeline->WaitFor(batch.timelineValue)) {
+		throw std::runtime_error("failed to wait for upload batch!");
+	}
+	stagingRing->Reclaim();
+}
+
+bool UploadContext::IsComplete(const UploadBatch& batch) {
+	return graphicsTimeline->HasCompleted(batch.timelineValue);
+}
+
+void UploadContext::TransferImageOwnership(UploadBatch& batch, VkImage image, VkImageLayout layout, uint32_t mipLevels, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage) {
+	if (!HasDedicatedQueue()) return;
+	VkImageMemoryBarrier barrier = Initializer::InitImageMemoryBarrier(image, layout, layout, mipLevels);
+	barrier.srcQueueFamilyIndex = transferFamily;
+	barrier.dstQueueFamilyIndex = graphicsFamily;
+	//release
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	//acquire
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = dstAccess;
+	vkCmdPipelineBarrier(batch.graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	batch.commandCount += 2;
+}
+
+void UploadContext::TransferBufferOwnership(UploadBatch& batch, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage) {
+	if (!HasDedicatedQueue()) return;
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = transferFamily;
+	barrier.dstQueueFamilyIndex = graphicsFamily;
+	barrier.buffer = buffer;
+	barrier.offset = offset;
+	barrier.size = size;
+	//release
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	//acquire
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = dstAccess;
+	vkCmdPipelineBarrier(batch.graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	batch.commandCount += 2;
+}
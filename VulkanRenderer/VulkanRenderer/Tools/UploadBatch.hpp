@@ -0,0 +1,97 @@
+#pragma once
+#ifndef UPLOAD_BATCH_HPP
+#define UPLOAD_BATCH_HPP
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include "StagingRing.hpp"
+#include "GpuTimeline.hpp"
+
+// one recording of upload commands, submitted by UploadContext::Submit().
+// commandBuffer runs on the upload(transfer) queue : copies and layout transitions.
+// graphicsCommandBuffer runs on the graphics queue after it : ownership acquires and blits(mipmaps).
+// both are the same command buffer when the device has no dedicated transfer family.
+struct UploadBatch {
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+	uint32_t slot = UINT32_MAX;
+	uint32_t commandCount = 0;	// copies, transitions and blits recorded, for logging
+	uint64_t timelineValue = 0;	// graphics timeline value signaled when the whole batch is done, set by Submit()
+	bool IsRecording() const { return commandBuffer != VK_NULL_HANDLE; }
+};
+
+// Records transfers into reusable command buffers and submits each batch once with one fence.
+// command buffers come from RESET_COMMAND_BUFFER pools and are reused after their fence signals,
+// staging regions used by a batch are retired to the staging ring with the same fence.
+// with a dedicated transfer family the copies run on the transfer queue, resources are released to the
+// graphics family and the graphics submit waits on the transfer timeline value signaled by the transfer submit.
+// only one batch may be recording at a time, because the staging ring retires every open region on submit.
+// a batch that can't be finished is dropped with Abort(), UploadBatchGuard does it when its scope is left by an exception.
+class UploadContext {
+public:
+	// without a dedicated transfer family _transferTimeline should be the graphics queue's timeline
+	void Init(VkDevice _device, VkQueue _transferQueue, uint32_t _transferFamily, GpuTimeline* _transferTimeline,
+		VkQueue _graphicsQueue, uint32_t _graphicsFamily, GpuTimeline* _graphicsTimeline, StagingRing* _stagingRing);
+	void Clean();
+
+	UploadBatch Begin();
+	// wait == false returns right after vkQueueSubmit, poll IsComplete() or call Wait() later.
+	// throws when the batch can't be submitted, it is still recording then and Abort() drops it. if part of it may
+	// still run on the gpu (device lost) it is not recording anymore and its slot is never reused
+	void Submit(UploadBatch& batch, bool wait = true);
+	// drops the recorded commands and frees the staging regions allocated since Begin(), nothing runs on the gpu.
+	// whoever writes into that staging (e.g. decode workers) must be finished. does nothing once the batch is submitted
+	void Abort(UploadBatch& batch);
+	// throws when the wait fails (device lost)
+	void Wait(const UploadBatch& batch);
+	bool IsComplete(const UploadBatch& batch);
+
+	// queue family ownership transfer, release on commandBuffer and acquire on graphicsCommandBuffer.
+	// does nothing when uploads run on the graphics family.
+	void TransferImageOwnership(UploadBatch& batch, VkImage image, VkImageLayout layout, uint32_t mipLevels, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
+	void TransferBufferOwnership(UploadBatch& batch, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
+
+	StagingRegion AllocateStaging(VkDeviceSize size, VkDeviceSize alignment = 16) { return stagingRing->Allocate(size, alignment); }
+	bool HasDedicatedQueue() const { return transferFamily != graphicsFamily; }
+	uint32_t GetSubmitCount() const { return submitCount; }
+private:
+	struct Slot {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		bool recording = false;
+	};
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueue transferQueue = VK_NULL_HANDLE;
+	VkQueue graphicsQueue = VK_NULL_HANDLE;
+	uint32_t transferFamily = 0;
+	uint32_t graphicsFamily = 0;
+	VkCommandPool transferPool = VK_NULL_HANDLE;
+	VkCommandPool graphicsPool = VK_NULL_HANDLE;	// only with a dedicated transfer family
+	GpuTimeline* transferTimeline = nullptr;
+	GpuTimeline* graphicsTimeline = nullptr;
+	StagingRing* stagingRing = nullptr;
+	std::vector<Slot> slots;
+	bool isRecording = false;
+	uint32_t submitCount = 0;
+
+	VkCommandPool CreatePool(uint32_t queueFamily);
+	// after a failed vkQueueSubmit, replaces the slot's reset fence with a signaled one
+	void RestoreFence(Slot& slot, UploadBatch& batch);
+};
+
+// aborts batch when the scope ends before it was submitted, so a throwing load doesn't leave the context recording.
+// batch may be submitted and begun again while the guard lives
+class UploadBatchGuard {
+public:
+	UploadBatchGuard(UploadContext& _context, UploadBatch& _batch) : context(_context), batch(_batch) {}
+	UploadBatchGuard(const UploadBatchGuard&) = delete;
+	UploadBatchGuard& operator=(const UploadBatchGuard&) = delete;
+	~UploadBatchGuard() { context.Abort(batch); }
+private:
+	UploadContext& context;
+	UploadBatch& batch;
+};
+
+#endif // !UPLOAD_BATCH_HPP
@@ -0,0 +1,110 @@
+#include <Tools/UploadScheduler.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+void UploadScheduler::Clean() {
+	for (auto& batch : inFlight) {
+		uploadContext->Wait(batch.batch);
+	}
+	inFlight.clear();
+	queue.clear();
+}
+
+uint64_t UploadScheduler::Schedule(UploadJob job) {
+	uint64_t id = nextId++;
+	queue.push_back({ id, std::move(job) });
+	return id;
+}
+
+void UploadScheduler::SetPriority(uint64_t id, UploadPriority priority) {
+	for (auto& queued : queue) {
+		if (queued.id == id) {
+			queued.job.priority = priority;
+			return;
+		}
+	}
+}
+
+bool UploadScheduler::Cancel(uint64_t id) {
+	for (auto it = queue.begin(); it != queue.end(); ++it) {
+		if (it->id == id) {
+			queue.erase(it);
+			return true;
+		}
+	}
+	return false;
+}
+
+void UploadScheduler::Run() {
+	frameStats = UploadFrameStats{};
+	//completions in submit order, a later batch may finish first on another queue but never completes before an earlier one
+	while (!inFlight.empty() && uploadContext->IsComplete(inFlight.front().batch)) {
+		InFlight done = std::move(inFlight.front());
+		inFlight.pop_front();
+		for (auto& recorded : done.jobs) {
+			Finish(recorded);
+		}
+	}
+	if (!queue.empty()) {
+		auto start = std::chrono::steady_clock::now();
+		//equal priorities keep their scheduling order
+		std::sort(queue.begin(), queue.end(), [](const QueuedJob& a, const QueuedJob& b) {
+			return a.job.priority != b.job.priority ? a.job.priority < b.job.priority : a.id < b.id;
+		});
+		InFlight submit;
+		submit.batch = uploadContext->Begin();
+		UploadBatchGuard guard(*uploadContext, submit.batch);
+		size_t taken = 0;
+		while (taken < queue.size()) {
+			UploadJob& job = queue[taken].job;
+			if (taken > 0) {
+				float elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+				if (frameStats.bytesUploaded + job.bytes > bytesPerFrame || elapsed >= millisecondsPerFrame) break;
+			}
+			Recorded recorded;
+			try {
+				job.record(submit.batch);
+				frameStats.bytesUploaded += job.bytes;
+				frameStats.jobsRecorded++;
+			}
+			catch (const std::exception& e) {
+				//the commands it recorded may use what it captured, so the job is kept until the batch is done
+				printf("Fail to record upload job : %s\n", e.what());
+				recorded.error = e.what();
+			}
+			recorded.job = std::move(job);
+			submit.jobs.push_back(std::move(recorded));
+			taken++;
+		}
+		queue.erase(queue.begin(), queue.begin() + taken);
+		try {
+			uploadContext->Submit(submit.batch, false);
+			inFlight.push_back(std::move(submit));
+		}
+		catch (const std::exception& e) {
+			//dropped before the jobs hear of it, nothing of it runs on the gpu
+			printf("Fail to submit upload batch : %s\n", e.what());
+			uploadContext->Abort(submit.batch);
+			for (auto& recorded : submit.jobs) {
+				if (recorded.error.empty()) recorded.error = e.what();
+				Finish(recorded);
+			}
+		}
+		frameStats.recordMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+	frameStats.queueDepth = queue.size();
+	for (const auto& queued : queue) frameStats.queuedBytes += queued.job.bytes;
+	frameStats.batchesInFlight = static_cast<uint32_t>(inFlight.size());
+}
+
+void UploadScheduler::Finish(Recorded& recorded) {
+	if (recorded.error.empty()) {
+		if (recorded.job.complete) recorded.job.complete();
+		frameStats.jobsCompleted++;
+	}
+	else {
+		if (recorded.job.fail) recorded.job.fail(recorded.error);
+		frameStats.jobsFailed++;
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+#ifndef UPLOAD_SCHEDULER_HPP
+#define UPLOAD_SCHEDULER_HPP
+#include <vector>
+#include <deque>
+#include <functional>
+#include <cstdint>
+#include <string>
+#include "UploadBatch.hpp"
+
+// lower drains first
+enum class UploadPriority {
+	Visible,		// drawn this frame
+	Normal,
+	Background		// prefetch, nothing waits on it
+};
+
+// one schedulable upload. record() writes staging memory and records its copies / blits into the frame's batch,
+// complete() runs once that batch has finished on the gpu. both run on the render thread inside Renderer::Render().
+// record() must not schedule other jobs, complete() may schedule. a record() that throws drops its job, whatever it
+// recorded before still goes with the batch : fail() gets the error instead of complete(), once the batch is done.
+// the job's functions (and what they captured) live until then
+struct UploadJob {
+	uint64_t bytes = 0;		// staging bytes, counted against the frame budget
+	UploadPriority priority = UploadPriority::Normal;
+	std::function<void(UploadBatch&)> record;
+	std::function<void()> complete;
+	std::function<void(const std::string&)> fail;
+};
+
+struct UploadFrameStats {
+	uint64_t bytesUploaded = 0;	// recorded this frame
+	uint32_t jobsRecorded = 0;
+	uint32_t jobsCompleted = 0;
+	uint32_t jobsFailed = 0;	// record() threw or the batch could not be submitted
+	size_t queueDepth = 0;		// jobs still queued after this frame
+	uint64_t queuedBytes = 0;
+	uint32_t batchesInFlight = 0;
+	float recordMilliseconds = 0.0f;
+};
+
+// Spreads uploads over frames. Renderer::Render() calls Run() once per frame before the frame's timeline value is
+// reserved : finished batches fire their completions, then queued jobs are recorded by priority (then age) into one
+// batch until bytesPerFrame or millisecondsPerFrame is used up and the batch is submitted without waiting.
+// at least one job goes every frame, so a job larger than the budget still makes progress.
+class UploadScheduler {
+public:
+	static constexpr uint64_t DEFAULT_BYTES_PER_FRAME = 16ull << 20;
+	static constexpr float DEFAULT_MILLISECONDS_PER_FRAME = 2.0f;
+
+	void Init(UploadContext* _uploadContext) { uploadContext = _uploadContext; }
+	// waits for the batches in flight, queued jobs and pending completions are dropped
+	void Clean();
+
+	// returns an id for SetPriority() / Cancel()
+	uint64_t Schedule(UploadJob job);
+	// no effect once the job has been recorded
+	void SetPriority(uint64_t id, UploadPriority priority);
+	// false when the job was already recorded, its completion still comes then
+	bool Cancel(uint64_t id);
+	void SetBudget(uint64_t _bytesPerFrame, float _millisecondsPerFrame) { bytesPerFrame = _bytesPerFrame; millisecondsPerFrame = _millisecondsPerFrame; }
+
+	void Run();
+	const UploadFrameStats& GetFrameStats() const { return frameStats; }
+	size_t GetQueueDepth() const { return queue.size(); }
+	bool IsIdle() const { return queue.empty() && inFlight.empty(); }
+private:
+	struct QueuedJob {
+		uint64_t id;
+		UploadJob job;
+	};
+	struct Recorded {
+		UploadJob job;
+		std::string error;	// record() threw
+	};
+	struct InFlight {
+		UploadBatch batch;
+		std::vector<Recorded> jobs;
+	};
+	UploadContext* uploadContext = nullptr;
+	std::vector<QueuedJob> queue;
+	std::deque<InFlight> inFlight;	// submit order
+	uint64_t nextId = 1;
+	uint64_t bytesPerFrame = DEFAULT_BYTES_PER_FRAME;
+	float millisecondsPerFrame = DEFAULT_MILLISECONDS_PER_FRAME;
+	UploadFrameStats frameStats;
+
+	void Finish(Recorded& recorded);
+};
+
+#endif // !UPLOAD_SCHEDULER_HPP
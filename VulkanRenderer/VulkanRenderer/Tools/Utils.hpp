@@ -11,6 +11,7 @@
 #include<cstring>
 #include<filesystem>
 #include<string>
+#include "MemoryAllocator.hpp"
 
 
 namespace Utils {
@@ -20,6 +21,7 @@ namespace Utils {
 		//supported in after c++17
 		std::optional<uint32_t> graphicsFamily; //write 2024 - 08 - 15__03:10
 		std::optional<uint32_t> presentFamily;  //write 2024 - 08 - 15__03:56
+		std::optional<uint32_t> transferFamily; //family without graphics, empty if the device has none
 		bool isComplete() {
 			return graphicsFamily.has_value() && presentFamily.has_value();
 		}
@@ -54,13 +56,16 @@ namespace Utils {
 	VkFormat findSupportedFormat(VkPhysicalDevice physicalDevice, const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 	VkFormat findDepthFormat(VkPhysicalDevice physicalDevice);
 	uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
-	void CreateBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory,VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE, VkDeviceSize memoffset = 0);
-	void CopyBuffer(VkDevice device, VkCommandPool commandPool, VkQueue submitQueue, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize _size);
-	void CreateVertexUniforBuffer(VkDevice device,VkPhysicalDevice physicalDevice, std::vector<VkBuffer>& buffer, std::vector<VkDeviceMemory>& bufferMemory, std::vector<void*>& mappedMemory, uint32_t bufferCount = 2);
-	void CreateImage(VkDevice device, VkPhysicalDevice physicalDevice, VkImage& image, VkDeviceMemory& imageMemory, VkMemoryPropertyFlags properties, VkImageCreateInfo& imageInfo, VkDeviceSize memoryOffset = 0);
+	void CreateBuffer(VkDevice device, MemoryAllocator& allocator, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory,VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE);
+	void DestroyBuffer(VkDevice device, MemoryAllocator& allocator, VkBuffer& buffer, MemoryAllocation& bufferMemory);
+	void CopyBuffer(VkDevice device, VkCommandPool commandPool, VkQueue submitQueue, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize _size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0);
+	void CreateVertexUniforBuffer(VkDevice device, MemoryAllocator& allocator, std::vector<VkBuffer>& buffer, std::vector<MemoryAllocation>& bufferMemory, std::vector<void*>& mappedMemory, uint32_t bufferCount = 2);
+	void CreateImage(VkDevice device, MemoryAllocator& allocator, VkImage& image, MemoryAllocation& imageMemory, VkMemoryPropertyFlags properties, VkImageCreateInfo& imageInfo);
+	void DestroyImage(VkDevice device, MemoryAllocator& allocator, VkImage& image, MemoryAllocation& imageMemory);
 	VkCommandBuffer BeginSingleTimeCommand(VkDevice device, VkCommandPool commandPool);
 	void EndSingleTimeCommand(VkDevice device, VkCommandPool commandPool, VkQueue submitQueue, VkCommandBuffer commandBuffer);
 	void transitionImageLayout(VkDevice device, VkCommandPool commandPool, VkQueue submitQueue, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout,uint32_t mipLevels);
+	void CmdTransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
 	std::string getPath(const std::string& filename);
 }
 
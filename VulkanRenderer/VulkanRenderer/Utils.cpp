@@ -92,6 +92,17 @@ namespace Utils
 			if (result.isComplete()) break;
 			++i;
 		}
+		//transfer family for uploads : transfer only(DMA engine) first, any non graphics family with transfer second
+		bool transferOnly = false;
+		for (uint32_t j = 0; j < queueFamilyCount; j++) {
+			VkQueueFlags flags = queueFamilies[j].queueFlags;
+			if ((flags & VK_QUEUE_GRAPHICS_BIT) || !(flags & VK_QUEUE_TRANSFER_BIT)) continue;
+			bool isTransferOnly = !(flags & VK_QUEUE_COMPUTE_BIT);
+			if (!result.transferFamily.has_value() || (isTransferOnly && !transferOnly)) {
+				result.transferFamily = j;
+				transferOnly = isTransferOnly;
+			}
+		}
 		return result;
 	}
 
@@ -172,52 +183,52 @@ namespace Utils
 		throw std::runtime_error("failed to find suitable memory type!");
 	}
 
-	void Utils::CreateBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, VkSharingMode sharingMode, VkDeviceSize memoffset) {
+	void Utils::CreateBuffer(VkDevice device, MemoryAllocator& allocator, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory, VkSharingMode sharingMode) {
 		VkBufferCreateInfo bufferInfo = Initializer::InitBufferCreateInfo(size, usage, sharingMode);
 		if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create buffer!");
 		}
-		VkMemoryRequirements memRequirements;
-		vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-
-		VkMemoryAllocateInfo allocInfo = Initializer::InitMemoryAllocateInfo(memRequirements.size, findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties));
-		if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate vertex buffer memory!");
-		}
-		vkBindBufferMemory(device, buffer, bufferMemory, memoffset);
+		bufferMemory = allocator.AllocateForBuffer(buffer, properties);
+		vkBindBufferMemory(device, buffer, bufferMemory.memory, bufferMemory.offset);
+	}
+	void Utils::DestroyBuffer(VkDevice device, MemoryAllocator& allocator, VkBuffer& buffer, MemoryAllocation& bufferMemory) {
+		vkDestroyBuffer(device, buffer, nullptr);
+		allocator.Free(bufferMemory);
+		buffer = VK_NULL_HANDLE;
 	}
-	void Utils::CopyBuffer(VkDevice device, VkCommandPool commandPool,VkQueue submitQueue, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize _size) {
+	void Utils::CopyBuffer(VkDevice device, VkCommandPool commandPool,VkQueue submitQueue, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize _size, VkDeviceSize srcOffset, VkDeviceSize dstOffset) {
 		VkCommandBuffer commandBuffer = BeginSingleTimeCommand(device, commandPool);
 
 		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = srcOffset;
+		copyRegion.dstOffset = dstOffset;
 		copyRegion.size = _size;
 		vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 		EndSingleTimeCommand(device, commandPool, submitQueue, commandBuffer);
 
 	}
-	void Utils::CreateVertexUniforBuffer(VkDevice device,VkPhysicalDevice physicalDevice ,std::vector<VkBuffer>& buffer, std::vector<VkDeviceMemory>& bufferMemory, std::vector<void*>& mappedMemory, uint32_t bufferCount) {
+	void Utils::CreateVertexUniforBuffer(VkDevice device, MemoryAllocator& allocator, std::vector<VkBuffer>& buffer, std::vector<MemoryAllocation>& bufferMemory, std::vector<void*>& mappedMemory, uint32_t bufferCount) {
 		buffer.resize(bufferCount);
 		bufferMemory.resize(bufferCount);
 		mappedMemory.resize(bufferCount);
 		for (int i = 0; i < bufferCount; i++) {
-			Utils::CreateBuffer(device, physicalDevice, sizeof(GlobalStructs::VertexShaderUBO), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			Utils::CreateBuffer(device, allocator, sizeof(GlobalStructs::VertexShaderUBO), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,buffer[i],bufferMemory[i]);
-			vkMapMemory(device, bufferMemory[i], 0, sizeof(GlobalStructs::VertexShaderUBO), 0, &mappedMemory[i]);
+			mappedMemory[i] = bufferMemory[i].mapped; //allocator keeps host visible blocks persistently mapped
 		}
 	}
 
-	void Utils::CreateImage(VkDevice device, VkPhysicalDevice physicalDevice, VkImage& image, VkDeviceMemory& imageMemory, VkMemoryPropertyFlags properties, VkImageCreateInfo& imageInfo, VkDeviceSize memoryOffset) {
+	void Utils::CreateImage(VkDevice device, MemoryAllocator& allocator, VkImage& image, MemoryAllocation& imageMemory, VkMemoryPropertyFlags properties, VkImageCreateInfo& imageInfo) {
 		if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create image!");
 		}
-		VkMemoryRequirements memRequirements;
-		vkGetImageMemoryRequirements(device, image, &memRequirements);
-
-		VkMemoryAllocateInfo allocInfo = Initializer::InitMemoryAllocateInfo(memRequirements.size, findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties));
-		if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate Image memory!");
-		}
-		vkBindImageMemory(device, image, imageMemory, memoryOffset);
+		imageMemory = allocator.AllocateForImage(image, properties, imageInfo.tiling);
+		vkBindImageMemory(device, image, imageMemory.memory, imageMemory.offset);
+	}
+	void Utils::DestroyImage(VkDevice device, MemoryAllocator& allocator, VkImage& image, MemoryAllocation& imageMemory) {
+		vkDestroyImage(device, image, nullptr);
+		allocator.Free(imageMemory);
+		image = VK_NULL_HANDLE;
 	}
 	VkCommandBuffer Utils::BeginSingleTimeCommand(VkDevice device, VkCommandPool commandPool) {
 		VkCommandBufferAllocateInfo allocInfo = Initializer::InitCommandBufferAllocateInfo(commandPool, 1);
@@ -240,6 +251,11 @@ namespace Utils
 	}
 	void Utils::transitionImageLayout(VkDevice device, VkCommandPool commandPool,VkQueue submitQueue, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels) {
 		VkCommandBuffer commandBuffer = BeginSingleTimeCommand(device,commandPool);
+		CmdTransitionImageLayout(commandBuffer, image, format, oldLayout, newLayout, mipLevels);
+		EndSingleTimeCommand(device, commandPool, submitQueue, commandBuffer);
+	}
+
+	void Utils::CmdTransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels) {
 		bool hasStencilComponent = format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT ? true : false;
 		VkImageMemoryBarrier barrier = Initializer::InitImageMemoryBarrier(image,oldLayout,newLayout,mipLevels,hasStencilComponent);
 		VkPipelineStageFlagBits sourceStage;
@@ -273,7 +289,6 @@ namespace Utils
 			0, nullptr,
 			1, &barrier
 		);
-		EndSingleTimeCommand(device, commandPool, submitQueue, commandBuffer);
 	}
 
 	std::string Utils::getPath(const std::string& filename) {
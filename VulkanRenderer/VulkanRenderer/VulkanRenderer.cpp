@@ -14,6 +14,7 @@
 #include "Model/Model.hpp"
 
 void CreateShadowMap(int, VkCommandBuffer);
+void GetLightMatrices(glm::mat4&, glm::mat4&);
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
@@ -24,6 +25,12 @@ Camera mainCamera;
 DirectionalLight sun;
 Model model;
 Model plane;
+//one per drawn instance, the shadow pass follows the main pass's selection
+LodState modelLods[2];
+LodState planeLods;
+//gpu meshlet culling of each model instance, [instance][0] camera, [instance][1] light
+CullTarget modelCulls[2][2];
+const glm::vec3 instanceOffsets[2] = { glm::vec3(0.0f), glm::vec3(0.2f, 0.1f, 0.2f) };
 GlobalStructs::VertexShaderUBO vert_ubo{};
 GlobalStructs::FragmentShaderUBO frag_ubo{};
 
@@ -31,7 +38,7 @@ FrameBuffer shadowFramebuffer;
 Texture shadowMap;
 VkSampler shadowSampler;
 std::vector<VkBuffer> ShadowVertexUnifomrBuffer;
-std::vector<VkDeviceMemory> ShadowVertexUniformBuffersMemory;
+std::vector<MemoryAllocation> ShadowVertexUniformBuffersMemory;
 std::vector<void*> ShadowVertexUniformBuffersMapped;
 VkRenderPass shadowMapRenderPass;
 VkPipelineLayout shadowMapPipeLayout = VK_NULL_HANDLE;
@@ -42,14 +49,18 @@ VkDescriptorPool shadowDescriptorPool;
 
 
 void Clean() {
+	for (auto& culls : modelCulls) {
+		culls[0].Clean();
+		culls[1].Clean();
+	}
 	model.Clean();
 	plane.Clean();
+	PrimitiveMesh::Clean();
 	shadowMap.Clean();
 	shadowFramebuffer.Clean();
 	vkDestroySampler(renderer->device, shadowSampler, nullptr);
 	for (int i = 0; i < shadowDescriptorSets.size(); i++) {
-		vkDestroyBuffer(renderer->device, ShadowVertexUnifomrBuffer[i], nullptr);
-		vkFreeMemory(renderer->device, ShadowVertexUniformBuffersMemory[i], nullptr);
+		Utils::DestroyBuffer(renderer->device, renderer->allocator, ShadowVertexUnifomrBuffer[i], ShadowVertexUniformBuffersMemory[i]);
 	}
 	
 	vkDestroyDescriptorPool(renderer->device, shadowDescriptorPool,nullptr);
@@ -78,13 +89,27 @@ void SetPhysicalDeviceFeatures(VkPhysicalDeviceFeatures& deviceFeatures) {
 }
 
 void drawFunc(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer, uint32_t currentFrame) {
-	//ShadowMap
-	CreateShadowMap(currentFrame, commandBuffer);
-
 	Renderer* renderer = Renderer::GetInstance();
 	if (renderer == nullptr) return;
 
 	VkExtent2D swapChainExtent = renderer->GetSwapChainExtent();
+	//meshlet culling of both passes runs on the gpu before the first render pass
+	glm::mat4 cameraProj = mainCamera.GetProjMat(swapChainExtent.width, swapChainExtent.height);
+	cameraProj[1][1] *= -1;
+	glm::mat4 lightViewMat, lightProj;
+	GetLightMatrices(lightViewMat, lightProj);
+	CullView cameraView = CullView::FromMatrices(mainCamera.GetViewMat(), cameraProj, static_cast<float>(swapChainExtent.height));
+	CullView lightView = CullView::FromMatrices(lightViewMat, lightProj);
+	for (int i = 0; i < 2; i++) {
+		model.SetPosition(pos + instanceOffsets[i]);
+		model.Cull(commandBuffer, cameraView, modelCulls[i][0]);
+		model.Cull(commandBuffer, lightView, modelCulls[i][1]);
+	}
+	CullTarget::Barrier(commandBuffer);
+
+	//ShadowMap
+	CreateShadowMap(currentFrame, commandBuffer);
+
 	std::array<VkClearValue, 2> clearValues{};
 	clearValues[0].color = { {0.3f, 0.3f, 0.3f, 1.0f} };
 	clearValues[1].depthStencil = { 1.0f, 0 };
@@ -102,11 +127,8 @@ void drawFunc(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer, uint32_t
 	VkDescriptorSet descriptorSet = renderer->GetDescriptorSet(currentFrame);
 
 	//update vertex ubo
-	VkExtent2D swapchainExtent = renderer->GetSwapChainExtent();
-
 	vert_ubo.view = mainCamera.GetViewMat();
-	vert_ubo.proj = mainCamera.GetProjMat(swapChainExtent.width, swapchainExtent.height);
-	vert_ubo.proj[1][1] *= -1;
+	vert_ubo.proj = cameraProj;
 	renderer->UpdateVertexUniformBuffer(currentFrame, vert_ubo);
 
 	//update frament ubo
@@ -123,12 +145,12 @@ void drawFunc(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer, uint32_t
 	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->GetPipelineLayout(), 0, 1, &descriptorSet, 0, nullptr);
 	//bind texture
 	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->GetPipelineLayout(), 1, 1, &renderer->texDescriptorSets[currentFrame], 0, nullptr);
-	model.SetPosition(pos);
-	model.Draw(commandBuffer, renderer->GetPipelineLayout(), renderer->texDescriptorSets[currentFrame], renderer->GetDefaultSampler());
-	model.SetPosition(pos + glm::vec3(0.2f, 0.1f, 0.2f));
-	model.Draw(commandBuffer, renderer->GetPipelineLayout(), renderer->texDescriptorSets[currentFrame], renderer->GetDefaultSampler());
+	for (int i = 0; i < 2; i++) {
+		model.SetPosition(pos + instanceOffsets[i]);
+		model.Draw(commandBuffer, renderer->GetPipelineLayout(), renderer->texDescriptorSets[currentFrame], renderer->GetDefaultSampler(), glm::mat4(1), &cameraView, &modelLods[i], &modelCulls[i][0]);
+	}
 	glm::mat4 modelMat = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f)) * glm::rotate(glm::mat4(1), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-	plane.Draw(commandBuffer, renderer->GetPipelineLayout(), renderer->texDescriptorSets[currentFrame], renderer->GetDefaultSampler(),modelMat);
+	plane.Draw(commandBuffer, renderer->GetPipelineLayout(), renderer->texDescriptorSets[currentFrame], renderer->GetDefaultSampler(), modelMat, &cameraView, &planeLods);
 }
 #pragma endregion
 
@@ -200,20 +222,24 @@ void CreateShadowMap(int currentFrame, VkCommandBuffer CommandBuffer) {
 	vkCmdSetScissor(CommandBuffer, 0, 1, &Scissor);
 	vkCmdSetDepthBias(CommandBuffer, 1.25f, 0.0f, 1.75f);
 	vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowMapPipeline);
-	vert_ubo.view = glm::lookAt(sun.direction, vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
-	vert_ubo.proj = glm::ortho(0.0f, 1.0f, -0.5f, 0.5f, 0.1f, 100.0f);
-	vert_ubo.proj[1][1] *= -1;
+	GetLightMatrices(vert_ubo.view, vert_ubo.proj);
 	vert_ubo.lightSpaceMat = vert_ubo.proj * vert_ubo.view;
 	memcpy(ShadowVertexUniformBuffersMapped[currentFrame], &vert_ubo, sizeof(vert_ubo));
 	vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowMapPipeLayout, 0, 1, &shadowDescriptorSets[currentFrame], 0, nullptr);
-	model.SetPosition(pos);
-	model.Draw(CommandBuffer, renderer->GetPipelineLayout(), renderer->texDescriptorSets[currentFrame], renderer->GetDefaultSampler());
-	model.SetPosition(pos + glm::vec3(0.2f,0.1f,0.2f));
-	model.Draw(CommandBuffer, renderer->GetPipelineLayout(), renderer->texDescriptorSets[currentFrame], renderer->GetDefaultSampler());
+	CullView lightView = CullView::FromMatrices(vert_ubo.view, vert_ubo.proj);
+	for (int i = 0; i < 2; i++) {
+		model.SetPosition(pos + instanceOffsets[i]);
+		model.DrawDepth(CommandBuffer, shadowMapPipeLayout, glm::mat4(1), &lightView, &modelLods[i], &modelCulls[i][1]);
+	}
 	glm::mat4 modelMat = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f)) * glm::rotate(glm::mat4(1), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-	plane.Draw(CommandBuffer, shadowMapPipeLayout, nullptr, nullptr, modelMat);
+	plane.DrawDepth(CommandBuffer, shadowMapPipeLayout, modelMat, &lightView, &planeLods);
 	vkCmdEndRenderPass(CommandBuffer);
 }
+void GetLightMatrices(glm::mat4& view, glm::mat4& proj) {
+	view = glm::lookAt(sun.direction, vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
+	proj = glm::ortho(0.0f, 1.0f, -0.5f, 0.5f, 0.1f, 100.0f);
+	proj[1][1] *= -1;
+}
 void PrepareShadowMap() {
 	//RenderPass
 	PipelineBuilder::RenderPassCreateInfos infos{};
@@ -229,21 +255,28 @@ void PrepareShadowMap() {
 	infos.subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 	infos.subpasses[0].pDepthStencilAttachment = &depthAttachmentRef;
 
-	infos.dependencies.emplace_back();
+	infos.dependencies.resize(2);
 
-	
+	//one shadow map is shared by every frame in flight : wait until the previous frame stopped sampling it
 	infos.dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 	infos.dependencies[0].dstSubpass = 0;
-	infos.dependencies[0].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	infos.dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 	infos.dependencies[0].srcAccessMask = 0;
-	infos.dependencies[0].dstStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	infos.dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
 	infos.dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	//and make the depth writes visible to the main pass
+	infos.dependencies[1].srcSubpass = 0;
+	infos.dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	infos.dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	infos.dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	infos.dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	infos.dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
 	PipelineBuilder::CreateRenderPass(shadowMapRenderPass, renderer->device, infos);
 
 	//DescriptorSet
 	DescriptorBuilder::CreateVertexUBO_DescriptorSets(renderer->device, shadowDescriptorSetLayout, shadowDescriptorPool, shadowDescriptorSets);
-	Utils::CreateVertexUniforBuffer(renderer->device, renderer->physicalDevice, ShadowVertexUnifomrBuffer, ShadowVertexUniformBuffersMemory, ShadowVertexUniformBuffersMapped, MAX_FRAMES_IN_FLIGHT);
+	Utils::CreateVertexUniforBuffer(renderer->device, renderer->allocator, ShadowVertexUnifomrBuffer, ShadowVertexUniformBuffersMemory, ShadowVertexUniformBuffersMapped, MAX_FRAMES_IN_FLIGHT);
 	std::vector<VkWriteDescriptorSet> writes;
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 		VkDescriptorBufferInfo vertBufferInfo = Initializer::InitDescriptorBufferInfo(ShadowVertexUnifomrBuffer[i], sizeof(GlobalStructs::VertexShaderUBO));
@@ -252,8 +285,10 @@ void PrepareShadowMap() {
 	vkUpdateDescriptorSets(renderer->device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 
 	vector<VkDescriptorSetLayout> desc_set = { shadowDescriptorSetLayout};
-	//Pipeline
-	PipelineBuilder::CreateGraphicsPipeline(shadowMapPipeline, shadowMapPipeLayout, renderer->device, "ShadowMappingVert.spv", "ShadowMappingFrag.spv", shadowMapRenderPass, desc_set);
+	//Pipeline, the shadow pass only fetches positions
+	PipelineBuilder::PipelineCreateInfos shadowInfos;
+	shadowInfos.SetVertexLayout<CompactDepthLayout>();
+	PipelineBuilder::CreateGraphicsPipeline(shadowMapPipeline, shadowMapPipeLayout, renderer->device, "ShadowMapping.vert", "ShadowMapping.frag", shadowMapRenderPass, desc_set, shadowInfos);
 	
 	//Texture
 	shadowMap.Create(2048.f, 2048.f, depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
@@ -285,6 +320,7 @@ int main()
 	sun.intensity = 2.0f;
 	frag_ubo.dirLight = sun;
 	PrepareShadowMap();
+	renderer->allocator.PrintStats();
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
 		float deltaTime = renderer->GetDeltaTime();